@@ -0,0 +1,202 @@
+// 前端性能测试：用合成程序测量词法分析和语法分析的吞吐量
+//
+// 每种形状在独立的子进程中生成和测量，峰值内存互不影响。
+// 输出每种形状的 MB/s、tokens/s（Lexer::getAllTokens）、
+// nodes/s（Parser::parse）和子进程的峰值 RSS。
+
+#include "generator.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct BenchOptions {
+    std::vector<ProgramShape> shapes;
+    GeneratorOptions generator;
+    int repeat = 5;
+    bool emit = false;
+};
+
+struct BenchResult {
+    size_t bytes = 0;
+    size_t tokens = 0;
+    size_t nodes = 0;
+    double lexSeconds = 0;
+    double parseSeconds = 0;
+    long peakRssKb = 0;
+};
+
+double now() {
+    using Clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+
+// 统计AST节点数
+size_t countNodes(const ASTNode& node) {
+    size_t count = 1;
+    visitChildren(node, [&](const ASTNode& child) { count += countNodes(child); });
+    return count;
+}
+
+// 取多次运行中的最短时间，减少调度噪声
+BenchResult measure(const std::string& source, int repeat) {
+    BenchResult result;
+    result.bytes = source.size();
+    result.lexSeconds = result.parseSeconds = 1e30;
+
+    for (int i = 0; i < repeat; i++) {
+        double start = now();
+        Lexer lexer(source);
+        std::vector<Token> tokens = lexer.getAllTokens();
+        result.lexSeconds = std::min(result.lexSeconds, now() - start);
+        result.tokens = tokens.size();
+    }
+
+    for (int i = 0; i < repeat; i++) {
+        double start = now();
+        Lexer lexer(source);
+        Parser parser(lexer);
+        std::unique_ptr<ProgramNode> program = parser.parse();
+        result.parseSeconds = std::min(result.parseSeconds, now() - start);
+        result.nodes = countNodes(*program);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peakRssKb = usage.ru_maxrss;
+    return result;
+}
+
+// 在子进程中生成并测量，结果通过管道传回
+bool runIsolated(ProgramShape shape, const BenchOptions& options, BenchResult& result) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        close(fds[0]);
+        int status = 0;
+        try {
+            GeneratorOptions generator = options.generator;
+            generator.shape = shape;
+            BenchResult child = measure(generateProgram(generator), options.repeat);
+            if (write(fds[1], &child, sizeof(child)) != static_cast<ssize_t>(sizeof(child))) status = 1;
+        } catch (const std::exception& e) {
+            std::cerr << programShapeName(shape) << ": " << e.what() << std::endl;
+            status = 1;
+        }
+        _exit(status);
+    }
+    close(fds[1]);
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return got == static_cast<ssize_t>(sizeof(result)) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --shape=<mixed|functions|nesting|comments|arrays|all>  program shape (default: all)\n"
+              << "  --size=<MB>        approximate program size in megabytes (default: 1)\n"
+              << "  --repeat=<N>       runs per measurement, the fastest is reported (default: 5)\n"
+              << "  --seed=<N>         generator seed (default: 1)\n"
+              << "  --depth=<N>        parenthesis depth for the nesting shape (default: 64)\n"
+              << "  --width=<N>        array length for the arrays shape (default: 4096)\n"
+              << "  --emit             print the generated program instead of benchmarking\n";
+}
+
+bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+    bool allShapes = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        size_t equals = arg.find('=');
+        if (equals != std::string::npos) {
+            value = arg.substr(equals + 1);
+            arg = arg.substr(0, equals);
+        }
+        if (arg == "--shape") {
+            ProgramShape shape;
+            if (value == "all") {
+                allShapes = true;
+            } else if (parseProgramShape(value, shape)) {
+                allShapes = false;
+                options.shapes.assign(1, shape);
+            } else {
+                std::cerr << "Unknown shape: " << value << "\n";
+                return false;
+            }
+        } else if (arg == "--size") {
+            options.generator.targetBytes = static_cast<size_t>(std::atof(value.c_str()) * (1 << 20));
+        } else if (arg == "--repeat") {
+            options.repeat = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--seed") {
+            options.generator.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--depth") {
+            options.generator.nestingDepth = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--width") {
+            options.generator.arrayWidth = std::max(2, std::atoi(value.c_str()));
+        } else if (arg == "--emit") {
+            options.emit = true;
+        } else {
+            return false;
+        }
+    }
+    if (allShapes) {
+        options.shapes = {ProgramShape::FUNCTIONS, ProgramShape::NESTING, ProgramShape::COMMENTS,
+                          ProgramShape::ARRAYS, ProgramShape::MIXED};
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.emit) {
+        GeneratorOptions generator = options.generator;
+        generator.shape = options.shapes.front();
+        std::cout << generateProgram(generator);
+        return 0;
+    }
+
+    std::printf("%-10s %8s %10s %9s %8s %10s %10s %9s %9s\n", "shape", "MB", "tokens", "lex MB/s",
+                "Mtok/s", "nodes", "parse MB/s", "Mnodes/s", "RSS MB");
+    int failures = 0;
+    for (ProgramShape shape : options.shapes) {
+        BenchResult result;
+        if (!runIsolated(shape, options, result)) {
+            std::printf("%-10s FAILED\n", programShapeName(shape));
+            failures++;
+            continue;
+        }
+        double megabytes = result.bytes / double(1 << 20);
+        std::printf("%-10s %8.2f %10zu %9.1f %8.2f %10zu %10.1f %9.2f %9.1f\n", programShapeName(shape),
+                    megabytes, result.tokens, megabytes / result.lexSeconds,
+                    result.tokens / result.lexSeconds / 1e6, result.nodes,
+                    megabytes / result.parseSeconds, result.nodes / result.parseSeconds / 1e6,
+                    result.peakRssKb / 1024.0);
+        std::fflush(stdout);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+#include "generator.h"
+
+namespace {
+
+// 每隔这么多个函数出现一个不调用其他函数的叶函数，限制运行时的调用深度
+const int callChainLimit = 64;
+
+const char* const loremWords[] = {
+    "lexer", "parser", "token", "scanner", "buffer", "symbol", "scope", "slot",
+    "register", "frame", "array", "index", "while", "return", "comment", "block",
+    "expression", "statement", "function", "argument", "value", "offset", "table", "node"
+};
+
+// 合成程序生成器：所有函数都是 int f(int a, int b)，只调用编号更小的函数
+class ProgramGenerator {
+public:
+    explicit ProgramGenerator(const GeneratorOptions& options)
+        : options(options), state(options.seed), functionCount(0), globalCount(0) {}
+
+    std::string generate() {
+        out.reserve(options.targetBytes + 4096);
+        out += "/* generated C- program, shape=";
+        out += programShapeName(options.shape);
+        out += " */\n\n";
+
+        int round = 0;
+        while (out.size() < options.targetBytes) {
+            ProgramShape shape = options.shape;
+            if (shape == ProgramShape::MIXED) {
+                shape = static_cast<ProgramShape>(1 + round % 4);
+            }
+            switch (shape) {
+                case ProgramShape::NESTING:  nestingFunction(); break;
+                case ProgramShape::COMMENTS: commentBlock(); smallFunction(); break;
+                case ProgramShape::ARRAYS:   arrayFunction(); break;
+                default:                     smallFunction(); break;
+            }
+            round++;
+        }
+
+        out += "int main(void) {\n";
+        if (functionCount > 0) {
+            out += "    output(f" + std::to_string(functionCount - 1) + "(1, 2));\n";
+        }
+        out += "    return 0;\n}\n";
+        return std::move(out);
+    }
+
+private:
+    // splitmix64
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    int below(int bound) { return static_cast<int>(next() % static_cast<uint64_t>(bound)); }
+
+    std::string number() { return std::to_string(below(1000)); }
+
+    // 标量操作数：参数、局部变量或常量
+    std::string leaf() {
+        switch (below(5)) {
+            case 0: return "a";
+            case 1: return "b";
+            case 2: return "x";
+            case 3: return "y";
+            default: return number();
+        }
+    }
+
+    // 除数总是非零常量，保证程序可以运行
+    std::string binaryOp(const std::string& left, const std::string& right) {
+        switch (below(4)) {
+            case 0: return left + " + " + right;
+            case 1: return left + " - " + right;
+            case 2: return left + " * " + right;
+            default: return left + " / " + std::to_string(1 + below(9));
+        }
+    }
+
+    std::string relop() {
+        static const char* const ops[] = {" < ", " <= ", " > ", " >= ", " == ", " != "};
+        return ops[below(6)];
+    }
+
+    // 小型表达式
+    std::string expression(int depth) {
+        if (depth <= 0 || below(3) == 0) return leaf();
+        std::string left = expression(depth - 1);
+        std::string right = expression(depth - 1);
+        if (below(4) == 0) return "(" + binaryOp(left, right) + ")";
+        return binaryOp(left, right);
+    }
+
+    // 调用更早生成的函数；叶函数不调用
+    std::string callOrLeaf() {
+        if (functionCount == 0 || functionCount % callChainLimit == 0) return leaf();
+        int callee = functionCount - 1 - below(functionCount < 8 ? functionCount : 8);
+        return "f" + std::to_string(callee) + "(" + expression(1) + ", " + expression(1) + ")";
+    }
+
+    void functionHeader() {
+        out += "int f" + std::to_string(functionCount) + "(int a, int b) {\n";
+        out += "    int x;\n    int y;\n";
+    }
+
+    void functionFooter(const std::string& result) {
+        out += "    return " + result + ";\n}\n\n";
+        functionCount++;
+    }
+
+    // 小函数：赋值、条件、循环和一次调用
+    void smallFunction() {
+        functionHeader();
+        out += "    x = " + expression(3) + ";\n";
+        out += "    y = 0;\n";
+        out += "    while (y < " + std::to_string(2 + below(8)) + ") {\n";
+        out += "        if (" + expression(2) + relop() + expression(2) + ") {\n";
+        out += "            x = " + expression(2) + ";\n";
+        out += "        } else {\n";
+        out += "            x = x - " + leaf() + ";\n";
+        out += "        }\n";
+        out += "        y = y + 1;\n";
+        out += "    }\n";
+        if (below(4) == 0) {
+            out += "    /* " + std::string(loremWords[below(24)]) + " */\n";
+        }
+        functionFooter(callOrLeaf() + " + x");
+    }
+
+    // 深度嵌套：一半向右嵌套（递归下降逐层深入），一半向左嵌套（括号紧挨着开头）
+    void nestingFunction() {
+        functionHeader();
+        int depth = options.nestingDepth;
+        std::string expr;
+        for (int i = 0; i < depth / 2; i++) {
+            expr += "(" + leaf();
+            expr += below(2) ? " + " : " * ";
+        }
+        expr += leaf();
+        expr.append(depth / 2, ')');
+        out += "    x = " + expr + ";\n";
+
+        std::string chain(depth - depth / 2, '(');
+        chain += leaf();
+        for (int i = 0; i < depth - depth / 2; i++) {
+            chain += below(2) ? " - " : " + ";
+            chain += leaf() + ")";
+        }
+        out += "    y = " + chain + ";\n";
+        functionFooter(callOrLeaf() + " + x + y");
+    }
+
+    // 长注释块：多行、多种长度，测试扫描注释的速度
+    void commentBlock() {
+        out += "/*\n";
+        for (int line = 0; line < options.commentLines; line++) {
+            out += " *";
+            int words = 4 + below(10);
+            for (int w = 0; w < words; w++) {
+                out += ' ';
+                out += loremWords[below(24)];
+            }
+            out += '\n';
+        }
+        out += " */\n";
+    }
+
+    // 宽数组：一个全局数组和一个局部数组，循环中做下标运算
+    void arrayFunction() {
+        int width = options.arrayWidth > 2 ? options.arrayWidth : 2;
+        std::string global = "g" + std::to_string(globalCount++);
+        std::string size = std::to_string(width);
+        out += "int " + global + "[" + size + "];\n\n";
+
+        functionHeader();
+        out += "    int i;\n    int t[64];\n";
+        out += "    i = 0;\n";
+        out += "    while (i < " + size + ") {\n";
+        out += "        t[i - i / 64 * 64] = i * " + number() + ";\n";
+        out += "        " + global + "[i] = " + global + "[(i + 1) / 2] + t[i - i / 64 * 64] - " + leaf() + ";\n";
+        out += "        i = i + 1;\n";
+        out += "    }\n";
+        out += "    x = " + global + "[" + std::to_string(below(width)) + "];\n";
+        out += "    y = t[" + std::to_string(below(64)) + "];\n";
+        functionFooter(callOrLeaf() + " + x - y");
+    }
+
+    const GeneratorOptions& options;
+    uint64_t state;
+    std::string out;
+    int functionCount;
+    int globalCount;
+};
+
+} // namespace
+
+std::string generateProgram(const GeneratorOptions& options) {
+    return ProgramGenerator(options).generate();
+}
+
+bool parseProgramShape(const std::string& name, ProgramShape& shape) {
+    static const ProgramShape shapes[] = {
+        ProgramShape::MIXED, ProgramShape::FUNCTIONS, ProgramShape::NESTING,
+        ProgramShape::COMMENTS, ProgramShape::ARRAYS
+    };
+    for (ProgramShape candidate : shapes) {
+        if (name == programShapeName(candidate)) {
+            shape = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* programShapeName(ProgramShape shape) {
+    switch (shape) {
+        case ProgramShape::FUNCTIONS: return "functions";
+        case ProgramShape::NESTING:   return "nesting";
+        case ProgramShape::COMMENTS:  return "comments";
+        case ProgramShape::ARRAYS:    return "arrays";
+        default:                      return "mixed";
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 合成程序的形状
+enum class ProgramShape {
+    MIXED,      // 以下各种形状轮流出现
+    FUNCTIONS,  // 大量小函数，互相调用
+    NESTING,    // 深度嵌套的括号表达式
+    COMMENTS,   // 长注释块，代码很少
+    ARRAYS      // 大数组和下标运算
+};
+
+// 生成器选项
+struct GeneratorOptions {
+    ProgramShape shape = ProgramShape::MIXED;
+    size_t targetBytes = 1 << 20;  // 达到这个大小后停止添加新函数
+    int nestingDepth = 64;         // NESTING 形状的表达式括号层数
+    int arrayWidth = 4096;         // ARRAYS 形状的数组长度
+    int commentLines = 64;         // COMMENTS 形状每个注释块的行数
+    uint64_t seed = 1;
+};
+
+// 确定性地生成一个语法和语义都合法的 C- 程序：相同的选项总是得到相同的文本
+std::string generateProgram(const GeneratorOptions& options);
+
+// 形状名称与枚举互转，未知名称返回 false
+bool parseProgramShape(const std::string& name, ProgramShape& shape);
+const char* programShapeName(ProgramShape shape);
+
+#endif // GENERATOR_H
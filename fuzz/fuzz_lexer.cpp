@@ -0,0 +1,41 @@
+// libFuzzer 入口：词法分析器
+//
+// 除了不崩溃，还检查Token序列的基本性质：Token依次排列且位置处正是其词素，
+// 除EOF外词素非空，行号不递减。违反时 abort，由 libFuzzer 或独立驱动程序保存输入。
+
+#include "lexer.h"
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    // 直接在输入上做词法分析，越界读取由 AddressSanitizer 发现
+    std::string_view source(reinterpret_cast<const char*>(data), size);
+
+    // Token 缓冲区跨迭代复用（与 CompilerContext 相同），测量的是词法分析而不是分配。
+    // 词法错误（未结束的注释等）是预期结果，出错之前得到的 Token 同样检查
+    static std::vector<Token> tokens;
+    Lexer lexer(source);
+    bool complete = true;
+    try {
+        lexer.tokenize(tokens);
+    } catch (const std::runtime_error&) {
+        complete = false;
+    }
+
+    int line = 1;
+    size_t end = 0;
+    for (const Token& token : tokens) {
+        if (token.start < end || token.start > size) std::abort();
+        int tokenLine = lexer.sourceManager()->line(token.start);
+        if (tokenLine < line) std::abort();
+        line = tokenLine;
+        if (token.type == TokenType::END_OF_FILE) break;
+        if (token.lexeme.empty() || source.substr(token.start, token.lexeme.size()) != token.lexeme) std::abort();
+        end = token.start + token.lexeme.size();
+    }
+    if (complete && (tokens.empty() || tokens.back().type != TokenType::END_OF_FILE)) std::abort();
+    return 0;
+}
@@ -0,0 +1,40 @@
+// libFuzzer 入口：词法分析器 + 语法分析器
+//
+// 非法输入只能以 std::runtime_error 报告；其他异常（如 std::out_of_range）
+// 和栈溢出都视为缺陷。
+
+#include "lexer.h"
+#include "parser.h"
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    // 直接在输入上做词法分析，越界读取由 AddressSanitizer 发现
+    std::string_view source(reinterpret_cast<const char*>(data), size);
+
+    // 与 CompilerContext 一样先词法分析到 Token 缓冲区再解析，缓冲区跨迭代复用，
+    // 测量的是前端而不是分配。解析会移走 Token 的词素，所以每种模式重新词法分析
+    static std::vector<Token> tokens;
+
+    // 两种模式各解析一遍：hash-consing 共享节点的引用计数错误由 AddressSanitizer 发现
+    for (bool hashConsing : {false, true}) {
+        try {
+            Lexer lexer(source);
+            lexer.tokenize(tokens);
+            Parser parser(std::move(tokens), lexer.sourceManager());
+            parser.setHashConsing(hashConsing);
+            try {
+                auto program = parser.parse();
+            } catch (const std::runtime_error&) {
+                // 语法错误是预期结果
+            }
+            tokens = parser.releaseTokens();
+        } catch (const std::runtime_error&) {
+            // 词法错误是预期结果
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,269 @@
+// 没有 libFuzzer（如 GCC 构建）时的驱动程序
+//
+// 参数与 libFuzzer 相同的子集：
+//   cminus_parser_fuzzer [-runs=N] [-seed=N] [-max_len=N] [-dict=file] <文件或目录>...
+// 先在进程内依次执行全部语料，然后在语料基础上做 N 次随机变异（翻转、插入、删除、
+// 字典Token、拼接）。所有迭代都在同一进程内完成，不做进程或 iostream 初始化；
+// 定期和结束时输出 exec/s。没有覆盖率反馈，需要覆盖率引导时用 Clang 构建。
+// 崩溃时把当前输入写入 crash-input 以便复现。
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace {
+
+using Input = std::vector<uint8_t>;
+
+// 当前正在执行的输入，崩溃时保存
+const uint8_t* currentData = nullptr;
+size_t currentSize = 0;
+
+void saveCrash() {
+    int fd = open("crash-input", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    size_t written = 0;
+    while (written < currentSize) {
+        ssize_t n = write(fd, currentData + written, currentSize - written);
+        if (n <= 0) break;
+        written += static_cast<size_t>(n);
+    }
+    close(fd);
+    const char message[] = "==fuzz== crash, input saved to crash-input\n";
+    ssize_t ignored = write(2, message, sizeof(message) - 1);
+    (void)ignored;
+}
+
+void onSignal(int sig) {
+    saveCrash();
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
+
+void onTerminate() {
+    saveCrash();
+    std::abort();
+}
+
+bool readFile(const std::string& path, Input& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// 读取文件或目录（不递归）中的所有输入
+void loadInputs(const std::string& path, std::vector<Input>& corpus) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        Input data;
+        if (readFile(path, data)) corpus.push_back(std::move(data));
+        return;
+    }
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        std::string child = path + "/" + name;
+        if (stat(child.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            Input data;
+            if (readFile(child, data)) corpus.push_back(std::move(data));
+        }
+    }
+    closedir(dir);
+}
+
+// libFuzzer 字典格式：name="value"，支持 \" \\ \xNN 转义
+void loadDictionary(const std::string& path, std::vector<Input>& dictionary) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t open = line.find('"');
+        size_t close = line.rfind('"');
+        if (line.empty() || line[0] == '#' || open == std::string::npos || close <= open) continue;
+        Input token;
+        for (size_t i = open + 1; i < close; i++) {
+            if (line[i] == '\\' && i + 1 < close) {
+                char next = line[++i];
+                if (next == 'x' && i + 2 < close) {
+                    token.push_back(static_cast<uint8_t>(std::strtol(line.substr(i + 1, 2).c_str(), nullptr, 16)));
+                    i += 2;
+                    continue;
+                }
+                token.push_back(static_cast<uint8_t>(next));
+            } else {
+                token.push_back(static_cast<uint8_t>(line[i]));
+            }
+        }
+        if (!token.empty()) dictionary.push_back(std::move(token));
+    }
+}
+
+class Mutator {
+public:
+    Mutator(uint64_t seed, size_t maxLen, const std::vector<Input>& corpus, const std::vector<Input>& dictionary)
+        : state(seed), maxLen(maxLen), corpus(corpus), dictionary(dictionary) {}
+
+    // 在 data 上做 1~4 次变异，data 作为缓冲区跨迭代复用
+    void mutate(Input& data) {
+        int count = 1 + static_cast<int>(below(4));
+        for (int i = 0; i < count; i++) mutateOnce(data);
+        if (data.size() > maxLen) data.resize(maxLen);
+    }
+
+    uint64_t below(uint64_t bound) { return bound ? next() % bound : 0; }
+
+private:
+    // xorshift64*
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545f4914f6cdd1dULL;
+    }
+
+    void mutateOnce(Input& data) {
+        size_t pos = below(data.size() + 1);
+        switch (below(6)) {
+            case 0:  // 翻转一位
+                if (!data.empty()) data[below(data.size())] ^= static_cast<uint8_t>(1u << below(8));
+                break;
+            case 1:  // 插入随机字节
+                data.insert(data.begin() + pos, static_cast<uint8_t>(below(256)));
+                break;
+            case 2:  // 删除一段
+                if (!data.empty()) {
+                    size_t start = below(data.size());
+                    size_t length = 1 + below(std::min<size_t>(16, data.size() - start));
+                    data.erase(data.begin() + start, data.begin() + start + length);
+                }
+                break;
+            case 3:  // 插入字典中的Token
+                if (!dictionary.empty()) {
+                    const Input& token = dictionary[below(dictionary.size())];
+                    data.insert(data.begin() + pos, token.begin(), token.end());
+                }
+                break;
+            case 4:  // 复制自身的一段（制造重复和嵌套）
+                if (!data.empty()) {
+                    size_t start = below(data.size());
+                    size_t length = 1 + below(std::min<size_t>(64, data.size() - start));
+                    Input chunk(data.begin() + start, data.begin() + start + length);
+                    data.insert(data.begin() + pos, chunk.begin(), chunk.end());
+                }
+                break;
+            default:  // 拼接另一个语料
+                if (!corpus.empty()) {
+                    const Input& other = corpus[below(corpus.size())];
+                    size_t start = below(other.size() + 1);
+                    data.resize(pos);
+                    data.insert(data.end(), other.begin() + start, other.end());
+                }
+                break;
+        }
+    }
+
+    uint64_t state;
+    size_t maxLen;
+    const std::vector<Input>& corpus;
+    const std::vector<Input>& dictionary;
+};
+
+void execute(const Input& data) {
+    currentData = data.data();
+    currentSize = data.size();
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+}
+
+void report(const char* what, uint64_t execs, double seconds) {
+    std::fprintf(stderr, "#%llu\t%s exec/s: %.0f\n", static_cast<unsigned long long>(execs), what,
+                 seconds > 0 ? execs / seconds : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    uint64_t runs = 0;
+    uint64_t seed = 1;
+    size_t maxLen = 4096;
+    std::vector<Input> corpus;
+    std::vector<Input> dictionary;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 6, "-runs=") == 0) {
+            runs = std::strtoull(arg.c_str() + 6, nullptr, 10);
+        } else if (arg.compare(0, 6, "-seed=") == 0) {
+            seed = std::strtoull(arg.c_str() + 6, nullptr, 10);
+        } else if (arg.compare(0, 9, "-max_len=") == 0) {
+            maxLen = std::strtoull(arg.c_str() + 9, nullptr, 10);
+        } else if (arg.compare(0, 6, "-dict=") == 0) {
+            loadDictionary(arg.substr(6), dictionary);
+        } else if (arg[0] == '-') {
+            std::fprintf(stderr, "ignoring unknown flag %s\n", arg.c_str());
+        } else {
+            loadInputs(arg, corpus);
+        }
+    }
+    if (seed == 0) seed = 1;
+
+    std::set_terminate(onTerminate);
+    std::signal(SIGSEGV, onSignal);
+    std::signal(SIGABRT, onSignal);
+    std::signal(SIGBUS, onSignal);
+    std::signal(SIGFPE, onSignal);
+
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    auto elapsed = [&] { return std::chrono::duration<double>(Clock::now() - start).count(); };
+
+    // 重放语料
+    uint64_t execs = 0;
+    for (const Input& data : corpus) {
+        execute(data);
+        execs++;
+    }
+    report("INITED", execs, elapsed());
+
+    // 变异
+    Mutator mutator(seed, maxLen, corpus, dictionary);
+    Input buffer;
+    uint64_t nextReport = 1 << 16;
+    for (uint64_t i = 0; i < runs; i++) {
+        if (corpus.empty()) {
+            buffer.clear();
+        } else {
+            const Input& base = corpus[mutator.below(corpus.size())];
+            buffer.assign(base.begin(), base.end());
+        }
+        mutator.mutate(buffer);
+        execute(buffer);
+        if (++execs == nextReport) {
+            report("pulse", execs, elapsed());
+            nextReport *= 2;
+        }
+    }
+    report("DONE", execs, elapsed());
+    return 0;
+}
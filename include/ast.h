@@ -1,13 +1,19 @@
 #ifndef AST_H
 #define AST_H
 
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <ostream>
 #include "lexer.h"
+#include "hash.h"
+#include "source.h"
 
 // AST节点类型
-enum class ASTNodeType {
+enum class ASTNodeType : uint8_t {
     PROGRAM,
     VAR_DECLARATION,
     ARRAY_DECLARATION,
@@ -30,13 +36,40 @@ enum class ASTNodeType {
 class ASTNode {
 public:
     ASTNodeType type;
-    int line;
+    // 除第一个所有者之外的所有者个数。hash-consing（见 Parser::setHashConsing）时
+    // 相同的无副作用表达式子树被多个父节点共享，最后一个所有者释放时才删除
+    uint16_t sharedOwners = 0;
+    SourceOffset start;  // 第一个Token的偏移，行号见 ProgramNode::sources
     
-    ASTNode(ASTNodeType t, int ln) : type(t), line(ln) {}
+    ASTNode(ASTNodeType t, SourceOffset s) : type(t), start(s) {}
     virtual ~ASTNode() = default;
     
     // 打印AST结构
-    virtual void print(int indent = 0) const = 0;
+    virtual void print(std::ostream& out, int indent = 0) const = 0;
+};
+
+// std::unique_ptr<ASTNode> 按 sharedOwners 释放共享的节点，其余节点照常删除
+namespace std {
+template <>
+struct default_delete<ASTNode> {
+    constexpr default_delete() noexcept = default;
+    template <class U, class = typename std::enable_if<std::is_convertible<U*, ASTNode*>::value>::type>
+    default_delete(const default_delete<U>&) noexcept {}
+
+    void operator()(ASTNode* node) const {
+        if (node->sharedOwners > 0) {
+            node->sharedOwners--;
+        } else {
+            delete node;
+        }
+    }
+};
+} // namespace std
+
+// 剖析得到的执行次数（--profile-use，见 profile.h），没有剖析数据时 count 为-1
+struct ExecutionCounts {
+    int64_t count = -1;  // 函数被调用、if/while 语句或调用执行的次数
+    int64_t taken = 0;   // if：进入 then 分支的次数；while：循环体执行的次数
 };
 
 // 程序节点
@@ -44,8 +77,15 @@ class ProgramNode : public ASTNode {
 public:
     std::vector<std::unique_ptr<ASTNode>> declarations;
     
-    ProgramNode() : ASTNode(ASTNodeType::PROGRAM, 1) {}
-    void print(int indent = 0) const override;
+    // 语义分析结果：全局标量槽位数和全局数组占用的int数
+    int numGlobalSlots = 0;
+    int globalArrayWords = 0;
+    
+    // 源代码的行首表，把各节点的偏移换算为行号
+    std::shared_ptr<const SourceManager> sources;
+    
+    ProgramNode() : ASTNode(ASTNodeType::PROGRAM, 0) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 变量声明节点
@@ -55,11 +95,16 @@ public:
     std::string identifier;
     bool isArray;
     int arraySize; // 仅当isArray为true时有效
+    std::unique_ptr<ASTNode> initializer; // 初始化表达式，可能为nullptr
     
-    VarDeclarationNode(const std::string& type, const std::string& id, int ln)
-        : ASTNode(ASTNodeType::VAR_DECLARATION, ln), 
+    // 语义分析结果
+    bool isGlobal = false;
+    int slot = -1;
+    
+    VarDeclarationNode(const std::string& type, const std::string& id, SourceOffset s)
+        : ASTNode(ASTNodeType::VAR_DECLARATION, s), 
           typeSpecifier(type), identifier(id), isArray(false), arraySize(0) {}
-    void print(int indent = 0) const override;
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 数组声明节点
@@ -68,11 +113,16 @@ public:
     std::string typeSpecifier;
     std::string identifier;
     int arraySize;
+    std::unique_ptr<ASTNode> sizeExpression;  // 长度不是整数常数时的常量表达式，语义分析求值后释放
+    
+    // 语义分析结果：数组存储区中的偏移（以int为单位）
+    bool isGlobal = false;
+    int offset = -1;
     
-    ArrayDeclarationNode(const std::string& type, const std::string& id, int size, int ln)
-        : ASTNode(ASTNodeType::ARRAY_DECLARATION, ln), 
+    ArrayDeclarationNode(const std::string& type, const std::string& id, int size, SourceOffset s)
+        : ASTNode(ASTNodeType::ARRAY_DECLARATION, s), 
           typeSpecifier(type), identifier(id), arraySize(size) {}
-    void print(int indent = 0) const override;
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 函数声明节点
@@ -83,10 +133,21 @@ public:
     std::vector<std::unique_ptr<ASTNode>> params;
     std::unique_ptr<ASTNode> body; // CompoundStmtNode
     
-    FunDeclarationNode(const std::string& type, const std::string& id, int ln)
-        : ASTNode(ASTNodeType::FUN_DECLARATION, ln), 
+    // 语义分析结果：标量槽位数（参数在前）和局部数组占用的int数
+    int numSlots = 0;
+    int arrayWords = 0;
+    
+    // 函数指纹（见 cache.h）：语法分析时计算的Token序列哈希，
+    // 语义分析时计算的所引用声明（全局变量、被调函数签名）的哈希
+    Hash128 tokenHash;
+    Hash128 referenceHash;
+
+    ExecutionCounts counts;  // 剖析数据
+    
+    FunDeclarationNode(const std::string& type, const std::string& id, SourceOffset s)
+        : ASTNode(ASTNodeType::FUN_DECLARATION, s), 
           returnType(type), identifier(id) {}
-    void print(int indent = 0) const override;
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 参数节点
@@ -95,11 +156,12 @@ public:
     std::string typeSpecifier;
     std::string identifier;
     bool isArray;
+    int slot = -1; // 语义分析结果
     
-    ParamNode(const std::string& type, const std::string& id, bool array, int ln)
-        : ASTNode(ASTNodeType::PARAM, ln), 
+    ParamNode(const std::string& type, const std::string& id, bool array, SourceOffset s)
+        : ASTNode(ASTNodeType::PARAM, s), 
           typeSpecifier(type), identifier(id), isArray(array) {}
-    void print(int indent = 0) const override;
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 复合语句节点
@@ -108,8 +170,8 @@ public:
     std::vector<std::unique_ptr<ASTNode>> localDeclarations;
     std::vector<std::unique_ptr<ASTNode>> statements;
     
-    CompoundStmtNode(int ln) : ASTNode(ASTNodeType::COMPOUND_STMT, ln) {}
-    void print(int indent = 0) const override;
+    CompoundStmtNode(SourceOffset s) : ASTNode(ASTNodeType::COMPOUND_STMT, s) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 表达式语句节点
@@ -117,8 +179,8 @@ class ExpressionStmtNode : public ASTNode {
 public:
     std::unique_ptr<ASTNode> expression; // 可能为nullptr
     
-    ExpressionStmtNode(int ln) : ASTNode(ASTNodeType::EXPRESSION_STMT, ln) {}
-    void print(int indent = 0) const override;
+    ExpressionStmtNode(SourceOffset s) : ASTNode(ASTNodeType::EXPRESSION_STMT, s) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 选择语句节点
@@ -127,9 +189,11 @@ public:
     std::unique_ptr<ASTNode> condition;
     std::unique_ptr<ASTNode> ifBranch;
     std::unique_ptr<ASTNode> elseBranch; // 可能为nullptr
+
+    ExecutionCounts counts;  // 剖析数据
     
-    SelectionStmtNode(int ln) : ASTNode(ASTNodeType::SELECTION_STMT, ln) {}
-    void print(int indent = 0) const override;
+    SelectionStmtNode(SourceOffset s) : ASTNode(ASTNodeType::SELECTION_STMT, s) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 循环语句节点
@@ -137,9 +201,11 @@ class IterationStmtNode : public ASTNode {
 public:
     std::unique_ptr<ASTNode> condition;
     std::unique_ptr<ASTNode> body;
+
+    ExecutionCounts counts;  // 剖析数据
     
-    IterationStmtNode(int ln) : ASTNode(ASTNodeType::ITERATION_STMT, ln) {}
-    void print(int indent = 0) const override;
+    IterationStmtNode(SourceOffset s) : ASTNode(ASTNodeType::ITERATION_STMT, s) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 返回语句节点
@@ -147,8 +213,8 @@ class ReturnStmtNode : public ASTNode {
 public:
     std::unique_ptr<ASTNode> expression; // 可能为nullptr
     
-    ReturnStmtNode(int ln) : ASTNode(ASTNodeType::RETURN_STMT, ln) {}
-    void print(int indent = 0) const override;
+    ReturnStmtNode(SourceOffset s) : ASTNode(ASTNodeType::RETURN_STMT, s) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 赋值表达式节点
@@ -157,8 +223,8 @@ public:
     std::unique_ptr<ASTNode> var;
     std::unique_ptr<ASTNode> expression;
     
-    AssignExprNode(int ln) : ASTNode(ASTNodeType::ASSIGN_EXPR, ln) {}
-    void print(int indent = 0) const override;
+    AssignExprNode(SourceOffset s) : ASTNode(ASTNodeType::ASSIGN_EXPR, s) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 简单表达式节点
@@ -168,8 +234,18 @@ public:
     std::unique_ptr<ASTNode> right;
     TokenType relop; // 关系运算符
     
-    SimpleExprNode(int ln) : ASTNode(ASTNodeType::SIMPLE_EXPR, ln), relop(TokenType::ERROR) {}
-    void print(int indent = 0) const override;
+    SimpleExprNode(SourceOffset s) : ASTNode(ASTNodeType::SIMPLE_EXPR, s), relop(TokenType::ERROR) {}
+    void print(std::ostream& out, int indent = 0) const override;
+};
+
+// 变量的存储类别（由语义分析填写）
+enum class VarKind {
+    UNRESOLVED,
+    GLOBAL_SCALAR,  // 全局标量：全局槽位
+    GLOBAL_ARRAY,   // 全局数组：全局数组区偏移
+    LOCAL_SCALAR,   // 局部变量或标量参数：栈帧槽位
+    LOCAL_ARRAY,    // 局部数组：栈帧数组区偏移
+    PARAM_ARRAY     // 数组参数：栈帧槽位中保存数组引用
 };
 
 // 变量节点
@@ -178,20 +254,41 @@ public:
     std::string identifier;
     std::unique_ptr<ASTNode> index; // 数组索引，可能为nullptr
     
-    VarNode(const std::string& id, int ln)
-        : ASTNode(ASTNodeType::VAR, ln), identifier(id) {}
-    void print(int indent = 0) const override;
+    // 语义分析结果
+    VarKind kind = VarKind::UNRESOLVED;
+    int slot = -1;
+    int arraySize = 0; // 已知长度的数组，参数数组为0
+    
+    VarNode(const std::string& id, SourceOffset s)
+        : ASTNode(ASTNodeType::VAR, s), identifier(id) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
+// 内建函数
+enum class BuiltinKind {
+    NONE,
+    INPUT,  // int input(void)
+    OUTPUT  // void output(int x)
+};
+
+class FunDeclarationNode;
+
 // 函数调用节点
 class CallNode : public ASTNode {
 public:
     std::string identifier;
     std::vector<std::unique_ptr<ASTNode>> args;
     
-    CallNode(const std::string& id, int ln)
-        : ASTNode(ASTNodeType::CALL, ln), identifier(id) {}
-    void print(int indent = 0) const override;
+    // 语义分析结果
+    FunDeclarationNode* callee = nullptr;
+    BuiltinKind builtin = BuiltinKind::NONE;
+    bool tailCall = false; // return f(...) 形式的调用，可以复用调用者的栈帧
+
+    ExecutionCounts counts;  // 剖析数据（只有调用用户函数的调用点）
+    
+    CallNode(const std::string& id, SourceOffset s)
+        : ASTNode(ASTNodeType::CALL, s), identifier(id) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 数字节点
@@ -199,8 +296,8 @@ class NumNode : public ASTNode {
 public:
     int value;
     
-    NumNode(int val, int ln) : ASTNode(ASTNodeType::NUM, ln), value(val) {}
-    void print(int indent = 0) const override;
+    NumNode(int val, SourceOffset s) : ASTNode(ASTNodeType::NUM, s), value(val) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
 // 二元操作节点
@@ -210,9 +307,24 @@ public:
     std::unique_ptr<ASTNode> right;
     TokenType op;
     
-    BinOpNode(TokenType opType, int ln) 
-        : ASTNode(ASTNodeType::BIN_OP, ln), op(opType) {}
-    void print(int indent = 0) const override;
+    BinOpNode(TokenType opType, SourceOffset s) 
+        : ASTNode(ASTNodeType::BIN_OP, s), op(opType) {}
+    void print(std::ostream& out, int indent = 0) const override;
 };
 
+// Token类型名称
+std::string tokenTypeToString(TokenType type);
+
+// 表达式是否没有副作用（不含赋值和调用）
+bool isPureExpression(const ASTNode* expr);
+
+// AST节点类型名称
+const char* astNodeTypeName(ASTNodeType type);
+
+// 依次访问节点的直接子节点（按源代码顺序，跳过空指针）
+void visitChildren(const ASTNode& node, const std::function<void(const ASTNode&)>& visit);
+
+// 依次访问节点的直接子节点的所有者指针，可以替换或删除子节点（跳过空指针）
+void visitChildSlots(ASTNode& node, const std::function<void(std::unique_ptr<ASTNode>&)>& visit);
+
 #endif // AST_H
\ No newline at end of file
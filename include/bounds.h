@@ -0,0 +1,39 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "ast.h"
+#include <unordered_map>
+#include <vector>
+
+// 下标检查的统计（每个函数一项）
+struct BoundsReport {
+    const FunDeclarationNode* function;
+    int accesses = 0;  // 已知长度数组的下标访问数
+    int checks = 0;    // 值域分析后仍需检查的访问数
+};
+
+// 数组下标检查的消除
+//
+// 检查模式下，已知长度的数组（局部数组和全局数组，VarNode::arraySize > 0）的每次下标访问
+// 都要检查 0 <= 下标 < 长度；数组参数的长度未知，不检查。值域分析为函数的局部标量计算取值
+// 区间：常数、赋值和 + - * / % 按区间运算（可能回绕时为整个 int 范围），if/while 的条件收窄
+// 各分支中被比较的变量，循环头部迭代到不动点（扩大的边界直接放宽到 int 的范围）。下标的区间
+// 落在 [0, 长度) 内的访问不需要检查，例如
+//     i = 0; while (i < 10) { a[i] = ...; i = i + 1; }     （int a[10]）
+// 全局变量可能被调用修改，按任意值处理。
+class BoundsAnalysis {
+public:
+    void analyze(const ProgramNode& program);
+
+    // 下标访问是否需要检查（没有分析到的访问总是需要）
+    bool needsCheck(const VarNode& var) const;
+
+    const std::vector<BoundsReport>& reports() const { return reportList; }
+
+private:
+    // 访问 -> 是否已证明在范围内（共享的节点须在每处都得到证明）
+    std::unordered_map<const VarNode*, bool> proven;
+    std::vector<BoundsReport> reportList;
+};
+
+#endif // BOUNDS_H
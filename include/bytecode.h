@@ -0,0 +1,236 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "ast.h"
+#include "cache.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 寄存器式字节码
+//
+// 每条指令占一个 uint32_t：低8位为操作码，其余为操作数
+//   ABC 格式：op | a<<8 | b<<16 | c<<24      （a/b/c 为寄存器号或8位立即数）
+//   ABx 格式：op | a<<8 | bx<<16             （bx 为16位无符号/有符号立即数）
+//   sAx格式：op | sax<<8                     （24位有符号偏移）
+// 部分指令后跟若干扩展字（跳转偏移、函数号、数组长度）。跳转偏移相对于
+// 指令本身的位置。
+//
+// 每个函数的寄存器 0..numParams-1 为参数，其后为局部变量槽位和临时寄存器。
+// 调用时实参放在调用者的连续寄存器中，被调函数的栈帧就从那里开始。
+// 数组引用是一个64位值：高32位为数组存储区中的起始下标，低32位为长度，
+// 下标访问均做越界检查。
+enum class Opcode : uint8_t {
+    LOADI,   // ABx:  R[a] = sbx
+    LOADK,   // ABx:  R[a] = K[bx]
+    MOV,     // ABC:  R[a] = R[b]
+    GETG,    // ABx:  R[a] = G[bx]
+    SETG,    // ABx:  G[bx] = R[a]
+    ADD,     // ABC:  R[a] = R[b] + R[c]
+    SUB,     // ABC:  R[a] = R[b] - R[c]
+    MUL,     // ABC:  R[a] = R[b] * R[c]
+    DIV,     // ABC:  R[a] = R[b] / R[c]
+    MOD,     // ABC:  R[a] = R[b] % R[c]
+    ADDI,    // ABC:  R[a] = R[b] + sc
+    LT, LE, GT, GE, EQ, NE,        // ABC:  R[a] = R[b] relop R[c]
+    JMP,     // sAx:  pc += sax
+    JT,      // A + 偏移字：R[a] != 0 时跳转
+    JF,      // A + 偏移字：R[a] == 0 时跳转
+    JLT, JLE, JGT, JGE, JEQ, JNE,  // AB + 偏移字：R[a] relop R[b] 时跳转
+    LREF,    // A + 偏移字 + 长度字：R[a] = 局部数组引用
+    GREF,    // A + 偏移字 + 长度字：R[a] = 全局数组引用
+    LOADX,   // ABC:  R[a] = R[b][R[c]]
+    STOREX,  // ABC:  R[a][R[b]] = R[c]
+    ZEROA,   // 偏移字 + 长度字：把栈帧数组区中的若干个int清零
+    CALL,    // ABC + 函数号字：以 R[a..a+c) 为实参调用，结果放在 R[a]
+    TAILCALL,// ABC + 函数号字：把 R[a..a+c) 搬到 R[0..c)，复用当前栈帧调用
+    INPUT,   // A:    R[a] = input()
+    OUTPUT,  // A:    output(R[a])
+    RET,     // A:    返回 R[a]
+    RET0,    // 返回 0
+    NUM_OPCODES
+};
+
+// 操作码名称
+const char* opcodeName(Opcode op);
+
+// 指令占用的字数（含扩展字）
+int instructionLength(Opcode op);
+
+// 指令字段
+inline uint32_t encodeABC(Opcode op, uint32_t a, uint32_t b, uint32_t c) {
+    return static_cast<uint32_t>(op) | (a << 8) | (b << 16) | (c << 24);
+}
+inline uint32_t encodeABx(Opcode op, uint32_t a, uint32_t bx) {
+    return static_cast<uint32_t>(op) | (a << 8) | ((bx & 0xffff) << 16);
+}
+inline uint32_t encodeSAx(Opcode op, int32_t sax) {
+    return static_cast<uint32_t>(op) | (static_cast<uint32_t>(sax) << 8);
+}
+inline Opcode insnOp(uint32_t insn) { return static_cast<Opcode>(insn & 0xff); }
+inline uint32_t insnA(uint32_t insn) { return (insn >> 8) & 0xff; }
+inline uint32_t insnB(uint32_t insn) { return (insn >> 16) & 0xff; }
+inline uint32_t insnC(uint32_t insn) { return insn >> 24; }
+inline int32_t insnSC(uint32_t insn) { return static_cast<int8_t>(insn >> 24); }
+inline uint32_t insnBx(uint32_t insn) { return insn >> 16; }
+inline int32_t insnSBx(uint32_t insn) { return static_cast<int16_t>(insn >> 16); }
+inline int32_t insnSAx(uint32_t insn) { return static_cast<int32_t>(insn) >> 8; }
+
+// 函数信息（与 .cmb 文件中的布局一致）
+struct BytecodeFunction {
+    uint32_t codeOffset;   // 在代码数组中的起点
+    uint32_t codeLength;
+    uint16_t numParams;
+    uint16_t numRegs;      // 参数 + 局部变量 + 临时寄存器
+    uint32_t arrayWords;   // 局部数组占用的int数
+    uint32_t nameOffset;   // 在名字区中的起点
+    uint32_t nameLength;
+};
+
+// .cmb 文件头
+struct CmbHeader {
+    char magic[4];              // "CMB\0"
+    uint32_t version;
+    uint32_t numFunctions;
+    uint32_t numConstants;
+    uint32_t numGlobals;        // 全局标量个数（初值随文件保存）
+    uint32_t globalArrayWords;
+    uint32_t codeWords;
+    uint32_t namesSize;
+    uint32_t mainFunction;
+    uint32_t reserved;
+};
+
+// 字节码模块：编译得到时数据保存在自身的vector中，
+// 从 .cmb 加载时直接指向只读映射的文件内容
+class BytecodeModule {
+public:
+    BytecodeModule();
+    ~BytecodeModule();
+
+    BytecodeModule(const BytecodeModule&) = delete;
+    BytecodeModule& operator=(const BytecodeModule&) = delete;
+
+    // 通过 mmap 加载 .cmb 文件，格式错误时抛出异常
+    static void load(const std::string& path, BytecodeModule& module);
+
+    // 写入 .cmb 文件
+    void save(const std::string& path) const;
+
+    // 反汇编输出
+    void disassemble(std::ostream& out) const;
+
+    const uint32_t* code() const { return codePtr; }
+    const int32_t* constants() const { return constantsPtr; }
+    const int32_t* globals() const { return globalsPtr; }
+    const BytecodeFunction* functions() const { return functionsPtr; }
+    std::string functionName(uint32_t index) const;
+
+    // 代码位置对应的源代码行（编译得到的模块才有行号表，.cmb 中不保存），未知时为0
+    int lineAt(uint32_t codeOffset) const;
+
+    uint32_t numFunctions() const { return header.numFunctions; }
+    uint32_t numGlobals() const { return header.numGlobals; }
+    uint32_t codeWords() const { return header.codeWords; }
+    uint32_t globalArrayWords() const { return header.globalArrayWords; }
+    uint32_t mainFunction() const { return header.mainFunction; }
+
+private:
+    friend class BytecodeCompiler;
+
+    void bindOwned();
+    void unmap();
+    void verify() const;
+
+    CmbHeader header;
+
+    // 自有存储（编译结果）
+    std::vector<BytecodeFunction> ownedFunctions;
+    std::vector<int32_t> ownedConstants;
+    std::vector<int32_t> ownedGlobals;
+    std::vector<uint32_t> ownedCode;
+    std::string ownedNames;
+    std::vector<std::pair<uint32_t, int>> lines;  // 行号表：（代码位置，行号），按位置排列
+
+    // 当前使用的数据
+    const BytecodeFunction* functionsPtr;
+    const int32_t* constantsPtr;
+    const int32_t* globalsPtr;
+    const uint32_t* codePtr;
+    const char* namesPtr;
+
+    // 文件映射
+    void* mapping;
+    size_t mappingSize;
+};
+
+// 字节码编译器：把经过语义分析的AST编译为字节码
+class BytecodeCompiler {
+public:
+    BytecodeCompiler();
+
+    void compile(const ProgramNode& program, BytecodeModule& module);
+
+    // 使用函数级缓存：指纹未变的函数直接取缓存中的字节码，不再编译
+    void setCache(FunctionCache* cache) { this->cache = cache; }
+
+    // 生成的 TAILCALL 指令数
+    size_t tailCallCount() const { return tailCalls; }
+
+    // 上一次编译中命中和未命中缓存的函数数
+    size_t cacheHits() const { return hits; }
+    size_t cacheMisses() const { return misses; }
+
+private:
+    void compileFunction(const FunDeclarationNode& fun);
+    void compileCached(const FunDeclarationNode& fun);
+    void markLine(const ASTNode* node);
+    void extractFunction(const BytecodeFunction& info, CachedFunction& entry) const;
+    bool appendCached(const FunDeclarationNode& fun, const CachedFunction& entry);
+
+    // 语句
+    void compileStatement(const ASTNode* stmt);
+    void compileCompoundStmt(const CompoundStmtNode& compoundStmt);
+    void compileBranch(const ASTNode* cond, bool jumpIfTrue, std::vector<size_t>& patches);
+
+    // 表达式
+    int exprAny(const ASTNode* expr);
+    int exprKeep(const ASTNode* expr, const ASTNode* later);
+    void exprTo(const ASTNode* expr, int dst);
+    void compileAssign(const AssignExprNode& assignExpr, int dst);
+    void compileCall(const CallNode& call, int dst);
+    void arrayRefTo(const VarNode& var, int dst);
+    int arrayRef(const VarNode& var);
+
+    // 寄存器与指令
+    int allocTemp();
+    void loadConst(int dst, int32_t value);
+    uint32_t constantIndex(int32_t value);
+    void emit(uint32_t insn);
+    size_t emitJump(uint32_t insn);
+    void patchJumps(const std::vector<size_t>& patches, size_t target);
+    void checkReg(int reg) const;
+
+    BytecodeModule* module;
+    const SourceManager* sources;
+    std::vector<uint32_t> code;
+    std::vector<int32_t> constants;
+    std::unordered_map<const FunDeclarationNode*, uint32_t> functionIndex;
+    std::vector<const FunDeclarationNode*> functionList;
+    std::unordered_map<std::string, uint32_t> functionByName;
+
+    FunctionCache* cache;
+    CachedFunction cachedEntry;  // 跨函数复用的条目缓冲区
+    size_t hits;
+    size_t misses;
+
+    const FunDeclarationNode* currentFun;
+    int freeReg;    // 第一个空闲临时寄存器
+    int maxReg;     // 使用到的最大寄存器数
+    size_t tailCalls;
+};
+
+#endif // BYTECODE_H
@@ -0,0 +1,71 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "ast.h"
+#include "hash.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 按函数缓存的编译结果（字节码）
+//
+// 与模块无关的形式：LOADK 的常量号是 constants 中的序号，CALL/TAILCALL 的
+// 函数号是 callees 中的序号，拼接进模块时再重定位。
+struct CachedFunction {
+    uint16_t numParams = 0;
+    uint16_t numRegs = 0;
+    uint32_t arrayWords = 0;
+    uint32_t tailCalls = 0;  // 生成的 TAILCALL 指令数
+    std::vector<uint32_t> code;
+    std::vector<int32_t> constants;
+    std::vector<std::string> callees;
+};
+
+// 函数级的内容寻址缓存，保存在本地目录中
+//
+// 键是函数的指纹：语法分析时按函数的Token序列（类型和词素，不含空白、注释和
+// 行号）计算的哈希，加上语义分析时按它引用的声明计算的哈希——全局变量的槽位
+// 和数组大小、被调函数的签名——以及代码格式的版本。只要这些都不变，函数的
+// 编译结果就不变；编辑一个函数或改变它引用的声明只会让这些函数重新编译。
+//
+// 条目追加保存在 <目录>/functions.pack 中：打开时映射整个文件并建立索引，
+// 新条目在析构时加文件锁一次性追加，多个编译进程可以共享同一个目录。
+// 文件过大或版本不符时整体替换为只含新条目的文件（改名，不影响正在读取的进程）。
+// 损坏、截断或版本不符的条目视为未命中。
+class FunctionCache {
+public:
+    explicit FunctionCache(const std::string& directory);
+    ~FunctionCache();
+
+    FunctionCache(const FunctionCache&) = delete;
+    FunctionCache& operator=(const FunctionCache&) = delete;
+
+    // 函数的指纹，variant 区分代码格式和影响代码生成的选项
+    static Hash128 fingerprint(const FunDeclarationNode& fun, const std::string& variant);
+
+    // 读取条目，不存在或损坏时返回 false
+    bool lookup(const Hash128& key, CachedFunction& entry);
+
+    // 记录新条目，析构时写入；写入失败（如目录不可写）时静默跳过，缓存只是加速手段
+    void store(const Hash128& key, const CachedFunction& entry);
+
+private:
+    void open();
+    void flush();
+
+    std::string directory;
+    bool opened;
+    bool damaged;  // 打开时发现文件头不符或有不完整的记录
+
+    // 映射的 pack 文件和其中各条目的位置
+    const char* mapping;
+    size_t mappingSize;
+    std::unordered_map<Hash128, std::pair<size_t, size_t>, Hash128Hash> index;
+
+    // 待写入的记录
+    std::string pending;
+};
+
+#endif // CACHE_H
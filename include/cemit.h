@@ -0,0 +1,86 @@
+#ifndef CEMIT_H
+#define CEMIT_H
+
+#include "ast.h"
+#include "bounds.h"
+#include "writer.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// C 代码生成：把经过语义分析的程序翻译为可移植的 C99 代码，
+// 交给宿主 C 编译器（如 cc -O2）生成优化的本机程序。
+//
+// 生成的代码保持 C- 的语义：32位整数回绕运算、从左到右求值（必要时借助
+// 临时变量和逗号表达式）、局部变量进入作用域时清零、除零和栈溢出报错（setBoundsChecks 时
+// 还检查已知长度数组的下标，见 bounds.h）。每条语句前
+// 按需输出 #line 指令，调试信息和性能分析结果可以对应回 .cm 源文件。
+//
+// 尾调用不占用C的栈：对自身的尾调用跳回函数开头；通过尾调用相互递归的一组函数
+// （尾调用图中的强连通分量）合并为一个C函数，组内的尾调用都是跳转。
+//
+// 命名：函数 f_<名字>，全局变量 g_<名字>，局部标量 l<槽位>_<名字>，
+// 局部数组 a<偏移>_<名字>，临时变量 t<编号>，合并的函数 tc<组号>，其中第 k 个
+// 成员的参数 p<k>_<序号>。C- 标识符不含下划线，因此不会与 C 关键字或生成的名字冲突。
+class CEmitter {
+public:
+    CEmitter(BufferedWriter& out, const std::string& sourceName);
+
+    // 检查数组下标，值域分析能证明在范围内的访问除外
+    void setBoundsChecks(bool enabled) { boundsChecks = enabled; }
+
+    void emit(const ProgramNode& program);
+
+    // 各函数的下标检查数（setBoundsChecks 时）
+    const std::vector<BoundsReport>& boundsReports() const { return bounds.reports(); }
+
+    // 转为跳转的尾调用数
+    size_t tailCallCount() const { return tailCalls; }
+
+private:
+    void emitPrelude();
+    void findTailGroups(const ProgramNode& program);
+    bool emitsFunction(const FunDeclarationNode& fun) const;
+    void emitFunction(const FunDeclarationNode& fun);
+    void emitTailGroup(size_t group);
+    void emitCompound(const CompoundStmtNode& compoundStmt);
+    void emitStatement(const ASTNode* stmt);
+    void emitBody(const ASTNode* stmt);
+    void emitTailJump(const CallNode& call, const std::vector<std::string>& params, const std::string& label);
+
+    // 表达式翻译为C表达式字符串，需要的临时变量记录在 pendingTemps 中
+    std::string expr(const ASTNode* node, bool parenthesize = true);
+    std::string assignment(const AssignExprNode& assignExpr, std::string& prefix);
+    std::string sequenced(const ASTNode* first, const ASTNode* later, std::string& prefix);
+    std::string call(const CallNode& call);
+    std::string stackCheck(const FunDeclarationNode& callee, SourceOffset start) const;
+    std::string varName(const VarNode& var) const;
+    std::string element(const VarNode& var, const std::string& index) const;
+    std::string newTemp();
+    void declareTemps();
+
+    std::string functionSignature(const FunDeclarationNode& fun) const;
+    int lineOf(SourceOffset start) const { return sources ? sources->line(start) : 0; }
+    void lineDirective(SourceOffset start);
+    void writeLine(const std::string& text);
+
+    BufferedWriter& out;
+    const FunDeclarationNode* currentFun;
+    const SourceManager* sources;  // 为空时不输出 #line
+    std::string quotedSource;   // #line 指令中的文件名
+    int indent;
+    int mappedLine;             // 下一行输出对应的源代码行号，未知时为-1
+    int tempCounter;
+    std::vector<std::string> pendingTemps;
+    size_t tailCalls;
+    // 相互尾调用的函数组（按声明顺序），以及各函数所在的组和在组中的序号
+    std::vector<std::vector<const FunDeclarationNode*>> tailGroups;
+    std::unordered_map<const FunDeclarationNode*, std::pair<size_t, size_t>> tailGroupOf;
+    std::unordered_set<const FunDeclarationNode*> calledMembers;  // 组外（或不是尾调用）还调用的成员
+    bool boundsChecks;
+    BoundsAnalysis bounds;
+};
+
+#endif // CEMIT_H
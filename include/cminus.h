@@ -0,0 +1,106 @@
+#ifndef CMINUS_H
+#define CMINUS_H
+
+#include "ast.h"
+#include "inliner.h"
+#include "interprocedural.h"
+#include "lexer.h"
+#include "parser.h"
+#include "profile.h"
+#include "semantic.h"
+#include <functional>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// libcminus：可嵌入的编译器前端接口
+//
+//   cminus::CompilerContext context;
+//   cminus::CompileResult result = context.compile(source);
+//   if (result.ok()) { ... *result.program ... } else { ... result.diagnostics ... }
+//
+// 分析得到的AST可以直接交给各执行引擎（Interpreter、BytecodeCompiler、JitCompiler、
+// CEmitter）。这些接口都不向控制台输出，错误以诊断信息返回。
+//
+// 线程安全：CompilerContext 之间不共享可变状态，每个线程使用自己的
+// CompilerContext 即可并发编译；同一个 CompilerContext 不能被多个线程同时使用。
+namespace cminus {
+
+// 出错的阶段
+enum class Stage {
+    LEX,
+    PARSE,
+    SEMANTIC,
+    OPTIMIZE  // 优化提示（CompileResult::remarks），不是错误
+};
+
+const char* stageName(Stage stage);
+
+// 诊断信息
+struct Diagnostic {
+    Stage stage;
+    int line;             // 出错的行号，未知时为0
+    int column;           // 出错的列号（按字节），未知时为0
+    std::string message;  // 完整的错误信息（与命令行输出的相同）
+};
+
+// 编译选项
+struct CompileOptions {
+    bool analyze = true;  // 做语义分析（执行引擎需要分析后的AST）
+    int maxNestingDepth = Parser::defaultMaxNestingDepth;  // 见 Parser::setMaxNestingDepth
+    bool hashConsing = false;  // 共享结构相同的表达式子树，见 Parser::setHashConsing
+    bool interprocedural = false;  // 语义分析后删除不可达的函数并做过程间常量传播，见 InterproceduralOptimizer
+    int inlineBudget = 0;      // 大于0时在语义分析后内联小函数（大小上限），见 Inliner；流式编译不内联
+    bool remarks = false;      // 在 CompileResult::remarks 中记录过程间优化和内联的决定
+    const Profile* profile = nullptr;  // 剖析数据，语义分析后（内联之前）填入AST，见 Profile::annotate
+};
+
+// 编译结果
+struct CompileResult {
+    std::unique_ptr<ProgramNode> program;  // 出错时为空
+    std::vector<Diagnostic> diagnostics;
+    std::vector<Diagnostic> remarks;  // 优化提示（CompileOptions::remarks），包括过期的剖析数据
+
+    bool ok() const { return program != nullptr; }
+};
+
+// 编译器上下文：持有跨编译复用的缓冲区（Token序列）和语义分析器的符号表，
+// 同一个上下文连续编译多个源程序时不再重新分配这些存储。
+class CompilerContext {
+public:
+    CompilerContext();
+
+    CompilerContext(const CompilerContext&) = delete;
+    CompilerContext& operator=(const CompilerContext&) = delete;
+
+    // 词法分析、语法分析和（可选的）语义分析。source 只在调用期间使用
+    CompileResult compile(std::string_view source, const CompileOptions& options = CompileOptions());
+
+    // 只做词法分析，返回的Token序列（末尾为EOF）在下一次使用本上下文前有效。
+    // 出错时返回空序列并在 diagnostics 中追加一条诊断
+    const std::vector<Token>& tokenize(std::string_view source, std::vector<Diagnostic>& diagnostics);
+
+    // 最近一次词法分析的行首表，把Token的位置换算为行号（分析得到的AST见 ProgramNode::sources）
+    const SourceManager& sourceManager() const { return *sources; }
+
+    // 流式编译：从 input 分块读取源代码，每解析（和分析）完一个顶层声明就交给 consumer，
+    // consumer 返回后即释放该声明。内存占用取决于最大的单个声明而不是输入的长度，
+    // 可以处理任意长的生成代码流。语义分析见 SemanticAnalyzer::beginStream，得到的声明
+    // 不能交给执行引擎。出错时停止读取并在 diagnostics 中追加一条诊断，返回 false；
+    // 词法错误在语法分析中发现，报告为 Stage::PARSE。
+    bool compileStream(std::istream& input, const std::function<void(ASTNode&)>& consumer,
+                       std::vector<Diagnostic>& diagnostics, const CompileOptions& options = CompileOptions());
+
+private:
+    bool lex(std::string_view source, std::vector<Diagnostic>& diagnostics);
+
+    std::vector<Token> tokens;
+    std::shared_ptr<const SourceManager> sources;
+    SemanticAnalyzer analyzer;
+};
+
+} // namespace cminus
+
+#endif // CMINUS_H
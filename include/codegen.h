@@ -0,0 +1,200 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "ast.h"
+#include "bounds.h"
+#include "loops.h"
+#include "peephole.h"
+#include "profile.h"
+#include "x86.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// 代码生成选项
+struct CodegenOptions {
+    // 0：模板式翻译，每个节点对应固定的指令序列，生成速度最快
+    // 1：优化层，局部变量分配到被调用者保存寄存器、常量折叠、
+    //    立即数/内存操作数、比较与跳转直接结合、循环倒置、计数循环的向量化和展开，
+//    最后对每个函数做窥孔优化和基本块内的指令调度（见 peephole.h）
+    int optLevel = 0;
+    x86::VectorIsa vectorIsa = x86::VectorIsa::SSE2;  // 向量化使用的指令集，NONE 时只展开
+    bool remarks = false;  // 记录每个循环的优化决定
+    bool boundsChecks = false;  // 检查已知长度数组的下标，值域分析能证明在范围内的除外（见 bounds.h）
+    bool instrument = false;    // 插桩：在BSS段中统计函数、if、while 和调用的执行次数（见 profile.h）
+    bool lineTable = false;     // 记录各语句的机器码位置（x86::ObjectCode::lines），供采样剖析换算行号
+};
+
+// 一个函数的插桩计数器（BSS段中 size 个64位整数）
+struct ProfileCounters {
+    std::string function;
+    Hash128 hash;  // 结构哈希
+    int symbol;
+    int size;
+};
+
+// 循环和分支布局的优化决定（优化提示）
+struct LoopRemark {
+    SourceOffset start;   // 循环或 if 的位置
+    std::string message;  // 如 "loop vectorized (avx2, 8 lanes)"
+};
+
+// x86-64 代码生成器：把经过语义分析的AST翻译为机器指令
+//
+// 调用约定遵循 System V AMD64，整数值为32位。表达式结果放在 eax
+// （数组引用放在 rax），中间值压栈保存。内建函数 input/output 调用
+// 外部符号 cminus_input/cminus_output。
+//
+// 优化层使用AST中的剖析数据（ExecutionCounts）：很少进入的 then 分支移到函数末尾，
+// else 分支更常执行时先放 else 分支；从未执行的循环不做向量化和展开，平均迭代次数
+// 代替未知的迭代次数决定向量化和展开的份数。
+class CodeGenerator {
+public:
+    explicit CodeGenerator(const CodegenOptions& options = CodegenOptions());
+
+    x86::Module generate(const ProgramNode& program);
+
+    // 消除的尾调用数（自身递归转为循环，其他转为跳转）
+    size_t tailCallCount() const { return tailCalls; }
+
+    // 向量化和展开的循环数
+    size_t vectorizedLoopCount() const { return vectorizedLoops; }
+    size_t unrolledLoopCount() const { return unrolledLoops; }
+
+    // 各循环的决定（options.remarks 时记录），按代码顺序
+    const std::vector<LoopRemark>& remarks() const { return remarkList; }
+
+    // 各函数的下标检查数（options.boundsChecks 时）
+    const std::vector<BoundsReport>& boundsReports() const { return bounds.reports(); }
+
+    // 各函数的插桩计数器（options.instrument 时）
+    const std::vector<ProfileCounters>& profileCounters() const { return counterList; }
+
+    // 优化层窥孔优化各模式的命中次数和调度的结果
+    const x86::PeepholeStats& peepholeStats() const { return peephole; }
+
+private:
+    void declareGlobals(const ProgramNode& program);
+    void generateFunction(const FunDeclarationNode& fun);
+    void allocateRegisters(const FunDeclarationNode& fun);
+
+    // 语句
+    void genStatement(const ASTNode* stmt, const ASTNode* previous = nullptr);
+    void genCompoundStmt(const CompoundStmtNode& compoundStmt);
+    void genSelectionStmt(const SelectionStmtNode& selectionStmt);
+    void genIterationStmt(const IterationStmtNode& iterationStmt, const ASTNode* previous);
+
+    // 计数循环（见 loops.h）：在原循环之前生成每次处理多次迭代的循环，
+    // 剩下的迭代由原循环完成
+    std::string checkVectorPlan(const CountedLoop& loop, const VectorPlan& plan, long long trips) const;
+    void genVectorLoop(const CountedLoop& loop, const VectorPlan& plan);
+    void genVectorExpr(const ASTNode* expr, const VectorPlan& plan, int reg, int invariantBase);
+    x86::Operand vectorElement(const VarNode& var);
+    void genUnrolledLoop(const CountedLoop& loop, int factor);
+    void genLoopLimit(const CountedLoop& loop, x86::Reg dst, int64_t lookahead);
+    void remark(const ASTNode& node, const std::string& message);
+
+    // 表达式
+    void genExpr(const ASTNode* expr);
+    void genAssign(const AssignExprNode& assignExpr);
+    void genBinOp(const BinOpNode& binOp);
+    void genArith(const BinOpNode& binOp, const x86::Operand& rhs);
+    void genDivide(bool modulo, int line);
+    void genMultiplyByConstant(int32_t factor);
+    void genDivideByConstant(int32_t divisor);
+    void genModuloByConstant(int32_t divisor);
+    void genCompare(const SimpleExprNode& simpleExpr);
+    void genCall(const CallNode& call);
+    bool genTailCall(const CallNode& call);
+    void genBranch(const ASTNode* cond, int label, bool jumpIfTrue);
+    void genArrayAddress(const VarNode& var, x86::Reg dst);
+    x86::Operand genElement(const VarNode& var, x86::Reg indexReg, x86::Reg baseReg, bool indexLoaded = false);
+    bool checksBounds(const VarNode& var) const;
+    bool hasCheckedAccess(const ASTNode& node) const;
+    void genBoundsCheck(const VarNode& var, x86::Reg indexReg);
+    void genRuntimeFailures();
+    void genZeroArray(int offset, int words);
+    void genCount(const ASTNode& site, int counter = 0);
+    void genColdBlocks();
+
+    // 操作数
+    x86::Operand scalarOperand(const VarNode& var) const;
+    x86::Operand slotOperand(int slot) const;
+    x86::Operand frameOperand(int32_t disp) const;
+    int32_t arrayDisp(int offset) const;
+    bool leafOperand(const ASTNode* expr, x86::Operand& out) const;
+    bool evalConst(const ASTNode* expr, int32_t& value) const;
+
+    // 指令
+    void emit(x86::Op op, uint8_t size, const x86::Operand& a = x86::Operand(),
+              const x86::Operand& b = x86::Operand(), const x86::Operand& c = x86::Operand());
+    void emitJcc(x86::Cond cc, int label);
+    void emitLabel(int label);
+    void emitLine(const ASTNode& node);
+    void push(x86::Reg reg);
+    void pop(x86::Reg reg);
+
+    CodegenOptions options;
+    x86::Module module;
+
+    // 符号
+    std::unordered_map<const FunDeclarationNode*, int> functionSymbols;
+    std::vector<int> globalSlotSymbols;                 // 全局标量槽位 -> 符号
+    std::unordered_map<int, int> globalArraySymbols;    // 全局数组偏移 -> 符号
+    int inputSymbol;
+    int outputSymbol;
+    int boundsErrorSymbol;
+    int divisionErrorSymbol;   // 第一次用到时添加
+    int stackLimitFunction;    // cminus_stack_limit，main 在序言中调用
+    int stackOverflowSymbol;
+    int stackLimitSymbol;      // BSS段中的栈底，各函数的序言与它比较
+
+    // 下标检查
+    struct BoundsFailure {
+        int label;
+        x86::Reg indexReg;
+        int line;
+    };
+    BoundsAnalysis bounds;
+    const SourceManager* sources;  // 换算行号（下标检查的报错和 LINE 伪指令）
+    std::vector<BoundsFailure> boundsFailures;  // 当前函数中检查失败时的跳转目标，生成在函数末尾
+
+    // 除数为0
+    struct DivisionFailure {
+        int label;
+        int line;
+    };
+    std::vector<DivisionFailure> divisionFailures;  // 同上
+
+    // 插桩
+    CounterLayout counterLayout;       // 当前函数的计数器布局
+    int counterSymbol;
+    std::vector<ProfileCounters> counterList;
+
+    // 移到函数末尾的冷分支（执行完跳回 resume）
+    struct ColdBlock {
+        int label;
+        int resume;
+        const SelectionStmtNode* stmt;
+    };
+    std::vector<ColdBlock> coldBlocks;
+
+    // 当前函数
+    x86::MFunction* current;
+    const FunDeclarationNode* currentFun;
+    std::vector<uint8_t> slotRegs;       // 槽位 -> 分配的寄存器（NOREG表示在内存）
+    std::vector<x86::Reg> savedRegs;     // 使用到的被调用者保存寄存器
+    int32_t slotBase;                    // 槽位区起点（相对rbp向下）
+    int32_t arrayBase;                   // 数组区起点（相对rbp向下）
+    int returnLabel;
+    int entryLabel;                      // 参数搬入槽位之前，自身尾调用跳到这里
+    int depth;                           // 当前压栈的8字节数，用于调用前对齐
+    size_t tailCalls;
+    size_t vectorizedLoops;
+    size_t unrolledLoops;
+    std::vector<LoopRemark> remarkList;
+    x86::PeepholeStats peephole;
+    bool copying;  // 正在生成展开的循环体副本，不重复记录优化决定
+};
+
+#endif // CODEGEN_H
@@ -0,0 +1,63 @@
+#ifndef CONSTEVAL_H
+#define CONSTEVAL_H
+
+#include "ast.h"
+#include "interpreter.h"
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 32位环绕语义的常量运算，与各执行引擎一致；除零不折叠（返回 false）
+bool foldBinary(TokenType op, int32_t left, int32_t right, int32_t& result);
+bool foldCompare(TokenType op, int32_t left, int32_t right);
+
+// 纯函数的编译期求值
+//
+// 纯函数不访问全局变量和全局数组、不调用 input/output，调用的函数也都是纯函数
+// （允许递归，允许写数组参数：以常数实参调用时数组只能来自纯函数的局部数组）。
+// 以常数实参调用纯函数，结果只取决于实参，可以在编译期执行。
+//
+// 执行在沙箱中进行：用树遍历解释器，限制调用和循环迭代的步数、调用深度、栈槽位和
+// 数组区大小。超出限制或发生运行时错误（除零、下标越界）时不求值，调用留到运行时
+// 照常执行（和报错）。同一函数和实参的结果只求一次。
+//
+// 只有用 addFunction 登记的（已通过语义分析的）函数参与判断，其余函数视为不纯。
+class ConstantEvaluator {
+public:
+    static constexpr size_t maxSteps = 1 << 20;     // 调用和循环迭代
+    static constexpr size_t maxCallDepth = 1 << 10;
+    static constexpr size_t stackCells = 1 << 16;
+    static constexpr size_t arrayWords = 1 << 18;   // 1MB
+
+    ConstantEvaluator();
+
+    // 忘记登记的函数和求过的结果（函数体改变或释放之后）
+    void clear();
+
+    void addFunction(const FunDeclarationNode& fun);
+
+    bool isPure(const FunDeclarationNode& fun);
+
+    // 以常数实参调用函数；函数不纯或执行失败时返回 false
+    bool call(const FunDeclarationNode& fun, const std::vector<int32_t>& args, int32_t& result);
+
+    // 常量表达式：整数常数、算术和比较，以及实参都是常量表达式的纯函数调用
+    bool evaluate(const ASTNode& expr, int32_t& value);
+
+private:
+    // 登记的函数：-1 未判断，0 不纯，1 纯
+    struct Function {
+        int directEffect = -1;  // 函数体本身访问全局存储或调用内建函数
+        int pure = -1;
+    };
+
+    bool hasDirectEffect(const ASTNode& node) const;
+
+    std::unordered_map<const FunDeclarationNode*, Function> functions;
+    std::map<std::pair<const FunDeclarationNode*, std::vector<int32_t>>, std::pair<bool, int32_t>> results;
+    Interpreter sandbox;
+};
+
+#endif // CONSTEVAL_H
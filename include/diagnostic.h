@@ -0,0 +1,18 @@
+#ifndef DIAGNOSTIC_H
+#define DIAGNOSTIC_H
+
+#include "source.h"
+#include <stdexcept>
+#include <string>
+
+// 源程序中的错误（词法、语法、语义），what() 为完整的错误信息
+class CompileError : public std::runtime_error {
+public:
+    CompileError(const std::string& message, SourceLocation location)
+        : std::runtime_error(message), line(location.line), column(location.column) {}
+
+    int line;    // 出错的行号
+    int column;  // 出错的列号，未知时为0
+};
+
+#endif // DIAGNOSTIC_H
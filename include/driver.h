@@ -0,0 +1,101 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include "cminus.h"
+#include "x86.h"
+
+class BytecodeModule;
+class SampleProfile;
+
+// 命令行选项
+struct Options {
+    std::string inputFile;  // "-" 表示从标准输入读取源代码
+    bool tokens = false;    // --tokens：只输出Token
+    bool ast = false;       // --ast：只输出AST
+    bool stream = false;    // --stream：分块读取输入，逐个顶层声明处理
+    bool jit = false;       // --jit：JIT编译并运行
+    bool stats = false;     // --stats / --jit-stats：输出执行引擎的统计信息
+    int optLevel = 0;       // -O / -O1：使用优化层
+    bool interp = false;    // --interp：用树遍历解释器运行
+    bool bench = false;     // --bench：比较各执行引擎
+    bool vm = false;        // --vm：编译为字节码并在虚拟机上运行
+    bool dumpBytecode = false;  // --dump-bytecode：输出字节码反汇编
+    bool dumpAsm = false;       // --dump-asm：输出本机代码的反汇编列表
+    std::string emit;       // --emit=cmb|c|obj：输出字节码文件、C代码或ELF目标文件
+    std::string outputFile; // -o <file>
+    bool timeReport = false;    // --time-report：输出各阶段耗时
+    bool memReport = false;     // --mem-report：输出各阶段分配的内存和峰值RSS
+    std::string statsJson;      // --stats-json=<file>：写入JSON统计文件
+    std::string cacheDir;       // --cache-dir=<dir>：函数级编译缓存目录
+    std::string serve;          // --serve=<socket>：作为编译服务运行
+    int threads = 0;            // --threads=N：编译服务的工作线程数（0为CPU数）
+    int maxNesting = Parser::defaultMaxNestingDepth;  // --max-nesting=N：最大嵌套深度
+    bool hashCons = false;      // --hash-cons：共享结构相同的表达式子树
+    bool ipo = false;           // --ipo：删除不可达的函数，过程间常量传播
+    int inlineBudget = 0;       // --inline[=N]：内联小函数（0为不内联）
+    bool remarks = false;       // --remarks：输出内联和循环优化的决定
+    x86::VectorIsa vectorIsa = x86::hostVectorIsa();  // --vector-isa=<isa>：JIT优化层的向量指令集
+    bool boundsCheck = false;   // --bounds-check：JIT和生成的C代码检查数组下标
+    std::string profileGenerate;  // --profile-generate[=<file>]：JIT插桩运行，退出时写入剖析文件
+    std::string profileUse;       // --profile-use[=<file>]：按剖析文件优化
+    std::string sampleFolded;     // --sample-folded=<file>：采样剖析，写入折叠栈（火焰图）
+    std::string sampleListing;    // --sample-listing=<file>：采样剖析，写入按行标注热度的源代码
+    int samplePeriod = 0;         // --sample-period=N：采样间隔（VM为指令数，JIT为CPU微秒；0为默认值）
+
+    // 已在内存中的源代码（编译服务的请求），不为空时不读取 inputFile
+    const std::string* sourceText = nullptr;
+    // 相对路径的基准目录（编译服务中为客户端的工作目录），为空时使用当前目录
+    std::string workingDirectory;
+};
+
+// 解析命令行参数，错误写到 err
+bool parseOptions(int argc, const char* const argv[], Options& options, std::ostream& err);
+void printUsage(const char* program, std::ostream& err);
+
+// 是否只做编译而不执行用户程序（编译服务只接受这类请求）
+bool isCompileOnly(const Options& options);
+
+// 命令行驱动：按选项完成编译或运行。编译结果和诊断写到 out/err；
+// 执行用户程序时，程序的输入输出仍使用进程的标准输入输出。
+// 前端通过 libcminus 完成，context 为空时使用自己的 CompilerContext。
+class Driver {
+public:
+    Driver(const Options& options, std::ostream& out, std::ostream& err,
+           cminus::CompilerContext* context = nullptr);
+
+    // 返回进程退出码
+    int run();
+
+private:
+    int dispatch();
+    bool loadSource(std::string& source);
+    std::string resolve(const std::string& path) const;
+    std::unique_ptr<ProgramNode> compile(const std::string& source, bool analyze = true);
+
+    void testLexer(const std::string& source);
+    void testParser(const std::string& source);
+    int dumpAST(const std::string& source);
+    int runStream();
+    int runJit(const std::string& source);
+    int runInterpreter(const std::string& source);
+    int runBenchmark(const std::string& source);
+    int emitC(const std::string& source);
+    int emitObject(const std::string& source);
+    std::string outputName(const char* suffix) const;
+    int runModule(const BytecodeModule& module, const std::string* source = nullptr);
+    bool sampling() const;
+    void writeSamples(const SampleProfile& profile, const std::string* source);
+    int runBytecode(const std::string& source);
+    int runBytecodeFile();
+
+    const Options& options;
+    std::ostream& out;
+    std::ostream& err;
+    std::unique_ptr<cminus::CompilerContext> ownedContext;
+    cminus::CompilerContext& context;
+};
+
+#endif // DRIVER_H
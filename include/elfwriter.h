@@ -0,0 +1,25 @@
+#ifndef ELFWRITER_H
+#define ELFWRITER_H
+
+#include "x86.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// x86-64 ELF 可重定位目标文件（.o）
+//
+// 把汇编结果直接写成目标文件，不经过文本汇编和外部汇编器：
+//     .text       各函数的机器码（入口按16字节对齐）
+//     .data       有初值的全局变量
+//     .bss        其余全局变量、全局数组和插桩计数器
+//     .rela.text  调用（R_X86_64_PLT32）和全局变量引用（R_X86_64_PC32）的重定位
+//     .symtab     每个函数和全局变量一个符号，外部函数 cminus_input 等为未定义符号
+// 只有 main 和未定义符号是全局符号，其余为局部符号，用户函数名不会与C库中的名字冲突。
+// 生成的 .o 与提供运行时的 libcminus 链接即为可执行程序：
+//     cc test.o libcminus.a -lstdc++ -o test
+std::vector<uint8_t> elfObject(const x86::ObjectCode& object, const std::string& sourceName);
+
+// 写入文件，失败时抛出 std::runtime_error
+void writeElfObject(const x86::ObjectCode& object, const std::string& sourceName, const std::string& path);
+
+#endif // ELFWRITER_H
@@ -0,0 +1,72 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// 128位哈希值（非密码学哈希，用作函数指纹）
+struct Hash128 {
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    bool operator==(const Hash128& other) const { return high == other.high && low == other.low; }
+    bool operator!=(const Hash128& other) const { return !(*this == other); }
+};
+
+struct Hash128Hash {
+    size_t operator()(const Hash128& hash) const { return static_cast<size_t>(hash.high ^ hash.low); }
+};
+
+// 增量计算 Hash128：两路独立的64位哈希，按8字节为单位混合
+class Hasher {
+public:
+    void number(int64_t value) { mix(static_cast<uint64_t>(value)); }
+
+    void text(const std::string& value) {
+        mix(value.size());
+        size_t i = 0;
+        for (; i + 8 <= value.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, value.data() + i, 8);
+            mix(word);
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, value.data() + i, value.size() - i);
+        mix(tail);
+    }
+
+    void hash(const Hash128& value) {
+        mix(value.high);
+        mix(value.low);
+    }
+
+    Hash128 result() const {
+        Hash128 out;
+        out.high = finish(a);
+        out.low = finish(b);
+        return out;
+    }
+
+private:
+    void mix(uint64_t v) {
+        a = (a ^ v) * 0x9e3779b97f4a7c15ULL;
+        a ^= a >> 32;
+        b = (b + v) * 0xc2b2ae3d27d4eb4fULL;
+        b = (b << 31) | (b >> 33);
+    }
+
+    static uint64_t finish(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        return h ^ (h >> 33);
+    }
+
+    uint64_t a = 0xcbf29ce484222325ULL;
+    uint64_t b = 0x6a09e667f3bcc908ULL;
+};
+
+#endif // HASH_H
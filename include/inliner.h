@@ -0,0 +1,106 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include "ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 内联选项
+struct InlineOptions {
+    static const int defaultBudget = 40;
+
+    int budget = defaultBudget;  // 被调函数的大小上限（函数体的AST节点数）
+    int maxFrameSlots = 128;     // 调用者栈帧的标量槽位上限（字节码每个函数最多256个寄存器，含临时寄存器）
+    bool remarks = false;        // 记录每个调用点的内联决定
+};
+
+// 内联决定（优化提示）
+struct InlineRemark {
+    SourceOffset start;   // 调用的位置
+    std::string message;  // 如 "inlined 'sq' into 'main' (cost 5, threshold 40)"
+};
+
+// 函数内联：在语义分析之后、交给执行引擎之前，把小函数的函数体展开到调用点
+//
+// 代价模型：函数体的AST节点数为代价，不超过阈值时内联。阈值为 budget，
+// 调用点在循环中时加倍，被调函数在整个程序中只有一个调用点时再乘4。有剖析数据
+// （CallNode::counts，见 profile.h）时不看循环：执行次数达到最热调用点1%的调用点
+// 预算乘4，从未执行的调用点不内联。每个
+// 调用者最多增长 10 * budget 个节点。按调用图自底向上处理（先处理被调函数，
+// 它内部的调用已经展开），递归函数（在调用图的环上）不内联。
+//
+// 展开方式：把调用提到所在语句之前，语句替换为复合语句
+//     { int 结果; int 参数 = 实参; ...; 被调函数的声明和语句; 原语句（调用换成结果变量） }
+// 被调函数的槽位和局部数组接在调用者的栈帧之后（FunDeclarationNode::numSlots/arrayWords
+// 随之增大），数组参数直接换成实参的存储位置。return 改写为给结果变量赋值，
+// 之后的语句移入 else 分支，因此 return 须在尾部：在循环中 return，或在会继续
+// 执行后续语句的分支中 return 的函数不内联。
+//
+// 只展开求值顺序不变的调用：表达式语句、return 和 if 条件中的调用，且在它之前
+// 求值的只有常量和局部标量（被调函数无法修改）。初始化表达式中的调用先改写为
+// 复合语句开头的赋值。循环条件中的调用不展开。
+//
+// 展开后的函数仍可交给任何执行引擎。调用者的 referenceHash 混入被展开函数的
+// 指纹，函数级编译缓存（见 cache.h）不会复用展开前的结果。
+class Inliner {
+public:
+    explicit Inliner(const InlineOptions& options = InlineOptions());
+
+    // 内联整个程序（须已通过语义分析）
+    void run(ProgramNode& program);
+
+    // 展开的调用数
+    size_t inlinedCalls() const { return inlined; }
+
+    // 各调用点的决定（options.remarks 时记录），按处理顺序
+    const std::vector<InlineRemark>& remarks() const { return remarkList; }
+
+private:
+    // 调用图中的函数
+    struct Callee {
+        FunDeclarationNode* node = nullptr;
+        int size = 0;        // 函数体的节点数（处理之后，含已展开的调用）
+        int callSites = 0;   // 程序中调用它的次数
+        bool recursive = false;  // 在调用图的环上
+        bool shapeChecked = false;
+        const char* unsuitable = nullptr;  // return 的位置不允许展开时的原因
+    };
+    struct Remap;
+    struct EvalState;
+
+    void analyzeCallGraph(ProgramNode& program);
+    void inlineFunction(FunDeclarationNode& caller);
+    void inlineBlock(CompoundStmtNode& block, int loopDepth);
+    void inlineStatement(std::unique_ptr<ASTNode>& stmt, int loopDepth);
+    std::unique_ptr<ASTNode>* findSite(std::unique_ptr<ASTNode>& expr, EvalState& state, int loopDepth);
+    void hoistInitializers(CompoundStmtNode& block, int loopDepth);
+    bool decide(const CallNode& call, bool blocked, int loopDepth);
+    void rejectCalls(const ASTNode* expr, const char* reason);
+    std::unique_ptr<ASTNode>* expand(std::unique_ptr<ASTNode>& stmt, std::unique_ptr<ASTNode>& site);
+    void remark(const CallNode& call, const std::string& message);
+
+    std::unique_ptr<ASTNode> clone(const ASTNode* node, const Remap& remap);
+    void rewriteReturns(std::vector<std::unique_ptr<ASTNode>>& stmts, int resultSlot, const std::string& resultName);
+
+    InlineOptions options;
+    size_t inlined;
+    std::vector<InlineRemark> remarkList;
+
+    std::vector<Callee> callees;  // 按声明顺序
+    std::unordered_map<const FunDeclarationNode*, size_t> calleeIndex;
+    std::vector<size_t> order;    // 处理顺序：被调函数在前
+    int64_t hottestSite;          // 剖析数据中调用点的最大执行次数，没有时为-1
+
+    // 当前调用者
+    FunDeclarationNode* currentCaller;
+    int callerSize;
+    int callerLimit;
+    int sites;  // 已展开的调用数，混入 referenceHash
+    std::unordered_map<const CallNode*, bool> decisions;  // 已决定的调用点
+};
+
+#endif // INLINER_H
@@ -0,0 +1,77 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include "ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 解释器选项
+struct InterpreterOptions {
+    size_t stackCells = 1 << 20;    // 标量槽位栈大小
+    size_t arrayWords = 1 << 22;    // 数组存储区大小（int）
+    size_t maxCallDepth = 1 << 14;  // 最大调用深度（受本机栈限制）
+    size_t maxSteps = 0;            // 最多执行的调用和循环迭代次数，0 表示不限
+};
+
+// 解释器统计信息
+struct InterpreterStats {
+    size_t calls = 0;       // 函数调用次数（不含内建函数）
+    size_t tailCalls = 0;   // 其中复用栈帧执行的尾调用
+};
+
+// 树遍历解释器：直接执行经过语义分析的AST
+//
+// 作为语义参考实现（差分测试）和其他执行引擎的性能基准。变量按语义分析
+// 分配的槽位访问，运行时不按名字查找。存储布局与虚拟机相同：标量槽位为
+// 64位单元，数组引用为（数组区起点 << 32 | 长度），下标访问做越界检查。
+class Interpreter {
+public:
+    explicit Interpreter(const InterpreterOptions& options = InterpreterOptions());
+
+    // 执行 main，返回其返回值；运行时错误抛出异常
+    int run(const ProgramNode& program);
+
+    // 以给定的标量实参执行一个函数，返回其返回值（编译期求值用）。
+    // 不初始化全局存储，函数及其调用的函数不能访问全局变量和调用内建函数；
+    // 运行时错误（含超出 maxSteps）抛出异常
+    int32_t run(const FunDeclarationNode& fun, const std::vector<int32_t>& args);
+
+    const InterpreterStats& stats() const { return interpStats; }
+
+private:
+    // 语句执行结果
+    enum class Flow {
+        NORMAL,
+        RETURN
+    };
+
+    int32_t call(const FunDeclarationNode& fun, const CallNode* call);
+    Flow execute(const ASTNode* stmt);
+    Flow executeCompound(const CompoundStmtNode& compoundStmt);
+    int64_t evaluate(const ASTNode* expr);
+    int64_t arrayRef(const VarNode& var);
+    int32_t* element(const VarNode& var, int64_t index);
+    int32_t* element(int64_t ref, int64_t index, SourceOffset start);
+    void step(SourceOffset start);
+    [[noreturn]] void runtimeError(const std::string& message, SourceOffset start) const;
+
+    InterpreterOptions options;
+    InterpreterStats interpStats;
+    const SourceManager* sources;  // 运行时错误的行号（ProgramNode::sources）
+    std::unique_ptr<int64_t[]> stack;
+    std::unique_ptr<int32_t[]> memory;
+    std::unique_ptr<int32_t[]> globals;
+
+    int64_t* slots;         // 当前栈帧的槽位
+    size_t stackTop;        // 栈中第一个空闲单元
+    uint32_t arrayBase;     // 当前栈帧的数组区起点
+    uint32_t arrayTop;      // 数组区第一个空闲位置
+    size_t callDepth;
+    size_t steps;           // 剩余的调用和循环迭代次数
+    int32_t returnValue;
+    const FunDeclarationNode* tailCallee;  // return 语句请求的尾调用，实参已在栈顶
+};
+
+#endif // INTERPRETER_H
@@ -0,0 +1,115 @@
+#ifndef INTERPROCEDURAL_H
+#define INTERPROCEDURAL_H
+
+#include "ast.h"
+#include "consteval.h"
+#include "hash.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 过程间优化的结果
+struct InterproceduralStats {
+    size_t removedFunctions = 0;  // 从 main 不可达的函数
+    size_t removedGlobals = 0;    // 不再被引用的全局变量和数组
+    size_t constantParams = 0;    // 每个调用点都传入同一个常数的参数
+    size_t constantGlobals = 0;   // 从不赋值的全局变量（读取换成初值）
+    size_t foldedCalls = 0;       // 换成常数结果的调用
+    size_t evaluatedCalls = 0;    // 在编译期执行纯函数、换成结果的调用
+    size_t removedCalls = 0;      // 结果不用且没有副作用、被删除的调用
+    size_t foldedBranches = 0;    // 条件为常数、只留下一个分支的 if 和不执行的 while
+};
+
+// 过程间优化的决定（优化提示）
+struct InterproceduralRemark {
+    SourceOffset start;
+    std::string message;  // 如 "parameter 'n' of 'fill' is always 16"
+};
+
+// 整个程序的过程间优化：在语义分析之后、内联和交给执行引擎之前进行
+//
+// 调用图（CallNode::callee）从 main 出发求可达的函数，不可达的函数和只被它们引用的
+// 全局变量、全局数组在其他分析之前删除，剩下的全局变量重新编号槽位和数组区偏移。
+//
+// 常量传播在调用图上迭代到不动点（格：未知 > 常数 > 变化）：
+// - 参数：函数体内不赋值的标量参数，每个调用点的实参都是同一个常数时，读取换成该常数。
+//   实参按常数、调用者的常量参数、常量全局变量和已知返回值折叠（32位环绕，除零不折叠）；
+// - 全局变量：可达的代码中从不赋值的全局标量总是初值（没有时为0），读取换成常数；
+//   局部标量同样：初始化为整数常数（或没有初始化）且从不赋值时，读取换成常数；
+// - 返回值：所有 return（以及末尾落空时的0）都是同一个常数的函数，调用的结果是该常数。
+//   被调函数没有可观察的作用（不递归、没有循环、不访问数组、只给局部变量赋值、不调用
+//   input/output、除数是非零常数、只调用同样的函数）且实参也没有作用时，调用换成常数；
+//   结果不用的这类调用直接删除。
+// - 纯函数（见 ConstantEvaluator）的实参都是常数时，在沙箱中执行得到结果，调用换成常数；
+//   结果也参与传播。执行失败（运行时错误、超出步数等限制）的调用保留。
+// 条件为常数时只有一个分支会执行（条件未知的分支暂不执行），return 之后的语句不执行；
+// 改写时删除不会执行的分支。
+// 改写后重新求可达性，所有调用都被替换的函数随之删除。参数本身保留，调用约定不变。
+//
+// 改写过的函数的 referenceHash 混入改写的内容，函数级编译缓存（见 cache.h）不会复用
+// 改写前的结果。
+class InterproceduralOptimizer {
+public:
+    explicit InterproceduralOptimizer(bool remarks = false);
+
+    // 优化整个程序（须已通过语义分析）
+    void run(ProgramNode& program);
+
+    const InterproceduralStats& stats() const { return result; }
+
+    // 各项决定（构造时 remarks 为 true 时记录），按处理顺序
+    const std::vector<InterproceduralRemark>& remarks() const { return remarkList; }
+
+private:
+    // 常量格上的值
+    struct Value {
+        enum Kind : uint8_t { UNKNOWN, CONSTANT, VARYING } kind = UNKNOWN;
+        int32_t value = 0;
+
+        bool isConstant() const { return kind == CONSTANT; }
+        bool meet(const Value& other);  // 与 other 取下界，改变时返回 true
+    };
+
+    // 调用图中的函数
+    struct Function {
+        FunDeclarationNode* node = nullptr;
+        bool reachable = false;
+        std::vector<Value> params;     // 按参数槽位，数组参数和被赋值的参数为 VARYING
+        std::vector<Value> locals;     // 按槽位（参数之后），只由整数常数初始化、从不赋值的局部标量为常数
+        Value returned;
+        int effectFree = -1;           // 没有可观察的作用：-1 未判断，0 否，1 是，2 判断中
+        Hasher changes;                // 改写的内容
+        bool changed = false;
+    };
+
+    void buildCallGraph(ProgramNode& program);
+    void markReachable();
+    void collectAssignments(const ASTNode& node, Function& function);
+    bool propagate(const ASTNode& stmt, Function& function, bool& changed);
+    Value evaluate(const ASTNode& expr, Function& function, bool& changed);
+    bool fold(const ASTNode& expr, const Function& function, int32_t& value) const;
+    bool isEffectFree(Function& function);
+    bool hasNoEffect(const ASTNode& node, Function& function, bool inCallee);
+    bool evaluateCall(const CallNode& call, const Function& function, int32_t& value);
+    void rewrite(std::unique_ptr<ASTNode>& slot, Function& function);
+    void removeUnreachable(ProgramNode& program);
+    void renumberGlobals(ProgramNode& program);
+    Function* functionOf(const CallNode& call);
+    void remark(SourceOffset start, const std::string& message);
+
+    bool recordRemarks;
+    InterproceduralStats result;
+    std::vector<InterproceduralRemark> remarkList;
+
+    std::vector<Function> functions;  // 按声明顺序
+    std::unordered_map<const FunDeclarationNode*, size_t> functionIndex;
+    std::vector<bool> globalAssigned;      // 按全局槽位
+    std::vector<bool> globalFolded;        // 读取已换成常数
+    std::vector<int32_t> globalInitial;    // 全局变量的初值
+    std::vector<const VarDeclarationNode*> globalDecls;
+    ConstantEvaluator evaluator;
+};
+
+#endif // INTERPROCEDURAL_H
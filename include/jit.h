@@ -0,0 +1,97 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "ast.h"
+#include "codegen.h"
+#include "profile.h"
+#include "sampler.h"
+#include "x86.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// JIT选项
+struct JitOptions {
+    int optLevel = 0;   // 0：模板层（启动最快）；1：优化层
+    x86::VectorIsa vectorIsa = x86::hostVectorIsa();  // 优化层向量化使用的指令集
+    bool remarks = false;  // 记录每个循环的优化决定
+    bool boundsChecks = false;  // 检查数组下标（见 CodegenOptions::boundsChecks）
+    bool instrument = false;    // 插桩统计执行次数（见 CodegenOptions::instrument）
+    int samplePeriod = 0;       // 采样剖析：run 期间每这么多微秒的CPU时间记录一次调用栈（0 为不采样）
+};
+
+// JIT统计信息（微秒）
+struct JitStats {
+    size_t functions = 0;
+    size_t codeBytes = 0;
+    size_t memoryBytes = 0;
+    size_t tailCalls = 0;   // 转为跳转的尾调用数
+    size_t vectorizedLoops = 0;
+    size_t unrolledLoops = 0;
+    size_t boundsAccesses = 0;  // 已知长度数组的下标访问数（boundsChecks 时）
+    size_t boundsChecks = 0;    // 其中仍需检查的
+    x86::PeepholeStats peephole;  // 优化层的窥孔优化和调度
+    double codegenMicros = 0;
+    double assembleMicros = 0;
+    double linkMicros = 0;
+};
+
+// 进程内JIT：把程序编译到可执行内存中并直接调用 main
+//
+// 内存布局：[代码][外部函数桩] | [数据][BSS]，前一部分映射为只读可执行，
+// 后一部分为可读写。所有重定位在进程内完成，无需汇编器和链接器。
+class JitCompiler {
+public:
+    explicit JitCompiler(const JitOptions& options = JitOptions());
+    ~JitCompiler();
+
+    JitCompiler(const JitCompiler&) = delete;
+    JitCompiler& operator=(const JitCompiler&) = delete;
+
+    // 编译并链接程序（程序需已通过语义分析）
+    void compile(const ProgramNode& program);
+
+    // 调用 main，返回其返回值
+    int run();
+
+    // 查找函数入口地址，不存在时返回nullptr
+    void* lookup(const std::string& name) const;
+
+    const JitStats& stats() const { return jitStats; }
+
+    // 各循环的优化决定（options.remarks 时记录）
+    const std::vector<LoopRemark>& remarks() const { return loopRemarks; }
+
+    // 把插桩计数器的当前值（run 之后即这次运行的计数）加到剖析数据中
+    void collectProfile(Profile& profile) const;
+
+    // 把 run 中采到的调用栈（options.samplePeriod 时）换算为函数名和行号，加到 profile 中，
+    // 返回因缓冲区已满而丢弃的样本数
+    uint64_t collectSamples(SampleProfile& profile) const;
+
+private:
+    void link(const x86::ObjectCode& object);
+    void release();
+    int runSampled(int (*mainFunction)());
+
+    JitOptions options;
+    JitStats jitStats;
+    x86::ObjectCode object;
+    std::vector<LoopRemark> loopRemarks;
+    std::vector<ProfileCounters> counters;
+    // 采到的样本，依次为：帧数 n，n 个代码地址（第一个是正在执行的指令，其后为返回地址）
+    std::vector<uint64_t> samples;
+    uint64_t droppedSamples = 0;
+
+    unsigned char* memory;
+    size_t memorySize;
+    size_t execSize;    // 可执行部分大小
+    size_t dataStart;   // 数据段在映射中的偏移
+    size_t bssStart;    // BSS段在映射中的偏移
+    size_t stubStart;   // 外部函数桩的偏移
+    size_t stubBytes;   // 每个桩的大小
+    size_t runtimeCallStart;  // 采样时桩记录调用者 rbp 和返回地址的位置（BSS之后）
+};
+
+#endif // JIT_H
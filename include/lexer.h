@@ -1,7 +1,11 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "source.h"
+#include <istream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
@@ -22,34 +26,54 @@ enum class TokenType {
     END_OF_FILE,
     
     // 错误标记
-    ERROR
+    ERROR,
+
+    // 扩展的运算符，放在最后以保持 --tokens 输出中原有的类型编号不变
+    MOD
 };
 
-// Token结构
+// Token结构：位置是第一个字符的偏移，行号和列号由 SourceManager 换算
 struct Token {
     TokenType type;
     std::string lexeme;
-    int line;
+    SourceOffset start;
     
-    Token(TokenType t, const std::string& l, int ln) 
-        : type(t), lexeme(l), line(ln) {}
+    Token(TokenType t, std::string l, SourceOffset s) 
+        : type(t), lexeme(std::move(l)), start(s) {}
 };
 
 // 词法分析器类
+//
+// 不复制源代码：source 指向的内容必须在词法分析器使用期间保持有效。
+// 流式模式从输入流分块读取，只保留当前Token所在的一段，Token和注释可以跨块。
+// Token的位置是在整个输入中的偏移，由 sourceManager() 换算为行号。
 class Lexer {
 public:
-    Lexer(const std::string& source);
+    // 流式模式每次读取的字节数
+    static const size_t defaultChunkSize = 64 * 1024;
+
+    Lexer(std::string_view source);
+    explicit Lexer(std::istream& input, size_t chunkSize = defaultChunkSize);
     
     // 获取下一个Token
     Token getNextToken();
     
     // 获取所有Token（用于测试）
     std::vector<Token> getAllTokens();
+    
+    // 把所有Token（末尾为EOF）写入 tokens，复用其已有容量
+    void tokenize(std::vector<Token>& tokens);
+
+    // 源代码的行首表（流式模式下随读入的内容增长）
+    const std::shared_ptr<SourceManager>& sourceManager() const { return sources; }
 
 private:
     // 辅助函数
-    char peek() const;
+    char peek();
+    char peekNext();
+    bool atEnd();
     char advance();
+    bool refill();
     void skipWhitespace();
     void skipComment();
     
@@ -58,13 +82,23 @@ private:
     Token handleNumber();
     Token handleOperator();
     Token handleSymbol();
+    SourceOffset offset(size_t pos) const { return static_cast<SourceOffset>(bufferStart + pos); }
     
     // 源程序
-    std::string source;
+    std::string_view source;
+    
+    std::shared_ptr<SourceManager> sources;
     
-    // 当前位置
+    // 当前位置和当前Token的起始位置
     size_t currentPos;
-    int currentLine;
+    size_t tokenStart;
+    
+    // 流式模式：输入流和已读入、尚未丢弃的内容（source 指向 buffer，从输入的 bufferStart 处开始）
+    std::istream* input;
+    size_t bufferStart;
+    size_t chunkSize;
+    std::string buffer;
+    bool skipping;  // 正在跳过空白和注释，读入新块时不必保留
     
     // 关键字映射
     static const std::unordered_map<std::string, TokenType> keywords;
@@ -0,0 +1,50 @@
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include "ast.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 计数循环：
+//     while (i < n) { 语句; i = i + 1; }      （或 i <= n）
+// i 为局部标量，n 为常数或循环中不变的标量，循环体只在末尾修改 i。
+// 进入一次循环体前只需检查 i，连续 k 次迭代都会执行当且仅当 i + k - 1 < n。
+struct CountedLoop {
+    const VarNode* induction = nullptr;     // 归纳变量 i
+    const ASTNode* bound = nullptr;         // 上界 n（NumNode 或不带下标的 VarNode）
+    bool inclusive = false;                 // 条件为 i <= n
+    const CompoundStmtNode* body = nullptr; // 循环体，最后一条语句是自增
+    int bodySize = 0;                       // 循环体的AST节点数
+    bool hasLoops = false;                  // 循环体中有嵌套循环
+    long long tripCount = -1;               // 循环前把 i 赋为常数且 n 为常数时的迭代次数，否则为-1
+};
+
+// 向量化方案：循环体（除自增外）的每条语句是下面两种之一，
+//     a[i] = E;           逐元素计算
+//     s = s + E;          求和归约（或 s = E + s、s = s - E）
+// E 由 a[i] 形式的元素、循环中不变的标量和常数经 + - * 组成。所有数组访问的
+// 下标都是 i 本身，不同迭代之间没有数据依赖（数组参数只能指向整个数组，两个
+// 数组要么相同要么不重叠），可以把连续的若干次迭代合为一组逐条语句执行。
+struct VectorPlan {
+    struct Statement {
+        const VarNode* target;  // a[i] 或归约变量 s
+        const ASTNode* value;   // E
+        bool reduction;
+        bool subtract;          // s = s - E
+    };
+    std::vector<Statement> statements;
+    std::vector<const ASTNode*> invariants;                // 不同的不变量（常数、标量或由它们组成的子树）
+    std::unordered_map<const ASTNode*, int> invariantOf;   // E 中不变的子树 -> invariants 中的编号
+    bool multiplies = false;
+    int temporaries = 0;  // 计算 E 需要的向量寄存器数
+};
+
+// 分析循环：是计数循环时填写 out 并返回 nullptr，否则返回原因。
+// previous 为同一语句序列中紧挨在循环之前的语句（可以为空），用于推算迭代次数
+const char* analyzeCountedLoop(const IterationStmtNode& loop, const ASTNode* previous, CountedLoop& out);
+
+// 计数循环能否向量化：能时填写 out 并返回空串，否则返回原因
+std::string planVectorization(const CountedLoop& loop, VectorPlan& out);
+
+#endif // LOOPS_H
@@ -3,6 +3,11 @@
 
 #include "lexer.h"
 #include "ast.h"
+#include "hash.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <memory>
 #include <stdexcept>
@@ -11,22 +16,103 @@
 
 class Parser {
 public:
+    // 表达式和语句的默认最大嵌套深度。表达式的解析不递归，但语句的解析以及
+    // 语义分析、各执行引擎对AST的遍历都是递归的，限制深度可以防止恶意输入耗尽调用栈
+    static const int defaultMaxNestingDepth = 1000;
+
     Parser(Lexer& lexer);
+    // 从预先词法分析得到的Token序列解析（末尾须为EOF），用于分别统计两个阶段；
+    // sources 是词法分析器的行首表，用于错误信息
+    Parser(std::vector<Token> tokens, std::shared_ptr<const SourceManager> sources);
+    ~Parser();
+
+    Parser(const Parser&) = delete;
+    Parser& operator=(const Parser&) = delete;
     std::unique_ptr<ProgramNode> parse();
+    // 流式解析：返回下一个顶层声明，输入结束时返回空（与 parse 不能混用）
+    std::unique_ptr<ASTNode> parseNextDeclaration();
+    // 解析结束后取回 tokens 的存储以复用其容量（只用于从Token序列解析）
+    std::vector<Token> releaseTokens();
+    
+    // 最大嵌套深度（括号、下标、实参、赋值右边和语句各算一层），超过时报错
+    void setMaxNestingDepth(int depth) { maxNesting = depth; }
+
+    // hash-consing：结构相同的无副作用表达式（常数、变量和不含调用、赋值、下标、除法和
+    // 取模的运算）在构造时通过哈希表去重，成为共享的节点（ASTNode::sharedOwners），相同的
+    // 子树只占一份内存，相等判断只需比较指针。变量按其绑定的声明区分，被遮蔽的同名
+    // 变量不会合并；赋值的目标不共享。共享节点的行号是第一次出现的行，其中的语义错误
+    // 按第一次出现的行报告；可能发生运行时错误的下标和除法不共享。在顶层声明之间清空哈希表
+    void setHashConsing(bool enable) { hashConsing = enable; }
+    // 去重时复用已有节点的次数
+    uint64_t sharedNodes() const { return sharedCount; }
+
+    // 是否输出解析过程的跟踪信息
+    void setTrace(bool enable, std::ostream& out = std::cout) {
+        trace = enable;
+        traceOut = &out;
+    }
     
 private:
     // 辅助函数
-    Token currentToken() const;
-    Token peekToken() const;
+    Token nextToken();
+    const Token& currentToken() const;
+    const Token& peekToken() const;
     void eatToken(TokenType expected);
     bool matchToken(TokenType expected) const;
     void error(const std::string& message) const;
+    SourceLocation locate(const Token& token) const { return sources->location(token.start); }
+    int parseNumber(const Token& numToken) const;
+    void hashToken(const Token& token);
+    
+    // 嵌套深度计数（RAII），超过 maxNesting 时报错
+    class NestingGuard {
+    public:
+        explicit NestingGuard(Parser& parser);
+        ~NestingGuard() { parser.nestingDepth--; }
+    private:
+        Parser& parser;
+    };
+    void enterNesting();
+
+    // 表达式解析中的一帧：整个表达式、括号、数组下标或实参列表
+    struct ExprFrame {
+        enum Kind { TOP, PAREN, INDEX, CALL } kind;
+        size_t operatorBase;             // 帧内的运算符在 operators 中的起点
+        size_t simpleBase;               // 当前 simple_expression 的运算符起点（赋值之后重新开始）
+        bool relop;                      // 当前 simple_expression 已有关系运算符
+        int depth;                       // 进入帧之前的嵌套深度
+        std::unique_ptr<ASTNode> owner;  // INDEX 的 VarNode 或 CALL 的 CallNode
+        int argHeight;                   // CALL：已解析的实参的最大高度
+    };
+    static int precedence(TokenType type);
+    void reduceOperators(size_t base, int minPrecedence);
+    void pushFrame(ExprFrame::Kind kind, std::unique_ptr<ASTNode> owner);
+
+    // hash-consing 的键：节点类型、运算符/常数值/变量绑定和子节点（子节点已共享，比较指针即可）
+    struct ExprKey {
+        ASTNodeType type;
+        int value;
+        const ASTNode* left;
+        const ASTNode* right;
+        bool operator==(const ExprKey& other) const {
+            return type == other.type && value == other.value && left == other.left && right == other.right;
+        }
+    };
+    struct ExprKeyHash {
+        size_t operator()(const ExprKey& key) const;
+    };
+    template <class Make>
+    std::unique_ptr<ASTNode> intern(const ExprKey& key, Make make);
+    void clearInternTable();
+    int bindingOf(const std::string& name);
+    void bind(const std::string& name, bool global);
     
     // 解析函数
     std::unique_ptr<ProgramNode> parseProgram();
     void parseDeclarationList(ProgramNode& program);
     std::unique_ptr<ASTNode> parseDeclaration();
     std::unique_ptr<ASTNode> parseVarDeclaration();
+    std::unique_ptr<ASTNode> parseVarDeclarationRest(const Token& typeToken, const Token& idToken);
     std::unique_ptr<FunDeclarationNode> parseFunDeclaration(const Token& typeToken, const Token& idToken);
     std::unique_ptr<ParamNode> parseParam();
     void parseParamList(std::vector<std::unique_ptr<ASTNode>>& params);
@@ -39,20 +125,44 @@ private:
     std::unique_ptr<IterationStmtNode> parseIterationStmt();
     std::unique_ptr<ReturnStmtNode> parseReturnStmt();
     std::unique_ptr<ASTNode> parseExpression();
-    std::unique_ptr<VarNode> parseVar();
-    std::unique_ptr<ASTNode> parseSimpleExpression();
-    std::unique_ptr<ASTNode> parseAdditiveExpression();
-    std::unique_ptr<ASTNode> parseTerm();
-    std::unique_ptr<ASTNode> parseFactor();
-    std::unique_ptr<CallNode> parseCall();
-    void parseArgList(std::vector<std::unique_ptr<ASTNode>>& args);
-    
-    // 词法分析器引用
-    Lexer& lexer;
-    
-    // Token缓冲区
+    
+    // 词法分析器，按需产生Token；为空时从 tokens 中依次取出
+    Lexer* lexer;
+    std::shared_ptr<const SourceManager> sources;
+    std::vector<Token> tokens;
+    size_t tokenPos;
+    
+    // Token缓冲区：[0]为当前Token，[1]为预读Token
     std::vector<Token> tokenBuffer;
-    size_t currentIndex;
+    
+    bool trace;
+    std::ostream* traceOut;
+    int nestingDepth;
+    int maxNesting;
+    bool parsedDeclaration;  // 流式解析已返回过声明
+    
+    // 表达式解析的操作数栈、运算符栈和帧栈（跨表达式复用存储）
+    std::vector<std::unique_ptr<ASTNode>> operands;
+    // 各操作数第一个Token的位置（共享节点的位置是第一次出现的位置，不能代替）
+    std::vector<SourceOffset> operandStarts;
+    // 各操作数子树的高度。运算符链（1+1+...）不增加嵌套深度，归约时按帧的嵌套深度加上
+    // 子树的高度检查限制，防止左深的长链耗尽递归遍历和析构的调用栈
+    std::vector<int> operandHeights;
+    std::vector<TokenType> operators;
+    std::vector<ExprFrame> frames;
+    
+    // hash-consing：表中的节点各持有一个引用（所以解析期间共享节点的 sharedOwners 大于0）；
+    // 全局名字和局部作用域栈中名字到绑定编号的映射
+    bool hashConsing;
+    std::unordered_map<ExprKey, ASTNode*, ExprKeyHash> internTable;
+    uint64_t sharedCount;
+    std::unordered_map<std::string, int> globalBindings;
+    std::vector<std::pair<std::string, int>> localBindings;
+    int nextBinding;
+    
+    // 当前函数的Token序列哈希（FunDeclarationNode::tokenHash）
+    Hasher spanHasher;
+    bool hashingSpan;
 };
 
 #endif // PARSER_H
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "x86.h"
+#include <cstddef>
+
+// 机器指令级的窥孔优化和基本块内的指令调度（优化层在每个函数生成后进行）
+//
+// 逐个表达式翻译留下的冗余：中间值经 push/pop 周转、结果先放 eax 再搬到变量的寄存器、
+// 比较前把操作数复制到 eax、刚存入内存又读回、可以用一条 lea 完成的 mov+add 等。
+// 各模式都按寄存器和标志位的活跃性判断改写是否安全，改写后重新计算活跃性，直到不再变化。
+namespace x86 {
+
+// 窥孔优化的模式
+enum class Peephole : uint8_t {
+    PUSH_POP,         // push r ... pop d 改为寄存器间传送（必要时借用空闲的寄存器）
+    COPY_COALESCE,    // 算出 a 后 mov d, a：直接算到 d 中
+    COPY_PROPAGATE,   // mov a, x 后只把 a 作源操作数：直接使用 x
+    COMPARE_OPERAND,  // mov a, x; cmp/test a, y：直接比较 x
+    STORE_LOAD,       // 存入内存后立即读回，或把刚读出的值原样存回
+    LEA,              // mov+add、shl+add 等合为一条 lea（不影响标志位）
+    DEAD_CODE,        // 结果不再使用的指令
+    UNREACHABLE,      // 无条件跳转或返回之后、下一个标签之前的指令
+    JUMP_NEXT,        // 跳到紧接着的标签
+    BRANCH_INVERSION, // jcc L1; jmp L2; L1: 改为条件取反的 jcc L2
+    COUNT
+};
+
+const char* peepholeName(Peephole pattern);
+
+// 各模式的命中次数和调度的结果
+struct PeepholeStats {
+    size_t hits[static_cast<size_t>(Peephole::COUNT)] = {};
+    size_t scheduledBlocks = 0;    // 调度后指令顺序改变的基本块
+    size_t movedInstructions = 0;  // 位置改变的指令
+
+    size_t& operator[](Peephole pattern) { return hits[static_cast<size_t>(pattern)]; }
+    size_t operator[](Peephole pattern) const { return hits[static_cast<size_t>(pattern)]; }
+};
+
+// 窥孔优化：就地改写函数的指令
+void optimizePeephole(MFunction& function, PeepholeStats& stats);
+
+// 表调度：在基本块内按依赖关系重排指令，优先安排关键路径上的指令，让访存和乘除的延迟
+// 与不相关的指令重叠。标签、跳转、调用和改变 rsp 的指令是边界。行号伪指令不参与调度：
+// 每条指令带着自己的行移动，调度后在行号变化处重新插入，生成的代码与是否记录行号无关
+void scheduleInstructions(MFunction& function, PeepholeStats& stats);
+
+} // namespace x86
+
+#endif // PEEPHOLE_H
@@ -0,0 +1,61 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "ast.h"
+#include "hash.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 函数的插桩计数器布局
+//
+// 计数器 0 为函数的调用次数，其余按先序（源代码顺序）分给函数体中的插桩位置：
+//     if      两个：语句执行的次数、进入 then 分支的次数
+//     while   两个：到达循环的次数、循环体执行的次数
+//     调用    一个：调用用户函数的次数（input/output 不计）
+struct CounterLayout {
+    int size = 1;  // 计数器个数
+    std::unordered_map<const ASTNode*, int> first;  // 插桩位置 -> 它的第一个计数器
+};
+
+CounterLayout layoutCounters(const FunDeclarationNode& fun);
+
+// 函数的结构哈希：只取插桩位置的嵌套结构和被调函数名。修改表达式、常数、变量名，
+// 增删不含 if、while 和调用的语句，或改动空白和注释，都不会使剖析数据失效
+Hash128 structuralHash(const FunDeclarationNode& fun);
+
+// 剖析数据（--profile-generate 写入，--profile-use 读取）
+//
+// 文本文件，按函数名和结构哈希保存各函数的计数器：
+//     cminus-profile 1
+//     function <函数名> <结构哈希> <计数器个数>
+//     <计数器...>
+// 多次运行写入同一个文件时，结构未变的函数的计数累加。
+class Profile {
+public:
+    // 读取剖析文件，文件不存在时返回 false，格式错误时抛出 std::runtime_error
+    bool load(const std::string& path);
+
+    // 写入剖析文件，失败时抛出 std::runtime_error
+    void save(const std::string& path) const;
+
+    // 加上一次运行的计数；结构哈希或计数器个数不同时替换原有的数据
+    void add(const std::string& function, const Hash128& hash, const std::vector<uint64_t>& counters);
+
+    // 把计数填入语义分析后的AST（ExecutionCounts），返回使用了剖析数据的函数数。
+    // 函数名相同而结构已经改变的函数不使用，名字记入 stale
+    int annotate(ProgramNode& program, std::vector<const FunDeclarationNode*>* stale = nullptr) const;
+
+    size_t size() const { return functions.size(); }
+
+private:
+    struct Entry {
+        Hash128 hash;
+        std::vector<uint64_t> counters;
+    };
+    std::unordered_map<std::string, Entry> functions;
+    std::vector<std::string> order;  // 函数按加入的顺序写出
+};
+
+#endif // PROFILE_H
@@ -0,0 +1,65 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// 编译服务与客户端之间的协议（Unix 域套接字）
+//
+// 帧：4字节小端负载长度 + 1字节类型 + 负载。
+// 客户端依次发送 REQUEST（工作目录和命令行参数）、可选的 SOURCE（输入文件为 "-" 时的
+// 源代码）和 END；服务端流式返回 STDOUT/STDERR 帧，最后是 EXIT（4字节小端退出码）。
+// 需要执行用户程序的请求不在服务端运行，服务端返回 FALLBACK，由客户端在本地执行。
+namespace protocol {
+
+enum class FrameType : uint8_t {
+    REQUEST = 1,
+    SOURCE,
+    END,
+    STDOUT,
+    STDERR,
+    EXIT,
+    FALLBACK
+};
+
+// 单帧负载上限，防止恶意或损坏的长度字段
+const uint32_t maxFrameSize = 256u << 20;
+
+// 默认套接字路径：环境变量 CMINUS_SERVER_SOCKET，否则 /tmp/cminus-<uid>.sock
+std::string defaultSocketPath();
+
+// 完整地写一帧 / 读一帧，连接断开或出错时返回 false
+bool writeFrame(int fd, FrameType type, const char* data, size_t size);
+bool readFrame(int fd, FrameType& type, std::string& payload);
+
+// REQUEST 负载：若干个“4字节长度 + 内容”的字符串
+void encodeStrings(const std::vector<std::string>& strings, std::string& payload);
+bool decodeStrings(const std::string& payload, std::vector<std::string>& strings);
+
+// 把写入的数据按帧发送：缓冲区满或 flush 时发出一帧。连接断开后丢弃后续输出
+class FrameStreambuf : public std::streambuf {
+public:
+    FrameStreambuf(int fd, FrameType type, size_t capacity = 1 << 16);
+
+    FrameStreambuf(const FrameStreambuf&) = delete;
+    FrameStreambuf& operator=(const FrameStreambuf&) = delete;
+
+protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+private:
+    bool send();
+
+    int fd;
+    FrameType type;
+    std::vector<char> buffer;
+    bool failed;
+};
+
+} // namespace protocol
+
+#endif // PROTOCOL_H
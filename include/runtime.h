@@ -0,0 +1,46 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <cstdint>
+#include <string>
+
+// C- 运行时支持：内建函数 input/output
+//
+// 所有执行引擎（以及生成的本机代码）都通过这两个函数完成输入输出，
+// 保证各引擎的行为一致。
+extern "C" {
+
+// 从标准输入读取一个整数，读取失败时返回0
+int cminus_input(void);
+
+// 向标准输出写一个整数并换行
+void cminus_output(int value);
+
+// 生成的代码中下标检查失败时调用：报告运行时错误并以状态1结束进程
+// （JIT 代码没有展开信息，不能抛出异常穿过）
+[[noreturn]] void cminus_bounds_error(int index, int line);
+
+// 生成的代码中除数为0时调用，同上
+[[noreturn]] void cminus_division_error(int line);
+
+// 当前线程栈的最低可用地址加上运行库函数所需的余量，取不到时返回0。
+// 生成的 main 在序言中调用一次，各函数分配栈帧之前与它比较
+uintptr_t cminus_stack_limit(void);
+
+// 栈帧超出 cminus_stack_limit 时调用，同 cminus_bounds_error；line 为函数定义的行号
+[[noreturn]] void cminus_stack_overflow(const char* function, int line);
+
+}
+
+namespace runtime {
+
+// 把输入输出重定向到内存：input() 从 input 中读取，output() 追加到 output。
+// 用于基准测试和差分测试时让各引擎看到相同的输入并比较输出。
+void redirect(const std::string* input, std::string* output);
+
+// 恢复标准输入输出
+void restore();
+
+}
+
+#endif // RUNTIME_H
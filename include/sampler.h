@@ -0,0 +1,46 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 调用栈中的一帧：函数名和正在执行的源代码行（未知时为0）
+struct SampleFrame {
+    std::string function;
+    int line = 0;
+};
+
+// 采样剖析的结果
+//
+// 虚拟机按执行的指令数采样，JIT 按进程的 CPU 时间（SIGPROF）采样，都把样本的调用栈换算为
+// 函数名和行号后加到这里。尾调用复用调用者的栈帧，被尾调用的函数直接接在调用者的调用者之后。
+class SampleProfile {
+public:
+    // 加上 count 个调用栈相同的样本，stack 从 main 开始，最后一帧是正在执行的函数
+    void add(const std::vector<SampleFrame>& stack, uint64_t count = 1);
+
+    uint64_t samples() const { return total; }
+
+    // 折叠栈：每个不同的调用栈一行 "main;sum;square 42"，可直接交给 flamegraph.pl、
+    // inferno、speedscope 等火焰图工具
+    void writeFolded(std::ostream& out) const;
+
+    // 按行的热度：逐行列出源代码，行前标出自身（样本正在执行这一行）和累计（这一行在调用栈中，
+    // 包括调用其他函数的时间）的样本比例
+    void writeListing(std::ostream& out, std::string_view source) const;
+
+private:
+    struct LineSamples {
+        uint64_t self = 0;
+        uint64_t total = 0;
+    };
+    std::map<std::string, uint64_t> stacks;  // 折叠栈 -> 样本数（按字典序输出）
+    std::map<int, LineSamples> lines;
+    uint64_t total = 0;
+};
+
+#endif // SAMPLER_H
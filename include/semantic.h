@@ -0,0 +1,123 @@
+#ifndef SEMANTIC_H
+#define SEMANTIC_H
+
+#include "ast.h"
+#include "consteval.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// 语义分析器：名字解析、类型检查，并为变量分配存储位置
+//
+// 分析完成后：
+//   - 每个 VarNode 的 kind/slot 指向具体的存储（全局槽位、栈帧槽位或数组区偏移）
+//   - 每个 CallNode 的 callee 指向被调函数（内建函数则设置 builtin）
+//   - FunDeclarationNode 记录栈帧大小，ProgramNode 记录全局存储大小
+//   - return f(...) 中的调用标记为尾调用（CallNode::tailCall），由各执行引擎消除
+//   - FunDeclarationNode::referenceHash 记录函数引用的全局变量和被调函数签名
+//   - 数组长度的常量表达式已求值（ArrayDeclarationNode::sizeExpression 释放）。表达式中可以
+//     调用此前已分析的纯函数，在编译期执行（见 ConstantEvaluator；流式分析时不能调用函数）
+// 各执行引擎只使用这些结果，运行时不再按名字查找变量。
+//
+// 约定：所有变量在进入其作用域时初始化为0（除非有初始化表达式）。
+class SemanticAnalyzer {
+public:
+    // 全局数组的总长度和每个函数的局部数组总长度的上限（int），保证各执行引擎的
+    // 数组偏移和栈帧大小不溢出
+    static constexpr int maxArrayWords = 1 << 28;
+
+    SemanticAnalyzer();
+
+    // 分析整个程序，出错时抛出 CompileError
+    void analyze(ProgramNode& program);
+
+    // 流式分析：beginStream 之后按源程序顺序逐个分析顶层声明，最后调用 finishStream。
+    // 声明分析完即可释放，所以其中的 CallNode::callee 为空（执行引擎需要 analyze）；
+    // 调用后面才定义的函数时先记下实参类型，到函数定义时再检查。
+    // sources 是词法分析器的行首表，在 finishStream 之前须保持有效。
+    void beginStream(const SourceManager& sources);
+    void analyzeDeclaration(ASTNode& decl);
+    void finishStream(SourceOffset start);
+
+private:
+    // 表达式的类型
+    enum class ExprType {
+        INT,
+        VOID,
+        ARRAY
+    };
+
+    // 符号表项
+    struct Symbol {
+        VarKind kind;
+        int slot;       // 标量槽位或数组区偏移
+        int arraySize;  // 数组长度（参数数组为0）
+    };
+
+    using Scope = std::unordered_map<std::string, Symbol>;
+
+    // 函数签名
+    struct Function {
+        FunDeclarationNode* node;  // 流式分析时为空
+        bool returnsVoid;
+        std::vector<bool> paramIsArray;
+        SourceOffset start;
+    };
+
+    // 流式分析中对尚未定义的函数的调用
+    struct PendingCall {
+        std::vector<ExprType> args;
+        std::string voidUse;  // 返回值被使用时，被调函数为void的错误信息；为空表示返回值被丢弃
+        SourceOffset start;
+    };
+
+    void reset();
+    void declareGlobal(ASTNode* decl);
+    void declareFunction(FunDeclarationNode* fun);
+    void analyzeFunction(FunDeclarationNode& fun);
+    void analyzeCompoundStmt(CompoundStmtNode& compoundStmt);
+    void analyzeLocalDeclaration(ASTNode* decl);
+    void evaluateArraySize(ArrayDeclarationNode& arrayDecl);
+    void allocateArray(ArrayDeclarationNode& arrayDecl, int& words, const std::string& owner);
+    void analyzeStatement(ASTNode* stmt);
+    ExprType analyzeExpression(ASTNode* expr);
+    ExprType analyzeVar(VarNode& var);
+    ExprType analyzeCall(CallNode& call);
+    void checkArgumentCount(const std::string& name, const Function& callee, size_t count, SourceOffset start) const;
+    void checkArgument(const std::string& name, const Function& callee, size_t i, ExprType type,
+                       SourceOffset start) const;
+    void expectInt(ASTNode* expr, const char* context);
+    void markTailCall(ASTNode* expr);
+
+    void declareSymbol(const std::string& name, const Symbol& symbol, SourceOffset start);
+    const Symbol* lookup(const std::string& name) const;
+    void error(const std::string& message, SourceOffset start) const;
+
+    // 换算错误位置的行首表（ProgramNode::sources 或 beginStream 的参数），没有时行号为0
+    const SourceManager* sources;
+
+    // 作用域栈：[0]为全局作用域
+    std::vector<Scope> scopes;
+
+    // 所有函数（允许先使用后定义，从而支持相互递归）
+    std::unordered_map<std::string, Function> functions;
+
+    // 全局存储的大小
+    int numGlobalSlots;
+    int globalArrayWords;
+
+    FunDeclarationNode* currentFunction;
+
+    // 流式分析的状态
+    bool streaming;
+    std::unordered_multimap<std::string, PendingCall> pendingCalls;
+    std::string voidUse;  // 下一个被分析的调用的 PendingCall::voidUse
+
+    // 当前函数所引用声明的哈希（FunDeclarationNode::referenceHash）
+    Hasher referenceHasher;
+
+    // 数组长度的编译期求值，登记已分析的函数
+    ConstantEvaluator evaluator;
+};
+
+#endif // SEMANTIC_H
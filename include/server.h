@@ -0,0 +1,57 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cminus.h"
+
+// 编译服务选项
+struct ServerOptions {
+    std::string socketPath;
+    int threads = 0;                    // 0：使用CPU数
+    size_t bufferBytes = 1 << 20;       // 每个工作线程预先分配的缓冲区大小
+};
+
+// 常驻编译服务：在 Unix 域套接字上接受编译请求，由预热的线程池处理
+//
+// 每个连接是一次完整的命令行调用（协议见 protocol.h）。工作线程复用各自的
+// 请求/源代码缓冲区和 CompilerContext，编译结果和诊断以帧的形式流式返回。
+// 收到 SIGINT/SIGTERM 时停止接受新连接，处理完已接受的请求后退出。
+class CompileServer {
+public:
+    explicit CompileServer(const ServerOptions& options);
+    ~CompileServer();
+
+    CompileServer(const CompileServer&) = delete;
+    CompileServer& operator=(const CompileServer&) = delete;
+
+    // 监听并处理请求，返回进程退出码
+    int serve();
+
+private:
+    // 工作线程复用的缓冲区和编译器上下文
+    struct WorkerBuffers {
+        std::string payload;
+        std::string source;
+        std::vector<std::string> args;
+        cminus::CompilerContext context;
+    };
+
+    void workerLoop();
+    void handle(int fd, WorkerBuffers& buffers);
+
+    ServerOptions options;
+    int listenFd;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<int> pending;
+    bool stopping;
+    std::vector<std::thread> workers;
+};
+
+#endif // SERVER_H
@@ -0,0 +1,45 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// 源代码中的位置：Token和AST节点只记录字节偏移，需要时再换算为行号和列号
+using SourceOffset = uint32_t;
+
+// 行号和列号（列按字节计），都从1开始，未知时为0
+struct SourceLocation {
+    int line = 0;
+    int column = 0;
+};
+
+// 源代码的行首表
+//
+// 词法分析不再逐字符数行：构造时（流式模式下每读入一块时）用 memchr 扫描一遍换行符，
+// 记录各行开头的偏移；报告诊断或输出 #line 时才按偏移二分查找行号。
+// 行首表不引用源代码，源代码释放后仍可使用。偏移为32位，源代码不能超过 4GB。
+class SourceManager {
+public:
+    static const size_t maxSize = UINT32_MAX;
+
+    SourceManager();
+    explicit SourceManager(std::string_view text);
+
+    // 流式模式：追加下一块源代码
+    void append(std::string_view chunk);
+
+    // 已记录的源代码长度和行数
+    size_t size() const { return length; }
+    size_t lineCount() const { return lineStarts.size(); }
+
+    SourceLocation location(SourceOffset offset) const;
+    int line(SourceOffset offset) const { return location(offset).line; }
+
+private:
+    std::vector<SourceOffset> lineStarts;
+    size_t length;
+};
+
+#endif // SOURCE_H
@@ -0,0 +1,59 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// 编译过程统计：阶段耗时、计数器、各阶段分配的内存和峰值RSS
+//
+// 默认关闭。关闭时 PhaseTimer 只检查一个标志。由 --time-report / --mem-report /
+// --stats-json 打开。统计状态按线程保存，峰值RSS是整个进程的。
+//
+// 库本身不替换全局分配函数：分配的字节数和次数由可执行程序替换的 operator new
+// 调用 countAllocation 累计（cminus_compiler 见 src/allocation.cpp），否则为0。
+namespace stats {
+
+extern thread_local bool active;
+
+// 开始收集，总耗时从此时算起
+void enable();
+inline bool enabled() { return active; }
+
+// 关闭并清空当前线程的统计
+void reset();
+
+// RAII 阶段计时器：记录阶段的耗时（单调时钟）、分配的字节数和次数，阶段可以嵌套
+class PhaseTimer {
+public:
+    explicit PhaseTimer(const char* name);
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    int index;  // 未启用时为-1
+};
+
+// 统计开启时由全局 operator new 调用，累计当前线程分配的字节数和次数
+void countAllocation(std::size_t size);
+
+// 计数器，同名累加，按首次出现的顺序输出
+void addCounter(const std::string& name, uint64_t value);
+
+// 按节点类型统计AST节点数（计数器 ast.<TYPE> 和 ast.nodes）
+void countAstNodes(const ProgramNode& program);
+
+// 人类可读的报告
+void printTimeReport(std::ostream& out);
+void printMemReport(std::ostream& out);
+
+// 写入JSON统计文件，失败时抛出 std::runtime_error
+void writeJson(const std::string& path, const std::string& inputFile, int exitCode);
+
+} // namespace stats
+
+#endif // STATS_H
@@ -0,0 +1,58 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include "sampler.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+// 虚拟机选项
+struct VmOptions {
+    size_t stackCells = 1 << 20;    // 寄存器栈大小（64位单元）
+    size_t arrayWords = 1 << 22;    // 数组存储区大小（int）
+    size_t maxCallDepth = 1 << 16;  // 最大调用深度
+    uint64_t samplePeriod = 0;      // 每执行这么多条指令记录一次调用栈（0 为不采样）
+};
+
+// 虚拟机统计信息
+struct VmStats {
+    size_t calls = 0;       // 函数调用次数（不含内建函数）
+    size_t tailCalls = 0;   // 其中复用栈帧执行的尾调用
+};
+
+// 寄存器式字节码虚拟机
+//
+// 所有函数的寄存器都在同一个值栈上，被调函数的栈帧从调用者存放实参的
+// 寄存器开始，因此调用时不需要复制实参。数组存储区的开头是全局数组，
+// 局部数组按调用顺序依次分配在其后。
+class VirtualMachine {
+public:
+    explicit VirtualMachine(const BytecodeModule& module, const VmOptions& options = VmOptions());
+
+    // 执行 main，返回其返回值；运行时错误抛出异常
+    int run();
+
+    const VmStats& stats() const { return vmStats; }
+
+    // 把 run 中采到的调用栈（options.samplePeriod 时）换算为函数名和行号，加到 profile 中
+    void collectSamples(SampleProfile& profile) const;
+
+private:
+    // 分发循环，Sampling 为 false 时不计数，与不支持采样时的代码相同
+    template <bool Sampling>
+    int execute();
+
+    const BytecodeModule& module;
+    VmOptions options;
+    VmStats vmStats;
+    std::unique_ptr<int64_t[]> stack;
+    std::unique_ptr<int32_t[]> memory;
+    std::unique_ptr<int32_t[]> globals;
+    // 采到的调用栈（各帧正在执行的代码位置，从 main 开始）-> 样本数
+    std::map<std::vector<uint32_t>, uint64_t> sampledStacks;
+};
+
+#endif // VM_H
@@ -0,0 +1,48 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <cstdio>
+#include <memory>
+#include <ostream>
+#include <string>
+
+// 带缓冲的输出：先写入内存缓冲区，满了再整块写到文件，
+// 避免大量小的写操作。析构时自动刷新。
+class BufferedWriter {
+public:
+    explicit BufferedWriter(std::FILE* file, size_t capacity = 1 << 16);
+    // 写到输出流（如编译服务的响应流）
+    explicit BufferedWriter(std::ostream& stream, size_t capacity = 1 << 16);
+    ~BufferedWriter();
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    void write(const char* data, size_t size);
+    void write(const std::string& text) { write(text.data(), text.size()); }
+    void put(char c) {
+        if (used == capacity) drain();
+        buffer[used++] = c;
+    }
+
+    BufferedWriter& operator<<(const std::string& text) { write(text); return *this; }
+    BufferedWriter& operator<<(const char* text);
+    BufferedWriter& operator<<(char c) { put(c); return *this; }
+    BufferedWriter& operator<<(long value);
+    BufferedWriter& operator<<(int value) { return *this << static_cast<long>(value); }
+
+    // 把缓冲区写到文件，出错时抛出异常
+    void flush();
+
+private:
+    void drain();
+    bool sink(const char* data, size_t size);
+
+    std::FILE* file;
+    std::ostream* stream;
+    std::unique_ptr<char[]> buffer;
+    size_t capacity;
+    size_t used;
+};
+
+#endif // WRITER_H
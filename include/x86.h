@@ -0,0 +1,202 @@
+#ifndef X86_H
+#define X86_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// x86-64 机器指令的中间表示与编码器
+//
+// 代码生成器产生 Module（每个函数一串 Inst），汇编器把它编码为 ObjectCode：
+// 机器码字节、数据段内容、符号表和重定位。JIT 在进程内完成重定位并执行，
+// 其他后端可以直接把 ObjectCode 写成目标文件。
+namespace x86 {
+
+// 通用寄存器编号与硬件编码一致
+enum Reg : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    RIP = 0x10,    // 仅用于内存操作数：RIP相对寻址
+    NOREG = 0xff
+};
+
+// 条件码，与 Jcc/SETcc 的低4位一致
+enum class Cond : uint8_t {
+    O, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G
+};
+
+// 取反条件
+Cond negate(Cond cc);
+
+// 可用的向量指令集
+enum class VectorIsa : uint8_t {
+    NONE,
+    SSE2,   // 4个32位整数，x86-64 的基线
+    SSE41,  // SSE2 加上 pmulld
+    AVX2    // 8个32位整数（VEX编码）
+};
+
+// 当前处理器支持的向量指令集（JIT生成的代码在本机运行）
+VectorIsa hostVectorIsa();
+const char* vectorIsaName(VectorIsa isa);
+
+// 操作数
+struct Operand {
+    enum Kind : uint8_t { NONE, REG, IMM, MEM, LABEL, SYM };
+
+    Kind kind = NONE;
+    uint8_t reg = NOREG;    // REG
+    uint8_t base = NOREG;   // MEM：基址寄存器（RIP表示相对符号）
+    uint8_t index = NOREG;  // MEM：变址寄存器
+    uint8_t scale = 1;      // MEM：比例因子 1/2/4/8
+    int32_t disp = 0;       // MEM：偏移
+    int64_t imm = 0;        // IMM
+    int id = -1;            // LABEL：标签号；SYM/RIP相对MEM：符号号；rbp相对MEM：栈帧区域
+
+    // rbp相对内存操作数所在的栈帧区域，由代码生成器标记，供调度判断别名：
+    // 未标记（unknownFrame）时可能与栈帧中的任何位置重叠
+    static constexpr int unknownFrame = -1;
+    static constexpr int frameSlot = -2;    // 标量槽位，只按固定偏移访问
+    // 局部数组以它在数组区的偏移（>= 0）为区域号
+
+    static Operand r(uint8_t reg);
+    static Operand immediate(int64_t value);
+    static Operand mem(uint8_t base, int32_t disp);
+    static Operand mem(uint8_t base, uint8_t index, uint8_t scale, int32_t disp);
+    static Operand rip(int symbol, int32_t disp = 0);
+    static Operand label(int id);
+    static Operand symbol(int id);
+
+    // 标记栈帧区域后的副本
+    Operand inFrame(int area) const;
+
+    bool isReg() const { return kind == REG; }
+    bool isImm() const { return kind == IMM; }
+    bool isMem() const { return kind == MEM; }
+    bool operator==(const Operand& other) const;
+    bool operator!=(const Operand& other) const { return !(*this == other); }
+};
+
+// 指令操作码
+enum class Op : uint8_t {
+    MOV,      // mov a, b
+    MOVSXD,   // movsxd a(64), b(32)
+    MOVZX8,   // movzx a(32), b(8)
+    LEA,      // lea a, [b]
+    ADD, SUB, AND, OR, XOR, CMP,
+    TEST,
+    IMUL,     // imul a, b  或  imul a, b, c(立即数)
+    IDIV,     // idiv a
+    NEG,
+    CDQ,      // size=8 时为 cqo
+    SHL, SAR, SHR,  // a, b(立即数)
+    SETCC,    // setcc a(8)
+    JCC,      // jcc a(标签)
+    JMP,      // jmp a(标签，或尾调用时的函数符号)
+    CALL,     // call a(符号)
+    RET,
+    LEAVE,
+    PUSH,
+    POP,
+    REP_STOSD,
+
+    // 向量指令：寄存器编号表示 xmm/ymm。size=16 为 SSE 编码（xmm），size=32 为
+    // AVX2 的 VEX.256 编码（ymm）；MOVD_* 在 size=32 时使用 VEX.128 编码
+    MOVDQU,         // 非对齐加载/存储，或寄存器间复制
+    MOVD_TO_VEC,    // movd a(xmm), b(r32)
+    MOVD_FROM_VEC,  // movd a(r32), b(xmm)
+    PADDD, PSUBD, PMULLD, PXOR,  // a = a op b
+    PSHUFD,         // pshufd a, b, c(立即数)，仅 SSE 编码
+    VPBROADCASTD,   // vpbroadcastd a(ymm), b(xmm)
+    VEXTRACTI128,   // vextracti128 a(xmm), b(ymm), 1
+    VZEROUPPER,
+
+    LABEL,    // 伪指令：定义标签 a
+    LINE      // 伪指令：之后的指令属于源代码第 a（立即数）行，记入行号表
+};
+
+// 一条指令
+struct Inst {
+    Op op;
+    uint8_t size = 4;    // 操作数宽度：4 或 8 字节，向量指令为 16 或 32
+    Cond cc = Cond::E;   // JCC/SETCC
+    Operand a, b, c;
+
+    Inst(Op o) : op(o) {}
+    Inst(Op o, uint8_t sz, const Operand& x, const Operand& y = Operand(), const Operand& z = Operand())
+        : op(o), size(sz), a(x), b(y), c(z) {}
+};
+
+// 一个函数的机器指令
+struct MFunction {
+    std::string name;
+    int symbol = -1;      // 函数在符号表中的编号
+    int numLabels = 0;
+    std::vector<Inst> code;
+
+    int newLabel() { return numLabels++; }
+};
+
+// 段
+enum class Section : uint8_t { TEXT, DATA, BSS, UNDEF };
+
+// 符号
+struct Symbol {
+    std::string name;
+    Section section;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    bool isFunction = false;
+};
+
+// 重定位类型
+enum class RelocKind : uint8_t {
+    PC32,   // 数据引用：S + A - P
+    PLT32   // 函数调用：S + A - P（外部函数可经由PLT或桩）
+};
+
+// 代码段中的重定位
+struct Reloc {
+    uint64_t offset;  // 在代码段中的位置
+    int symbol;
+    RelocKind kind;
+    int64_t addend;
+};
+
+// 代码生成结果
+struct Module {
+    std::vector<Symbol> symbols;
+    std::vector<uint8_t> data;
+    uint64_t bssSize = 0;
+    std::vector<MFunction> functions;
+
+    int addSymbol(const std::string& name, Section section, uint64_t offset, uint64_t size, bool isFunction);
+};
+
+// 汇编结果
+struct ObjectCode {
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> data;
+    uint64_t bssSize = 0;
+    std::vector<Symbol> symbols;
+    std::vector<Reloc> relocs;
+    // 行号表：（代码位置，行号），按位置排列。每个函数的入口为0行（未知），
+    // 之后按 LINE 伪指令记录
+    std::vector<std::pair<uint64_t, int>> lines;
+
+    // 按名字查找符号，不存在时返回-1
+    int findSymbol(const std::string& name) const;
+};
+
+// 把 Module 编码为机器码；offsets 不为空时按顺序记下各函数每条指令的开始位置（供 printListing）
+ObjectCode assemble(const Module& module, std::vector<uint64_t>* offsets = nullptr);
+
+// 反汇编风格的列表：每条指令的代码位置、编码后的字节和 Intel 语法的文本，以及标签和行号
+void printListing(std::ostream& out, const Module& module, const ObjectCode& object,
+                  const std::vector<uint64_t>& offsets);
+
+} // namespace x86
+
+#endif // X86_H
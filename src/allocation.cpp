@@ -0,0 +1,35 @@
+// cminus_compiler 的全局分配函数：统计开启时累计分配的字节数和次数（--mem-report）
+//
+// 替换放在可执行程序中，libcminus 不改变使用它的程序的分配函数。
+
+#include "stats.h"
+#include <cstdlib>
+#include <new>
+
+void* operator new(std::size_t size) {
+    if (stats::active) stats::countAllocation(size);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
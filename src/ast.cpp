@@ -4,9 +4,9 @@
 #include <map>
 
 // 辅助函数：打印缩进
-void printIndent(int indent) {
+void printIndent(std::ostream& out, int indent) {
     for (int i = 0; i < indent; i++) {
-        std::cout << "  ";
+        out << "  ";
     }
 }
 
@@ -41,216 +41,426 @@ std::string tokenTypeToString(TokenType type) {
         {TokenType::ID, "ID"},
         {TokenType::NUM, "NUM"},
         {TokenType::END_OF_FILE, "EOF"},
-        {TokenType::ERROR, "ERROR"}
+        {TokenType::ERROR, "ERROR"},
+        {TokenType::MOD, "MOD"}
     };
     
     auto it = typeMap.find(type);
     return it != typeMap.end() ? it->second : "UNKNOWN";
 }
 
+// 表达式是否没有副作用（不含赋值和调用）
+bool isPureExpression(const ASTNode* expr) {
+    switch (expr->type) {
+        case ASTNodeType::NUM:
+            return true;
+        case ASTNodeType::VAR: {
+            auto* var = static_cast<const VarNode*>(expr);
+            return !var->index || isPureExpression(var->index.get());
+        }
+        case ASTNodeType::BIN_OP: {
+            auto* binOp = static_cast<const BinOpNode*>(expr);
+            return isPureExpression(binOp->left.get()) && isPureExpression(binOp->right.get());
+        }
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto* simpleExpr = static_cast<const SimpleExprNode*>(expr);
+            return isPureExpression(simpleExpr->left.get()) && isPureExpression(simpleExpr->right.get());
+        }
+        default:
+            return false;
+    }
+}
+
+// AST节点类型名称
+const char* astNodeTypeName(ASTNodeType type) {
+    switch (type) {
+        case ASTNodeType::PROGRAM:           return "PROGRAM";
+        case ASTNodeType::VAR_DECLARATION:   return "VAR_DECLARATION";
+        case ASTNodeType::ARRAY_DECLARATION: return "ARRAY_DECLARATION";
+        case ASTNodeType::FUN_DECLARATION:   return "FUN_DECLARATION";
+        case ASTNodeType::PARAM:             return "PARAM";
+        case ASTNodeType::COMPOUND_STMT:     return "COMPOUND_STMT";
+        case ASTNodeType::EXPRESSION_STMT:   return "EXPRESSION_STMT";
+        case ASTNodeType::SELECTION_STMT:    return "SELECTION_STMT";
+        case ASTNodeType::ITERATION_STMT:    return "ITERATION_STMT";
+        case ASTNodeType::RETURN_STMT:       return "RETURN_STMT";
+        case ASTNodeType::ASSIGN_EXPR:       return "ASSIGN_EXPR";
+        case ASTNodeType::SIMPLE_EXPR:       return "SIMPLE_EXPR";
+        case ASTNodeType::VAR:               return "VAR";
+        case ASTNodeType::CALL:              return "CALL";
+        case ASTNodeType::NUM:               return "NUM";
+        case ASTNodeType::BIN_OP:            return "BIN_OP";
+    }
+    return "UNKNOWN";
+}
+
+// 访问直接子节点
+void visitChildren(const ASTNode& node, const std::function<void(const ASTNode&)>& visit) {
+    auto visitIf = [&](const std::unique_ptr<ASTNode>& child) {
+        if (child) visit(*child);
+    };
+    switch (node.type) {
+        case ASTNodeType::PROGRAM:
+            for (const auto& decl : static_cast<const ProgramNode&>(node).declarations) visitIf(decl);
+            break;
+        case ASTNodeType::VAR_DECLARATION:
+            visitIf(static_cast<const VarDeclarationNode&>(node).initializer);
+            break;
+        case ASTNodeType::ARRAY_DECLARATION:
+            visitIf(static_cast<const ArrayDeclarationNode&>(node).sizeExpression);
+            break;
+        case ASTNodeType::FUN_DECLARATION: {
+            auto& fun = static_cast<const FunDeclarationNode&>(node);
+            for (const auto& param : fun.params) visitIf(param);
+            visitIf(fun.body);
+            break;
+        }
+        case ASTNodeType::COMPOUND_STMT: {
+            auto& compoundStmt = static_cast<const CompoundStmtNode&>(node);
+            for (const auto& decl : compoundStmt.localDeclarations) visitIf(decl);
+            for (const auto& stmt : compoundStmt.statements) visitIf(stmt);
+            break;
+        }
+        case ASTNodeType::EXPRESSION_STMT:
+            visitIf(static_cast<const ExpressionStmtNode&>(node).expression);
+            break;
+        case ASTNodeType::SELECTION_STMT: {
+            auto& selectionStmt = static_cast<const SelectionStmtNode&>(node);
+            visitIf(selectionStmt.condition);
+            visitIf(selectionStmt.ifBranch);
+            visitIf(selectionStmt.elseBranch);
+            break;
+        }
+        case ASTNodeType::ITERATION_STMT: {
+            auto& iterationStmt = static_cast<const IterationStmtNode&>(node);
+            visitIf(iterationStmt.condition);
+            visitIf(iterationStmt.body);
+            break;
+        }
+        case ASTNodeType::RETURN_STMT:
+            visitIf(static_cast<const ReturnStmtNode&>(node).expression);
+            break;
+        case ASTNodeType::ASSIGN_EXPR: {
+            auto& assignExpr = static_cast<const AssignExprNode&>(node);
+            visitIf(assignExpr.var);
+            visitIf(assignExpr.expression);
+            break;
+        }
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto& simpleExpr = static_cast<const SimpleExprNode&>(node);
+            visitIf(simpleExpr.left);
+            visitIf(simpleExpr.right);
+            break;
+        }
+        case ASTNodeType::BIN_OP: {
+            auto& binOp = static_cast<const BinOpNode&>(node);
+            visitIf(binOp.left);
+            visitIf(binOp.right);
+            break;
+        }
+        case ASTNodeType::VAR:
+            visitIf(static_cast<const VarNode&>(node).index);
+            break;
+        case ASTNodeType::CALL:
+            for (const auto& arg : static_cast<const CallNode&>(node).args) visitIf(arg);
+            break;
+        default:
+            break;
+    }
+}
+
+// 访问直接子节点的所有者指针（可以替换子节点），顺序与 visitChildren 相同
+void visitChildSlots(ASTNode& node, const std::function<void(std::unique_ptr<ASTNode>&)>& visit) {
+    auto visitIf = [&](std::unique_ptr<ASTNode>& child) {
+        if (child) visit(child);
+    };
+    switch (node.type) {
+        case ASTNodeType::PROGRAM:
+            for (auto& decl : static_cast<ProgramNode&>(node).declarations) visitIf(decl);
+            break;
+        case ASTNodeType::VAR_DECLARATION:
+            visitIf(static_cast<VarDeclarationNode&>(node).initializer);
+            break;
+        case ASTNodeType::ARRAY_DECLARATION:
+            visitIf(static_cast<ArrayDeclarationNode&>(node).sizeExpression);
+            break;
+        case ASTNodeType::FUN_DECLARATION: {
+            auto& fun = static_cast<FunDeclarationNode&>(node);
+            for (auto& param : fun.params) visitIf(param);
+            visitIf(fun.body);
+            break;
+        }
+        case ASTNodeType::COMPOUND_STMT: {
+            auto& compoundStmt = static_cast<CompoundStmtNode&>(node);
+            for (auto& decl : compoundStmt.localDeclarations) visitIf(decl);
+            for (auto& stmt : compoundStmt.statements) visitIf(stmt);
+            break;
+        }
+        case ASTNodeType::EXPRESSION_STMT:
+            visitIf(static_cast<ExpressionStmtNode&>(node).expression);
+            break;
+        case ASTNodeType::SELECTION_STMT: {
+            auto& selectionStmt = static_cast<SelectionStmtNode&>(node);
+            visitIf(selectionStmt.condition);
+            visitIf(selectionStmt.ifBranch);
+            visitIf(selectionStmt.elseBranch);
+            break;
+        }
+        case ASTNodeType::ITERATION_STMT: {
+            auto& iterationStmt = static_cast<IterationStmtNode&>(node);
+            visitIf(iterationStmt.condition);
+            visitIf(iterationStmt.body);
+            break;
+        }
+        case ASTNodeType::RETURN_STMT:
+            visitIf(static_cast<ReturnStmtNode&>(node).expression);
+            break;
+        case ASTNodeType::ASSIGN_EXPR: {
+            auto& assignExpr = static_cast<AssignExprNode&>(node);
+            visitIf(assignExpr.var);
+            visitIf(assignExpr.expression);
+            break;
+        }
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto& simpleExpr = static_cast<SimpleExprNode&>(node);
+            visitIf(simpleExpr.left);
+            visitIf(simpleExpr.right);
+            break;
+        }
+        case ASTNodeType::BIN_OP: {
+            auto& binOp = static_cast<BinOpNode&>(node);
+            visitIf(binOp.left);
+            visitIf(binOp.right);
+            break;
+        }
+        case ASTNodeType::VAR:
+            visitIf(static_cast<VarNode&>(node).index);
+            break;
+        case ASTNodeType::CALL:
+            for (auto& arg : static_cast<CallNode&>(node).args) visitIf(arg);
+            break;
+        default:
+            break;
+    }
+}
+
 // ProgramNode打印
-void ProgramNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "Program:\n";
+void ProgramNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "Program:\n";
     for (const auto& decl : declarations) {
-        decl->print(indent + 1);
+        decl->print(out, indent + 1);
     }
 }
 
 // VarDeclarationNode打印
-void VarDeclarationNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "VarDeclaration: " << typeSpecifier << " " << identifier;
+void VarDeclarationNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "VarDeclaration: " << typeSpecifier << " " << identifier;
     if (isArray) {
-        std::cout << "[" << arraySize << "]";
+        out << "[" << arraySize << "]";
+    }
+    out << "\n";
+    
+    if (initializer) {
+        printIndent(out, indent + 1);
+        out << "Initializer:\n";
+        initializer->print(out, indent + 2);
     }
-    std::cout << "\n";
 }
 
 // ArrayDeclarationNode打印
-void ArrayDeclarationNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "ArrayDeclaration: " << typeSpecifier << " " 
-              << identifier << "[" << arraySize << "]\n";
+void ArrayDeclarationNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "ArrayDeclaration: " << typeSpecifier << " " 
+              << identifier << "[";
+    if (sizeExpression) {
+        out << "]\n";
+        printIndent(out, indent + 1);
+        out << "Size:\n";
+        sizeExpression->print(out, indent + 2);
+        return;
+    }
+    out << arraySize << "]\n";
 }
 
 // FunDeclarationNode打印
-void FunDeclarationNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "FunDeclaration: " << returnType << " " << identifier << "(\n";
+void FunDeclarationNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "FunDeclaration: " << returnType << " " << identifier << "(\n";
     
     for (const auto& param : params) {
-        param->print(indent + 1);
+        param->print(out, indent + 1);
     }
     
-    printIndent(indent);
-    std::cout << ")\n";
+    printIndent(out, indent);
+    out << ")\n";
     
     if (body) {
-        body->print(indent + 1);
+        body->print(out, indent + 1);
     }
 }
 
 // ParamNode打印
-void ParamNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "Param: " << typeSpecifier << " " << identifier;
+void ParamNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "Param: " << typeSpecifier << " " << identifier;
     if (isArray) {
-        std::cout << "[]";
+        out << "[]";
     }
-    std::cout << "\n";
+    out << "\n";
 }
 
 // CompoundStmtNode打印
-void CompoundStmtNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "CompoundStmt: {\n";
+void CompoundStmtNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "CompoundStmt: {\n";
     
-    printIndent(indent + 1);
-    std::cout << "LocalDeclarations:\n";
+    printIndent(out, indent + 1);
+    out << "LocalDeclarations:\n";
     for (const auto& decl : localDeclarations) {
-        decl->print(indent + 2);
+        decl->print(out, indent + 2);
     }
     
-    printIndent(indent + 1);
-    std::cout << "Statements:\n";
+    printIndent(out, indent + 1);
+    out << "Statements:\n";
     for (const auto& stmt : statements) {
-        stmt->print(indent + 2);
+        stmt->print(out, indent + 2);
     }
     
-    printIndent(indent);
-    std::cout << "}\n";
+    printIndent(out, indent);
+    out << "}\n";
 }
 
 // ExpressionStmtNode打印
-void ExpressionStmtNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "ExpressionStmt: ";
+void ExpressionStmtNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "ExpressionStmt: ";
     if (expression) {
-        std::cout << "\n";
-        expression->print(indent + 1);
+        out << "\n";
+        expression->print(out, indent + 1);
     } else {
-        std::cout << ";\n";
+        out << ";\n";
     }
 }
 
 // SelectionStmtNode打印
-void SelectionStmtNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "IfStmt:\n";
+void SelectionStmtNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "IfStmt:\n";
     
-    printIndent(indent + 1);
-    std::cout << "Condition:\n";
-    condition->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Condition:\n";
+    condition->print(out, indent + 2);
     
-    printIndent(indent + 1);
-    std::cout << "Then:\n";
-    ifBranch->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Then:\n";
+    ifBranch->print(out, indent + 2);
     
     if (elseBranch) {
-        printIndent(indent + 1);
-        std::cout << "Else:\n";
-        elseBranch->print(indent + 2);
+        printIndent(out, indent + 1);
+        out << "Else:\n";
+        elseBranch->print(out, indent + 2);
     }
 }
 
 // IterationStmtNode打印
-void IterationStmtNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "WhileStmt:\n";
+void IterationStmtNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "WhileStmt:\n";
     
-    printIndent(indent + 1);
-    std::cout << "Condition:\n";
-    condition->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Condition:\n";
+    condition->print(out, indent + 2);
     
-    printIndent(indent + 1);
-    std::cout << "Body:\n";
-    body->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Body:\n";
+    body->print(out, indent + 2);
 }
 
 // ReturnStmtNode打印
-void ReturnStmtNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "ReturnStmt:";
+void ReturnStmtNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "ReturnStmt:";
     if (expression) {
-        std::cout << "\n";
-        expression->print(indent + 1);
+        out << "\n";
+        expression->print(out, indent + 1);
     } else {
-        std::cout << " (void)\n";
+        out << " (void)\n";
     }
 }
 
 // AssignExprNode打印
-void AssignExprNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "AssignExpression:\n";
+void AssignExprNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "AssignExpression:\n";
     
-    printIndent(indent + 1);
-    std::cout << "Left:\n";
-    var->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Left:\n";
+    var->print(out, indent + 2);
     
-    printIndent(indent + 1);
-    std::cout << "Right:\n";
-    expression->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Right:\n";
+    expression->print(out, indent + 2);
 }
 
 // SimpleExprNode打印
-void SimpleExprNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "SimpleExpression (";
-    std::cout << tokenTypeToString(relop) << "):\n";
+void SimpleExprNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "SimpleExpression (";
+    out << tokenTypeToString(relop) << "):\n";
     
-    printIndent(indent + 1);
-    std::cout << "Left:\n";
-    left->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Left:\n";
+    left->print(out, indent + 2);
     
-    printIndent(indent + 1);
-    std::cout << "Right:\n";
-    right->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Right:\n";
+    right->print(out, indent + 2);
 }
 
 // VarNode打印
-void VarNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "Variable: " << identifier;
+void VarNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "Variable: " << identifier;
     if (index) {
-        std::cout << "[\n";
-        index->print(indent + 1);
-        printIndent(indent);
-        std::cout << "]";
+        out << "[\n";
+        index->print(out, indent + 1);
+        printIndent(out, indent);
+        out << "]";
     }
-    std::cout << "\n";
+    out << "\n";
 }
 
 // CallNode打印
-void CallNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "Call: " << identifier << "(\n";
+void CallNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "Call: " << identifier << "(\n";
     
     for (const auto& arg : args) {
-        arg->print(indent + 1);
+        arg->print(out, indent + 1);
     }
     
-    printIndent(indent);
-    std::cout << ")\n";
+    printIndent(out, indent);
+    out << ")\n";
 }
 
 // NumNode打印
-void NumNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "Number: " << value << "\n";
+void NumNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "Number: " << value << "\n";
 }
 
 // BinOpNode打印
-void BinOpNode::print(int indent) const {
-    printIndent(indent);
-    std::cout << "BinaryOp: " << tokenTypeToString(op) << "\n";
+void BinOpNode::print(std::ostream& out, int indent) const {
+    printIndent(out, indent);
+    out << "BinaryOp: " << tokenTypeToString(op) << "\n";
     
-    printIndent(indent + 1);
-    std::cout << "Left:\n";
-    left->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Left:\n";
+    left->print(out, indent + 2);
     
-    printIndent(indent + 1);
-    std::cout << "Right:\n";
-    right->print(indent + 2);
+    printIndent(out, indent + 1);
+    out << "Right:\n";
+    right->print(out, indent + 2);
 }
\ No newline at end of file
@@ -0,0 +1,368 @@
+#include "bounds.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+const int64_t minInt = INT32_MIN;
+const int64_t maxInt = INT32_MAX;
+
+// 只有最外面几层循环迭代到不动点，更深的循环直接放宽其中赋值的变量
+const int maxFixpointDepth = 4;
+const int maxPasses = 4;
+
+// 闭区间，默认为整个 int 范围
+struct Range {
+    int64_t lo = minInt;
+    int64_t hi = maxInt;
+
+    bool operator==(const Range& other) const { return lo == other.lo && hi == other.hi; }
+};
+
+Range constant(int64_t value) {
+    return {value, value};
+}
+
+// 超出 int 范围时运算可能回绕，结果为任意值
+Range clamp(int64_t lo, int64_t hi) {
+    if (lo < minInt || hi > maxInt) return Range();
+    return {lo, hi};
+}
+
+Range join(const Range& a, const Range& b) {
+    return {std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+}
+
+Range arith(TokenType op, const Range& l, const Range& r) {
+    switch (op) {
+        case TokenType::PLUS:
+            return clamp(l.lo + r.lo, l.hi + r.hi);
+        case TokenType::MINUS:
+            return clamp(l.lo - r.hi, l.hi - r.lo);
+        case TokenType::TIMES: {
+            int64_t corners[4] = {l.lo * r.lo, l.lo * r.hi, l.hi * r.lo, l.hi * r.hi};
+            return clamp(*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4));
+        }
+        case TokenType::DIVIDE: {
+            // 除数恒为正时商在四个角上取到极值
+            if (r.lo <= 0) return Range();
+            int64_t corners[4] = {l.lo / r.lo, l.lo / r.hi, l.hi / r.lo, l.hi / r.hi};
+            return {*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4)};
+        }
+        case TokenType::MOD: {
+            // 余数与被除数同号，绝对值小于除数、不超过被除数（除数为0时报错，没有结果）
+            int64_t m = std::max<int64_t>(std::max(-r.lo, r.hi), 1);
+            Range result = {l.lo >= 0 ? 0 : -(m - 1), l.hi <= 0 ? 0 : m - 1};
+            if (l.lo >= 0) result.hi = std::min(result.hi, l.hi);
+            if (l.hi <= 0) result.lo = std::max(result.lo, l.lo);
+            return result;
+        }
+        default:
+            return Range();
+    }
+}
+
+bool isLocalScalar(const ASTNode* node) {
+    if (node->type != ASTNodeType::VAR) return false;
+    auto* var = static_cast<const VarNode*>(node);
+    return !var->index && var->kind == VarKind::LOCAL_SCALAR;
+}
+
+// 各局部标量槽位的区间；不可达时区间没有意义
+struct State {
+    bool reachable = true;
+    std::vector<Range> slots;
+
+    bool operator==(const State& other) const {
+        return reachable == other.reachable && (!reachable || slots == other.slots);
+    }
+};
+
+void joinInto(State& into, const State& other) {
+    if (!other.reachable) return;
+    if (!into.reachable) {
+        into = other;
+        return;
+    }
+    for (size_t i = 0; i < into.slots.size(); i++) {
+        into.slots[i] = join(into.slots[i], other.slots[i]);
+    }
+}
+
+// 比上一次扩大的边界直接放宽到 int 的范围，保证迭代终止
+void widen(State& next, const State& previous) {
+    if (!next.reachable || !previous.reachable) return;
+    for (size_t i = 0; i < next.slots.size(); i++) {
+        if (next.slots[i].lo < previous.slots[i].lo) next.slots[i].lo = minInt;
+        if (next.slots[i].hi > previous.slots[i].hi) next.slots[i].hi = maxInt;
+    }
+}
+
+// 子树中赋值或声明的局部标量槽位
+void collectAssigned(const ASTNode& node, std::vector<int>& slots) {
+    if (node.type == ASTNodeType::ASSIGN_EXPR) {
+        auto* target = static_cast<const AssignExprNode&>(node).var.get();
+        if (isLocalScalar(target)) slots.push_back(static_cast<const VarNode*>(target)->slot);
+    } else if (node.type == ASTNodeType::VAR_DECLARATION) {
+        slots.push_back(static_cast<const VarDeclarationNode&>(node).slot);
+    }
+    visitChildren(node, [&slots](const ASTNode& child) { collectAssigned(child, slots); });
+}
+
+TokenType negate(TokenType relop) {
+    switch (relop) {
+        case TokenType::LT: return TokenType::GE;
+        case TokenType::LE: return TokenType::GT;
+        case TokenType::GT: return TokenType::LE;
+        case TokenType::GE: return TokenType::LT;
+        case TokenType::EQ: return TokenType::NE;
+        default:            return TokenType::EQ;
+    }
+}
+
+// a relop b 等价于 b mirror(relop) a
+TokenType mirror(TokenType relop) {
+    switch (relop) {
+        case TokenType::LT: return TokenType::GT;
+        case TokenType::LE: return TokenType::GE;
+        case TokenType::GT: return TokenType::LT;
+        case TokenType::GE: return TokenType::LE;
+        default:            return relop;
+    }
+}
+
+class Analyzer {
+public:
+    Analyzer(std::unordered_map<const VarNode*, bool>& proven, BoundsReport& report)
+        : proven(proven), report(report), recording(true), loopDepth(0) {}
+
+    void function(const FunDeclarationNode& fun) {
+        State state;
+        state.slots.assign(fun.numSlots, Range());
+        statement(fun.body.get(), state);
+    }
+
+private:
+    // 记录一次下标访问；分析循环头部的中间轮次不记录
+    void access(const VarNode& var, const Range& index, const State& state) {
+        if (!recording || var.arraySize <= 0) return;
+        bool inRange = !state.reachable || (index.lo >= 0 && index.hi < var.arraySize);
+        auto it = proven.find(&var);
+        if (it == proven.end()) {
+            proven.emplace(&var, inRange);
+            report.accesses++;
+            if (!inRange) report.checks++;
+        } else if (it->second && !inRange) {
+            it->second = false;
+            report.checks++;
+        }
+    }
+
+    Range eval(const ASTNode* expr, State& state) {
+        switch (expr->type) {
+            case ASTNodeType::NUM:
+                return constant(static_cast<const NumNode*>(expr)->value);
+
+            case ASTNodeType::VAR: {
+                auto* var = static_cast<const VarNode*>(expr);
+                if (var->index) {
+                    Range index = eval(var->index.get(), state);
+                    access(*var, index, state);
+                    return Range();
+                }
+                if (var->kind == VarKind::LOCAL_SCALAR && state.reachable) return state.slots[var->slot];
+                return Range();
+            }
+
+            case ASTNodeType::ASSIGN_EXPR: {
+                // 先求下标再求右值，下标的值在求右值之前就已确定
+                auto* assignExpr = static_cast<const AssignExprNode*>(expr);
+                auto* target = static_cast<const VarNode*>(assignExpr->var.get());
+                if (target->index) {
+                    Range index = eval(target->index.get(), state);
+                    Range value = eval(assignExpr->expression.get(), state);
+                    access(*target, index, state);
+                    return value;
+                }
+                Range value = eval(assignExpr->expression.get(), state);
+                if (target->kind == VarKind::LOCAL_SCALAR && state.reachable) state.slots[target->slot] = value;
+                return value;
+            }
+
+            case ASTNodeType::BIN_OP: {
+                auto* binOp = static_cast<const BinOpNode*>(expr);
+                Range left = eval(binOp->left.get(), state);
+                Range right = eval(binOp->right.get(), state);
+                return arith(binOp->op, left, right);
+            }
+
+            case ASTNodeType::SIMPLE_EXPR: {
+                auto* simpleExpr = static_cast<const SimpleExprNode*>(expr);
+                eval(simpleExpr->left.get(), state);
+                eval(simpleExpr->right.get(), state);
+                return {0, 1};
+            }
+
+            case ASTNodeType::CALL:
+                // 被调函数不能修改调用者的局部变量
+                for (const auto& arg : static_cast<const CallNode*>(expr)->args) {
+                    eval(arg.get(), state);
+                }
+                return Range();
+
+            default:
+                return Range();
+        }
+    }
+
+    // 按 var relop bound 收窄局部标量的区间
+    void narrow(const ASTNode* node, TokenType relop, const Range& bound, State& state) {
+        if (!state.reachable || !isLocalScalar(node)) return;
+        Range& range = state.slots[static_cast<const VarNode*>(node)->slot];
+        switch (relop) {
+            case TokenType::LT: range.hi = std::min(range.hi, bound.hi - 1); break;
+            case TokenType::LE: range.hi = std::min(range.hi, bound.hi); break;
+            case TokenType::GT: range.lo = std::max(range.lo, bound.lo + 1); break;
+            case TokenType::GE: range.lo = std::max(range.lo, bound.lo); break;
+            case TokenType::EQ:
+                range.lo = std::max(range.lo, bound.lo);
+                range.hi = std::min(range.hi, bound.hi);
+                break;
+            default:
+                if (bound.lo == bound.hi && range.lo == bound.lo) range.lo++;
+                if (bound.lo == bound.hi && range.hi == bound.hi) range.hi--;
+                break;
+        }
+        if (range.lo > range.hi) state.reachable = false;
+    }
+
+    // 条件取值为 taken 时收窄 state（state 为求值条件之后的状态）。
+    // 有副作用的条件中变量的值可能在比较前后不同，不收窄
+    void refine(const ASTNode* cond, bool taken, State& state) {
+        if (!state.reachable || !isPureExpression(cond)) return;
+        if (cond->type == ASTNodeType::SIMPLE_EXPR) {
+            auto* simpleExpr = static_cast<const SimpleExprNode*>(cond);
+            TokenType relop = taken ? simpleExpr->relop : negate(simpleExpr->relop);
+            State before = state;
+            Range left = eval(simpleExpr->left.get(), before);
+            Range right = eval(simpleExpr->right.get(), before);
+            narrow(simpleExpr->left.get(), relop, right, state);
+            narrow(simpleExpr->right.get(), mirror(relop), left, state);
+        } else {
+            narrow(cond, taken ? TokenType::NE : TokenType::EQ, constant(0), state);
+        }
+    }
+
+    void statement(const ASTNode* stmt, State& state) {
+        switch (stmt->type) {
+            case ASTNodeType::COMPOUND_STMT: {
+                auto* compoundStmt = static_cast<const CompoundStmtNode*>(stmt);
+                for (const auto& decl : compoundStmt->localDeclarations) {
+                    if (decl->type != ASTNodeType::VAR_DECLARATION) continue;
+                    auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+                    Range value = varDecl->initializer ? eval(varDecl->initializer.get(), state) : constant(0);
+                    if (state.reachable) state.slots[varDecl->slot] = value;
+                }
+                for (const auto& child : compoundStmt->statements) {
+                    statement(child.get(), state);
+                }
+                break;
+            }
+
+            case ASTNodeType::EXPRESSION_STMT: {
+                auto* exprStmt = static_cast<const ExpressionStmtNode*>(stmt);
+                if (exprStmt->expression) eval(exprStmt->expression.get(), state);
+                break;
+            }
+
+            case ASTNodeType::SELECTION_STMT: {
+                auto* selectionStmt = static_cast<const SelectionStmtNode*>(stmt);
+                eval(selectionStmt->condition.get(), state);
+                State taken = state;
+                refine(selectionStmt->condition.get(), true, taken);
+                refine(selectionStmt->condition.get(), false, state);
+                statement(selectionStmt->ifBranch.get(), taken);
+                if (selectionStmt->elseBranch) statement(selectionStmt->elseBranch.get(), state);
+                joinInto(state, taken);
+                break;
+            }
+
+            case ASTNodeType::ITERATION_STMT:
+                loop(*static_cast<const IterationStmtNode*>(stmt), state);
+                break;
+
+            case ASTNodeType::RETURN_STMT: {
+                auto* returnStmt = static_cast<const ReturnStmtNode*>(stmt);
+                if (returnStmt->expression) eval(returnStmt->expression.get(), state);
+                state.reachable = false;
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    // 循环头部的状态是进入时的状态与每次回到头部时的状态的并：先不记录访问地迭代，
+    // 稳定后（或放宽循环中赋值的变量后）再分析一遍循环体并记录
+    void loop(const IterationStmtNode& loopStmt, State& state) {
+        const ASTNode* cond = loopStmt.condition.get();
+        State head = state;
+        bool saved = recording;
+        recording = false;
+        bool stable = false;
+        int passes = loopDepth < maxFixpointDepth ? maxPasses : 0;
+        loopDepth++;
+        for (int pass = 0; pass < passes && !stable; pass++) {
+            State body = head;
+            eval(cond, body);
+            refine(cond, true, body);
+            statement(loopStmt.body.get(), body);
+            State next = head;
+            joinInto(next, body);
+            if (pass > 0) widen(next, head);
+            stable = next == head;
+            head = std::move(next);
+        }
+        if (!stable && head.reachable) {
+            std::vector<int> assigned;
+            collectAssigned(loopStmt, assigned);
+            for (int slot : assigned) head.slots[slot] = Range();
+        }
+        recording = saved;
+
+        eval(cond, head);
+        State body = head;
+        refine(cond, true, body);
+        refine(cond, false, head);
+        statement(loopStmt.body.get(), body);
+        loopDepth--;
+        state = std::move(head);
+    }
+
+    std::unordered_map<const VarNode*, bool>& proven;
+    BoundsReport& report;
+    bool recording;
+    int loopDepth;
+};
+
+} // namespace
+
+void BoundsAnalysis::analyze(const ProgramNode& program) {
+    proven.clear();
+    reportList.clear();
+    for (const auto& decl : program.declarations) {
+        if (decl->type != ASTNodeType::FUN_DECLARATION) continue;
+        auto* fun = static_cast<const FunDeclarationNode*>(decl.get());
+        BoundsReport report;
+        report.function = fun;
+        Analyzer(proven, report).function(*fun);
+        reportList.push_back(report);
+    }
+}
+
+bool BoundsAnalysis::needsCheck(const VarNode& var) const {
+    if (var.arraySize <= 0) return false;
+    auto it = proven.find(&var);
+    return it == proven.end() || !it->second;
+}
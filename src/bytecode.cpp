@@ -0,0 +1,940 @@
+#include "bytecode.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t cmbVersion = 3;
+
+// 函数级缓存条目的变体：字节码格式改变时旧条目自然失效
+const std::string cacheVariant = "bytecode-" + std::to_string(cmbVersion);
+
+const char* const opcodeNames[] = {
+    "LOADI", "LOADK", "MOV", "GETG", "SETG",
+    "ADD", "SUB", "MUL", "DIV", "MOD", "ADDI",
+    "LT", "LE", "GT", "GE", "EQ", "NE",
+    "JMP", "JT", "JF",
+    "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE",
+    "LREF", "GREF", "LOADX", "STOREX", "ZEROA",
+    "CALL", "TAILCALL", "INPUT", "OUTPUT", "RET", "RET0"
+};
+static_assert(sizeof(opcodeNames) / sizeof(opcodeNames[0]) == static_cast<size_t>(Opcode::NUM_OPCODES),
+              "opcode name table out of sync");
+
+// 关系运算符对应的比较/跳转指令
+Opcode relopOpcode(TokenType op, bool jump) {
+    int index;
+    switch (op) {
+        case TokenType::LT: index = 0; break;
+        case TokenType::LE: index = 1; break;
+        case TokenType::GT: index = 2; break;
+        case TokenType::GE: index = 3; break;
+        case TokenType::EQ: index = 4; break;
+        case TokenType::NE: index = 5; break;
+        default:
+            throw std::runtime_error("Bytecode: invalid relational operator");
+    }
+    Opcode base = jump ? Opcode::JLT : Opcode::LT;
+    return static_cast<Opcode>(static_cast<int>(base) + index);
+}
+
+TokenType negateRelop(TokenType op) {
+    switch (op) {
+        case TokenType::LT: return TokenType::GE;
+        case TokenType::LE: return TokenType::GT;
+        case TokenType::GT: return TokenType::LE;
+        case TokenType::GE: return TokenType::LT;
+        case TokenType::EQ: return TokenType::NE;
+        default:            return TokenType::EQ;
+    }
+}
+
+bool isJumpWithOffsetWord(Opcode op) {
+    return op == Opcode::JT || op == Opcode::JF ||
+           (op >= Opcode::JLT && op <= Opcode::JNE);
+}
+
+} // namespace
+
+const char* opcodeName(Opcode op) {
+    return op < Opcode::NUM_OPCODES ? opcodeNames[static_cast<int>(op)] : "???";
+}
+
+int instructionLength(Opcode op) {
+    switch (op) {
+        case Opcode::JT: case Opcode::JF:
+        case Opcode::JLT: case Opcode::JLE: case Opcode::JGT:
+        case Opcode::JGE: case Opcode::JEQ: case Opcode::JNE:
+        case Opcode::CALL: case Opcode::TAILCALL:
+            return 2;
+        case Opcode::LREF: case Opcode::GREF: case Opcode::ZEROA:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+// ===== BytecodeModule =====
+
+BytecodeModule::BytecodeModule()
+    : functionsPtr(nullptr), constantsPtr(nullptr), globalsPtr(nullptr), codePtr(nullptr),
+      namesPtr(nullptr), mapping(nullptr), mappingSize(0) {
+    std::memset(&header, 0, sizeof(header));
+}
+
+BytecodeModule::~BytecodeModule() {
+    unmap();
+}
+
+void BytecodeModule::unmap() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
+
+// 使用自有存储
+void BytecodeModule::bindOwned() {
+    functionsPtr = ownedFunctions.data();
+    constantsPtr = ownedConstants.data();
+    globalsPtr = ownedGlobals.data();
+    codePtr = ownedCode.data();
+    namesPtr = ownedNames.data();
+}
+
+std::string BytecodeModule::functionName(uint32_t index) const {
+    const BytecodeFunction& fun = functionsPtr[index];
+    return std::string(namesPtr + fun.nameOffset, fun.nameLength);
+}
+
+int BytecodeModule::lineAt(uint32_t codeOffset) const {
+    auto next = std::upper_bound(lines.begin(), lines.end(), codeOffset,
+                                 [](uint32_t offset, const std::pair<uint32_t, int>& entry) {
+                                     return offset < entry.first;
+                                 });
+    return next == lines.begin() ? 0 : std::prev(next)->second;
+}
+
+// 写入 .cmb 文件：文件头、函数表、常量、全局初值、代码、名字
+void BytecodeModule::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Cannot open '" + path + "' for writing");
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(functionsPtr), sizeof(BytecodeFunction) * header.numFunctions);
+    out.write(reinterpret_cast<const char*>(constantsPtr), sizeof(int32_t) * header.numConstants);
+    out.write(reinterpret_cast<const char*>(globalsPtr), sizeof(int32_t) * header.numGlobals);
+    out.write(reinterpret_cast<const char*>(codePtr), sizeof(uint32_t) * header.codeWords);
+    out.write(namesPtr, header.namesSize);
+    if (!out) {
+        throw std::runtime_error("Failed to write '" + path + "'");
+    }
+}
+
+// 通过 mmap 加载 .cmb 文件，数据直接在映射上使用
+void BytecodeModule::load(const std::string& path, BytecodeModule& module) {
+    module.unmap();
+    module.lines.clear();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open '" + path + "'");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CmbHeader)) {
+        close(fd);
+        throw std::runtime_error("'" + path + "' is not a bytecode file");
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map '" + path + "'");
+    }
+    module.mapping = mapped;
+    module.mappingSize = size;
+
+    const char* base = static_cast<const char*>(mapped);
+    std::memcpy(&module.header, base, sizeof(CmbHeader));
+    const CmbHeader& h = module.header;
+    if (std::memcmp(h.magic, "CMB", 4) != 0 || h.version != cmbVersion) {
+        module.unmap();
+        throw std::runtime_error("'" + path + "' is not a compatible bytecode file");
+    }
+
+    uint64_t expected = sizeof(CmbHeader) +
+                        uint64_t(sizeof(BytecodeFunction)) * h.numFunctions +
+                        uint64_t(sizeof(int32_t)) * (uint64_t(h.numConstants) + h.numGlobals) +
+                        uint64_t(sizeof(uint32_t)) * h.codeWords + h.namesSize;
+    if (expected != size) {
+        module.unmap();
+        throw std::runtime_error("'" + path + "' is truncated or corrupt");
+    }
+
+    const char* p = base + sizeof(CmbHeader);
+    module.functionsPtr = reinterpret_cast<const BytecodeFunction*>(p);
+    p += sizeof(BytecodeFunction) * h.numFunctions;
+    module.constantsPtr = reinterpret_cast<const int32_t*>(p);
+    p += sizeof(int32_t) * h.numConstants;
+    module.globalsPtr = reinterpret_cast<const int32_t*>(p);
+    p += sizeof(int32_t) * h.numGlobals;
+    module.codePtr = reinterpret_cast<const uint32_t*>(p);
+    p += sizeof(uint32_t) * h.codeWords;
+    module.namesPtr = p;
+
+    try {
+        module.verify();
+    } catch (...) {
+        module.unmap();
+        throw;
+    }
+}
+
+// 校验字节码：操作码、寄存器、跳转目标、函数号和常量号都必须有效，
+// 这样虚拟机执行时无需再做这些检查
+void BytecodeModule::verify() const {
+    const CmbHeader& h = header;
+    auto fail = [](const std::string& message) {
+        throw std::runtime_error("Invalid bytecode: " + message);
+    };
+
+    if (h.mainFunction >= h.numFunctions) fail("bad main function");
+
+    for (uint32_t f = 0; f < h.numFunctions; f++) {
+        const BytecodeFunction& fun = functionsPtr[f];
+        uint64_t end = uint64_t(fun.codeOffset) + fun.codeLength;
+        if (end > h.codeWords || fun.codeLength == 0) fail("bad code range");
+        if (uint64_t(fun.nameOffset) + fun.nameLength > h.namesSize) fail("bad function name");
+        if (fun.numParams > fun.numRegs) fail("bad register count");
+
+        const uint32_t* code = codePtr + fun.codeOffset;
+        uint32_t pc = 0;
+        while (pc < fun.codeLength) {
+            uint32_t insn = code[pc];
+            Opcode op = insnOp(insn);
+            if (op >= Opcode::NUM_OPCODES) fail("bad opcode");
+            uint32_t length = static_cast<uint32_t>(instructionLength(op));
+            if (pc + length > fun.codeLength) fail("truncated instruction");
+
+            uint32_t a = insnA(insn), b = insnB(insn), c = insnC(insn);
+            auto reg = [&](uint32_t r) { if (r >= fun.numRegs) fail("register out of range"); };
+            auto target = [&](int64_t t) { if (t < 0 || t >= fun.codeLength) fail("jump out of range"); };
+
+            switch (op) {
+                case Opcode::LOADI: case Opcode::INPUT: case Opcode::OUTPUT: case Opcode::RET:
+                    reg(a);
+                    break;
+                case Opcode::LOADK:
+                    reg(a);
+                    if (insnBx(insn) >= h.numConstants) fail("constant out of range");
+                    break;
+                case Opcode::GETG: case Opcode::SETG:
+                    reg(a);
+                    if (insnBx(insn) >= h.numGlobals) fail("global out of range");
+                    break;
+                case Opcode::MOV:
+                case Opcode::ADDI:
+                    reg(a); reg(b);
+                    break;
+                case Opcode::ADD: case Opcode::SUB: case Opcode::MUL: case Opcode::DIV: case Opcode::MOD:
+                case Opcode::LT: case Opcode::LE: case Opcode::GT:
+                case Opcode::GE: case Opcode::EQ: case Opcode::NE:
+                case Opcode::LOADX: case Opcode::STOREX:
+                    reg(a); reg(b); reg(c);
+                    break;
+                case Opcode::JMP:
+                    target(int64_t(pc) + insnSAx(insn));
+                    break;
+                case Opcode::JT: case Opcode::JF:
+                    reg(a);
+                    target(int64_t(pc) + static_cast<int32_t>(code[pc + 1]));
+                    break;
+                case Opcode::JLT: case Opcode::JLE: case Opcode::JGT:
+                case Opcode::JGE: case Opcode::JEQ: case Opcode::JNE:
+                    reg(a); reg(b);
+                    target(int64_t(pc) + static_cast<int32_t>(code[pc + 1]));
+                    break;
+                case Opcode::LREF:
+                    reg(a);
+                    if (uint64_t(code[pc + 1]) + code[pc + 2] > fun.arrayWords) fail("local array out of range");
+                    break;
+                case Opcode::GREF:
+                    reg(a);
+                    if (uint64_t(code[pc + 1]) + code[pc + 2] > h.globalArrayWords) fail("global array out of range");
+                    break;
+                case Opcode::ZEROA:
+                    if (uint64_t(code[pc + 1]) + code[pc + 2] > fun.arrayWords) fail("local array out of range");
+                    break;
+                case Opcode::CALL: case Opcode::TAILCALL: {
+                    uint32_t callee = code[pc + 1];
+                    if (callee >= h.numFunctions) fail("function out of range");
+                    if (c != functionsPtr[callee].numParams) fail("argument count mismatch");
+                    if (a + std::max<uint32_t>(c, 1) > fun.numRegs) fail("register out of range");
+                    break;
+                }
+                default:
+                    break;
+            }
+            pc += length;
+        }
+
+        // 函数必须以无条件控制转移结束
+        Opcode last = Opcode::NUM_OPCODES;
+        for (uint32_t p = 0; p < fun.codeLength; p += instructionLength(insnOp(code[p]))) {
+            last = insnOp(code[p]);
+        }
+        if (last != Opcode::RET && last != Opcode::RET0 && last != Opcode::JMP && last != Opcode::TAILCALL) {
+            fail("function falls off its end");
+        }
+    }
+}
+
+// 反汇编
+void BytecodeModule::disassemble(std::ostream& out) const {
+    for (uint32_t f = 0; f < header.numFunctions; f++) {
+        const BytecodeFunction& fun = functionsPtr[f];
+        out << "function " << f << " " << functionName(f) << " (params=" << fun.numParams
+            << ", regs=" << fun.numRegs << ", arrays=" << fun.arrayWords << ")\n";
+
+        const uint32_t* code = codePtr + fun.codeOffset;
+        for (uint32_t pc = 0; pc < fun.codeLength; pc += instructionLength(insnOp(code[pc]))) {
+            uint32_t insn = code[pc];
+            Opcode op = insnOp(insn);
+            out << "  " << pc << "\t" << opcodeName(op);
+            switch (op) {
+                case Opcode::LOADI:
+                    out << " r" << insnA(insn) << ", " << insnSBx(insn);
+                    break;
+                case Opcode::LOADK:
+                    out << " r" << insnA(insn) << ", " << constantsPtr[insnBx(insn)];
+                    break;
+                case Opcode::GETG: case Opcode::SETG:
+                    out << " r" << insnA(insn) << ", g" << insnBx(insn);
+                    break;
+                case Opcode::MOV:
+                    out << " r" << insnA(insn) << ", r" << insnB(insn);
+                    break;
+                case Opcode::ADDI:
+                    out << " r" << insnA(insn) << ", r" << insnB(insn) << ", " << insnSC(insn);
+                    break;
+                case Opcode::JMP:
+                    out << " -> " << pc + insnSAx(insn);
+                    break;
+                case Opcode::JT: case Opcode::JF:
+                    out << " r" << insnA(insn) << " -> " << pc + static_cast<int32_t>(code[pc + 1]);
+                    break;
+                case Opcode::LREF: case Opcode::GREF:
+                    out << " r" << insnA(insn) << ", @" << code[pc + 1] << "[" << code[pc + 2] << "]";
+                    break;
+                case Opcode::ZEROA:
+                    out << " @" << code[pc + 1] << "[" << code[pc + 2] << "]";
+                    break;
+                case Opcode::CALL: case Opcode::TAILCALL:
+                    out << " r" << insnA(insn) << ", " << insnC(insn) << " args, " << functionName(code[pc + 1]);
+                    break;
+                case Opcode::INPUT: case Opcode::OUTPUT: case Opcode::RET:
+                    out << " r" << insnA(insn);
+                    break;
+                case Opcode::RET0:
+                    break;
+                default:
+                    if (isJumpWithOffsetWord(op)) {
+                        out << " r" << insnA(insn) << ", r" << insnB(insn) << " -> "
+                            << pc + static_cast<int32_t>(code[pc + 1]);
+                    } else {
+                        out << " r" << insnA(insn) << ", r" << insnB(insn) << ", r" << insnC(insn);
+                    }
+                    break;
+            }
+            out << "\n";
+        }
+    }
+}
+
+// ===== BytecodeCompiler =====
+
+BytecodeCompiler::BytecodeCompiler()
+    : module(nullptr), sources(nullptr), cache(nullptr), hits(0), misses(0), currentFun(nullptr), freeReg(0), maxReg(0),
+      tailCalls(0) {}
+
+// 编译整个程序
+void BytecodeCompiler::compile(const ProgramNode& program, BytecodeModule& target) {
+    module = &target;
+    sources = program.sources.get();
+    tailCalls = 0;
+    hits = 0;
+    misses = 0;
+    code.clear();
+    constants.clear();
+    functionIndex.clear();
+    functionList.clear();
+    functionByName.clear();
+
+    for (const auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::FUN_DECLARATION) {
+            auto* fun = static_cast<const FunDeclarationNode*>(decl.get());
+            functionIndex[fun] = static_cast<uint32_t>(functionList.size());
+            if (cache) functionByName[fun->identifier] = static_cast<uint32_t>(functionList.size());
+            functionList.push_back(fun);
+        }
+    }
+
+    target.unmap();
+    target.ownedFunctions.clear();
+    target.ownedNames.clear();
+    target.lines.clear();
+    target.ownedGlobals.assign(program.numGlobalSlots, 0);
+    for (const auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::VAR_DECLARATION) {
+            auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+            if (varDecl->initializer) {
+                target.ownedGlobals[varDecl->slot] = static_cast<const NumNode*>(varDecl->initializer.get())->value;
+            }
+        }
+    }
+    if (program.numGlobalSlots > 0xffff) {
+        throw std::runtime_error("Bytecode: too many global variables");
+    }
+
+    uint32_t mainIndex = 0;
+    for (const FunDeclarationNode* fun : functionList) {
+        if (fun->identifier == "main") mainIndex = functionIndex[fun];
+        if (cache) {
+            compileCached(*fun);
+        } else {
+            compileFunction(*fun);
+        }
+    }
+
+    CmbHeader& h = target.header;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "CMB", 4);
+    h.version = cmbVersion;
+    h.numFunctions = static_cast<uint32_t>(target.ownedFunctions.size());
+    h.numConstants = static_cast<uint32_t>(constants.size());
+    h.numGlobals = static_cast<uint32_t>(program.numGlobalSlots);
+    h.globalArrayWords = static_cast<uint32_t>(program.globalArrayWords);
+    h.codeWords = static_cast<uint32_t>(code.size());
+    h.namesSize = static_cast<uint32_t>(target.ownedNames.size());
+    h.mainFunction = mainIndex;
+
+    target.ownedCode = std::move(code);
+    target.ownedConstants = std::move(constants);
+    target.bindOwned();
+    code.clear();
+    constants.clear();
+    module = nullptr;
+    sources = nullptr;
+    // 缓存条目来自磁盘，与从 .cmb 加载一样要校验
+    if (hits > 0) {
+        target.verify();
+    }
+}
+
+// 编译函数：寄存器依次为槽位（参数在前）和临时寄存器
+void BytecodeCompiler::compileFunction(const FunDeclarationNode& fun) {
+    currentFun = &fun;
+    freeReg = fun.numSlots;
+    maxReg = fun.numSlots;
+    checkReg(fun.numSlots - 1);
+
+    BytecodeFunction info;
+    info.codeOffset = static_cast<uint32_t>(code.size());
+    info.numParams = static_cast<uint16_t>(fun.params.size());
+    info.arrayWords = static_cast<uint32_t>(fun.arrayWords);
+    info.nameOffset = static_cast<uint32_t>(module->ownedNames.size());
+    info.nameLength = static_cast<uint32_t>(fun.identifier.size());
+    module->ownedNames += fun.identifier;
+
+    markLine(&fun);
+    compileCompoundStmt(*static_cast<const CompoundStmtNode*>(fun.body.get()));
+    emit(encodeABC(Opcode::RET0, 0, 0, 0));
+
+    info.codeLength = static_cast<uint32_t>(code.size()) - info.codeOffset;
+    info.numRegs = static_cast<uint16_t>(std::max(maxReg, 1));
+    module->ownedFunctions.push_back(info);
+    currentFun = nullptr;
+}
+
+// ===== 函数级缓存 =====
+
+// 先查缓存，未命中时编译并写回
+void BytecodeCompiler::compileCached(const FunDeclarationNode& fun) {
+    Hash128 key = FunctionCache::fingerprint(fun, cacheVariant);
+    CachedFunction& entry = cachedEntry;
+    if (cache->lookup(key, entry) && appendCached(fun, entry)) {
+        hits++;
+        return;
+    }
+    misses++;
+    size_t tailCallsBefore = tailCalls;
+    compileFunction(fun);
+    extractFunction(module->ownedFunctions.back(), entry);
+    entry.tailCalls = static_cast<uint32_t>(tailCalls - tailCallsBefore);
+    cache->store(key, entry);
+}
+
+// 把刚编译的函数转为与模块无关的形式：常量号和函数号改为条目内的序号
+void BytecodeCompiler::extractFunction(const BytecodeFunction& info, CachedFunction& entry) const {
+    entry.numParams = info.numParams;
+    entry.numRegs = info.numRegs;
+    entry.arrayWords = info.arrayWords;
+    entry.code.assign(code.begin() + info.codeOffset, code.begin() + info.codeOffset + info.codeLength);
+    entry.constants.clear();
+    entry.callees.clear();
+
+    for (size_t pc = 0; pc < entry.code.size(); pc += instructionLength(insnOp(entry.code[pc]))) {
+        uint32_t insn = entry.code[pc];
+        Opcode op = insnOp(insn);
+        if (op == Opcode::LOADK) {
+            int32_t value = constants[insnBx(insn)];
+            size_t index = 0;
+            while (index < entry.constants.size() && entry.constants[index] != value) index++;
+            if (index == entry.constants.size()) entry.constants.push_back(value);
+            entry.code[pc] = encodeABx(Opcode::LOADK, insnA(insn), static_cast<uint32_t>(index));
+        } else if (op == Opcode::CALL || op == Opcode::TAILCALL) {
+            const std::string& name = functionList[entry.code[pc + 1]]->identifier;
+            size_t index = 0;
+            while (index < entry.callees.size() && entry.callees[index] != name) index++;
+            if (index == entry.callees.size()) entry.callees.push_back(name);
+            entry.code[pc + 1] = static_cast<uint32_t>(index);
+        }
+    }
+}
+
+// 把缓存的函数拼接到模块中并重定位；条目与当前程序不符时返回 false（改为重新编译）
+bool BytecodeCompiler::appendCached(const FunDeclarationNode& fun, const CachedFunction& entry) {
+    if (entry.numParams != fun.params.size() || entry.code.empty()) return false;
+    std::vector<uint32_t> callees;
+    for (const std::string& name : entry.callees) {
+        auto it = functionByName.find(name);
+        if (it == functionByName.end()) return false;
+        callees.push_back(it->second);
+    }
+    for (size_t pc = 0; pc < entry.code.size(); ) {
+        Opcode op = insnOp(entry.code[pc]);
+        if (op >= Opcode::NUM_OPCODES) return false;
+        size_t length = static_cast<size_t>(instructionLength(op));
+        if (pc + length > entry.code.size()) return false;
+        if (op == Opcode::LOADK && insnBx(entry.code[pc]) >= entry.constants.size()) return false;
+        if ((op == Opcode::CALL || op == Opcode::TAILCALL) && entry.code[pc + 1] >= callees.size()) return false;
+        pc += length;
+    }
+
+    BytecodeFunction info;
+    info.codeOffset = static_cast<uint32_t>(code.size());
+    info.codeLength = static_cast<uint32_t>(entry.code.size());
+    info.numParams = entry.numParams;
+    info.numRegs = entry.numRegs;
+    info.arrayWords = entry.arrayWords;
+    info.nameOffset = static_cast<uint32_t>(module->ownedNames.size());
+    info.nameLength = static_cast<uint32_t>(fun.identifier.size());
+    module->ownedNames += fun.identifier;
+
+    markLine(nullptr);  // 缓存中没有行号
+    code.insert(code.end(), entry.code.begin(), entry.code.end());
+    for (size_t pc = info.codeOffset; pc < code.size(); pc += instructionLength(insnOp(code[pc]))) {
+        uint32_t insn = code[pc];
+        Opcode op = insnOp(insn);
+        if (op == Opcode::LOADK) {
+            code[pc] = encodeABx(Opcode::LOADK, insnA(insn), constantIndex(entry.constants[insnBx(insn)]));
+        } else if (op == Opcode::CALL || op == Opcode::TAILCALL) {
+            code[pc + 1] = callees[code[pc + 1]];
+        }
+    }
+    module->ownedFunctions.push_back(info);
+    tailCalls += entry.tailCalls;
+    return true;
+}
+
+// 行号表：从当前位置开始的指令属于 node 所在的行（node 为空时行号未知）。除了语句，
+// 可能出错的指令（除法、下标访问和调用）也按所在的表达式记录，报错的行号与解释器一致
+void BytecodeCompiler::markLine(const ASTNode* node) {
+    int line = node && sources ? sources->line(node->start) : 0;
+    uint32_t offset = static_cast<uint32_t>(code.size());
+    auto& lines = module->lines;
+    if (!lines.empty() && lines.back().first == offset) {
+        lines.back().second = line;
+    } else if (lines.empty() || lines.back().second != line) {
+        lines.emplace_back(offset, line);
+    }
+}
+
+// ===== 语句 =====
+
+void BytecodeCompiler::compileStatement(const ASTNode* stmt) {
+    int saved = freeReg;
+    if (stmt->type != ASTNodeType::COMPOUND_STMT) markLine(stmt);
+
+    switch (stmt->type) {
+        case ASTNodeType::COMPOUND_STMT:
+            compileCompoundStmt(*static_cast<const CompoundStmtNode*>(stmt));
+            break;
+
+        case ASTNodeType::EXPRESSION_STMT: {
+            auto* exprStmt = static_cast<const ExpressionStmtNode*>(stmt);
+            const ASTNode* expr = exprStmt->expression.get();
+            if (expr && expr->type == ASTNodeType::ASSIGN_EXPR) {
+                compileAssign(*static_cast<const AssignExprNode*>(expr), -1);
+            } else if (expr) {
+                exprAny(expr);
+            }
+            break;
+        }
+
+        case ASTNodeType::SELECTION_STMT: {
+            auto* selectionStmt = static_cast<const SelectionStmtNode*>(stmt);
+            std::vector<size_t> elsePatches;
+            compileBranch(selectionStmt->condition.get(), false, elsePatches);
+            compileStatement(selectionStmt->ifBranch.get());
+            if (selectionStmt->elseBranch) {
+                size_t endJump = emitJump(encodeSAx(Opcode::JMP, 0));
+                patchJumps(elsePatches, code.size());
+                compileStatement(selectionStmt->elseBranch.get());
+                patchJumps({endJump}, code.size());
+            } else {
+                patchJumps(elsePatches, code.size());
+            }
+            break;
+        }
+
+        case ASTNodeType::ITERATION_STMT: {
+            // 条件放在循环底部
+            auto* iterationStmt = static_cast<const IterationStmtNode*>(stmt);
+            size_t condJump = emitJump(encodeSAx(Opcode::JMP, 0));
+            size_t bodyStart = code.size();
+            compileStatement(iterationStmt->body.get());
+            patchJumps({condJump}, code.size());
+            markLine(stmt);
+            std::vector<size_t> loopPatches;
+            compileBranch(iterationStmt->condition.get(), true, loopPatches);
+            patchJumps(loopPatches, bodyStart);
+            break;
+        }
+
+        case ASTNodeType::RETURN_STMT: {
+            auto* returnStmt = static_cast<const ReturnStmtNode*>(stmt);
+            const ASTNode* expression = returnStmt->expression.get();
+            if (expression && expression->type == ASTNodeType::CALL &&
+                static_cast<const CallNode*>(expression)->tailCall) {
+                compileCall(*static_cast<const CallNode*>(expression), -1);
+            } else if (expression) {
+                int reg = exprAny(expression);
+                emit(encodeABC(Opcode::RET, reg, 0, 0));
+            } else {
+                emit(encodeABC(Opcode::RET0, 0, 0, 0));
+            }
+            break;
+        }
+
+        default:
+            throw std::runtime_error("Bytecode: unexpected statement at offset " + std::to_string(stmt->start));
+    }
+
+    freeReg = saved;
+}
+
+// 进入复合语句时初始化其局部变量
+void BytecodeCompiler::compileCompoundStmt(const CompoundStmtNode& compoundStmt) {
+    for (const auto& decl : compoundStmt.localDeclarations) {
+        if (decl->type == ASTNodeType::ARRAY_DECLARATION) {
+            auto* arrayDecl = static_cast<const ArrayDeclarationNode*>(decl.get());
+            emit(encodeABC(Opcode::ZEROA, 0, 0, 0));
+            emit(static_cast<uint32_t>(arrayDecl->offset));
+            emit(static_cast<uint32_t>(arrayDecl->arraySize));
+            continue;
+        }
+        auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+        if (varDecl->initializer) {
+            exprTo(varDecl->initializer.get(), varDecl->slot);
+        } else {
+            loadConst(varDecl->slot, 0);
+        }
+    }
+
+    for (const auto& stmt : compoundStmt.statements) {
+        compileStatement(stmt.get());
+    }
+}
+
+// 条件为真（jumpIfTrue）或为假时跳转，待回填的跳转加入patches
+void BytecodeCompiler::compileBranch(const ASTNode* cond, bool jumpIfTrue, std::vector<size_t>& patches) {
+    int saved = freeReg;
+
+    if (cond->type == ASTNodeType::NUM) {
+        if ((static_cast<const NumNode*>(cond)->value != 0) == jumpIfTrue) {
+            patches.push_back(emitJump(encodeSAx(Opcode::JMP, 0)));
+        }
+    } else if (cond->type == ASTNodeType::SIMPLE_EXPR) {
+        // 比较与跳转合并为一条指令
+        auto* simpleExpr = static_cast<const SimpleExprNode*>(cond);
+        int left = exprKeep(simpleExpr->left.get(), simpleExpr->right.get());
+        int right = exprAny(simpleExpr->right.get());
+        TokenType relop = jumpIfTrue ? simpleExpr->relop : negateRelop(simpleExpr->relop);
+        patches.push_back(emitJump(encodeABC(relopOpcode(relop, true), left, right, 0)));
+    } else {
+        int reg = exprAny(cond);
+        patches.push_back(emitJump(encodeABC(jumpIfTrue ? Opcode::JT : Opcode::JF, reg, 0, 0)));
+    }
+
+    freeReg = saved;
+}
+
+// ===== 表达式 =====
+
+// 计算表达式，返回保存结果的寄存器（局部标量直接返回其槽位）
+int BytecodeCompiler::exprAny(const ASTNode* expr) {
+    if (expr->type == ASTNodeType::VAR) {
+        auto* var = static_cast<const VarNode*>(expr);
+        if (!var->index && var->kind == VarKind::LOCAL_SCALAR) {
+            return var->slot;
+        }
+    }
+    int reg = allocTemp();
+    exprTo(expr, reg);
+    return reg;
+}
+
+// 同 exprAny，但若随后求值的 later 有副作用，则把变量的当前值复制出来，
+// 保证从左到右的求值语义
+int BytecodeCompiler::exprKeep(const ASTNode* expr, const ASTNode* later) {
+    int reg = exprAny(expr);
+    if (reg < currentFun->numSlots && !isPureExpression(later)) {
+        int temp = allocTemp();
+        emit(encodeABC(Opcode::MOV, temp, reg, 0));
+        return temp;
+    }
+    return reg;
+}
+
+// 计算表达式到指定寄存器
+void BytecodeCompiler::exprTo(const ASTNode* expr, int dst) {
+    int saved = freeReg;
+
+    switch (expr->type) {
+        case ASTNodeType::NUM:
+            loadConst(dst, static_cast<const NumNode*>(expr)->value);
+            break;
+
+        case ASTNodeType::VAR: {
+            auto* var = static_cast<const VarNode*>(expr);
+            if (var->index) {
+                int ref = arrayRef(*var);
+                int index = exprAny(var->index.get());
+                markLine(var);
+                emit(encodeABC(Opcode::LOADX, dst, ref, index));
+            } else if (var->kind == VarKind::LOCAL_SCALAR) {
+                if (var->slot != dst) emit(encodeABC(Opcode::MOV, dst, var->slot, 0));
+            } else if (var->kind == VarKind::GLOBAL_SCALAR) {
+                emit(encodeABx(Opcode::GETG, dst, var->slot));
+            } else {
+                arrayRefTo(*var, dst);
+            }
+            break;
+        }
+
+        case ASTNodeType::ASSIGN_EXPR:
+            compileAssign(*static_cast<const AssignExprNode*>(expr), dst);
+            break;
+
+        case ASTNodeType::BIN_OP: {
+            auto* binOp = static_cast<const BinOpNode*>(expr);
+            // 加减小常量使用立即数形式
+            if (binOp->right->type == ASTNodeType::NUM &&
+                (binOp->op == TokenType::PLUS || binOp->op == TokenType::MINUS)) {
+                int32_t value = static_cast<const NumNode*>(binOp->right.get())->value;
+                if (binOp->op == TokenType::MINUS) value = -value;
+                if (value >= -128 && value <= 127) {
+                    int left = exprAny(binOp->left.get());
+                    emit(encodeABC(Opcode::ADDI, dst, left, static_cast<uint8_t>(value)));
+                    break;
+                }
+            }
+            int left = exprKeep(binOp->left.get(), binOp->right.get());
+            int right = exprAny(binOp->right.get());
+            Opcode op;
+            switch (binOp->op) {
+                case TokenType::PLUS:  op = Opcode::ADD; break;
+                case TokenType::MINUS: op = Opcode::SUB; break;
+                case TokenType::TIMES: op = Opcode::MUL; break;
+                case TokenType::MOD:   op = Opcode::MOD; break;
+                default:               op = Opcode::DIV; break;
+            }
+            if (op == Opcode::DIV || op == Opcode::MOD) markLine(binOp);
+            emit(encodeABC(op, dst, left, right));
+            break;
+        }
+
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto* simpleExpr = static_cast<const SimpleExprNode*>(expr);
+            int left = exprKeep(simpleExpr->left.get(), simpleExpr->right.get());
+            int right = exprAny(simpleExpr->right.get());
+            emit(encodeABC(relopOpcode(simpleExpr->relop, false), dst, left, right));
+            break;
+        }
+
+        case ASTNodeType::CALL:
+            compileCall(*static_cast<const CallNode*>(expr), dst);
+            break;
+
+        default:
+            throw std::runtime_error("Bytecode: unexpected expression at offset " + std::to_string(expr->start));
+    }
+
+    freeReg = saved;
+}
+
+// 赋值，dst 为 -1 时不需要结果
+void BytecodeCompiler::compileAssign(const AssignExprNode& assignExpr, int dst) {
+    auto* var = static_cast<const VarNode*>(assignExpr.var.get());
+    const ASTNode* value = assignExpr.expression.get();
+    int reg;
+    if (var->index) {
+        int ref = arrayRef(*var);
+        int index = exprKeep(var->index.get(), value);
+        reg = exprAny(value);
+        markLine(var);
+        emit(encodeABC(Opcode::STOREX, ref, index, reg));
+    } else if (var->kind == VarKind::LOCAL_SCALAR) {
+        exprTo(value, var->slot);
+        reg = var->slot;
+    } else {
+        reg = exprAny(value);
+        emit(encodeABx(Opcode::SETG, reg, var->slot));
+    }
+    if (dst >= 0 && reg != dst) {
+        emit(encodeABC(Opcode::MOV, dst, reg, 0));
+    }
+}
+
+// 函数调用：实参放在连续的临时寄存器中。dst 为 -1 时生成尾调用
+void BytecodeCompiler::compileCall(const CallNode& call, int dst) {
+    if (call.builtin == BuiltinKind::INPUT) {
+        emit(encodeABC(Opcode::INPUT, dst, 0, 0));
+        return;
+    }
+    if (call.builtin == BuiltinKind::OUTPUT) {
+        int reg = exprAny(call.args[0].get());
+        emit(encodeABC(Opcode::OUTPUT, reg, 0, 0));
+        return;
+    }
+
+    int base = freeReg;
+    for (const auto& arg : call.args) {
+        int reg = allocTemp();
+        const ASTNode* node = arg.get();
+        auto* var = node->type == ASTNodeType::VAR ? static_cast<const VarNode*>(node) : nullptr;
+        if (var && !var->index && (var->kind == VarKind::LOCAL_ARRAY || var->kind == VarKind::GLOBAL_ARRAY ||
+                                   var->kind == VarKind::PARAM_ARRAY)) {
+            arrayRefTo(*var, reg);
+        } else {
+            exprTo(node, reg);
+        }
+    }
+    if (call.args.empty()) {
+        allocTemp();
+    }
+
+    Opcode op = dst < 0 ? Opcode::TAILCALL : Opcode::CALL;
+    markLine(&call);
+    emit(encodeABC(op, base, 0, static_cast<uint32_t>(call.args.size())));
+    emit(functionIndex.at(call.callee));
+    if (dst < 0) {
+        tailCalls++;
+    } else if (base != dst) {
+        emit(encodeABC(Opcode::MOV, dst, base, 0));
+    }
+}
+
+// 数组引用
+void BytecodeCompiler::arrayRefTo(const VarNode& var, int dst) {
+    switch (var.kind) {
+        case VarKind::LOCAL_ARRAY:
+        case VarKind::GLOBAL_ARRAY:
+            emit(encodeABC(var.kind == VarKind::LOCAL_ARRAY ? Opcode::LREF : Opcode::GREF, dst, 0, 0));
+            emit(static_cast<uint32_t>(var.slot));
+            emit(static_cast<uint32_t>(var.arraySize));
+            break;
+        case VarKind::PARAM_ARRAY:
+            if (var.slot != dst) emit(encodeABC(Opcode::MOV, dst, var.slot, 0));
+            break;
+        default:
+            throw std::runtime_error("Bytecode: '" + var.identifier + "' is not an array");
+    }
+}
+
+int BytecodeCompiler::arrayRef(const VarNode& var) {
+    if (var.kind == VarKind::PARAM_ARRAY) {
+        return var.slot;
+    }
+    int reg = allocTemp();
+    arrayRefTo(var, reg);
+    return reg;
+}
+
+// ===== 寄存器与指令 =====
+
+int BytecodeCompiler::allocTemp() {
+    int reg = freeReg++;
+    checkReg(reg);
+    if (freeReg > maxReg) maxReg = freeReg;
+    return reg;
+}
+
+void BytecodeCompiler::checkReg(int reg) const {
+    if (reg > 0xff) {
+        throw std::runtime_error("Bytecode: function '" + currentFun->identifier + "' needs more than 256 registers");
+    }
+}
+
+void BytecodeCompiler::loadConst(int dst, int32_t value) {
+    if (value >= INT16_MIN && value <= INT16_MAX) {
+        emit(encodeABx(Opcode::LOADI, dst, static_cast<uint32_t>(value)));
+        return;
+    }
+    emit(encodeABx(Opcode::LOADK, dst, constantIndex(value)));
+}
+
+// 常量在常量表中的序号，不存在时加入
+uint32_t BytecodeCompiler::constantIndex(int32_t value) {
+    size_t index = 0;
+    while (index < constants.size() && constants[index] != value) index++;
+    if (index == constants.size()) {
+        if (index > 0xffff) throw std::runtime_error("Bytecode: too many constants");
+        constants.push_back(value);
+    }
+    return static_cast<uint32_t>(index);
+}
+
+void BytecodeCompiler::emit(uint32_t insn) {
+    code.push_back(insn);
+}
+
+// 发出跳转指令，返回其位置以便回填
+size_t BytecodeCompiler::emitJump(uint32_t insn) {
+    size_t pos = code.size();
+    emit(insn);
+    if (isJumpWithOffsetWord(insnOp(insn))) {
+        emit(0);
+    }
+    return pos;
+}
+
+void BytecodeCompiler::patchJumps(const std::vector<size_t>& patches, size_t target) {
+    for (size_t pos : patches) {
+        int32_t offset = static_cast<int32_t>(target) - static_cast<int32_t>(pos);
+        if (insnOp(code[pos]) == Opcode::JMP) {
+            code[pos] = encodeSAx(Opcode::JMP, offset);
+        } else {
+            code[pos + 1] = static_cast<uint32_t>(offset);
+        }
+    }
+}
@@ -0,0 +1,251 @@
+#include "cache.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char packMagic[8] = {'C', 'M', 'F', 'P', 'A', 'C', 'K', '\0'};
+const uint32_t cacheVersion = 1;
+const uint32_t recordMagic = 0x52464d43;  // "CMFR"
+
+// pack 文件超过此大小时整体替换
+const size_t maxPackBytes = 64u << 20;
+
+// 文件头：魔数 + 版本；记录头：魔数、指纹、数据长度、数据校验和
+const size_t packHeaderSize = 12;
+const size_t recordHeaderSize = 28;
+
+// 小端整数的读写
+void put32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out += static_cast<char>(value >> (8 * i));
+}
+
+void put64(std::string& out, uint64_t value) {
+    put32(out, static_cast<uint32_t>(value));
+    put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+uint32_t get32(const char* p) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    return value;
+}
+
+uint64_t get64(const char* p) {
+    return get32(p) | uint64_t(get32(p + 4)) << 32;
+}
+
+// 记录数据的校验和（按4字节处理，末尾不足4字节的部分逐字节处理）
+uint32_t checksum(const char* data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) h = (h ^ get32(data + i)) * 0x100000001b3ULL;
+    for (; i < size; i++) h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ULL;
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// 条目数据的顺序读取，越界时置失败标志
+class Reader {
+public:
+    Reader(const char* data, size_t size) : data(data), size(size), pos(0), ok(true) {}
+
+    uint32_t get() {
+        if (size - pos < 4) {
+            ok = false;
+            return 0;
+        }
+        uint32_t value = get32(data + pos);
+        pos += 4;
+        return value;
+    }
+
+    // 读取 count 个元素前先检查剩余长度，防止损坏的条目导致巨大的分配
+    bool has(uint64_t count, size_t elementSize) {
+        if (count > (size - pos) / elementSize) ok = false;
+        return ok;
+    }
+
+    std::string text(uint32_t length) {
+        if (!has(length, 1)) return std::string();
+        std::string value(data + pos, length);
+        pos += length;
+        return value;
+    }
+
+    bool done() const { return ok && pos == size; }
+    bool good() const { return ok; }
+
+private:
+    const char* data;
+    size_t size;
+    size_t pos;
+    bool ok;
+};
+
+bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string packHeader() {
+    std::string header(packMagic, sizeof(packMagic));
+    put32(header, cacheVersion);
+    return header;
+}
+
+} // namespace
+
+FunctionCache::FunctionCache(const std::string& directory)
+    : directory(directory), opened(false), damaged(false), mapping(nullptr), mappingSize(0) {}
+
+FunctionCache::~FunctionCache() {
+    flush();
+    if (mapping) munmap(const_cast<char*>(mapping), mappingSize);
+}
+
+Hash128 FunctionCache::fingerprint(const FunDeclarationNode& fun, const std::string& variant) {
+    Hasher h;
+    h.number(cacheVersion);
+    h.text(variant);
+    h.hash(fun.tokenHash);
+    h.hash(fun.referenceHash);
+    return h.result();
+}
+
+// 映射 pack 文件并索引其中完整的记录；遇到不完整的记录即停止，并在写入时替换文件
+void FunctionCache::open() {
+    opened = true;
+    int fd = ::open((directory + "/functions.pack").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    // 共享锁：不会看到正在追加的记录
+    struct stat st;
+    if (flock(fd, LOCK_SH) != 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return;
+    }
+    damaged = true;
+    size_t size = static_cast<size_t>(st.st_size);
+    void* p = size >= packHeaderSize ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    // 映射会保持文件打开，锁须显式释放
+    flock(fd, LOCK_UN);
+    close(fd);
+    if (p == MAP_FAILED) return;
+    mapping = static_cast<const char*>(p);
+    mappingSize = size;
+    if (std::string(mapping, packHeaderSize) != packHeader()) return;
+
+    size_t pos = packHeaderSize;
+    while (mappingSize - pos >= recordHeaderSize && get32(mapping + pos) == recordMagic) {
+        Hash128 key;
+        key.high = get64(mapping + pos + 4);
+        key.low = get64(mapping + pos + 12);
+        size_t length = get32(mapping + pos + 20);
+        if (length > mappingSize - pos - recordHeaderSize) break;
+        index[key] = std::make_pair(pos, length);
+        pos += recordHeaderSize + length;
+    }
+    damaged = pos != mappingSize;
+}
+
+bool FunctionCache::lookup(const Hash128& key, CachedFunction& entry) {
+    if (!opened) open();
+    auto it = index.find(key);
+    if (it == index.end()) return false;
+    const char* record = mapping + it->second.first;
+    const char* data = record + recordHeaderSize;
+    size_t size = it->second.second;
+    if (checksum(data, size) != get32(record + 24)) return false;
+
+    Reader in(data, size);
+    uint32_t params = in.get();
+    uint32_t regs = in.get();
+    entry.arrayWords = in.get();
+    entry.tailCalls = in.get();
+    uint32_t codeLength = in.get();
+    uint32_t numConstants = in.get();
+    uint32_t numCallees = in.get();
+    if (!in.good() || params > 0xffff || regs > 0xffff) return false;
+    entry.numParams = static_cast<uint16_t>(params);
+    entry.numRegs = static_cast<uint16_t>(regs);
+
+    if (!in.has(codeLength, 4)) return false;
+    entry.code.resize(codeLength);
+    for (uint32_t& word : entry.code) word = in.get();
+    if (!in.has(numConstants, 4)) return false;
+    entry.constants.resize(numConstants);
+    for (int32_t& value : entry.constants) value = static_cast<int32_t>(in.get());
+    if (!in.has(numCallees, 4)) return false;
+    entry.callees.resize(numCallees);
+    for (std::string& name : entry.callees) name = in.text(in.get());
+    return in.done();
+}
+
+void FunctionCache::store(const Hash128& key, const CachedFunction& entry) {
+    std::string data;
+    put32(data, entry.numParams);
+    put32(data, entry.numRegs);
+    put32(data, entry.arrayWords);
+    put32(data, entry.tailCalls);
+    put32(data, static_cast<uint32_t>(entry.code.size()));
+    put32(data, static_cast<uint32_t>(entry.constants.size()));
+    put32(data, static_cast<uint32_t>(entry.callees.size()));
+    for (uint32_t word : entry.code) put32(data, word);
+    for (int32_t value : entry.constants) put32(data, static_cast<uint32_t>(value));
+    for (const std::string& name : entry.callees) {
+        put32(data, static_cast<uint32_t>(name.size()));
+        data += name;
+    }
+
+    put32(pending, recordMagic);
+    put64(pending, key.high);
+    put64(pending, key.low);
+    put32(pending, static_cast<uint32_t>(data.size()));
+    put32(pending, checksum(data.data(), data.size()));
+    pending += data;
+}
+
+// 加锁后一次性追加新记录；文件损坏或过大时改为写一个新文件再改名替换
+void FunctionCache::flush() {
+    if (pending.empty()) return;
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) return;
+    std::string path = directory + "/functions.pack";
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    if (flock(fd, LOCK_EX) != 0) {
+        close(fd);
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        size_t size = static_cast<size_t>(st.st_size);
+        std::string header = packHeader();
+        if (size == 0) {
+            writeAll(fd, header + pending);
+        } else if (!damaged && size + pending.size() <= maxPackBytes) {
+            writeAll(fd, pending);
+        } else {
+            std::string temp = path + ".XXXXXX";
+            int tempFd = mkstemp(&temp[0]);
+            if (tempFd >= 0) {
+                bool ok = fchmod(tempFd, 0644) == 0 && writeAll(tempFd, header + pending);
+                ok = close(tempFd) == 0 && ok;
+                if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) std::remove(temp.c_str());
+            }
+        }
+    }
+    close(fd);  // 同时释放文件锁
+    pending.clear();
+}
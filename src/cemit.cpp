@@ -0,0 +1,793 @@
+#include "cemit.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+// 生成代码的公共部分：回绕运算、除法、下标和栈的检查、内建函数
+const char* const prelude =
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#if defined(__GNUC__) && defined(__unix__)\n"
+    "#include <sys/resource.h>\n"
+    "#define CM_CHECK_STACK 1\n"
+    "#endif\n"
+    "\n"
+    "#define CM_ADD(a, b) ((int)((unsigned)(a) + (unsigned)(b)))\n"
+    "#define CM_SUB(a, b) ((int)((unsigned)(a) - (unsigned)(b)))\n"
+    "#define CM_MUL(a, b) ((int)((unsigned)(a) * (unsigned)(b)))\n"
+    "\n"
+    "static inline int cm_div(int a, int b, int line) {\n"
+    "    if (b == 0) {\n"
+    "        fflush(stdout);\n"
+    "        fprintf(stderr, \"Runtime error: division by zero at line %d\\n\", line);\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    if (b == -1) return (int)(0u - (unsigned)a);\n"
+    "    return a / b;\n"
+    "}\n"
+    "\n"
+    "static inline int cm_mod(int a, int b, int line) {\n"
+    "    if (b == 0) {\n"
+    "        fflush(stdout);\n"
+    "        fprintf(stderr, \"Runtime error: division by zero at line %d\\n\", line);\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    if (b == -1) return 0;\n"
+    "    return a % b;\n"
+    "}\n"
+    "\n"
+    "static inline int cm_index(int i, int n, int line) {\n"
+    "    if ((unsigned)i >= (unsigned)n) {\n"
+    "        fflush(stdout);\n"
+    "        fprintf(stderr, \"Runtime error: array index %d out of bounds at line %d\\n\", i, line);\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    return i;\n"
+    "}\n"
+    "\n"
+    "static uintptr_t cm_stack_limit;\n"
+    "\n"
+    "static void cm_stack_init(void) {\n"
+    "#ifdef CM_CHECK_STACK\n"
+    "    struct rlimit limit;\n"
+    "    uintptr_t top = (uintptr_t)__builtin_frame_address(0);\n"
+    "    const uintptr_t margin = 256 * 1024;\n"
+    "    if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&\n"
+    "        limit.rlim_cur > margin && limit.rlim_cur < top) {\n"
+    "        cm_stack_limit = top - (uintptr_t)limit.rlim_cur + margin;\n"
+    "    }\n"
+    "#endif\n"
+    "}\n"
+    "\n"
+    "static inline void cm_stack(uintptr_t frame, const char *function, int line) {\n"
+    "#ifdef CM_CHECK_STACK\n"
+    "    if (cm_stack_limit != 0 && (uintptr_t)__builtin_frame_address(0) < cm_stack_limit + frame) {\n"
+    "        fflush(stdout);\n"
+    "        fprintf(stderr, \"Runtime error: stack overflow in call to '%s' at line %d\\n\", function, line);\n"
+    "        exit(1);\n"
+    "    }\n"
+    "#endif\n"
+    "}\n"
+    "\n"
+    "static inline int cm_input(void) {\n"
+    "    int value = 0;\n"
+    "    if (scanf(\"%d\", &value) != 1) return 0;\n"
+    "    return value;\n"
+    "}\n"
+    "\n"
+    "static inline int cm_output(int value) {\n"
+    "    printf(\"%d\\n\", value);\n"
+    "    return 0;\n"
+    "}\n"
+    "\n";
+
+// 常数或标量，求值没有副作用也不会出错
+bool isOperand(const ASTNode* node) {
+    return node->type == ASTNodeType::NUM ||
+           (node->type == ASTNodeType::VAR && !static_cast<const VarNode*>(node)->index);
+}
+
+bool isArrayName(const ASTNode* node) {
+    if (node->type != ASTNodeType::VAR) return false;
+    auto* var = static_cast<const VarNode*>(node);
+    return !var->index && (var->kind == VarKind::LOCAL_ARRAY || var->kind == VarKind::GLOBAL_ARRAY ||
+                           var->kind == VarKind::PARAM_ARRAY);
+}
+
+const char* relopText(TokenType op) {
+    switch (op) {
+        case TokenType::LT: return " < ";
+        case TokenType::LE: return " <= ";
+        case TokenType::GT: return " > ";
+        case TokenType::GE: return " >= ";
+        case TokenType::EQ: return " == ";
+        default:            return " != ";
+    }
+}
+
+std::string literal(int value) {
+    // INT_MIN 不能直接写成字面量
+    if (value == -2147483647 - 1) return "(-2147483647 - 1)";
+    return std::to_string(value);
+}
+
+// return 语句中的尾调用，没有时返回空
+const CallNode* tailCallOf(const ReturnStmtNode& returnStmt) {
+    const ASTNode* expression = returnStmt.expression.get();
+    if (!expression || expression->type != ASTNodeType::CALL) return nullptr;
+    auto* call = static_cast<const CallNode*>(expression);
+    return call->tailCall && call->callee ? call : nullptr;
+}
+
+// 函数体中的尾调用
+void collectTailCalls(const ASTNode* node, std::vector<const CallNode*>& calls) {
+    if (!node) return;
+    switch (node->type) {
+        case ASTNodeType::COMPOUND_STMT:
+            for (const auto& stmt : static_cast<const CompoundStmtNode*>(node)->statements) {
+                collectTailCalls(stmt.get(), calls);
+            }
+            break;
+        case ASTNodeType::SELECTION_STMT: {
+            auto* selectionStmt = static_cast<const SelectionStmtNode*>(node);
+            collectTailCalls(selectionStmt->ifBranch.get(), calls);
+            collectTailCalls(selectionStmt->elseBranch.get(), calls);
+            break;
+        }
+        case ASTNodeType::ITERATION_STMT:
+            collectTailCalls(static_cast<const IterationStmtNode*>(node)->body.get(), calls);
+            break;
+        case ASTNodeType::RETURN_STMT:
+            if (const CallNode* call = tailCallOf(*static_cast<const ReturnStmtNode*>(node))) {
+                calls.push_back(call);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// 有向图中多于一个顶点的强连通分量，各分量中的顶点按编号排列（Tarjan 算法，用显式栈）
+std::vector<std::vector<size_t>> cycles(const std::vector<std::vector<size_t>>& edges) {
+    const size_t none = SIZE_MAX;
+    size_t n = edges.size();
+    std::vector<size_t> order(n, none);
+    std::vector<size_t> low(n, 0);
+    std::vector<bool> onStack(n, false);
+    std::vector<size_t> stack;
+    std::vector<std::pair<size_t, size_t>> work;  // （顶点，下一条边）
+    std::vector<std::vector<size_t>> result;
+    size_t counter = 0;
+    auto visit = [&](size_t v) {
+        order[v] = low[v] = counter++;
+        stack.push_back(v);
+        onStack[v] = true;
+        work.emplace_back(v, 0);
+    };
+    for (size_t root = 0; root < n; root++) {
+        if (order[root] != none) continue;
+        visit(root);
+        while (!work.empty()) {
+            size_t v = work.back().first;
+            if (work.back().second < edges[v].size()) {
+                size_t w = edges[v][work.back().second++];
+                if (order[w] == none) {
+                    visit(w);
+                } else if (onStack[w]) {
+                    low[v] = std::min(low[v], order[w]);
+                }
+                continue;
+            }
+            work.pop_back();
+            if (!work.empty()) {
+                size_t u = work.back().first;
+                low[u] = std::min(low[u], low[v]);
+            }
+            if (low[v] != order[v]) continue;
+            std::vector<size_t> component;
+            size_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onStack[w] = false;
+                component.push_back(w);
+            } while (w != v);
+            if (component.size() > 1) {
+                std::sort(component.begin(), component.end());
+                result.push_back(std::move(component));
+            }
+        }
+    }
+    return result;
+}
+
+// 函数 fun 的第 i 个参数的名字
+std::string paramName(const FunDeclarationNode& fun, size_t i) {
+    auto* param = static_cast<const ParamNode*>(fun.params[i].get());
+    return "l" + std::to_string(param->slot) + "_" + param->identifier;
+}
+
+// 合并的函数中第 member 个成员的第 i 个参数
+std::string groupParamName(size_t member, size_t i) {
+    return "p" + std::to_string(member) + "_" + std::to_string(i);
+}
+
+} // namespace
+
+CEmitter::CEmitter(BufferedWriter& out, const std::string& sourceName)
+    : out(out), currentFun(nullptr), sources(nullptr), indent(0), mappedLine(-1), tempCounter(0), tailCalls(0),
+      boundsChecks(false) {
+    quotedSource = "\"";
+    for (char c : sourceName) {
+        if (c == '"' || c == '\\') quotedSource += '\\';
+        quotedSource += c;
+    }
+    quotedSource += "\"";
+}
+
+// 生成整个程序
+void CEmitter::emit(const ProgramNode& program) {
+    sources = program.sources.get();
+    if (boundsChecks) bounds.analyze(program);
+    findTailGroups(program);
+    emitPrelude();
+
+    // 全局变量
+    for (const auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::VAR_DECLARATION) {
+            auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+            int value = varDecl->initializer ? static_cast<const NumNode*>(varDecl->initializer.get())->value : 0;
+            lineDirective(decl->start);
+            writeLine("static int g_" + varDecl->identifier + " = " + literal(value) + ";");
+        } else if (decl->type == ASTNodeType::ARRAY_DECLARATION) {
+            auto* arrayDecl = static_cast<const ArrayDeclarationNode*>(decl.get());
+            lineDirective(decl->start);
+            writeLine("static int g_" + arrayDecl->identifier + "[" + std::to_string(arrayDecl->arraySize) + "];");
+        }
+    }
+    writeLine("");
+
+    // 函数原型（允许相互递归）
+    for (const auto& decl : program.declarations) {
+        auto* fun = static_cast<const FunDeclarationNode*>(decl.get());
+        if (decl->type == ASTNodeType::FUN_DECLARATION && emitsFunction(*fun)) {
+            writeLine(functionSignature(*fun) + ";");
+        }
+    }
+    writeLine("");
+
+    // 函数组在第一个成员的位置输出
+    for (const auto& decl : program.declarations) {
+        if (decl->type != ASTNodeType::FUN_DECLARATION) continue;
+        auto* fun = static_cast<const FunDeclarationNode*>(decl.get());
+        auto group = tailGroupOf.find(fun);
+        if (group == tailGroupOf.end()) {
+            emitFunction(*fun);
+        } else if (group->second.second == 0) {
+            emitTailGroup(group->second.first);
+        }
+    }
+
+    const FunDeclarationNode* mainFun = nullptr;
+    for (const auto& decl : program.declarations) {
+        auto* fun = static_cast<const FunDeclarationNode*>(decl.get());
+        if (decl->type == ASTNodeType::FUN_DECLARATION && fun->identifier == "main") mainFun = fun;
+    }
+    writeLine("int main(void) {");
+    writeLine("    cm_stack_init();");
+    if (mainFun) writeLine("    " + stackCheck(*mainFun, mainFun->start) + ";");
+    writeLine("    return f_main();");
+    writeLine("}");
+}
+
+void CEmitter::emitPrelude() {
+    out << "/* Generated by cminus_compiler from " << quotedSource << " */\n" << prelude;
+}
+
+// 函数签名：所有函数都返回int（void函数返回0）
+std::string CEmitter::functionSignature(const FunDeclarationNode& fun) const {
+    std::string signature = "static int f_" + fun.identifier + "(";
+    if (fun.params.empty()) {
+        signature += "void";
+    }
+    for (size_t i = 0; i < fun.params.size(); i++) {
+        auto* param = static_cast<const ParamNode*>(fun.params[i].get());
+        if (i > 0) signature += ", ";
+        signature += param->isArray ? "int *l" : "int l";
+        signature += std::to_string(param->slot) + "_" + param->identifier;
+    }
+    return signature + ")";
+}
+
+// 尾调用图中相互递归的函数分组
+void CEmitter::findTailGroups(const ProgramNode& program) {
+    tailGroups.clear();
+    tailGroupOf.clear();
+    std::vector<const FunDeclarationNode*> functions;
+    std::unordered_map<const FunDeclarationNode*, size_t> number;
+    for (const auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::FUN_DECLARATION) {
+            number.emplace(static_cast<const FunDeclarationNode*>(decl.get()), functions.size());
+            functions.push_back(static_cast<const FunDeclarationNode*>(decl.get()));
+        }
+    }
+    std::vector<std::vector<const CallNode*>> tailCallsOf(functions.size());
+    std::vector<std::vector<size_t>> edges(functions.size());
+    for (size_t i = 0; i < functions.size(); i++) {
+        collectTailCalls(functions[i]->body.get(), tailCallsOf[i]);
+        for (const CallNode* call : tailCallsOf[i]) {
+            auto found = number.find(call->callee);
+            if (found != number.end()) edges[i].push_back(found->second);
+        }
+    }
+    for (const std::vector<size_t>& component : cycles(edges)) {
+        std::vector<const FunDeclarationNode*> members;
+        for (size_t i : component) {
+            tailGroupOf[functions[i]] = std::make_pair(tailGroups.size(), members.size());
+            members.push_back(functions[i]);
+        }
+        tailGroups.push_back(std::move(members));
+    }
+
+    // 组内的尾调用都成为跳转，成员原来的函数只在其他调用需要时输出
+    calledMembers.clear();
+    std::unordered_set<const CallNode*> jumps;
+    for (size_t i = 0; i < functions.size(); i++) {
+        auto caller = tailGroupOf.find(functions[i]);
+        if (caller == tailGroupOf.end()) continue;
+        for (const CallNode* call : tailCallsOf[i]) {
+            auto callee = tailGroupOf.find(call->callee);
+            if (callee != tailGroupOf.end() && callee->second.first == caller->second.first) jumps.insert(call);
+        }
+    }
+    std::function<void(const ASTNode&)> collect = [&](const ASTNode& node) {
+        if (node.type == ASTNodeType::CALL) {
+            auto& call = static_cast<const CallNode&>(node);
+            if (call.callee && tailGroupOf.count(call.callee) && !jumps.count(&call)) calledMembers.insert(call.callee);
+        }
+        visitChildren(node, collect);
+    };
+    for (const FunDeclarationNode* fun : functions) {
+        if (fun->identifier == "main") calledMembers.insert(fun);
+        collect(*fun->body);
+    }
+}
+
+// 函数的定义是否输出：不在组内，或组外还有对它的调用
+bool CEmitter::emitsFunction(const FunDeclarationNode& fun) const {
+    return !tailGroupOf.count(&fun) || calledMembers.count(&fun);
+}
+
+// 对自身的尾调用转为跳回函数开头；对组外函数的尾调用保留为调用，
+// 由C编译器做兄弟调用优化
+void CEmitter::emitFunction(const FunDeclarationNode& fun) {
+    currentFun = &fun;
+    tempCounter = 0;
+    lineDirective(fun.start);
+    writeLine(functionSignature(fun) + " {");
+    indent++;
+    std::vector<const CallNode*> calls;
+    collectTailCalls(fun.body.get(), calls);
+    if (std::any_of(calls.begin(), calls.end(), [&](const CallNode* call) { return call->callee == &fun; })) {
+        writeLine("tail_call:;");
+    }
+    emitCompound(*static_cast<const CompoundStmtNode*>(fun.body.get()));
+    writeLine("return 0;");
+    indent--;
+    writeLine("}");
+    writeLine("");
+}
+
+// 相互尾调用的一组函数合并为 tc<组号>(entry, 各成员的参数)：各成员的函数体放在标签
+// m<k> 之后的代码块中，进入时把参数复制为局部变量；组内的尾调用给被调成员的参数赋值后
+// goto 到它的标签，重新进入代码块。原来的函数转调合并的函数，其他成员的参数传0；
+// 只有组内尾调用的成员不输出原来的函数，没有这样的调用时整组都不输出
+void CEmitter::emitTailGroup(size_t group) {
+    const std::vector<const FunDeclarationNode*>& members = tailGroups[group];
+    auto emitted = [&](const FunDeclarationNode* fun) { return emitsFunction(*fun); };
+    if (std::none_of(members.begin(), members.end(), emitted)) return;
+    std::string name = "tc" + std::to_string(group);
+    std::string signature = "static int " + name + "(int entry";
+    for (size_t k = 0; k < members.size(); k++) {
+        for (size_t i = 0; i < members[k]->params.size(); i++) {
+            bool isArray = static_cast<const ParamNode*>(members[k]->params[i].get())->isArray;
+            signature += (isArray ? ", int *" : ", int ") + groupParamName(k, i);
+        }
+    }
+    tempCounter = 0;
+    lineDirective(members[0]->start);
+    writeLine(signature + ") {");
+    indent++;
+    writeLine("switch (entry) {");
+    for (size_t k = 1; k < members.size(); k++) {
+        writeLine("case " + std::to_string(k) + ": goto m" + std::to_string(k) + ";");
+    }
+    writeLine("}");
+    for (size_t k = 0; k < members.size(); k++) {
+        const FunDeclarationNode& fun = *members[k];
+        currentFun = &fun;
+        lineDirective(fun.start);
+        writeLine("m" + std::to_string(k) + ": {");
+        indent++;
+        for (size_t i = 0; i < fun.params.size(); i++) {
+            bool isArray = static_cast<const ParamNode*>(fun.params[i].get())->isArray;
+            writeLine((isArray ? "int *" : "int ") + paramName(fun, i) + " = " + groupParamName(k, i) + ";");
+        }
+        emitCompound(*static_cast<const CompoundStmtNode*>(fun.body.get()));
+        indent--;
+        writeLine("}");
+        writeLine("return 0;");
+    }
+    indent--;
+    writeLine("}");
+    writeLine("");
+
+    for (size_t k = 0; k < members.size(); k++) {
+        if (!emitsFunction(*members[k])) continue;
+        std::string args = std::to_string(k);
+        for (size_t m = 0; m < members.size(); m++) {
+            for (size_t i = 0; i < members[m]->params.size(); i++) {
+                args += ", " + (m == k ? paramName(*members[k], i) : std::string("0"));
+            }
+        }
+        lineDirective(members[k]->start);
+        writeLine(functionSignature(*members[k]) + " {");
+        writeLine("    return " + name + "(" + args + ");");
+        writeLine("}");
+        writeLine("");
+    }
+}
+
+// ===== 语句 =====
+
+// 复合语句的内容：局部变量在进入时初始化
+void CEmitter::emitCompound(const CompoundStmtNode& compoundStmt) {
+    for (const auto& decl : compoundStmt.localDeclarations) {
+        lineDirective(decl->start);
+        if (decl->type == ASTNodeType::ARRAY_DECLARATION) {
+            auto* arrayDecl = static_cast<const ArrayDeclarationNode*>(decl.get());
+            writeLine("int a" + std::to_string(arrayDecl->offset) + "_" + arrayDecl->identifier + "[" +
+                      std::to_string(arrayDecl->arraySize) + "] = {0};");
+            continue;
+        }
+        auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+        std::string init = varDecl->initializer ? expr(varDecl->initializer.get(), false) : "0";
+        declareTemps();
+        writeLine("int l" + std::to_string(varDecl->slot) + "_" + varDecl->identifier + " = " + init + ";");
+    }
+
+    for (const auto& stmt : compoundStmt.statements) {
+        emitStatement(stmt.get());
+    }
+}
+
+void CEmitter::emitStatement(const ASTNode* stmt) {
+    lineDirective(stmt->start);
+
+    switch (stmt->type) {
+        case ASTNodeType::COMPOUND_STMT:
+            writeLine("{");
+            indent++;
+            emitCompound(*static_cast<const CompoundStmtNode*>(stmt));
+            indent--;
+            writeLine("}");
+            break;
+
+        case ASTNodeType::EXPRESSION_STMT: {
+            const ASTNode* expression = static_cast<const ExpressionStmtNode*>(stmt)->expression.get();
+            if (!expression) break;
+            std::string text;
+            if (expression->type == ASTNodeType::ASSIGN_EXPR) {
+                std::string prefix;
+                text = assignment(*static_cast<const AssignExprNode*>(expression), prefix);
+                text = prefix + text;
+            } else {
+                text = expr(expression, false);
+            }
+            declareTemps();
+            writeLine(text + ";");
+            break;
+        }
+
+        case ASTNodeType::SELECTION_STMT: {
+            auto* selectionStmt = static_cast<const SelectionStmtNode*>(stmt);
+            std::string cond = expr(selectionStmt->condition.get(), false);
+            declareTemps();
+            writeLine("if (" + cond + ") {");
+            emitBody(selectionStmt->ifBranch.get());
+            if (selectionStmt->elseBranch) {
+                writeLine("} else {");
+                emitBody(selectionStmt->elseBranch.get());
+            }
+            writeLine("}");
+            break;
+        }
+
+        case ASTNodeType::ITERATION_STMT: {
+            auto* iterationStmt = static_cast<const IterationStmtNode*>(stmt);
+            std::string cond = expr(iterationStmt->condition.get(), false);
+            declareTemps();
+            writeLine("while (" + cond + ") {");
+            emitBody(iterationStmt->body.get());
+            writeLine("}");
+            break;
+        }
+
+        case ASTNodeType::RETURN_STMT: {
+            auto* returnStmt = static_cast<const ReturnStmtNode*>(stmt);
+            if (const CallNode* tailCall = tailCallOf(*returnStmt)) {
+                auto caller = tailGroupOf.find(currentFun);
+                auto callee = tailGroupOf.find(tailCall->callee);
+                if (caller != tailGroupOf.end() && callee != tailGroupOf.end() &&
+                    caller->second.first == callee->second.first) {
+                    size_t member = callee->second.second;
+                    std::vector<std::string> params;
+                    for (size_t i = 0; i < tailCall->callee->params.size(); i++) {
+                        params.push_back(groupParamName(member, i));
+                    }
+                    emitTailJump(*tailCall, params, "m" + std::to_string(member));
+                    break;
+                }
+                if (tailCall->callee == currentFun) {
+                    std::vector<std::string> params;
+                    for (size_t i = 0; i < currentFun->params.size(); i++) {
+                        params.push_back(paramName(*currentFun, i));
+                    }
+                    emitTailJump(*tailCall, params, "tail_call");
+                    break;
+                }
+            }
+            std::string value = returnStmt->expression ? expr(returnStmt->expression.get(), false) : "0";
+            declareTemps();
+            writeLine("return " + value + ";");
+            break;
+        }
+
+        default:
+            throw std::runtime_error("C emitter: unexpected statement at line " + std::to_string(lineOf(stmt->start)));
+    }
+}
+
+// 尾调用转为跳转：实参按顺序求值到临时变量，再赋给 params 并跳到 label
+void CEmitter::emitTailJump(const CallNode& callNode, const std::vector<std::string>& params,
+                            const std::string& label) {
+    std::vector<std::string> values;
+    for (const auto& arg : callNode.args) {
+        if (isArrayName(arg.get())) {
+            values.push_back(expr(arg.get(), false));
+            continue;
+        }
+        std::string value = expr(arg.get(), false);
+        std::string temp = newTemp();
+        declareTemps();
+        writeLine(temp + " = " + value + ";");
+        values.push_back(temp);
+    }
+    for (size_t i = 0; i < callNode.args.size(); i++) {
+        if (values[i] != params[i]) {
+            writeLine(params[i] + " = " + values[i] + ";");
+        }
+    }
+    writeLine("goto " + label + ";");
+    tailCalls++;
+}
+
+// if/while 的分支总是放在花括号中，复合语句直接展开
+void CEmitter::emitBody(const ASTNode* stmt) {
+    indent++;
+    if (stmt->type == ASTNodeType::COMPOUND_STMT) {
+        emitCompound(*static_cast<const CompoundStmtNode*>(stmt));
+    } else {
+        emitStatement(stmt);
+    }
+    indent--;
+}
+
+// ===== 表达式 =====
+
+std::string CEmitter::expr(const ASTNode* node, bool parenthesize) {
+    // 逗号表达式总是加括号，以便用作实参或初始化表达式
+    auto wrap = [parenthesize](const std::string& prefix, const std::string& text) {
+        return parenthesize || !prefix.empty() ? "(" + prefix + text + ")" : text;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::NUM:
+            return literal(static_cast<const NumNode*>(node)->value);
+
+        case ASTNodeType::VAR: {
+            auto* var = static_cast<const VarNode*>(node);
+            if (var->index) {
+                return element(*var, expr(var->index.get(), false));
+            }
+            return varName(*var);
+        }
+
+        case ASTNodeType::ASSIGN_EXPR: {
+            std::string prefix;
+            std::string text = assignment(*static_cast<const AssignExprNode*>(node), prefix);
+            return wrap(prefix, text);
+        }
+
+        case ASTNodeType::BIN_OP: {
+            auto* binOp = static_cast<const BinOpNode*>(node);
+            std::string prefix;
+            std::string left = sequenced(binOp->left.get(), binOp->right.get(), prefix);
+            std::string right = expr(binOp->right.get(), false);
+            std::string text;
+            switch (binOp->op) {
+                case TokenType::PLUS:  text = "CM_ADD(" + left + ", " + right + ")"; break;
+                case TokenType::MINUS: text = "CM_SUB(" + left + ", " + right + ")"; break;
+                case TokenType::TIMES: text = "CM_MUL(" + left + ", " + right + ")"; break;
+                case TokenType::MOD:
+                    text = "cm_mod(" + left + ", " + right + ", " + std::to_string(lineOf(node->start)) + ")";
+                    break;
+                default:
+                    text = "cm_div(" + left + ", " + right + ", " + std::to_string(lineOf(node->start)) + ")";
+                    break;
+            }
+            return prefix.empty() ? text : "(" + prefix + text + ")";
+        }
+
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto* simpleExpr = static_cast<const SimpleExprNode*>(node);
+            std::string prefix;
+            std::string left = sequenced(simpleExpr->left.get(), simpleExpr->right.get(), prefix);
+            std::string right = expr(simpleExpr->right.get());
+            return wrap(prefix, left + relopText(simpleExpr->relop) + right);
+        }
+
+        case ASTNodeType::CALL:
+            return call(*static_cast<const CallNode*>(node));
+
+        default:
+            throw std::runtime_error("C emitter: unexpected expression at line " + std::to_string(lineOf(node->start)));
+    }
+}
+
+// 赋值：数组下标在右值之前求值（需要时把下标存入临时变量，加入 prefix）
+std::string CEmitter::assignment(const AssignExprNode& assignExpr, std::string& prefix) {
+    auto* var = static_cast<const VarNode*>(assignExpr.var.get());
+    const ASTNode* value = assignExpr.expression.get();
+    if (!var->index) {
+        return varName(*var) + " = " + expr(value, false);
+    }
+    if (boundsChecks && bounds.needsCheck(*var) && !isOperand(value)) {
+        // 依次求下标和右值，最后检查下标
+        std::string index = expr(var->index.get(), false);
+        if (var->index->type != ASTNodeType::NUM) {
+            std::string temp = newTemp();
+            prefix += temp + " = " + index + ", ";
+            index = temp;
+        }
+        std::string temp = newTemp();
+        prefix += temp + " = " + expr(value, false) + ", ";
+        return element(*var, index) + " = " + temp;
+    }
+    std::string index = sequenced(var->index.get(), value, prefix);
+    return element(*var, index) + " = " + expr(value, false);
+}
+
+// 数组元素；需要检查时下标经过 cm_index
+std::string CEmitter::element(const VarNode& var, const std::string& index) const {
+    if (boundsChecks && bounds.needsCheck(var)) {
+        return varName(var) + "[cm_index(" + index + ", " + std::to_string(var.arraySize) + ", " +
+               std::to_string(lineOf(var.start)) + ")]";
+    }
+    return varName(var) + "[" + index + "]";
+}
+
+// C 不规定操作数的求值顺序。若 first 与 later 之间可能相互影响，
+// 先把 first 的值存入临时变量（用逗号表达式排在前面）
+std::string CEmitter::sequenced(const ASTNode* first, const ASTNode* later, std::string& prefix) {
+    bool independent = first->type == ASTNodeType::NUM || later->type == ASTNodeType::NUM ||
+                       (isPureExpression(first) && isPureExpression(later));
+    if (independent) {
+        return expr(first);
+    }
+    std::string temp = newTemp();
+    prefix += temp + " = " + expr(first, false) + ", ";
+    return temp;
+}
+
+std::string CEmitter::call(const CallNode& callNode) {
+    if (callNode.builtin == BuiltinKind::INPUT) {
+        return "cm_input()";
+    }
+    if (callNode.builtin == BuiltinKind::OUTPUT) {
+        return "cm_output(" + expr(callNode.args[0].get(), false) + ")";
+    }
+
+    // 有副作用的实参及其之前的实参按顺序先存入临时变量，其后的实参都无副作用
+    int lastImpure = -1;
+    for (size_t i = 0; i < callNode.args.size(); i++) {
+        if (!isPureExpression(callNode.args[i].get())) lastImpure = static_cast<int>(i);
+    }
+    bool ordered = lastImpure >= 0 && callNode.args.size() > 1;
+
+    std::string prefix;
+    std::string args;
+    for (size_t i = 0; i < callNode.args.size(); i++) {
+        const ASTNode* arg = callNode.args[i].get();
+        if (i > 0) args += ", ";
+        if (ordered && static_cast<int>(i) <= lastImpure && arg->type != ASTNodeType::NUM && !isArrayName(arg)) {
+            std::string temp = newTemp();
+            prefix += temp + " = " + expr(arg, false) + ", ";
+            args += temp;
+        } else {
+            args += expr(arg, false);
+        }
+    }
+
+    std::string text = "f_" + callNode.identifier + "(" + args + ")";
+    if (!callNode.callee) return prefix.empty() ? text : "(" + prefix + text + ")";
+    return "(" + stackCheck(*callNode.callee, callNode.start) + ", " + prefix + text + ")";
+}
+
+// 调用之前检查栈上还能容纳被调函数的栈帧（合并的函数包含组内所有成员的局部变量），
+// 与解释器一样在求实参之前、按调用的位置报错
+std::string CEmitter::stackCheck(const FunDeclarationNode& callee, SourceOffset start) const {
+    std::vector<const FunDeclarationNode*> frame{&callee};
+    auto group = tailGroupOf.find(&callee);
+    if (group != tailGroupOf.end()) frame = tailGroups[group->second.first];
+    uint64_t bytes = 0;
+    for (const FunDeclarationNode* fun : frame) {
+        bytes += 8 * uint64_t(fun->numSlots) + 4 * uint64_t(fun->arrayWords);
+    }
+    return "cm_stack(" + std::to_string(bytes) + "u, \"" + callee.identifier + "\", " +
+           std::to_string(lineOf(start)) + ")";
+}
+
+std::string CEmitter::varName(const VarNode& var) const {
+    switch (var.kind) {
+        case VarKind::GLOBAL_SCALAR:
+        case VarKind::GLOBAL_ARRAY:
+            return "g_" + var.identifier;
+        case VarKind::LOCAL_ARRAY:
+            return "a" + std::to_string(var.slot) + "_" + var.identifier;
+        default:
+            return "l" + std::to_string(var.slot) + "_" + var.identifier;
+    }
+}
+
+// ===== 临时变量与输出 =====
+
+std::string CEmitter::newTemp() {
+    std::string name = "t" + std::to_string(++tempCounter);
+    pendingTemps.push_back(name);
+    return name;
+}
+
+// 在使用临时变量的语句之前声明它们
+void CEmitter::declareTemps() {
+    if (pendingTemps.empty()) return;
+    std::string text = "int ";
+    for (size_t i = 0; i < pendingTemps.size(); i++) {
+        if (i > 0) text += ", ";
+        text += pendingTemps[i];
+    }
+    pendingTemps.clear();
+    writeLine(text + ";");
+}
+
+// 当前输出位置与源代码行号不一致时输出 #line
+void CEmitter::lineDirective(SourceOffset start) {
+    int line = lineOf(start);
+    if (line == 0 || line == mappedLine) return;
+    out << "#line " << line << ' ' << quotedSource << '\n';
+    mappedLine = line;
+}
+
+void CEmitter::writeLine(const std::string& text) {
+    if (!text.empty()) {
+        for (int i = 0; i < indent; i++) out << "    ";
+        out << text;
+    }
+    out << '\n';
+    if (mappedLine >= 0) mappedLine++;
+}
@@ -0,0 +1,140 @@
+// 编译服务的客户端：参数与 cminus_compiler 相同
+//
+// 把命令行转发给编译服务并原样输出结果，退出码与直接运行编译器一致。
+// 服务未运行或请求需要执行用户程序时，直接在本地执行 cminus_compiler
+// （环境变量 CMINUS_COMPILER，默认与客户端位于同一目录）。
+
+#include "protocol.h"
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using protocol::FrameType;
+
+namespace {
+
+bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+int connectServer() {
+    std::string path = protocol::defaultSocketPath();
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return -1;
+    std::strcpy(address.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 在本地执行编译器；已经读走的标准输入通过临时文件交给它
+[[noreturn]] void runLocally(char* argv[], const std::string* consumedInput) {
+    std::string compiler;
+    if (const char* path = std::getenv("CMINUS_COMPILER")) compiler = path;
+    if (compiler.empty()) {
+        char self[PATH_MAX];
+        ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+        if (n > 0) {
+            self[n] = '\0';
+            compiler = self;
+            compiler = compiler.substr(0, compiler.rfind('/') + 1);
+        }
+        compiler += "cminus_compiler";
+    }
+    if (consumedInput) {
+        std::FILE* input = std::tmpfile();
+        if (!input || std::fwrite(consumedInput->data(), 1, consumedInput->size(), input) != consumedInput->size() ||
+            std::fflush(input) != 0 || lseek(fileno(input), 0, SEEK_SET) != 0 || dup2(fileno(input), 0) < 0) {
+            std::fprintf(stderr, "cminus_client: cannot forward standard input\n");
+            std::exit(1);
+        }
+    }
+    argv[0] = const_cast<char*>(compiler.c_str());
+    execv(argv[0], argv);
+    std::fprintf(stderr, "cminus_client: cannot run %s: %s\n", compiler.c_str(), std::strerror(errno));
+    std::exit(127);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int fd = connectServer();
+    if (fd < 0) {
+        runLocally(argv, nullptr);
+    }
+
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) {
+        std::perror("cminus_client: getcwd");
+        return 1;
+    }
+    std::vector<std::string> request;
+    request.push_back(cwd);
+    bool readsStdin = false;
+    for (int i = 1; i < argc; i++) {
+        request.push_back(argv[i]);
+        if (std::strcmp(argv[i], "-") == 0) readsStdin = true;
+    }
+
+    std::string payload;
+    protocol::encodeStrings(request, payload);
+    bool sent = protocol::writeFrame(fd, FrameType::REQUEST, payload.data(), payload.size());
+    std::string input;
+    if (sent && readsStdin) {
+        char buffer[1 << 16];
+        ssize_t n;
+        while ((n = read(0, buffer, sizeof(buffer))) > 0) input.append(buffer, static_cast<size_t>(n));
+        sent = protocol::writeFrame(fd, FrameType::SOURCE, input.data(), input.size());
+    }
+    sent = sent && protocol::writeFrame(fd, FrameType::END, nullptr, 0);
+    if (!sent) {
+        std::fprintf(stderr, "cminus_client: lost connection to the compile server\n");
+        return 1;
+    }
+
+    FrameType type;
+    while (protocol::readFrame(fd, type, payload)) {
+        switch (type) {
+            case FrameType::STDOUT:
+                writeAll(1, payload);
+                break;
+            case FrameType::STDERR:
+                writeAll(2, payload);
+                break;
+            case FrameType::EXIT: {
+                if (payload.size() != 4) return 1;
+                uint32_t code = 0;
+                for (int i = 0; i < 4; i++) code |= uint32_t(static_cast<unsigned char>(payload[i])) << (8 * i);
+                return static_cast<int>(static_cast<int32_t>(code));
+            }
+            case FrameType::FALLBACK:
+                close(fd);
+                runLocally(argv, readsStdin ? &input : nullptr);
+            default:
+                break;
+        }
+    }
+    std::fprintf(stderr, "cminus_client: lost connection to the compile server\n");
+    return 1;
+}
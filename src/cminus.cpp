@@ -0,0 +1,172 @@
+#include "cminus.h"
+#include "diagnostic.h"
+#include "parser.h"
+#include "stats.h"
+#include <exception>
+
+namespace cminus {
+
+namespace {
+
+void addDiagnostic(std::vector<Diagnostic>& diagnostics, Stage stage, const std::exception& e) {
+    const CompileError* error = dynamic_cast<const CompileError*>(&e);
+    diagnostics.push_back(Diagnostic{stage, error ? error->line : 0, error ? error->column : 0, e.what()});
+}
+
+// 优化提示："Remark: <message> at line N"
+Diagnostic remarkAt(const SourceManager& sources, SourceOffset start, const std::string& message) {
+    SourceLocation location = sources.location(start);
+    return Diagnostic{Stage::OPTIMIZE, location.line, location.column,
+                      "Remark: " + message + " at line " + std::to_string(location.line)};
+}
+
+} // namespace
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::LEX: return "lex";
+        case Stage::PARSE: return "parse";
+        case Stage::SEMANTIC: return "semantic";
+        case Stage::OPTIMIZE: return "optimize";
+    }
+    return "unknown";
+}
+
+CompilerContext::CompilerContext() : sources(std::make_shared<SourceManager>()) {}
+
+// 词法分析到 tokens，出错时清空 tokens
+bool CompilerContext::lex(std::string_view source, std::vector<Diagnostic>& diagnostics) {
+    stats::PhaseTimer timer("lex");
+    try {
+        Lexer lexer(source);
+        sources = lexer.sourceManager();
+        lexer.tokenize(tokens);
+        return true;
+    } catch (const std::exception& e) {
+        tokens.clear();
+        addDiagnostic(diagnostics, Stage::LEX, e);
+        return false;
+    }
+}
+
+const std::vector<Token>& CompilerContext::tokenize(std::string_view source, std::vector<Diagnostic>& diagnostics) {
+    lex(source, diagnostics);
+    return tokens;
+}
+
+CompileResult CompilerContext::compile(std::string_view source, const CompileOptions& options) {
+    CompileResult result;
+    if (!lex(source, result.diagnostics)) {
+        return result;
+    }
+    stats::addCounter("tokens", tokens.size() - 1);
+
+    std::unique_ptr<ProgramNode> program;
+    {
+        stats::PhaseTimer timer("parse");
+        Parser parser(std::move(tokens), sources);
+        parser.setMaxNestingDepth(options.maxNestingDepth);
+        parser.setHashConsing(options.hashConsing);
+        try {
+            program = parser.parse();
+        } catch (const std::exception& e) {
+            addDiagnostic(result.diagnostics, Stage::PARSE, e);
+        }
+        if (options.hashConsing) stats::addCounter("ast.shared", parser.sharedNodes());
+        tokens = parser.releaseTokens();
+    }
+    if (!program) {
+        return result;
+    }
+    stats::countAstNodes(*program);
+
+    if (options.analyze) {
+        stats::PhaseTimer timer("semantic");
+        try {
+            analyzer.analyze(*program);
+        } catch (const std::exception& e) {
+            addDiagnostic(result.diagnostics, Stage::SEMANTIC, e);
+            return result;
+        }
+    }
+    if (options.analyze && options.profile) {
+        std::vector<const FunDeclarationNode*> stale;
+        stats::addCounter("profile.functions", options.profile->annotate(*program, &stale));
+        for (const FunDeclarationNode* fun : stale) {
+            if (!options.remarks) break;
+            SourceLocation location = sources->location(fun->start);
+            result.remarks.push_back(Diagnostic{Stage::OPTIMIZE, location.line, location.column,
+                                                "Remark: profile of '" + fun->identifier +
+                                                    "' is out of date and was ignored at line " +
+                                                    std::to_string(location.line)});
+        }
+    }
+    if (options.analyze && options.interprocedural) {
+        stats::PhaseTimer timer("ipo");
+        InterproceduralOptimizer optimizer(options.remarks);
+        optimizer.run(*program);
+        const InterproceduralStats& ipo = optimizer.stats();
+        stats::addCounter("ipo.functions.removed", ipo.removedFunctions);
+        stats::addCounter("ipo.globals.removed", ipo.removedGlobals);
+        stats::addCounter("ipo.params.constant", ipo.constantParams);
+        stats::addCounter("ipo.globals.constant", ipo.constantGlobals);
+        stats::addCounter("ipo.calls.folded", ipo.foldedCalls);
+        stats::addCounter("ipo.calls.evaluated", ipo.evaluatedCalls);
+        stats::addCounter("ipo.calls.removed", ipo.removedCalls);
+        stats::addCounter("ipo.branches.folded", ipo.foldedBranches);
+        for (const InterproceduralRemark& remark : optimizer.remarks()) {
+            result.remarks.push_back(remarkAt(*sources, remark.start, remark.message));
+        }
+    }
+    if (options.analyze && options.inlineBudget > 0) {
+        stats::PhaseTimer timer("inline");
+        InlineOptions inlineOptions;
+        inlineOptions.budget = options.inlineBudget;
+        inlineOptions.remarks = options.remarks;
+        Inliner inliner(inlineOptions);
+        inliner.run(*program);
+        stats::addCounter("inline.calls", inliner.inlinedCalls());
+        for (const InlineRemark& remark : inliner.remarks()) {
+            result.remarks.push_back(remarkAt(*sources, remark.start, remark.message));
+        }
+    }
+    result.program = std::move(program);
+    return result;
+}
+
+bool CompilerContext::compileStream(std::istream& input, const std::function<void(ASTNode&)>& consumer,
+                                    std::vector<Diagnostic>& diagnostics, const CompileOptions& options) {
+    stats::PhaseTimer timer("stream");
+    Lexer lexer(input);
+    std::unique_ptr<Parser> parser;
+    uint64_t declarations = 0;
+    while (true) {
+        std::unique_ptr<ASTNode> decl;
+        Stage stage = Stage::PARSE;
+        try {
+            if (!parser) {
+                parser.reset(new Parser(lexer));
+                parser->setMaxNestingDepth(options.maxNestingDepth);
+                parser->setHashConsing(options.hashConsing);
+                if (options.analyze) analyzer.beginStream(*lexer.sourceManager());
+            }
+            decl = parser->parseNextDeclaration();
+            stage = Stage::SEMANTIC;
+            if (!decl) {
+                if (options.analyze) analyzer.finishStream(0);
+                break;
+            }
+            if (options.analyze) analyzer.analyzeDeclaration(*decl);
+        } catch (const std::exception& e) {
+            addDiagnostic(diagnostics, stage, e);
+            return false;
+        }
+        declarations++;
+        consumer(*decl);
+    }
+    stats::addCounter("declarations", declarations);
+    if (options.hashConsing && parser) stats::addCounter("ast.shared", parser->sharedNodes());
+    return true;
+}
+
+} // namespace cminus
@@ -0,0 +1,1449 @@
+#include "codegen.h"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+using namespace x86;
+
+namespace {
+
+// System V 整数参数寄存器
+const Reg argRegs[6] = {RDI, RSI, RDX, RCX, R8, R9};
+
+// 可分配给局部变量的被调用者保存寄存器
+const Reg calleeSaved[5] = {RBX, R12, R13, R14, R15};
+
+int32_t alignTo16(int32_t value) {
+    return (value + 15) & ~15;
+}
+
+// 栈帧大小的上限，数组区的偏移要能用32位位移表示
+const int64_t maxFrameBytes = (int64_t(1) << 31) - 4096;
+
+// 关系运算符对应的条件码
+Cond relopCond(TokenType op) {
+    switch (op) {
+        case TokenType::LT: return Cond::L;
+        case TokenType::LE: return Cond::LE;
+        case TokenType::GT: return Cond::G;
+        case TokenType::GE: return Cond::GE;
+        case TokenType::EQ: return Cond::E;
+        case TokenType::NE: return Cond::NE;
+        default:
+            throw std::runtime_error("Codegen: invalid relational operator");
+    }
+}
+
+// 32位环绕语义的常量运算；除零等运行时错误不折叠
+bool foldBinary(TokenType op, int32_t left, int32_t right, int32_t& result) {
+    uint32_t l = static_cast<uint32_t>(left);
+    uint32_t r = static_cast<uint32_t>(right);
+    switch (op) {
+        case TokenType::PLUS:   result = static_cast<int32_t>(l + r); return true;
+        case TokenType::MINUS:  result = static_cast<int32_t>(l - r); return true;
+        case TokenType::TIMES:  result = static_cast<int32_t>(l * r); return true;
+        case TokenType::DIVIDE:
+            if (right == 0 || (left == INT32_MIN && right == -1)) return false;
+            result = left / right;
+            return true;
+        case TokenType::MOD:
+            if (right == 0) return false;
+            result = right == -1 ? 0 : left % right;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool foldCompare(TokenType op, int32_t left, int32_t right) {
+    switch (op) {
+        case TokenType::LT: return left < right;
+        case TokenType::LE: return left <= right;
+        case TokenType::GT: return left > right;
+        case TokenType::GE: return left >= right;
+        case TokenType::EQ: return left == right;
+        default:            return left != right;
+    }
+}
+
+bool isArrayKind(VarKind kind) {
+    return kind == VarKind::LOCAL_ARRAY || kind == VarKind::GLOBAL_ARRAY || kind == VarKind::PARAM_ARRAY;
+}
+
+// 统计槽位的使用次数，循环内的使用权重更高
+void countSlotUses(const ASTNode* node, int weight, std::vector<int>& counts) {
+    if (!node) return;
+    switch (node->type) {
+        case ASTNodeType::COMPOUND_STMT: {
+            auto* compoundStmt = static_cast<const CompoundStmtNode*>(node);
+            for (const auto& decl : compoundStmt->localDeclarations) {
+                auto* varDecl = decl->type == ASTNodeType::VAR_DECLARATION
+                                    ? static_cast<const VarDeclarationNode*>(decl.get()) : nullptr;
+                if (varDecl) {
+                    counts[varDecl->slot] += weight;
+                    countSlotUses(varDecl->initializer.get(), weight, counts);
+                }
+            }
+            for (const auto& stmt : compoundStmt->statements) {
+                countSlotUses(stmt.get(), weight, counts);
+            }
+            break;
+        }
+        case ASTNodeType::EXPRESSION_STMT:
+            countSlotUses(static_cast<const ExpressionStmtNode*>(node)->expression.get(), weight, counts);
+            break;
+        case ASTNodeType::SELECTION_STMT: {
+            auto* selectionStmt = static_cast<const SelectionStmtNode*>(node);
+            countSlotUses(selectionStmt->condition.get(), weight, counts);
+            countSlotUses(selectionStmt->ifBranch.get(), weight, counts);
+            countSlotUses(selectionStmt->elseBranch.get(), weight, counts);
+            break;
+        }
+        case ASTNodeType::ITERATION_STMT: {
+            auto* iterationStmt = static_cast<const IterationStmtNode*>(node);
+            int loopWeight = std::min(weight * 10, 100000);
+            countSlotUses(iterationStmt->condition.get(), loopWeight, counts);
+            countSlotUses(iterationStmt->body.get(), loopWeight, counts);
+            break;
+        }
+        case ASTNodeType::RETURN_STMT:
+            countSlotUses(static_cast<const ReturnStmtNode*>(node)->expression.get(), weight, counts);
+            break;
+        case ASTNodeType::ASSIGN_EXPR: {
+            auto* assignExpr = static_cast<const AssignExprNode*>(node);
+            countSlotUses(assignExpr->var.get(), weight, counts);
+            countSlotUses(assignExpr->expression.get(), weight, counts);
+            break;
+        }
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto* simpleExpr = static_cast<const SimpleExprNode*>(node);
+            countSlotUses(simpleExpr->left.get(), weight, counts);
+            countSlotUses(simpleExpr->right.get(), weight, counts);
+            break;
+        }
+        case ASTNodeType::BIN_OP: {
+            auto* binOp = static_cast<const BinOpNode*>(node);
+            countSlotUses(binOp->left.get(), weight, counts);
+            countSlotUses(binOp->right.get(), weight, counts);
+            break;
+        }
+        case ASTNodeType::VAR: {
+            auto* var = static_cast<const VarNode*>(node);
+            if (var->kind == VarKind::LOCAL_SCALAR || var->kind == VarKind::PARAM_ARRAY) {
+                counts[var->slot] += weight;
+            }
+            countSlotUses(var->index.get(), weight, counts);
+            break;
+        }
+        case ASTNodeType::CALL:
+            for (const auto& arg : static_cast<const CallNode*>(node)->args) {
+                countSlotUses(arg.get(), weight, counts);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+} // namespace
+
+// 构造函数
+CodeGenerator::CodeGenerator(const CodegenOptions& options)
+    : options(options), inputSymbol(-1), outputSymbol(-1), boundsErrorSymbol(-1), divisionErrorSymbol(-1),
+      stackLimitFunction(-1), stackOverflowSymbol(-1), stackLimitSymbol(-1),
+      sources(nullptr), counterSymbol(-1), current(nullptr), currentFun(nullptr),
+      slotBase(0), arrayBase(0), returnLabel(-1), entryLabel(-1), depth(0), tailCalls(0),
+      vectorizedLoops(0), unrolledLoops(0), copying(false) {}
+
+// 生成整个程序
+Module CodeGenerator::generate(const ProgramNode& program) {
+    module = Module();
+    divisionErrorSymbol = -1;
+    tailCalls = 0;
+    vectorizedLoops = 0;
+    unrolledLoops = 0;
+    remarkList.clear();
+    counterList.clear();
+    peephole = PeepholeStats();
+    functionSymbols.clear();
+    globalArraySymbols.clear();
+
+    declareGlobals(program);
+
+    for (const auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::FUN_DECLARATION) {
+            auto* fun = static_cast<const FunDeclarationNode*>(decl.get());
+            functionSymbols[fun] = module.addSymbol(fun->identifier, Section::TEXT, 0, 0, true);
+        }
+    }
+    inputSymbol = module.addSymbol("cminus_input", Section::UNDEF, 0, 0, true);
+    outputSymbol = module.addSymbol("cminus_output", Section::UNDEF, 0, 0, true);
+    stackLimitFunction = module.addSymbol("cminus_stack_limit", Section::UNDEF, 0, 0, true);
+    stackOverflowSymbol = module.addSymbol("cminus_stack_overflow", Section::UNDEF, 0, 0, true);
+    module.bssSize = (module.bssSize + 7) & ~7ull;
+    stackLimitSymbol = module.addSymbol("stack.limit", Section::BSS, module.bssSize, 8, false);
+    module.bssSize += 8;
+    sources = program.sources.get();
+    if (options.boundsChecks) {
+        boundsErrorSymbol = module.addSymbol("cminus_bounds_error", Section::UNDEF, 0, 0, true);
+        bounds.analyze(program);
+    }
+
+    for (const auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::FUN_DECLARATION) {
+            generateFunction(*static_cast<const FunDeclarationNode*>(decl.get()));
+        }
+    }
+
+    return std::move(module);
+}
+
+// 为全局变量分配数据段/BSS段空间：标量8字节，数组按16字节对齐
+void CodeGenerator::declareGlobals(const ProgramNode& program) {
+    globalSlotSymbols.assign(program.numGlobalSlots, -1);
+
+    for (const auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::VAR_DECLARATION) {
+            auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+            int sym;
+            if (varDecl->initializer) {
+                uint64_t offset = module.data.size();
+                uint32_t value = static_cast<uint32_t>(static_cast<const NumNode*>(varDecl->initializer.get())->value);
+                for (int i = 0; i < 8; i++) {
+                    module.data.push_back(i < 4 ? static_cast<uint8_t>(value >> (8 * i)) : 0);
+                }
+                sym = module.addSymbol(varDecl->identifier, Section::DATA, offset, 8, false);
+            } else {
+                module.bssSize = (module.bssSize + 7) & ~7ull;
+                sym = module.addSymbol(varDecl->identifier, Section::BSS, module.bssSize, 8, false);
+                module.bssSize += 8;
+            }
+            globalSlotSymbols[varDecl->slot] = sym;
+        } else if (decl->type == ASTNodeType::ARRAY_DECLARATION) {
+            auto* arrayDecl = static_cast<const ArrayDeclarationNode*>(decl.get());
+            uint64_t size = 4ull * arrayDecl->arraySize;
+            module.bssSize = (module.bssSize + 15) & ~15ull;
+            globalArraySymbols[arrayDecl->offset] =
+                module.addSymbol(arrayDecl->identifier, Section::BSS, module.bssSize, size, false);
+            module.bssSize += size;
+        }
+    }
+}
+
+// 选择使用最频繁的槽位放入被调用者保存寄存器
+void CodeGenerator::allocateRegisters(const FunDeclarationNode& fun) {
+    std::vector<int> counts(fun.numSlots, 0);
+    for (const auto& param : fun.params) {
+        counts[static_cast<const ParamNode*>(param.get())->slot] += 1;
+    }
+    countSlotUses(fun.body.get(), 1, counts);
+
+    std::vector<int> order;
+    for (int slot = 0; slot < fun.numSlots; slot++) {
+        if (counts[slot] > 1) order.push_back(slot);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return counts[a] > counts[b]; });
+
+    for (size_t i = 0; i < order.size() && i < 5; i++) {
+        slotRegs[order[i]] = calleeSaved[i];
+        savedRegs.push_back(calleeSaved[i]);
+    }
+}
+
+// 生成函数
+//
+// 栈帧布局（相对rbp向下）：被调用者保存寄存器、8字节槽位、局部数组区
+void CodeGenerator::generateFunction(const FunDeclarationNode& fun) {
+    module.functions.emplace_back();
+    current = &module.functions.back();
+    current->name = fun.identifier;
+    current->symbol = functionSymbols[&fun];
+    currentFun = &fun;
+
+    slotRegs.assign(fun.numSlots, NOREG);
+    savedRegs.clear();
+    if (options.optLevel >= 1) {
+        allocateRegisters(fun);
+    }
+
+    int64_t frameBytes = 8 * int64_t(savedRegs.size()) + 8 * int64_t(fun.numSlots) + 4 * int64_t(fun.arrayWords);
+    if (frameBytes > maxFrameBytes) {
+        throw std::runtime_error("Codegen: stack frame of '" + fun.identifier + "' is too large");
+    }
+    slotBase = static_cast<int32_t>(8 * savedRegs.size());
+    arrayBase = alignTo16(static_cast<int32_t>(frameBytes));
+    int32_t frameSize = arrayBase;
+    returnLabel = current->newLabel();
+    entryLabel = current->newLabel();
+    int overflowLabel = current->newLabel();
+    depth = 0;
+
+    // 序言。main 先取得当前线程的栈底（留有运行库函数所需的余量），每个函数在分配栈帧之前
+    // 检查新的 rsp 不低于它；栈底为0（取不到）时不检查
+    emit(Op::PUSH, 8, Operand::r(RBP));
+    emit(Op::MOV, 8, Operand::r(RBP), Operand::r(RSP));
+    if (fun.identifier == "main") {
+        emit(Op::CALL, 8, Operand::symbol(stackLimitFunction));
+        emit(Op::MOV, 8, Operand::rip(stackLimitSymbol), Operand::r(RAX));
+    }
+    emit(Op::LEA, 8, Operand::r(RAX), Operand::mem(RSP, -frameSize));
+    emit(Op::CMP, 8, Operand::r(RAX), Operand::rip(stackLimitSymbol));
+    emitJcc(Cond::B, overflowLabel);
+    if (frameSize > 0) {
+        emit(Op::SUB, 8, Operand::r(RSP), Operand::immediate(frameSize));
+    }
+    for (size_t i = 0; i < savedRegs.size(); i++) {
+        emit(Op::MOV, 8, frameOperand(-8 * static_cast<int32_t>(i + 1)), Operand::r(savedRegs[i]));
+    }
+
+    // 每个函数的计数器接在全局变量之后
+    if (options.instrument) {
+        counterLayout = layoutCounters(fun);
+        uint64_t size = 8ull * counterLayout.size;
+        module.bssSize = (module.bssSize + 7) & ~7ull;
+        counterSymbol = module.addSymbol("profile." + fun.identifier, Section::BSS, module.bssSize, size, false);
+        module.bssSize += size;
+        counterList.push_back(ProfileCounters{fun.identifier, structuralHash(fun), counterSymbol, counterLayout.size});
+    }
+
+    // 参数从寄存器或调用者栈帧搬入槽位（自身尾调用也从这里开始，计入调用次数）
+    emitLabel(entryLabel);
+    if (options.instrument) genCount(fun);
+    for (size_t i = 0; i < fun.params.size(); i++) {
+        auto* param = static_cast<const ParamNode*>(fun.params[i].get());
+        uint8_t size = param->isArray ? 8 : 4;
+        Operand dst = slotOperand(param->slot);
+        if (i < 6) {
+            emit(Op::MOV, size, dst, Operand::r(argRegs[i]));
+        } else {
+            emit(Op::MOV, 8, Operand::r(RAX), frameOperand(16 + 8 * static_cast<int32_t>(i - 6)));
+            emit(Op::MOV, size, dst, Operand::r(RAX));
+        }
+    }
+
+    if (options.boundsChecks) {
+        for (const BoundsReport& report : bounds.reports()) {
+            if (report.function == &fun && report.accesses > 0) {
+                remark(fun, std::to_string(report.checks) + " of " + std::to_string(report.accesses) +
+                                " bounds checks remain in '" + fun.identifier + "'");
+            }
+        }
+    }
+
+    genCompoundStmt(*static_cast<const CompoundStmtNode*>(fun.body.get()));
+
+    // 执行到函数末尾时返回0
+    emit(Op::MOV, 4, Operand::r(RAX), Operand::immediate(0));
+
+    // 尾声
+    emitLabel(returnLabel);
+    for (size_t i = 0; i < savedRegs.size(); i++) {
+        emit(Op::MOV, 8, Operand::r(savedRegs[i]), frameOperand(-8 * static_cast<int32_t>(i + 1)));
+    }
+    emit(Op::LEAVE, 8);
+    emit(Op::RET, 8);
+    genColdBlocks();
+    genRuntimeFailures();
+
+    // 栈溢出时 rsp 等于 rbp，已对齐
+    uint64_t nameOffset = module.data.size();
+    module.data.insert(module.data.end(), fun.identifier.begin(), fun.identifier.end());
+    module.data.push_back(0);
+    int nameSymbol = module.addSymbol("name." + fun.identifier, Section::DATA, nameOffset,
+                                      fun.identifier.size() + 1, false);
+    emitLabel(overflowLabel);
+    emit(Op::LEA, 8, Operand::r(RDI), Operand::rip(nameSymbol));
+    emit(Op::MOV, 4, Operand::r(RSI), Operand::immediate(sources ? sources->line(fun.start) : 0));
+    emit(Op::CALL, 8, Operand::symbol(stackOverflowSymbol));
+
+    if (options.optLevel >= 1) {
+        optimizePeephole(*current, peephole);
+        scheduleInstructions(*current, peephole);
+    }
+
+    current = nullptr;
+    currentFun = nullptr;
+}
+
+// ===== 语句 =====
+
+void CodeGenerator::genStatement(const ASTNode* stmt, const ASTNode* previous) {
+    if (stmt->type != ASTNodeType::COMPOUND_STMT) emitLine(*stmt);
+    switch (stmt->type) {
+        case ASTNodeType::COMPOUND_STMT:
+            genCompoundStmt(*static_cast<const CompoundStmtNode*>(stmt));
+            break;
+
+        case ASTNodeType::EXPRESSION_STMT: {
+            auto* exprStmt = static_cast<const ExpressionStmtNode*>(stmt);
+            if (exprStmt->expression) {
+                genExpr(exprStmt->expression.get());
+            }
+            break;
+        }
+
+        case ASTNodeType::SELECTION_STMT:
+            genSelectionStmt(*static_cast<const SelectionStmtNode*>(stmt));
+            break;
+
+        case ASTNodeType::ITERATION_STMT:
+            genIterationStmt(*static_cast<const IterationStmtNode*>(stmt), previous);
+            break;
+
+        case ASTNodeType::RETURN_STMT: {
+            auto* returnStmt = static_cast<const ReturnStmtNode*>(stmt);
+            const ASTNode* expression = returnStmt->expression.get();
+            if (expression && expression->type == ASTNodeType::CALL &&
+                static_cast<const CallNode*>(expression)->tailCall &&
+                genTailCall(*static_cast<const CallNode*>(expression))) {
+                break;
+            }
+            if (expression) {
+                genExpr(expression);
+            }
+            emit(Op::JMP, 4, Operand::label(returnLabel));
+            break;
+        }
+
+        default:
+            throw std::runtime_error("Codegen: unexpected statement at offset " + std::to_string(stmt->start));
+    }
+}
+
+// 进入复合语句时初始化其局部变量
+void CodeGenerator::genCompoundStmt(const CompoundStmtNode& compoundStmt) {
+    for (const auto& decl : compoundStmt.localDeclarations) {
+        if (decl->type == ASTNodeType::ARRAY_DECLARATION) {
+            auto* arrayDecl = static_cast<const ArrayDeclarationNode*>(decl.get());
+            genZeroArray(arrayDecl->offset, arrayDecl->arraySize);
+            continue;
+        }
+        auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+        if (varDecl->initializer) {
+            genExpr(varDecl->initializer.get());
+            emit(Op::MOV, 4, slotOperand(varDecl->slot), Operand::r(RAX));
+        } else {
+            emit(Op::MOV, 4, slotOperand(varDecl->slot), Operand::immediate(0));
+        }
+    }
+
+    const ASTNode* previous = nullptr;
+    for (const auto& stmt : compoundStmt.statements) {
+        genStatement(stmt.get(), previous);
+        previous = stmt.get();
+    }
+}
+
+void CodeGenerator::genSelectionStmt(const SelectionStmtNode& selectionStmt) {
+    if (options.instrument) genCount(selectionStmt);
+
+    // 按剖析数据布局：顺序执行的一侧放更常执行的分支
+    const ExecutionCounts& counts = selectionStmt.counts;
+    if (options.optLevel >= 1 && counts.count > 0) {
+        std::string taken = "taken " + std::to_string(counts.taken) + " of " + std::to_string(counts.count) + " times";
+        if (!selectionStmt.elseBranch && counts.taken * 8 < counts.count) {
+            int coldLabel = current->newLabel();
+            int resumeLabel = current->newLabel();
+            genBranch(selectionStmt.condition.get(), coldLabel, true);
+            coldBlocks.push_back({coldLabel, resumeLabel, &selectionStmt});
+            emitLabel(resumeLabel);
+            remark(selectionStmt, "then branch moved out of line (" + taken + ")");
+            return;
+        }
+        if (selectionStmt.elseBranch && counts.count - counts.taken > counts.taken) {
+            int thenLabel = current->newLabel();
+            int endLabel = current->newLabel();
+            genBranch(selectionStmt.condition.get(), thenLabel, true);
+            genStatement(selectionStmt.elseBranch.get());
+            emit(Op::JMP, 4, Operand::label(endLabel));
+            emitLabel(thenLabel);
+            if (options.instrument) genCount(selectionStmt, 1);
+            genStatement(selectionStmt.ifBranch.get());
+            emitLabel(endLabel);
+            remark(selectionStmt, "else branch laid out first (then " + taken + ")");
+            return;
+        }
+    }
+
+    int elseLabel = current->newLabel();
+    genBranch(selectionStmt.condition.get(), elseLabel, false);
+    if (options.instrument) genCount(selectionStmt, 1);
+    genStatement(selectionStmt.ifBranch.get());
+
+    if (selectionStmt.elseBranch) {
+        int endLabel = current->newLabel();
+        emit(Op::JMP, 4, Operand::label(endLabel));
+        emitLabel(elseLabel);
+        genStatement(selectionStmt.elseBranch.get());
+        emitLabel(endLabel);
+    } else {
+        emitLabel(elseLabel);
+    }
+}
+
+void CodeGenerator::genIterationStmt(const IterationStmtNode& iterationStmt, const ASTNode* previous) {
+    if (options.instrument) genCount(iterationStmt);
+
+    if (options.optLevel >= 1) {
+        CountedLoop loop;
+        VectorPlan plan;
+        std::string reason;
+        // 迭代次数未知时用剖析数据中的平均迭代次数
+        const ExecutionCounts& counts = iterationStmt.counts;
+        long long trips = loop.tripCount;
+        if (const char* notCounted = analyzeCountedLoop(iterationStmt, previous, loop)) {
+            reason = notCounted;
+        } else {
+            trips = loop.tripCount >= 0 || counts.count <= 0 ? loop.tripCount : counts.taken / counts.count;
+            reason = planVectorization(loop, plan);
+            if (reason.empty()) reason = checkVectorPlan(loop, plan, trips);
+        }
+
+        if (!loop.induction) {
+            remark(iterationStmt, "loop not vectorized: " + reason);
+        } else if (options.instrument) {
+            // 计数器按迭代统计，插桩时不合并迭代
+            remark(iterationStmt, "loop not vectorized: instrumented for profiling");
+        } else if (counts.count == 0) {
+            remark(iterationStmt, "loop not vectorized: never executed in the profile");
+        } else if (reason.empty()) {
+            genVectorLoop(loop, plan);
+            vectorizedLoops++;
+            int lanes = options.vectorIsa == VectorIsa::AVX2 ? 8 : 4;
+            remark(iterationStmt, std::string("loop vectorized (") + vectorIsaName(options.vectorIsa) + ", " +
+                                      std::to_string(lanes) + " lanes)");
+        } else {
+            // 展开：循环体小、没有嵌套循环时复制4份（较大时2份），已知迭代次数不足时不展开。
+            // 剖析数据表明平均迭代16次以上时，较大的循环体（128个节点以内）也复制2份
+            int factor = loop.hasLoops ? 0 : loop.bodySize <= 24 ? 4 : loop.bodySize <= 64 ? 2 : 0;
+            if (factor == 0 && !loop.hasLoops && loop.bodySize <= 128 && counts.count > 0 && trips >= 16) {
+                factor = 2;
+            }
+            if (trips >= 0 && trips < factor) {
+                factor = trips >= 2 ? 2 : 0;
+            }
+            if (factor > 0) {
+                genUnrolledLoop(loop, factor);
+                unrolledLoops++;
+                remark(iterationStmt, "loop not vectorized: " + reason + "; unrolled " + std::to_string(factor) +
+                                          " times");
+            } else {
+                remark(iterationStmt, "loop not vectorized: " + reason);
+            }
+        }
+
+        // 循环倒置：条件放在循环底部，每次迭代只有一次跳转。
+        // 向量化或展开后这里完成剩下的迭代
+        int bodyLabel = current->newLabel();
+        int condLabel = current->newLabel();
+        emit(Op::JMP, 4, Operand::label(condLabel));
+        emitLabel(bodyLabel);
+        if (options.instrument) genCount(iterationStmt, 1);
+        genStatement(iterationStmt.body.get());
+        emitLabel(condLabel);
+        emitLine(iterationStmt);
+        genBranch(iterationStmt.condition.get(), bodyLabel, true);
+        return;
+    }
+
+    remark(iterationStmt, "loop not vectorized: optimizations are disabled (-O0)");
+    int topLabel = current->newLabel();
+    int endLabel = current->newLabel();
+    emitLabel(topLabel);
+    genBranch(iterationStmt.condition.get(), endLabel, false);
+    if (options.instrument) genCount(iterationStmt, 1);
+    genStatement(iterationStmt.body.get());
+    emit(Op::JMP, 4, Operand::label(topLabel));
+    emitLabel(endLabel);
+}
+
+// 向量化方案在目标指令集上是否可行
+// trips 为已知或剖析得到的平均迭代次数，都没有时为-1
+std::string CodeGenerator::checkVectorPlan(const CountedLoop& loop, const VectorPlan& plan, long long trips) const {
+    if (options.vectorIsa == VectorIsa::NONE) return "vectorization is disabled";
+    if (plan.multiplies && options.vectorIsa == VectorIsa::SSE2) return "multiplication needs SSE4.1";
+    int lanes = options.vectorIsa == VectorIsa::AVX2 ? 8 : 4;
+    if (trips >= 0 && trips < lanes) {
+        return std::string(loop.tripCount >= 0 ? "trip count " : "average trip count in the profile ") +
+               std::to_string(trips) + " is less than the vector width";
+    }
+    int reductions = 0;
+    for (const auto& stmt : plan.statements) {
+        reductions += stmt.reduction ? 1 : 0;
+    }
+    if (plan.temporaries + reductions + static_cast<int>(plan.invariants.size()) > 16) {
+        return "needs more than 16 vector registers";
+    }
+    // 向量循环中不做下标检查
+    if (hasCheckedAccess(*loop.body)) return "bounds checks not eliminated";
+    return "";
+}
+
+// dst = n - count（i <= n 时再加1）：i <= dst 时接下来的 count 次迭代都会执行。
+// 用64位计算，n 接近 INT_MIN 时不会溢出
+void CodeGenerator::genLoopLimit(const CountedLoop& loop, Reg dst, int64_t count) {
+    int64_t adjust = count - (loop.inclusive ? 1 : 0);
+    if (loop.bound->type == ASTNodeType::NUM) {
+        emit(Op::MOV, 8, Operand::r(dst), Operand::immediate(static_cast<const NumNode*>(loop.bound)->value - adjust));
+        return;
+    }
+    emit(Op::MOVSXD, 8, Operand::r(dst), scalarOperand(*static_cast<const VarNode*>(loop.bound)));
+    emit(Op::SUB, 8, Operand::r(dst), Operand::immediate(adjust));
+}
+
+// 向量循环：每次处理 lanes 次迭代。向量寄存器依次为：临时值、归约的部分和、
+// 广播后的不变量。r10 为上界，r11 为符号扩展后的 i；循环中没有调用，
+// 这些调用者保存的寄存器都可以自由使用
+void CodeGenerator::genVectorLoop(const CountedLoop& loop, const VectorPlan& plan) {
+    bool avx = options.vectorIsa == VectorIsa::AVX2;
+    int lanes = avx ? 8 : 4;
+    uint8_t vsize = avx ? 32 : 16;
+    int reductions = 0;
+    for (const auto& stmt : plan.statements) {
+        reductions += stmt.reduction ? 1 : 0;
+    }
+    int accumulatorBase = plan.temporaries;
+    int invariantBase = accumulatorBase + reductions;
+
+    genLoopLimit(loop, R10, lanes);
+    for (size_t k = 0; k < plan.invariants.size(); k++) {
+        Reg reg = static_cast<Reg>(invariantBase + k);
+        genExpr(plan.invariants[k]);
+        emit(Op::MOVD_TO_VEC, vsize, Operand::r(reg), Operand::r(RAX));
+        if (avx) {
+            emit(Op::VPBROADCASTD, 32, Operand::r(reg), Operand::r(reg));
+        } else {
+            emit(Op::PSHUFD, 16, Operand::r(reg), Operand::r(reg), Operand::immediate(0));
+        }
+    }
+    for (int k = 0; k < reductions; k++) {
+        Reg reg = static_cast<Reg>(accumulatorBase + k);
+        emit(Op::PXOR, vsize, Operand::r(reg), Operand::r(reg));
+    }
+
+    int bodyLabel = current->newLabel();
+    int condLabel = current->newLabel();
+    emit(Op::JMP, 4, Operand::label(condLabel));
+    emitLabel(bodyLabel);
+    int accumulator = accumulatorBase;
+    for (const auto& stmt : plan.statements) {
+        genVectorExpr(stmt.value, plan, 0, invariantBase);
+        if (stmt.reduction) {
+            emit(Op::PADDD, vsize, Operand::r(static_cast<Reg>(accumulator++)), Operand::r(0));
+        } else {
+            emit(Op::MOVDQU, vsize, vectorElement(*stmt.target), Operand::r(0));
+        }
+    }
+    emit(Op::ADD, 4, scalarOperand(*loop.induction), Operand::immediate(lanes));
+    emitLabel(condLabel);
+    emit(Op::MOVSXD, 8, Operand::r(R11), scalarOperand(*loop.induction));
+    emit(Op::CMP, 8, Operand::r(R11), Operand::r(R10));
+    emitJcc(Cond::LE, bodyLabel);
+
+    // 部分和横向相加后加到（或减到）归约变量上
+    if (avx) {
+        for (int k = 0; k < reductions; k++) {
+            Reg reg = static_cast<Reg>(accumulatorBase + k);
+            emit(Op::VEXTRACTI128, 32, Operand::r(0), Operand::r(reg));
+            emit(Op::PADDD, 32, Operand::r(reg), Operand::r(0));
+        }
+        emit(Op::VZEROUPPER, 32);
+    }
+    accumulator = accumulatorBase;
+    for (const auto& stmt : plan.statements) {
+        if (!stmt.reduction) continue;
+        Reg reg = static_cast<Reg>(accumulator++);
+        emit(Op::PSHUFD, 16, Operand::r(0), Operand::r(reg), Operand::immediate(0x4E));
+        emit(Op::PADDD, 16, Operand::r(reg), Operand::r(0));
+        emit(Op::PSHUFD, 16, Operand::r(0), Operand::r(reg), Operand::immediate(0xB1));
+        emit(Op::PADDD, 16, Operand::r(reg), Operand::r(0));
+        emit(Op::MOVD_FROM_VEC, 16, Operand::r(RAX), Operand::r(reg));
+        emit(stmt.subtract ? Op::SUB : Op::ADD, 4, scalarOperand(*stmt.target), Operand::r(RAX));
+    }
+}
+
+// 向量表达式的值放入寄存器 reg，需要时使用其后的寄存器
+void CodeGenerator::genVectorExpr(const ASTNode* expr, const VectorPlan& plan, int reg, int invariantBase) {
+    uint8_t vsize = options.vectorIsa == VectorIsa::AVX2 ? 32 : 16;
+    auto invariant = plan.invariantOf.find(expr);
+    if (invariant != plan.invariantOf.end()) {
+        emit(Op::MOVDQU, vsize, Operand::r(static_cast<Reg>(reg)),
+             Operand::r(static_cast<Reg>(invariantBase + invariant->second)));
+        return;
+    }
+    if (expr->type == ASTNodeType::VAR) {
+        emit(Op::MOVDQU, vsize, Operand::r(static_cast<Reg>(reg)), vectorElement(*static_cast<const VarNode*>(expr)));
+        return;
+    }
+
+    auto* binOp = static_cast<const BinOpNode*>(expr);
+    Op op = binOp->op == TokenType::PLUS ? Op::PADDD : binOp->op == TokenType::MINUS ? Op::PSUBD : Op::PMULLD;
+    genVectorExpr(binOp->left.get(), plan, reg, invariantBase);
+    Operand rhs;
+    auto rightInvariant = plan.invariantOf.find(binOp->right.get());
+    if (rightInvariant != plan.invariantOf.end()) {
+        rhs = Operand::r(static_cast<Reg>(invariantBase + rightInvariant->second));
+    } else {
+        genVectorExpr(binOp->right.get(), plan, reg + 1, invariantBase);
+        rhs = Operand::r(static_cast<Reg>(reg + 1));
+    }
+    emit(op, vsize, Operand::r(static_cast<Reg>(reg)), rhs);
+}
+
+// 向量循环中 a[i] 开始的元素（r11 为符号扩展后的 i）
+Operand CodeGenerator::vectorElement(const VarNode& var) {
+    switch (var.kind) {
+        case VarKind::LOCAL_ARRAY:
+            return Operand::mem(RBP, R11, 4, arrayDisp(var.slot)).inFrame(var.slot);
+        case VarKind::GLOBAL_ARRAY:
+            emit(Op::LEA, 8, Operand::r(RCX), Operand::rip(globalArraySymbols.at(var.slot)));
+            return Operand::mem(RCX, R11, 4, 0);
+        case VarKind::PARAM_ARRAY:
+            emit(Op::MOV, 8, Operand::r(RCX), slotOperand(var.slot));
+            return Operand::mem(RCX, R11, 4, 0);
+        default:
+            throw std::runtime_error("Codegen: '" + var.identifier + "' is not an array");
+    }
+}
+
+// 展开的循环：循环体（含末尾的自增）复制 factor 份，每 factor 次迭代检查一次上界。
+// 循环体中可能有调用，上界每次重新计算
+void CodeGenerator::genUnrolledLoop(const CountedLoop& loop, int factor) {
+    int bodyLabel = current->newLabel();
+    int condLabel = current->newLabel();
+    emit(Op::JMP, 4, Operand::label(condLabel));
+    emitLabel(bodyLabel);
+    // 循环体中 if 的决定在之后的原循环中记录一次
+    copying = true;
+    for (int k = 0; k < factor; k++) {
+        genStatement(loop.body);
+    }
+    copying = false;
+    emitLabel(condLabel);
+    genLoopLimit(loop, RCX, factor);
+    emit(Op::MOVSXD, 8, Operand::r(RAX), scalarOperand(*loop.induction));
+    emit(Op::CMP, 8, Operand::r(RAX), Operand::r(RCX));
+    emitJcc(Cond::LE, bodyLabel);
+}
+
+void CodeGenerator::remark(const ASTNode& node, const std::string& message) {
+    if (options.remarks && !copying) {
+        remarkList.push_back(LoopRemark{node.start, message});
+    }
+}
+
+// 条件为真（jumpIfTrue）或为假时跳转到label
+void CodeGenerator::genBranch(const ASTNode* cond, int label, bool jumpIfTrue) {
+    if (options.optLevel >= 1) {
+        int32_t value;
+        if (evalConst(cond, value)) {
+            if ((value != 0) == jumpIfTrue) {
+                emit(Op::JMP, 4, Operand::label(label));
+            }
+            return;
+        }
+        if (cond->type == ASTNodeType::SIMPLE_EXPR) {
+            auto* simpleExpr = static_cast<const SimpleExprNode*>(cond);
+            genCompare(*simpleExpr);
+            Cond cc = relopCond(simpleExpr->relop);
+            emitJcc(jumpIfTrue ? cc : negate(cc), label);
+            return;
+        }
+    }
+
+    genExpr(cond);
+    emit(Op::TEST, 4, Operand::r(RAX), Operand::r(RAX));
+    emitJcc(jumpIfTrue ? Cond::NE : Cond::E, label);
+}
+
+// ===== 表达式 =====
+
+void CodeGenerator::genExpr(const ASTNode* expr) {
+    if (options.optLevel >= 1) {
+        int32_t value;
+        if (evalConst(expr, value)) {
+            emit(Op::MOV, 4, Operand::r(RAX), Operand::immediate(value));
+            return;
+        }
+    }
+
+    switch (expr->type) {
+        case ASTNodeType::NUM:
+            emit(Op::MOV, 4, Operand::r(RAX), Operand::immediate(static_cast<const NumNode*>(expr)->value));
+            break;
+
+        case ASTNodeType::VAR: {
+            auto* var = static_cast<const VarNode*>(expr);
+            if (var->index) {
+                Operand element = genElement(*var, RAX, RCX);
+                emit(Op::MOV, 4, Operand::r(RAX), element);
+            } else if (isArrayKind(var->kind)) {
+                genArrayAddress(*var, RAX);
+            } else {
+                emit(Op::MOV, 4, Operand::r(RAX), scalarOperand(*var));
+            }
+            break;
+        }
+
+        case ASTNodeType::ASSIGN_EXPR:
+            genAssign(*static_cast<const AssignExprNode*>(expr));
+            break;
+
+        case ASTNodeType::SIMPLE_EXPR:
+            genCompare(*static_cast<const SimpleExprNode*>(expr));
+            {
+                Inst setcc(Op::SETCC, 4, Operand::r(RAX));
+                setcc.cc = relopCond(static_cast<const SimpleExprNode*>(expr)->relop);
+                current->code.push_back(setcc);
+            }
+            emit(Op::MOVZX8, 4, Operand::r(RAX), Operand::r(RAX));
+            break;
+
+        case ASTNodeType::BIN_OP:
+            genBinOp(*static_cast<const BinOpNode*>(expr));
+            break;
+
+        case ASTNodeType::CALL:
+            genCall(*static_cast<const CallNode*>(expr));
+            break;
+
+        default:
+            throw std::runtime_error("Codegen: unexpected expression at offset " + std::to_string(expr->start));
+    }
+}
+
+void CodeGenerator::genAssign(const AssignExprNode& assignExpr) {
+    auto* var = static_cast<const VarNode*>(assignExpr.var.get());
+
+    if (!var->index) {
+        genExpr(assignExpr.expression.get());
+        emit(Op::MOV, 4, scalarOperand(*var), Operand::r(RAX));
+        return;
+    }
+
+    // 下标与右值都无副作用时，求值顺序无关，可以省去地址的压栈
+    Operand leaf;
+    int32_t constIndex;
+    if (options.optLevel >= 1 && isPureExpression(assignExpr.expression.get()) &&
+        (evalConst(var->index.get(), constIndex) || leafOperand(var->index.get(), leaf))) {
+        genExpr(assignExpr.expression.get());
+        Operand element = genElement(*var, RDX, RCX);
+        emit(Op::MOV, 4, element, Operand::r(RAX));
+        return;
+    }
+
+    // 要检查下标时先求下标、再求右值，最后检查（与解释器相同，右值中的输出和错误在前）
+    if (checksBounds(*var)) {
+        genExpr(var->index.get());
+        push(RAX);
+        genExpr(assignExpr.expression.get());
+        pop(RDX);
+        emit(Op::MOVSXD, 8, Operand::r(RDX), Operand::r(RDX));
+        emit(Op::MOV, 4, genElement(*var, RDX, RCX, true), Operand::r(RAX));
+        return;
+    }
+
+    // 先计算元素地址，再计算右值
+    Operand element = genElement(*var, RAX, RCX);
+    emit(Op::LEA, 8, Operand::r(RAX), element);
+    push(RAX);
+    genExpr(assignExpr.expression.get());
+    pop(RCX);
+    emit(Op::MOV, 4, Operand::mem(RCX, 0), Operand::r(RAX));
+}
+
+void CodeGenerator::genBinOp(const BinOpNode& binOp) {
+    if (options.optLevel >= 1) {
+        Operand operand;
+        if (leafOperand(binOp.right.get(), operand)) {
+            genExpr(binOp.left.get());
+            genArith(binOp, operand);
+            return;
+        }
+        // 交换操作数时左操作数在右操作数之后读取，右操作数须无副作用
+        bool commutative = binOp.op == TokenType::PLUS || binOp.op == TokenType::TIMES;
+        if (commutative && leafOperand(binOp.left.get(), operand) &&
+            (operand.isImm() || isPureExpression(binOp.right.get()))) {
+            genExpr(binOp.right.get());
+            genArith(binOp, operand);
+            return;
+        }
+    }
+
+    genExpr(binOp.left.get());
+    push(RAX);
+    genExpr(binOp.right.get());
+    emit(Op::MOV, 4, Operand::r(RCX), Operand::r(RAX));
+    pop(RAX);
+    genArith(binOp, Operand::r(RCX));
+}
+
+// eax = eax op rhs
+void CodeGenerator::genArith(const BinOpNode& binOp, const Operand& rhs) {
+    TokenType op = binOp.op;
+    switch (op) {
+        case TokenType::PLUS:
+            emit(Op::ADD, 4, Operand::r(RAX), rhs);
+            break;
+        case TokenType::MINUS:
+            emit(Op::SUB, 4, Operand::r(RAX), rhs);
+            break;
+        case TokenType::TIMES:
+            if (rhs.isImm()) {
+                genMultiplyByConstant(static_cast<int32_t>(rhs.imm));
+            } else {
+                emit(Op::IMUL, 4, Operand::r(RAX), rhs);
+            }
+            break;
+        case TokenType::DIVIDE:
+        case TokenType::MOD:
+            // 除数为非零常数时不需要 idiv
+            if (rhs.isImm() && rhs.imm != 0) {
+                if (op == TokenType::DIVIDE) {
+                    genDivideByConstant(static_cast<int32_t>(rhs.imm));
+                } else {
+                    genModuloByConstant(static_cast<int32_t>(rhs.imm));
+                }
+                break;
+            }
+            if (!(rhs.isReg() && rhs.reg == RCX)) {
+                emit(Op::MOV, 4, Operand::r(RCX), rhs);
+            }
+            genDivide(op == TokenType::MOD, sources ? sources->line(binOp.start) : 0);
+            break;
+        default:
+            throw std::runtime_error("Codegen: invalid arithmetic operator");
+    }
+}
+
+// eax = eax / ecx 或 eax % ecx。idiv 在除数为0和 INT_MIN / -1 时产生异常：除数为 -1 时
+// 商取 0 - eax（INT_MIN 回绕为自身）、余数为0，除数为0时跳到函数末尾报告运行时错误
+void CodeGenerator::genDivide(bool modulo, int line) {
+    int divide = current->newLabel();
+    int done = current->newLabel();
+    int failure = current->newLabel();
+    emit(Op::CMP, 4, Operand::r(RCX), Operand::immediate(-1));
+    emitJcc(Cond::NE, divide);
+    if (modulo) {
+        emit(Op::MOV, 4, Operand::r(RAX), Operand::immediate(0));
+    } else {
+        emit(Op::NEG, 4, Operand::r(RAX));
+    }
+    emit(Op::JMP, 4, Operand::label(done));
+    emitLabel(divide);
+    emit(Op::TEST, 4, Operand::r(RCX), Operand::r(RCX));
+    emitJcc(Cond::E, failure);
+    divisionFailures.push_back({failure, line});
+    emit(Op::CDQ, 4);
+    emit(Op::IDIV, 4, Operand::r(RCX));
+    if (modulo) {
+        emit(Op::MOV, 4, Operand::r(RAX), Operand::r(RDX));
+    }
+    emitLabel(done);
+}
+
+// eax = eax * factor：0、±1、±2^k 和 2^k±1 用移位、lea 和加减代替 imul
+void CodeGenerator::genMultiplyByConstant(int32_t factor) {
+    uint32_t magnitude = factor < 0 ? 0u - static_cast<uint32_t>(factor) : static_cast<uint32_t>(factor);
+    bool negate = factor < 0;
+    if (factor == 0) {
+        emit(Op::MOV, 4, Operand::r(RAX), Operand::immediate(0));
+        return;
+    }
+    if ((magnitude & (magnitude - 1)) == 0) {
+        int k = __builtin_ctz(magnitude);
+        if (k > 0) emit(Op::SHL, 4, Operand::r(RAX), Operand::immediate(k));
+    } else if (magnitude == 3 || magnitude == 5 || magnitude == 9) {
+        emit(Op::LEA, 4, Operand::r(RAX), Operand::mem(RAX, RAX, static_cast<uint8_t>(magnitude - 1), 0));
+    } else if (((magnitude + 1) & magnitude) == 0 || ((magnitude - 1) & (magnitude - 2)) == 0) {
+        // 2^k - 1：(x << k) - x；2^k + 1：(x << k) + x
+        bool below = ((magnitude + 1) & magnitude) == 0;
+        int k = __builtin_ctz(below ? magnitude + 1 : magnitude - 1);
+        emit(Op::MOV, 4, Operand::r(RCX), Operand::r(RAX));
+        emit(Op::SHL, 4, Operand::r(RAX), Operand::immediate(k));
+        emit(below ? Op::SUB : Op::ADD, 4, Operand::r(RAX), Operand::r(RCX));
+    } else {
+        emit(Op::IMUL, 4, Operand::r(RAX), Operand::r(RAX), Operand::immediate(factor));
+        return;
+    }
+    if (negate) emit(Op::NEG, 4, Operand::r(RAX));
+}
+
+// eax = eax / divisor（divisor != 0，向零取整）。|d| = 2^k 时先给负数加上 2^k - 1
+// 再算术右移；否则乘以 m = floor(2^(31+l) / |d|) + 1（l = ceil(log2 |d|)），
+// 取64位积右移 31+l 位，负数再加1。只用 rax、rcx
+void CodeGenerator::genDivideByConstant(int32_t divisor) {
+    uint32_t magnitude = divisor < 0 ? 0u - static_cast<uint32_t>(divisor) : static_cast<uint32_t>(divisor);
+    if ((magnitude & (magnitude - 1)) == 0) {
+        int k = __builtin_ctz(magnitude);
+        if (k > 0) {
+            emit(Op::MOV, 4, Operand::r(RCX), Operand::r(RAX));
+            emit(Op::SAR, 4, Operand::r(RCX), Operand::immediate(31));
+            emit(Op::SHR, 4, Operand::r(RCX), Operand::immediate(32 - k));
+            emit(Op::ADD, 4, Operand::r(RAX), Operand::r(RCX));
+            emit(Op::SAR, 4, Operand::r(RAX), Operand::immediate(k));
+        }
+    } else {
+        int l = 32 - __builtin_clz(magnitude - 1);
+        uint64_t multiplier = (uint64_t(1) << (31 + l)) / magnitude + 1;
+        emit(Op::MOVSXD, 8, Operand::r(RAX), Operand::r(RAX));
+        emit(Op::MOV, 4, Operand::r(RCX), Operand::immediate(static_cast<int64_t>(multiplier)));
+        emit(Op::IMUL, 8, Operand::r(RAX), Operand::r(RCX));
+        emit(Op::SAR, 8, Operand::r(RAX), Operand::immediate(31 + l));
+        emit(Op::MOV, 4, Operand::r(RCX), Operand::r(RAX));
+        emit(Op::SHR, 4, Operand::r(RCX), Operand::immediate(31));
+        emit(Op::ADD, 4, Operand::r(RAX), Operand::r(RCX));
+    }
+    // 除以 -1 时 INT_MIN 取负回绕为自身，与解释器一致
+    if (divisor < 0) emit(Op::NEG, 4, Operand::r(RAX));
+}
+
+// eax = eax % divisor（divisor != 0），余数与被除数同号，只与 |d| 有关。
+// |d| = 2^k 时 x - ((x + 偏置) & -2^k)；否则 x - (x / |d|) * |d|
+void CodeGenerator::genModuloByConstant(int32_t divisor) {
+    uint32_t magnitude = divisor < 0 ? 0u - static_cast<uint32_t>(divisor) : static_cast<uint32_t>(divisor);
+    if (magnitude == 1) {
+        emit(Op::MOV, 4, Operand::r(RAX), Operand::immediate(0));
+        return;
+    }
+    if ((magnitude & (magnitude - 1)) == 0) {
+        int k = __builtin_ctz(magnitude);
+        emit(Op::MOV, 4, Operand::r(RDX), Operand::r(RAX));
+        emit(Op::SAR, 4, Operand::r(RDX), Operand::immediate(31));
+        emit(Op::SHR, 4, Operand::r(RDX), Operand::immediate(32 - k));
+        emit(Op::LEA, 4, Operand::r(RCX), Operand::mem(RAX, RDX, 1, 0));
+        emit(Op::AND, 4, Operand::r(RCX), Operand::immediate(-static_cast<int64_t>(magnitude)));
+        emit(Op::SUB, 4, Operand::r(RAX), Operand::r(RCX));
+        return;
+    }
+    // |d| 不是2的幂时 |d| < 2^31，按正的除数求商
+    int32_t positive = static_cast<int32_t>(magnitude);
+    emit(Op::MOV, 4, Operand::r(RDX), Operand::r(RAX));
+    genDivideByConstant(positive);
+    genMultiplyByConstant(positive);
+    emit(Op::SUB, 4, Operand::r(RDX), Operand::r(RAX));
+    emit(Op::MOV, 4, Operand::r(RAX), Operand::r(RDX));
+}
+
+// 计算比较，结果在标志位中
+void CodeGenerator::genCompare(const SimpleExprNode& simpleExpr) {
+    Operand operand;
+    if (options.optLevel >= 1 && leafOperand(simpleExpr.right.get(), operand)) {
+        genExpr(simpleExpr.left.get());
+        emit(Op::CMP, 4, Operand::r(RAX), operand);
+        return;
+    }
+
+    genExpr(simpleExpr.left.get());
+    push(RAX);
+    genExpr(simpleExpr.right.get());
+    emit(Op::MOV, 4, Operand::r(RCX), Operand::r(RAX));
+    pop(RAX);
+    emit(Op::CMP, 4, Operand::r(RAX), Operand::r(RCX));
+}
+
+// 函数调用：参数从左到右求值，调用时rsp按16字节对齐
+void CodeGenerator::genCall(const CallNode& call) {
+    if (options.instrument && call.builtin == BuiltinKind::NONE) genCount(call);
+    int target;
+    if (call.builtin == BuiltinKind::INPUT) {
+        target = inputSymbol;
+    } else if (call.builtin == BuiltinKind::OUTPUT) {
+        target = outputSymbol;
+    } else {
+        target = functionSymbols.at(call.callee);
+    }
+
+    int n = static_cast<int>(call.args.size());
+    auto isArrayArg = [](const ASTNode* arg) {
+        return arg->type == ASTNodeType::VAR && !static_cast<const VarNode*>(arg)->index &&
+               isArrayKind(static_cast<const VarNode*>(arg)->kind);
+    };
+
+    // 参数都是叶子时直接装入参数寄存器
+    if (options.optLevel >= 1 && n <= 6) {
+        bool allLeaves = true;
+        Operand operand;
+        for (const auto& arg : call.args) {
+            if (!isArrayArg(arg.get()) && !leafOperand(arg.get(), operand)) {
+                allLeaves = false;
+                break;
+            }
+        }
+        if (allLeaves) {
+            bool pad = depth % 2 != 0;
+            if (pad) {
+                emit(Op::SUB, 8, Operand::r(RSP), Operand::immediate(8));
+                depth++;
+            }
+            for (int k = 0; k < n; k++) {
+                const ASTNode* arg = call.args[k].get();
+                if (isArrayArg(arg)) {
+                    genArrayAddress(*static_cast<const VarNode*>(arg), argRegs[k]);
+                } else {
+                    leafOperand(arg, operand);
+                    emit(Op::MOV, 4, Operand::r(argRegs[k]), operand);
+                }
+            }
+            emit(Op::CALL, 8, Operand::symbol(target));
+            if (pad) {
+                emit(Op::ADD, 8, Operand::r(RSP), Operand::immediate(8));
+                depth--;
+            }
+            return;
+        }
+    }
+
+    bool stackArgs = n > 6;
+    bool pad = (stackArgs ? depth + n : depth) % 2 != 0;
+    if (pad) {
+        emit(Op::SUB, 8, Operand::r(RSP), Operand::immediate(8));
+        depth++;
+    }
+
+    for (const auto& arg : call.args) {
+        if (isArrayArg(arg.get())) {
+            genArrayAddress(*static_cast<const VarNode*>(arg.get()), RAX);
+        } else {
+            genExpr(arg.get());
+        }
+        push(RAX);
+    }
+
+    if (stackArgs) {
+        // 第7个及以后的参数需要按升序位于栈顶，原地反转这一段
+        int count = n - 6;
+        for (int j = 0; j < count / 2; j++) {
+            Operand low = Operand::mem(RSP, 8 * j);
+            Operand high = Operand::mem(RSP, 8 * (count - 1 - j));
+            emit(Op::MOV, 8, Operand::r(RAX), low);
+            emit(Op::MOV, 8, Operand::r(RCX), high);
+            emit(Op::MOV, 8, low, Operand::r(RCX));
+            emit(Op::MOV, 8, high, Operand::r(RAX));
+        }
+        for (int k = 0; k < 6; k++) {
+            emit(Op::MOV, 8, Operand::r(argRegs[k]), Operand::mem(RSP, 8 * (n - 1 - k)));
+        }
+    } else {
+        for (int k = n - 1; k >= 0; k--) {
+            pop(argRegs[k]);
+        }
+    }
+
+    emit(Op::CALL, 8, Operand::symbol(target));
+
+    int cleanup = (stackArgs ? n : 0) + (pad ? 1 : 0);
+    if (cleanup > 0) {
+        emit(Op::ADD, 8, Operand::r(RSP), Operand::immediate(8 * cleanup));
+        depth -= cleanup;
+    }
+}
+
+// 尾调用：实参装入参数寄存器后，调用自身时跳回参数搬移处（即循环），
+// 调用其他函数时先拆除栈帧再跳转。自身调用的第7个及以后的实参直接写回
+// 本函数的栈参数区；调用其他函数且需要栈参数时不处理，返回false
+bool CodeGenerator::genTailCall(const CallNode& call) {
+    int n = static_cast<int>(call.args.size());
+    bool self = call.callee == currentFun;
+    if (n > 6 && !self) {
+        return false;
+    }
+    if (options.instrument) genCount(call);
+    auto isArrayArg = [](const ASTNode* arg) {
+        return arg->type == ASTNodeType::VAR && !static_cast<const VarNode*>(arg)->index &&
+               isArrayKind(static_cast<const VarNode*>(arg)->kind);
+    };
+
+    bool allLeaves = options.optLevel >= 1 && n <= 6;
+    Operand operand;
+    for (int k = 0; k < n && allLeaves; k++) {
+        const ASTNode* arg = call.args[k].get();
+        allLeaves = isArrayArg(arg) || leafOperand(arg, operand);
+    }
+
+    if (allLeaves) {
+        for (int k = 0; k < n; k++) {
+            const ASTNode* arg = call.args[k].get();
+            if (isArrayArg(arg)) {
+                genArrayAddress(*static_cast<const VarNode*>(arg), argRegs[k]);
+            } else {
+                leafOperand(arg, operand);
+                emit(Op::MOV, 4, Operand::r(argRegs[k]), operand);
+            }
+        }
+    } else {
+        for (const auto& arg : call.args) {
+            if (isArrayArg(arg.get())) {
+                genArrayAddress(*static_cast<const VarNode*>(arg.get()), RAX);
+            } else {
+                genExpr(arg.get());
+            }
+            push(RAX);
+        }
+        for (int k = n - 1; k >= 6; k--) {
+            pop(RAX);
+            emit(Op::MOV, 8, frameOperand(16 + 8 * (k - 6)), Operand::r(RAX));
+        }
+        for (int k = std::min(n, 6) - 1; k >= 0; k--) {
+            pop(argRegs[k]);
+        }
+    }
+
+    if (self) {
+        emit(Op::JMP, 4, Operand::label(entryLabel));
+    } else {
+        for (size_t i = 0; i < savedRegs.size(); i++) {
+            emit(Op::MOV, 8, Operand::r(savedRegs[i]), frameOperand(-8 * static_cast<int32_t>(i + 1)));
+        }
+        emit(Op::LEAVE, 8);
+        emit(Op::JMP, 8, Operand::symbol(functionSymbols.at(call.callee)));
+    }
+    tailCalls++;
+    return true;
+}
+
+// 数组首地址
+void CodeGenerator::genArrayAddress(const VarNode& var, Reg dst) {
+    switch (var.kind) {
+        case VarKind::LOCAL_ARRAY:
+            emit(Op::LEA, 8, Operand::r(dst), Operand::mem(RBP, arrayDisp(var.slot)));
+            break;
+        case VarKind::GLOBAL_ARRAY:
+            emit(Op::LEA, 8, Operand::r(dst), Operand::rip(globalArraySymbols.at(var.slot)));
+            break;
+        case VarKind::PARAM_ARRAY:
+            emit(Op::MOV, 8, Operand::r(dst), slotOperand(var.slot));
+            break;
+        default:
+            throw std::runtime_error("Codegen: '" + var.identifier + "' is not an array");
+    }
+}
+
+// 计算数组元素的内存操作数，可能使用indexReg和baseReg
+Operand CodeGenerator::genElement(const VarNode& var, Reg indexReg, Reg baseReg, bool indexLoaded) {
+    int32_t constIndex = 0;
+    bool isConst = !indexLoaded && options.optLevel >= 1 && evalConst(var.index.get(), constIndex);
+    // 越界的常数下标照常装入寄存器，由检查报错
+    if (isConst && checksBounds(var) && (constIndex < 0 || constIndex >= var.arraySize)) {
+        isConst = false;
+    }
+
+    if (!isConst && !indexLoaded) {
+        Operand leaf;
+        if (options.optLevel >= 1 && leafOperand(var.index.get(), leaf)) {
+            emit(Op::MOV, 4, Operand::r(indexReg), leaf);
+        } else {
+            genExpr(var.index.get());
+            if (indexReg != RAX) {
+                emit(Op::MOV, 4, Operand::r(indexReg), Operand::r(RAX));
+            }
+        }
+        emit(Op::MOVSXD, 8, Operand::r(indexReg), Operand::r(indexReg));
+    }
+    if (!isConst) {
+        genBoundsCheck(var, indexReg);
+    }
+
+    switch (var.kind) {
+        case VarKind::LOCAL_ARRAY: {
+            int32_t disp = arrayDisp(var.slot);
+            Operand element = isConst ? Operand::mem(RBP, disp + 4 * constIndex)
+                                      : Operand::mem(RBP, indexReg, 4, disp);
+            return element.inFrame(var.slot);
+        }
+        case VarKind::GLOBAL_ARRAY: {
+            int sym = globalArraySymbols.at(var.slot);
+            if (isConst) {
+                return Operand::rip(sym, 4 * constIndex);
+            }
+            emit(Op::LEA, 8, Operand::r(baseReg), Operand::rip(sym));
+            return Operand::mem(baseReg, indexReg, 4, 0);
+        }
+        case VarKind::PARAM_ARRAY:
+            emit(Op::MOV, 8, Operand::r(baseReg), slotOperand(var.slot));
+            return isConst ? Operand::mem(baseReg, 4 * constIndex)
+                           : Operand::mem(baseReg, indexReg, 4, 0);
+        default:
+            throw std::runtime_error("Codegen: '" + var.identifier + "' is not an array");
+    }
+}
+
+bool CodeGenerator::checksBounds(const VarNode& var) const {
+    return options.boundsChecks && bounds.needsCheck(var);
+}
+
+// 子树中是否有需要检查的下标访问
+bool CodeGenerator::hasCheckedAccess(const ASTNode& node) const {
+    if (node.type == ASTNodeType::VAR && static_cast<const VarNode&>(node).index &&
+        checksBounds(static_cast<const VarNode&>(node))) {
+        return true;
+    }
+    bool found = false;
+    visitChildren(node, [&](const ASTNode& child) { found = found || hasCheckedAccess(child); });
+    return found;
+}
+
+// 无符号比较同时排除负的下标，越界时跳到函数末尾的报错代码
+void CodeGenerator::genBoundsCheck(const VarNode& var, Reg indexReg) {
+    if (!checksBounds(var)) return;
+    int label = current->newLabel();
+    emit(Op::CMP, 4, Operand::r(indexReg), Operand::immediate(var.arraySize));
+    emitJcc(Cond::AE, label);
+    boundsFailures.push_back({label, indexReg, sources ? sources->line(var.start) : 0});
+}
+
+// cminus_bounds_error(下标, 行号) 和 cminus_division_error(行号) 不返回，调用前只需对齐栈
+void CodeGenerator::genRuntimeFailures() {
+    for (const BoundsFailure& failure : boundsFailures) {
+        emitLabel(failure.label);
+        emit(Op::MOV, 4, Operand::r(RDI), Operand::r(failure.indexReg));
+        emit(Op::MOV, 4, Operand::r(RSI), Operand::immediate(failure.line));
+        emit(Op::AND, 8, Operand::r(RSP), Operand::immediate(-16));
+        emit(Op::CALL, 8, Operand::symbol(boundsErrorSymbol));
+    }
+    boundsFailures.clear();
+    if (!divisionFailures.empty() && divisionErrorSymbol < 0) {
+        divisionErrorSymbol = module.addSymbol("cminus_division_error", Section::UNDEF, 0, 0, true);
+    }
+    for (const DivisionFailure& failure : divisionFailures) {
+        emitLabel(failure.label);
+        emit(Op::MOV, 4, Operand::r(RDI), Operand::immediate(failure.line));
+        emit(Op::AND, 8, Operand::r(RSP), Operand::immediate(-16));
+        emit(Op::CALL, 8, Operand::symbol(divisionErrorSymbol));
+    }
+    divisionFailures.clear();
+}
+
+// 插桩位置 site 的第 counter 个计数器加1（site 为函数本身时是调用次数）
+void CodeGenerator::genCount(const ASTNode& site, int counter) {
+    int index = &site == currentFun ? 0 : counterLayout.first.at(&site);
+    emit(Op::ADD, 8, Operand::rip(counterSymbol, 8 * (index + counter)), Operand::immediate(1));
+}
+
+// 冷分支放在函数末尾，执行完跳回 if 之后。其中的 if 可能再产生冷分支
+void CodeGenerator::genColdBlocks() {
+    for (size_t i = 0; i < coldBlocks.size(); i++) {
+        ColdBlock block = coldBlocks[i];
+        emitLabel(block.label);
+        if (options.instrument) genCount(*block.stmt, 1);
+        genStatement(block.stmt->ifBranch.get());
+        emit(Op::JMP, 4, Operand::label(block.resume));
+    }
+    coldBlocks.clear();
+}
+
+// 把数组区偏移offset处的局部数组（words个int）清零
+void CodeGenerator::genZeroArray(int offset, int words) {
+    int32_t disp = arrayDisp(offset);
+    if (words <= 16) {
+        for (int k = 0; k < words; k++) {
+            emit(Op::MOV, 4, Operand::mem(RBP, disp + 4 * k).inFrame(offset), Operand::immediate(0));
+        }
+        return;
+    }
+    emit(Op::LEA, 8, Operand::r(RDI), Operand::mem(RBP, disp));
+    emit(Op::MOV, 4, Operand::r(RCX), Operand::immediate(words));
+    emit(Op::XOR, 4, Operand::r(RAX), Operand::r(RAX));
+    emit(Op::REP_STOSD, 4);
+}
+
+// ===== 操作数 =====
+
+Operand CodeGenerator::slotOperand(int slot) const {
+    if (slotRegs[slot] != NOREG) {
+        return Operand::r(slotRegs[slot]);
+    }
+    return frameOperand(-(slotBase + 8 * (slot + 1)));
+}
+
+// 栈帧中按固定偏移访问的标量（局部变量、保存的寄存器和栈上传递的参数）
+Operand CodeGenerator::frameOperand(int32_t disp) const {
+    return Operand::mem(RBP, disp).inFrame(Operand::frameSlot);
+}
+
+Operand CodeGenerator::scalarOperand(const VarNode& var) const {
+    if (var.kind == VarKind::GLOBAL_SCALAR) {
+        return Operand::rip(globalSlotSymbols[var.slot]);
+    }
+    return slotOperand(var.slot);
+}
+
+int32_t CodeGenerator::arrayDisp(int offset) const {
+    return -arrayBase + 4 * offset;
+}
+
+// 可以直接作为指令操作数的表达式：常量或标量变量
+bool CodeGenerator::leafOperand(const ASTNode* expr, Operand& out) const {
+    int32_t value;
+    if (evalConst(expr, value)) {
+        out = Operand::immediate(value);
+        return true;
+    }
+    if (expr->type == ASTNodeType::VAR) {
+        auto* var = static_cast<const VarNode*>(expr);
+        if (!var->index && (var->kind == VarKind::LOCAL_SCALAR || var->kind == VarKind::GLOBAL_SCALAR)) {
+            out = scalarOperand(*var);
+            return true;
+        }
+    }
+    return false;
+}
+
+// 常量表达式求值
+bool CodeGenerator::evalConst(const ASTNode* expr, int32_t& value) const {
+    switch (expr->type) {
+        case ASTNodeType::NUM:
+            value = static_cast<const NumNode*>(expr)->value;
+            return true;
+        case ASTNodeType::BIN_OP: {
+            auto* binOp = static_cast<const BinOpNode*>(expr);
+            int32_t left, right;
+            return evalConst(binOp->left.get(), left) && evalConst(binOp->right.get(), right) &&
+                   foldBinary(binOp->op, left, right, value);
+        }
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto* simpleExpr = static_cast<const SimpleExprNode*>(expr);
+            int32_t left, right;
+            if (evalConst(simpleExpr->left.get(), left) && evalConst(simpleExpr->right.get(), right)) {
+                value = foldCompare(simpleExpr->relop, left, right) ? 1 : 0;
+                return true;
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
+// ===== 指令 =====
+
+void CodeGenerator::emit(Op op, uint8_t size, const Operand& a, const Operand& b, const Operand& c) {
+    current->code.emplace_back(op, size, a, b, c);
+}
+
+void CodeGenerator::emitJcc(Cond cc, int label) {
+    Inst inst(Op::JCC, 4, Operand::label(label));
+    inst.cc = cc;
+    current->code.push_back(inst);
+}
+
+void CodeGenerator::emitLabel(int label) {
+    emit(Op::LABEL, 4, Operand::label(label));
+}
+
+// 之后的指令属于 node 所在的行（options.lineTable 时）
+void CodeGenerator::emitLine(const ASTNode& node) {
+    if (options.lineTable && sources) {
+        emit(Op::LINE, 4, Operand::immediate(sources->line(node.start)));
+    }
+}
+
+void CodeGenerator::push(Reg reg) {
+    emit(Op::PUSH, 8, Operand::r(reg));
+    depth++;
+}
+
+void CodeGenerator::pop(Reg reg) {
+    emit(Op::POP, 8, Operand::r(reg));
+    depth--;
+}
@@ -0,0 +1,178 @@
+#include "consteval.h"
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+InterpreterOptions sandboxOptions() {
+    InterpreterOptions options;
+    options.stackCells = ConstantEvaluator::stackCells;
+    options.arrayWords = ConstantEvaluator::arrayWords;
+    options.maxCallDepth = ConstantEvaluator::maxCallDepth;
+    options.maxSteps = ConstantEvaluator::maxSteps;
+    return options;
+}
+
+} // namespace
+
+bool foldBinary(TokenType op, int32_t left, int32_t right, int32_t& result) {
+    uint32_t l = static_cast<uint32_t>(left);
+    uint32_t r = static_cast<uint32_t>(right);
+    switch (op) {
+        case TokenType::PLUS:   result = static_cast<int32_t>(l + r); return true;
+        case TokenType::MINUS:  result = static_cast<int32_t>(l - r); return true;
+        case TokenType::TIMES:  result = static_cast<int32_t>(l * r); return true;
+        case TokenType::DIVIDE:
+            if (right == 0) return false;
+            result = right == -1 ? static_cast<int32_t>(0 - l) : left / right;
+            return true;
+        case TokenType::MOD:
+            if (right == 0) return false;
+            result = right == -1 ? 0 : left % right;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool foldCompare(TokenType op, int32_t left, int32_t right) {
+    switch (op) {
+        case TokenType::LT: return left < right;
+        case TokenType::LE: return left <= right;
+        case TokenType::GT: return left > right;
+        case TokenType::GE: return left >= right;
+        case TokenType::EQ: return left == right;
+        default:            return left != right;
+    }
+}
+
+ConstantEvaluator::ConstantEvaluator() : sandbox(sandboxOptions()) {}
+
+void ConstantEvaluator::clear() {
+    functions.clear();
+    results.clear();
+}
+
+void ConstantEvaluator::addFunction(const FunDeclarationNode& fun) {
+    functions.emplace(&fun, Function());
+}
+
+// 子树是否访问全局存储或调用内建函数（被调函数未解析时也算）
+bool ConstantEvaluator::hasDirectEffect(const ASTNode& node) const {
+    if (node.type == ASTNodeType::VAR) {
+        VarKind kind = static_cast<const VarNode&>(node).kind;
+        if (kind == VarKind::GLOBAL_SCALAR || kind == VarKind::GLOBAL_ARRAY) return true;
+    } else if (node.type == ASTNodeType::CALL) {
+        auto& call = static_cast<const CallNode&>(node);
+        if (call.builtin != BuiltinKind::NONE || !call.callee) return true;
+    }
+    bool effect = false;
+    visitChildren(node, [&](const ASTNode& child) { effect = effect || hasDirectEffect(child); });
+    return effect;
+}
+
+// 函数纯当且仅当它调用（直接或间接）的所有函数都已登记且没有直接的作用。
+// 纯的结论对调用到的每个函数都成立；不纯的结论只在由直接的作用导致时记下
+// （未登记的函数以后可能登记）
+bool ConstantEvaluator::isPure(const FunDeclarationNode& fun) {
+    auto found = functions.find(&fun);
+    if (found == functions.end()) return false;
+    if (found->second.pure >= 0) return found->second.pure == 1;
+
+    std::vector<const FunDeclarationNode*> closure{&fun};
+    std::unordered_set<const FunDeclarationNode*> visited{&fun};
+    bool pure = true;
+    bool definite = true;
+    for (size_t i = 0; i < closure.size() && pure; i++) {
+        auto it = functions.find(closure[i]);
+        if (it == functions.end()) {
+            pure = false;
+            definite = false;
+            break;
+        }
+        Function& function = it->second;
+        if (function.pure == 1) continue;
+        if (function.pure == 0 || function.directEffect == 1) {
+            pure = false;
+            break;
+        }
+        if (function.directEffect < 0) {
+            function.directEffect = hasDirectEffect(*closure[i]->body) ? 1 : 0;
+            if (function.directEffect == 1) {
+                pure = false;
+                break;
+            }
+        }
+        std::function<void(const ASTNode&)> collect = [&](const ASTNode& node) {
+            if (node.type == ASTNodeType::CALL) {
+                const FunDeclarationNode* callee = static_cast<const CallNode&>(node).callee;
+                if (visited.insert(callee).second) closure.push_back(callee);
+            }
+            visitChildren(node, collect);
+        };
+        collect(*closure[i]->body);
+    }
+
+    if (pure) {
+        for (const FunDeclarationNode* member : closure) functions[member].pure = 1;
+    } else if (definite) {
+        found->second.pure = 0;
+    }
+    return pure;
+}
+
+bool ConstantEvaluator::call(const FunDeclarationNode& fun, const std::vector<int32_t>& args, int32_t& result) {
+    if (args.size() != fun.params.size() || !isPure(fun)) return false;
+    for (const auto& param : fun.params) {
+        if (static_cast<const ParamNode&>(*param).isArray) return false;
+    }
+    auto key = std::make_pair(&fun, args);
+    auto found = results.find(key);
+    if (found == results.end()) {
+        std::pair<bool, int32_t> evaluated(false, 0);
+        try {
+            evaluated.second = sandbox.run(fun, args);
+            evaluated.first = true;
+        } catch (const std::runtime_error&) {
+            // 运行时错误或超出限制：留到运行时
+        }
+        found = results.emplace(std::move(key), evaluated).first;
+    }
+    result = found->second.second;
+    return found->second.first;
+}
+
+bool ConstantEvaluator::evaluate(const ASTNode& expr, int32_t& value) {
+    switch (expr.type) {
+        case ASTNodeType::NUM:
+            value = static_cast<const NumNode&>(expr).value;
+            return true;
+        case ASTNodeType::BIN_OP: {
+            auto& binOp = static_cast<const BinOpNode&>(expr);
+            int32_t left, right;
+            return evaluate(*binOp.left, left) && evaluate(*binOp.right, right) &&
+                   foldBinary(binOp.op, left, right, value);
+        }
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto& simpleExpr = static_cast<const SimpleExprNode&>(expr);
+            int32_t left, right;
+            if (!evaluate(*simpleExpr.left, left) || !evaluate(*simpleExpr.right, right)) return false;
+            value = foldCompare(simpleExpr.relop, left, right);
+            return true;
+        }
+        case ASTNodeType::CALL: {
+            auto& callNode = static_cast<const CallNode&>(expr);
+            if (callNode.builtin != BuiltinKind::NONE || !callNode.callee ||
+                callNode.callee->returnType == "void") {
+                return false;
+            }
+            std::vector<int32_t> args(callNode.args.size());
+            for (size_t i = 0; i < args.size(); i++) {
+                if (!evaluate(*callNode.args[i], args[i])) return false;
+            }
+            return call(*callNode.callee, args, value);
+        }
+        default:
+            return false;
+    }
+}
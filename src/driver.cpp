@@ -0,0 +1,951 @@
+#include "driver.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "jit.h"
+#include "bytecode.h"
+#include "cache.h"
+#include "vm.h"
+#include "interpreter.h"
+#include "runtime.h"
+#include "cemit.h"
+#include "codegen.h"
+#include "elfwriter.h"
+#include "stats.h"
+#include "sampler.h"
+#include "cminus.h"
+#include "protocol.h"
+
+namespace {
+
+// --profile-generate/--profile-use 不给文件名时使用的剖析文件
+const char* const defaultProfile = "cminus.profile";
+
+// 采样间隔的默认值：虚拟机每一万条指令、JIT 每毫秒CPU时间一个样本
+const int defaultVmSamplePeriod = 10000;
+const int defaultJitSamplePeriod = 1000;
+
+// 文件名是否以指定后缀结尾
+bool hasSuffix(const std::string& name, const std::string& suffix) {
+    return name.size() >= suffix.size() &&
+           name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// 窥孔优化和调度的统计：计入 --stats-json 的计数器，返回 --stats 输出的文字
+std::string reportPeephole(const x86::PeepholeStats& peephole, const std::string& counterPrefix) {
+    std::ostringstream text;
+    text << "peephole";
+    for (size_t k = 0; k < static_cast<size_t>(x86::Peephole::COUNT); k++) {
+        auto pattern = static_cast<x86::Peephole>(k);
+        stats::addCounter(counterPrefix + ".peephole." + x86::peepholeName(pattern), peephole[pattern]);
+        text << (k == 0 ? " " : ", ") << x86::peepholeName(pattern) << " " << peephole[pattern];
+    }
+    stats::addCounter(counterPrefix + ".schedule.blocks", peephole.scheduledBlocks);
+    stats::addCounter(counterPrefix + ".schedule.moved", peephole.movedInstructions);
+    text << "\n" << counterPrefix << ": scheduler moved " << peephole.movedInstructions << " instructions in "
+         << peephole.scheduledBlocks << " blocks";
+    return text.str();
+}
+
+} // namespace
+
+Driver::Driver(const Options& options, std::ostream& out, std::ostream& err, cminus::CompilerContext* context)
+    : options(options), out(out), err(err),
+      ownedContext(context ? nullptr : new cminus::CompilerContext()),
+      context(context ? *context : *ownedContext) {}
+
+// 编译源代码，出错时输出诊断信息并返回空
+std::unique_ptr<ProgramNode> Driver::compile(const std::string& source, bool analyze) {
+    cminus::CompileOptions compileOptions;
+    compileOptions.analyze = analyze;
+    compileOptions.maxNestingDepth = options.maxNesting;
+    compileOptions.hashConsing = options.hashCons;
+    // 插桩运行不内联、不删改函数，计数器与源代码中的函数一一对应
+    compileOptions.interprocedural = options.profileGenerate.empty() && options.ipo;
+    compileOptions.inlineBudget = options.profileGenerate.empty() ? options.inlineBudget : 0;
+    compileOptions.remarks = options.remarks;
+    Profile profile;
+    if (analyze && !options.profileUse.empty()) {
+        try {
+            if (!profile.load(resolve(options.profileUse))) {
+                err << "Cannot open profile '" << options.profileUse << "'" << std::endl;
+                return nullptr;
+            }
+        } catch (const std::exception& e) {
+            err << e.what() << std::endl;
+            return nullptr;
+        }
+        compileOptions.profile = &profile;
+    }
+    cminus::CompileResult result = context.compile(source, compileOptions);
+    for (const cminus::Diagnostic& remark : result.remarks) {
+        err << remark.message << std::endl;
+    }
+    for (const cminus::Diagnostic& diagnostic : result.diagnostics) {
+        err << diagnostic.message << std::endl;
+    }
+    return std::move(result.program);
+}
+
+// 按 workingDirectory 解析相对路径；诊断和生成的代码中仍使用用户给出的路径
+std::string Driver::resolve(const std::string& path) const {
+    if (options.workingDirectory.empty() || path.empty() || path[0] == '/') {
+        return path;
+    }
+    return options.workingDirectory + "/" + path;
+}
+
+// 读取源代码：请求中自带的源代码、标准输入（"-"）或文件
+bool Driver::loadSource(std::string& source) {
+    stats::PhaseTimer timer("read");
+    if (options.sourceText) {
+        source = *options.sourceText;
+    } else if (options.inputFile == "-") {
+        source.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    } else {
+        std::ifstream file(resolve(options.inputFile));
+        if (!file.is_open()) {
+            err << "Error opening file: " << options.inputFile << std::endl;
+            return false;
+        }
+        source.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    return !source.empty();
+}
+
+// 测试词法分析器
+void Driver::testLexer(const std::string& source) {
+    out << "===== Testing Lexer =====\n";
+
+    std::vector<cminus::Diagnostic> diagnostics;
+    const std::vector<Token>& tokens = context.tokenize(source, diagnostics);
+    for (const auto& token : tokens) {
+        out << "Line " << context.sourceManager().line(token.start) << ": ";
+        out << "Type=" << static_cast<int>(token.type)
+            << ", Lexeme='" << token.lexeme << "'\n";
+    }
+    for (const cminus::Diagnostic& diagnostic : diagnostics) {
+        err << "Lexer error: " << diagnostic.message << std::endl;
+    }
+
+    out << "=========================\n\n";
+}
+
+// 测试语法分析器
+void Driver::testParser(const std::string& source) {
+    out << "===== Testing Parser =====\n";
+
+    try {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        parser.setTrace(true, out);
+        parser.setMaxNestingDepth(options.maxNesting);
+        parser.setHashConsing(options.hashCons);
+        auto ast = parser.parse();
+
+        if (ast) {
+            out << "AST Structure:\n";
+            ast->print(out);
+        } else {
+            out << "Parser returned null AST\n";
+        }
+    } catch (const std::exception& e) {
+        err << "Parser error: " << e.what() << std::endl;
+    }
+
+    out << "==========================\n";
+}
+
+// 输出AST
+int Driver::dumpAST(const std::string& source) {
+    auto ast = compile(source, false);
+    if (!ast) {
+        return 1;
+    }
+    ast->print(out);
+    return 0;
+}
+
+// 流式处理：--tokens 输出Token，--ast 逐个输出声明的AST，否则只做检查。
+// 输入按块读取，内存占用不随输入的长度增长
+int Driver::runStream() {
+    std::ifstream file;
+    std::istringstream text;
+    std::istream* input = &std::cin;
+    if (options.sourceText) {
+        text.str(*options.sourceText);
+        input = &text;
+    } else if (options.inputFile != "-") {
+        file.open(resolve(options.inputFile), std::ios::binary);
+        if (!file.is_open()) {
+            err << "Error opening file: " << options.inputFile << std::endl;
+            return 1;
+        }
+        input = &file;
+    }
+
+    if (options.tokens) {
+        out << "===== Testing Lexer =====\n";
+        try {
+            Lexer lexer(*input);
+            while (true) {
+                Token token = lexer.getNextToken();
+                out << "Line " << lexer.sourceManager()->line(token.start) << ": Type=" << static_cast<int>(token.type)
+                    << ", Lexeme='" << token.lexeme << "'\n";
+                if (token.type == TokenType::END_OF_FILE) break;
+            }
+        } catch (const std::exception& e) {
+            err << "Lexer error: " << e.what() << std::endl;
+        }
+        out << "=========================\n\n";
+        return 0;
+    }
+
+    cminus::CompileOptions compileOptions;
+    compileOptions.analyze = !options.ast;
+    compileOptions.maxNestingDepth = options.maxNesting;
+    compileOptions.hashConsing = options.hashCons;
+    if (options.ast) out << "Program:\n";
+    std::vector<cminus::Diagnostic> diagnostics;
+    uint64_t declarations = 0;
+    bool ok = context.compileStream(*input, [&](ASTNode& decl) {
+        if (options.ast) decl.print(out, 1);
+        declarations++;
+    }, diagnostics, compileOptions);
+    for (const cminus::Diagnostic& diagnostic : diagnostics) {
+        err << diagnostic.message << std::endl;
+    }
+    if (options.stats) {
+        err << "stream: " << declarations << " declarations\n";
+    }
+    return ok ? 0 : 1;
+}
+
+// JIT编译并运行，返回 main 的返回值
+int Driver::runJit(const std::string& source) {
+    using Clock = std::chrono::steady_clock;
+
+    try {
+        auto start = Clock::now();
+        auto ast = compile(source);
+        if (!ast) {
+            return 1;
+        }
+        auto analyzed = Clock::now();
+
+        JitOptions jitOptions;
+        jitOptions.optLevel = options.optLevel;
+        jitOptions.vectorIsa = options.vectorIsa;
+        jitOptions.remarks = options.remarks;
+        jitOptions.boundsChecks = options.boundsCheck;
+        jitOptions.instrument = !options.profileGenerate.empty();
+        if (sampling()) {
+            jitOptions.samplePeriod = options.samplePeriod > 0 ? options.samplePeriod : defaultJitSamplePeriod;
+        }
+        JitCompiler jit(jitOptions);
+        {
+            stats::PhaseTimer timer("jit");
+            jit.compile(*ast);
+        }
+        for (const LoopRemark& remark : jit.remarks()) {
+            err << "Remark: " << remark.message << " at line " << ast->sources->line(remark.start) << std::endl;
+        }
+        auto ready = Clock::now();
+        const JitStats& jitStats = jit.stats();
+        stats::addCounter("jit.functions", jitStats.functions);
+        stats::addCounter("jit.codeBytes", jitStats.codeBytes);
+        stats::addCounter("jit.loops.vectorized", jitStats.vectorizedLoops);
+        stats::addCounter("jit.loops.unrolled", jitStats.unrolledLoops);
+        if (options.boundsCheck) {
+            stats::addCounter("jit.bounds.accesses", jitStats.boundsAccesses);
+            stats::addCounter("jit.bounds.checks", jitStats.boundsChecks);
+        }
+        std::string peephole = options.optLevel >= 1 ? reportPeephole(jitStats.peephole, "jit") : "";
+
+        if (options.stats) {
+            const JitStats& stats = jitStats;
+            auto micros = [](Clock::duration d) {
+                return std::chrono::duration<double, std::micro>(d).count();
+            };
+            err << "jit: tier " << options.optLevel << ", " << stats.functions << " functions, "
+                << stats.codeBytes << " bytes of code, " << stats.memoryBytes << " bytes mapped\n"
+                << "jit: front end " << micros(analyzed - start) << " us, codegen " << stats.codegenMicros
+                << " us, assemble " << stats.assembleMicros << " us, link " << stats.linkMicros << " us\n"
+                << "jit: source to first instruction " << micros(ready - start) << " us\n"
+                << "jit: " << stats.tailCalls << " tail calls turned into jumps\n"
+                << "jit: " << stats.vectorizedLoops << " loops vectorized (" << x86::vectorIsaName(options.vectorIsa)
+                << "), " << stats.unrolledLoops << " unrolled\n";
+            if (options.boundsCheck) {
+                err << "jit: " << stats.boundsChecks << " of " << stats.boundsAccesses
+                    << " array accesses keep their bounds check\n";
+            }
+            if (!peephole.empty()) {
+                err << "jit: " << peephole << "\n";
+            }
+        }
+
+        int result;
+        {
+            stats::PhaseTimer timer("execute");
+            result = jit.run();
+            out.flush();
+        }
+        if (sampling()) {
+            SampleProfile samples;
+            uint64_t dropped = jit.collectSamples(samples);
+            if (options.stats) {
+                err << "jit: " << samples.samples() << " samples, " << dropped << " dropped\n";
+            }
+            writeSamples(samples, &source);
+        }
+        if (!options.profileGenerate.empty()) {
+            // 与已有的剖析文件合并
+            stats::PhaseTimer timer("profile");
+            std::string path = resolve(options.profileGenerate);
+            Profile profile;
+            profile.load(path);
+            jit.collectProfile(profile);
+            profile.save(path);
+        }
+        return result;
+    } catch (const std::exception& e) {
+        err << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// 用树遍历解释器运行
+int Driver::runInterpreter(const std::string& source) {
+    try {
+        auto ast = compile(source);
+        if (!ast) {
+            return 1;
+        }
+        Interpreter interpreter;
+        int result;
+        {
+            stats::PhaseTimer timer("execute");
+            result = interpreter.run(*ast);
+            out.flush();
+        }
+        if (options.stats) {
+            const InterpreterStats& stats = interpreter.stats();
+            err << "interp: " << stats.calls << " calls, " << stats.tailCalls
+                << " executed as tail calls in the caller's frame\n";
+        }
+        return result;
+    } catch (const std::exception& e) {
+        err << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// 以解释器为基准比较各执行引擎：所有引擎读取相同的输入（标准输入的全部内容），
+// 输出和返回值必须与解释器一致。各引擎的时间包括编译和运行。
+int Driver::runBenchmark(const std::string& source) {
+    using Clock = std::chrono::steady_clock;
+
+    struct Engine {
+        const char* name;
+        std::function<int(const ProgramNode&)> run;
+    };
+    struct Result {
+        std::string output;
+        std::string error;
+        int exitCode = 0;
+        double millis = 0;
+    };
+
+    std::unique_ptr<ProgramNode> ast = compile(source);
+    if (!ast) {
+        return 1;
+    }
+    std::string input((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+
+    auto runJitTier = [](const ProgramNode& program, int optLevel) {
+        JitOptions jitOptions;
+        jitOptions.optLevel = optLevel;
+        JitCompiler jit(jitOptions);
+        jit.compile(program);
+        return jit.run();
+    };
+    const std::vector<Engine> engines = {
+        {"interp", [](const ProgramNode& program) {
+            Interpreter interpreter;
+            return interpreter.run(program);
+        }},
+        {"vm", [](const ProgramNode& program) {
+            BytecodeModule module;
+            BytecodeCompiler compiler;
+            compiler.compile(program, module);
+            VirtualMachine vm(module);
+            return vm.run();
+        }},
+        {"jit -O0", [&](const ProgramNode& program) { return runJitTier(program, 0); }},
+        {"jit -O1", [&](const ProgramNode& program) { return runJitTier(program, 1); }},
+    };
+
+    std::vector<Result> results(engines.size());
+    for (size_t i = 0; i < engines.size(); i++) {
+        Result& result = results[i];
+        runtime::redirect(&input, &result.output);
+        auto start = Clock::now();
+        try {
+            result.exitCode = engines[i].run(*ast);
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        result.millis = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        runtime::restore();
+    }
+
+    bool consistent = true;
+    err << std::left << std::setw(10) << "engine" << std::right << std::setw(12) << "time (ms)"
+        << std::setw(10) << "speedup" << "  result\n";
+    for (size_t i = 0; i < engines.size(); i++) {
+        const Result& result = results[i];
+        bool same = result.output == results[0].output && result.exitCode == results[0].exitCode &&
+                    result.error == results[0].error;
+        consistent = consistent && same;
+        std::ostringstream speedup;
+        speedup << std::fixed << std::setprecision(2) << results[0].millis / result.millis << "x";
+        err << std::left << std::setw(10) << engines[i].name << std::right << std::fixed
+            << std::setprecision(3) << std::setw(12) << result.millis << std::setw(10) << speedup.str()
+            << "  " << (result.error.empty() ? "exit " + std::to_string(result.exitCode) : result.error)
+            << (same ? "" : "  MISMATCH") << "\n";
+    }
+
+    out << results[0].output;
+    out.flush();
+    if (!consistent) {
+        err << "bench: engines disagree with the interpreter\n";
+        return 1;
+    }
+    return results[0].exitCode;
+}
+
+// 生成C代码，写到 -o 指定的文件或输出流
+int Driver::emitC(const std::string& source) {
+    std::FILE* file = nullptr;
+    try {
+        auto ast = compile(source);
+        if (!ast) {
+            return 1;
+        }
+        if (!options.outputFile.empty()) {
+            file = std::fopen(resolve(options.outputFile).c_str(), "w");
+            if (!file) {
+                err << "Cannot open '" << options.outputFile << "' for writing" << std::endl;
+                return 1;
+            }
+        }
+        {
+            stats::PhaseTimer timer("emit-c");
+            std::unique_ptr<BufferedWriter> writer(file ? new BufferedWriter(file) : new BufferedWriter(out));
+            CEmitter emitter(*writer, options.inputFile);
+            emitter.setBoundsChecks(options.boundsCheck);
+            emitter.emit(*ast);
+            writer->flush();
+            if (options.remarks) {
+                for (const BoundsReport& report : emitter.boundsReports()) {
+                    if (report.accesses == 0) continue;
+                    err << "Remark: " << report.checks << " of " << report.accesses << " bounds checks remain in '"
+                        << report.function->identifier << "' at line " << ast->sources->line(report.function->start)
+                        << std::endl;
+                }
+            }
+            if (options.stats) {
+                err << "cemit: " << emitter.tailCallCount() << " tail calls turned into jumps\n";
+            }
+        }
+        if (file && std::fclose(file) != 0) {
+            err << "Failed to write '" << options.outputFile << "'" << std::endl;
+            return 1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        if (file) std::fclose(file);
+        err << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// 生成本机代码：写入ELF目标文件（--emit=obj）和/或输出反汇编列表（--dump-asm）
+int Driver::emitObject(const std::string& source) {
+    try {
+        auto ast = compile(source);
+        if (!ast) {
+            return 1;
+        }
+
+        x86::Module module;
+        x86::PeepholeStats peephole;
+        {
+            stats::PhaseTimer timer("codegen");
+            CodegenOptions codegenOptions;
+            codegenOptions.optLevel = options.optLevel;
+            codegenOptions.vectorIsa = options.vectorIsa;
+            codegenOptions.remarks = options.remarks;
+            codegenOptions.boundsChecks = options.boundsCheck;
+            codegenOptions.lineTable = options.dumpAsm;
+            CodeGenerator generator(codegenOptions);
+            module = generator.generate(*ast);
+            peephole = generator.peepholeStats();
+            for (const LoopRemark& remark : generator.remarks()) {
+                err << "Remark: " << remark.message << " at line " << ast->sources->line(remark.start) << std::endl;
+            }
+        }
+        x86::ObjectCode object;
+        std::vector<uint64_t> offsets;
+        {
+            stats::PhaseTimer timer("assemble");
+            object = x86::assemble(module, options.dumpAsm ? &offsets : nullptr);
+        }
+        stats::addCounter("obj.codeBytes", object.text.size());
+        stats::addCounter("obj.relocations", object.relocs.size());
+        std::string peepholeReport = options.optLevel >= 1 ? reportPeephole(peephole, "obj") : "";
+
+        if (options.dumpAsm) {
+            x86::printListing(out, module, object, offsets);
+        }
+        if (options.emit == "obj") {
+            stats::PhaseTimer timer("write");
+            writeElfObject(object, options.inputFile == "-" ? "a.cm" : options.inputFile, resolve(outputName(".o")));
+        }
+        if (options.stats) {
+            err << "obj: " << module.functions.size() << " functions, " << object.text.size() << " bytes of code, "
+                << object.relocs.size() << " relocations\n";
+            if (!peepholeReport.empty()) {
+                err << "obj: " << peepholeReport << "\n";
+            }
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        err << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// -o 指定的输出文件，未指定时把输入文件的 .cm 换成 suffix
+std::string Driver::outputName(const char* suffix) const {
+    if (!options.outputFile.empty()) return options.outputFile;
+    std::string output = options.inputFile == "-" ? "a.cm" : options.inputFile;
+    if (hasSuffix(output, ".cm")) output.resize(output.size() - 3);
+    return output + suffix;
+}
+
+// 在虚拟机上运行字节码模块，source 为编译模块的源代码（从 .cmb 加载时为空）
+int Driver::runModule(const BytecodeModule& module, const std::string* source) {
+    if (options.dumpBytecode) {
+        module.disassemble(out);
+        return 0;
+    }
+    VmOptions vmOptions;
+    if (sampling()) {
+        vmOptions.samplePeriod = options.samplePeriod > 0 ? options.samplePeriod : defaultVmSamplePeriod;
+    }
+    VirtualMachine vm(module, vmOptions);
+    int result;
+    {
+        stats::PhaseTimer timer("execute");
+        result = vm.run();
+        out.flush();
+    }
+    if (options.stats) {
+        const VmStats& stats = vm.stats();
+        err << "vm: " << stats.calls << " calls, " << stats.tailCalls
+            << " executed as tail calls in the caller's frame\n";
+    }
+    if (sampling()) {
+        SampleProfile samples;
+        vm.collectSamples(samples);
+        if (options.stats) {
+            err << "vm: " << samples.samples() << " samples\n";
+        }
+        writeSamples(samples, source);
+    }
+    return result;
+}
+
+bool Driver::sampling() const {
+    return !options.sampleFolded.empty() || !options.sampleListing.empty();
+}
+
+// 写出采样剖析的结果
+void Driver::writeSamples(const SampleProfile& samples, const std::string* source) {
+    stats::PhaseTimer timer("samples");
+    stats::addCounter("sample.samples", samples.samples());
+    auto write = [this](const std::string& name, const std::function<void(std::ostream&)>& print) {
+        std::ofstream file(resolve(name), std::ios::trunc);
+        print(file);
+        file.close();
+        if (!file) {
+            throw std::runtime_error("Failed to write '" + name + "'");
+        }
+    };
+    if (!options.sampleFolded.empty()) {
+        write(options.sampleFolded, [&samples](std::ostream& file) { samples.writeFolded(file); });
+    }
+    if (!options.sampleListing.empty() && source) {
+        write(options.sampleListing, [&](std::ostream& file) { samples.writeListing(file, *source); });
+    }
+}
+
+// 编译为字节码：写入 .cmb 文件、输出反汇编或直接运行
+int Driver::runBytecode(const std::string& source) {
+    try {
+        auto ast = compile(source);
+        if (!ast) {
+            return 1;
+        }
+
+        BytecodeModule module;
+        BytecodeCompiler compiler;
+        std::unique_ptr<FunctionCache> cache;
+        // 缓存中的字节码没有行号，采样时不用
+        if (!options.cacheDir.empty() && !sampling()) {
+            cache.reset(new FunctionCache(resolve(options.cacheDir)));
+            compiler.setCache(cache.get());
+        }
+        {
+            stats::PhaseTimer timer("bytecode");
+            compiler.compile(*ast, module);
+        }
+        stats::addCounter("bytecode.codeWords", module.codeWords());
+        if (cache) {
+            stats::addCounter("cache.hits", compiler.cacheHits());
+            stats::addCounter("cache.misses", compiler.cacheMisses());
+        }
+        if (options.stats) {
+            err << "vm: " << compiler.tailCallCount() << " tail calls compiled to TAILCALL\n";
+            if (cache) {
+                err << "cache: " << compiler.cacheHits() << " functions reused, " << compiler.cacheMisses()
+                    << " compiled\n";
+            }
+        }
+
+        if (options.emit == "cmb") {
+            stats::PhaseTimer timer("save");
+            module.save(resolve(outputName(".cmb")));
+            return 0;
+        }
+        return runModule(module, &source);
+    } catch (const std::exception& e) {
+        err << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// 加载 .cmb 文件并运行
+int Driver::runBytecodeFile() {
+    try {
+        BytecodeModule module;
+        {
+            stats::PhaseTimer timer("load");
+            BytecodeModule::load(resolve(options.inputFile), module);
+        }
+        return runModule(module);
+    } catch (const std::exception& e) {
+        err << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// 按选项执行编译或运行
+int Driver::dispatch() {
+    // 字节码文件直接映射到内存执行
+    if (hasSuffix(options.inputFile, ".cmb")) {
+        return runBytecodeFile();
+    }
+
+    if (options.stream) {
+        return runStream();
+    }
+
+    // 读取源文件
+    std::string source;
+    if (!loadSource(source)) {
+        return 1;
+    }
+
+    if (options.bench) {
+        return runBenchmark(source);
+    }
+    if (options.interp) {
+        return runInterpreter(source);
+    }
+    if (options.jit) {
+        return runJit(source);
+    }
+    if (options.emit == "c") {
+        return emitC(source);
+    }
+    if (options.emit == "obj" || options.dumpAsm) {
+        return emitObject(source);
+    }
+    if (options.vm || options.dumpBytecode || !options.emit.empty()) {
+        return runBytecode(source);
+    }
+    if (options.ast) {
+        return dumpAST(source);
+    }
+
+    // 测试词法分析器
+    testLexer(source);
+
+    if (options.tokens) {
+        return 0;
+    }
+
+    // 测试语法分析器
+    testParser(source);
+
+    return 0;
+}
+
+int Driver::run() {
+    bool report = options.timeReport || options.memReport || !options.statsJson.empty();
+    if (report) {
+        stats::enable();
+    }
+    int result = dispatch();
+    if (report) {
+        out.flush();
+        if (options.timeReport) stats::printTimeReport(err);
+        if (options.memReport) stats::printMemReport(err);
+        if (!options.statsJson.empty()) {
+            try {
+                stats::writeJson(resolve(options.statsJson), options.inputFile, result);
+            } catch (const std::exception& e) {
+                err << e.what() << std::endl;
+                result = 1;
+            }
+        }
+        stats::reset();
+    }
+    return result;
+}
+
+bool isCompileOnly(const Options& options) {
+    if (hasSuffix(options.inputFile, ".cmb") || options.bench || options.interp || options.jit) {
+        return false;
+    }
+    return !options.vm || options.dumpBytecode || options.dumpAsm || !options.emit.empty();
+}
+
+void printUsage(const char* program, std::ostream& err) {
+    err << "Usage: " << program << " <input_file.cm|input_file.cmb|-> [options]\n"
+        << "Options:\n"
+        << "  --tokens      Print tokens only\n"
+        << "  --ast         Print the AST only\n"
+        << "  --stream      Read the input in chunks and handle one declaration at a time\n"
+        << "                (with --tokens, --ast, or alone to check the program)\n"
+        << "  --jit         Compile to native code in memory and run main\n"
+        << "  --stats       Print engine statistics (JIT timings, calls, tail calls) to stderr\n"
+        << "  -O, -O1       Use the optimizing tier\n"
+        << "  --interp      Run with the tree-walking reference interpreter\n"
+        << "  --bench       Run every engine on the same input and compare with the interpreter\n"
+        << "  --vm          Compile to bytecode and run it on the VM\n"
+        << "  --emit=cmb    Write a bytecode file (see -o)\n"
+        << "  --emit=c      Write portable C source (to -o or stdout)\n"
+        << "  --emit=obj    Write an x86-64 ELF object file (see -o); link it with libcminus\n"
+        << "  --dump-bytecode  Print the bytecode disassembly\n"
+        << "  --dump-asm    Print the native code with offsets, encoded bytes and source lines\n"
+        << "  -o <file>     Output file name\n"
+        << "  --time-report Print the time spent in each compiler phase to stderr\n"
+        << "  --mem-report  Print memory allocated in each phase and peak RSS to stderr\n"
+        << "  --stats-json=<file>  Write phase timings and counters as JSON\n"
+        << "  --max-nesting=<N>    Maximum nesting of expressions and statements (default: "
+        << Parser::defaultMaxNestingDepth << ")\n"
+        << "  --hash-cons          Share structurally identical expression subtrees in the AST\n"
+        << "  --ipo                Drop functions and globals unreachable from main and propagate\n"
+        << "                       constant arguments, globals and return values across calls;\n"
+        << "                       evaluate pure calls with constant arguments at compile time\n"
+        << "  --inline[=<N>]       Inline functions of up to N AST nodes into their callers (default: "
+        << InlineOptions::defaultBudget << ")\n"
+        << "  --remarks            Print interprocedural, inlining, loop, branch layout and\n"
+        << "                       bounds-check decisions\n"
+        << "  --vector-isa=<isa>   Vector instructions of the optimizing JIT tier: none, sse2, sse4.1\n"
+        << "                       or avx2 (default: the best one this processor supports)\n"
+        << "  --bounds-check       Check array indices in JIT code and emitted C, except where a\n"
+        << "                       value-range analysis proves them in range\n"
+        << "  --profile-generate[=<file>]  With --jit, count how often functions, branches, loops\n"
+        << "                       and calls run and add the counts to <file> at exit\n"
+        << "                       (default: " << defaultProfile << ")\n"
+        << "  --profile-use[=<file>]  Use the counts for inlining, branch layout and loop unrolling\n"
+        << "  --sample-folded=<file>   With --jit or --vm, sample the call stack while the program\n"
+        << "                       runs and write folded stacks for flame graph tools\n"
+        << "  --sample-listing=<file>  Same, but write the source annotated with the share of\n"
+        << "                       samples on each line\n"
+        << "  --sample-period=<N>  Sample every N VM instructions (default: " << defaultVmSamplePeriod
+        << ")\n"
+        << "                       or N microseconds of JIT CPU time (default: " << defaultJitSamplePeriod
+        << ")\n"
+        << "  --cache-dir=<dir>    Reuse the bytecode of unchanged functions from <dir>\n"
+        << "  --serve[=<socket>]   Run as a compile server on a Unix domain socket\n"
+        << "                       (default: $CMINUS_SERVER_SOCKET or /tmp/cminus-<uid>.sock)\n"
+        << "  --threads=<N>        Worker threads of the compile server (default: CPU count)\n";
+}
+
+// 解析命令行参数
+bool parseOptions(int argc, const char* const argv[], Options& options, std::ostream& err) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--tokens") == 0) {
+            options.tokens = true;
+        } else if (std::strcmp(arg, "--ast") == 0) {
+            options.ast = true;
+        } else if (std::strcmp(arg, "--stream") == 0) {
+            options.stream = true;
+        } else if (std::strcmp(arg, "--jit") == 0) {
+            options.jit = true;
+        } else if (std::strcmp(arg, "--stats") == 0 || std::strcmp(arg, "--jit-stats") == 0) {
+            options.stats = true;
+        } else if (std::strcmp(arg, "-O") == 0 || std::strcmp(arg, "-O1") == 0) {
+            options.optLevel = 1;
+        } else if (std::strcmp(arg, "-O0") == 0) {
+            options.optLevel = 0;
+        } else if (std::strcmp(arg, "--interp") == 0) {
+            options.interp = true;
+        } else if (std::strcmp(arg, "--bench") == 0) {
+            options.bench = true;
+        } else if (std::strcmp(arg, "--vm") == 0) {
+            options.vm = true;
+        } else if (std::strcmp(arg, "--dump-bytecode") == 0) {
+            options.dumpBytecode = true;
+        } else if (std::strcmp(arg, "--dump-asm") == 0) {
+            options.dumpAsm = true;
+        } else if (std::strncmp(arg, "--emit=", 7) == 0) {
+            options.emit = arg + 7;
+            if (options.emit != "cmb" && options.emit != "c" && options.emit != "obj") {
+                err << "Unknown output format: " << options.emit << "\n";
+                return false;
+            }
+        } else if (std::strcmp(arg, "--time-report") == 0) {
+            options.timeReport = true;
+        } else if (std::strcmp(arg, "--mem-report") == 0) {
+            options.memReport = true;
+        } else if (std::strncmp(arg, "--stats-json=", 13) == 0) {
+            options.statsJson = arg + 13;
+        } else if (std::strncmp(arg, "--max-nesting=", 14) == 0) {
+            options.maxNesting = std::atoi(arg + 14);
+            if (options.maxNesting <= 0) {
+                err << "Invalid nesting limit: " << (arg + 14) << "\n";
+                return false;
+            }
+        } else if (std::strcmp(arg, "--hash-cons") == 0) {
+            options.hashCons = true;
+        } else if (std::strcmp(arg, "--ipo") == 0) {
+            options.ipo = true;
+        } else if (std::strcmp(arg, "--inline") == 0) {
+            options.inlineBudget = InlineOptions::defaultBudget;
+        } else if (std::strncmp(arg, "--inline=", 9) == 0) {
+            options.inlineBudget = std::atoi(arg + 9);
+            if (options.inlineBudget <= 0) {
+                err << "Invalid inline budget: " << (arg + 9) << "\n";
+                return false;
+            }
+        } else if (std::strcmp(arg, "--remarks") == 0) {
+            options.remarks = true;
+        } else if (std::strncmp(arg, "--vector-isa=", 13) == 0) {
+            const x86::VectorIsa all[] = {x86::VectorIsa::NONE, x86::VectorIsa::SSE2, x86::VectorIsa::SSE41,
+                                          x86::VectorIsa::AVX2};
+            auto found = std::find_if(std::begin(all), std::end(all), [arg](x86::VectorIsa isa) {
+                return std::strcmp(arg + 13, x86::vectorIsaName(isa)) == 0;
+            });
+            if (found == std::end(all)) {
+                err << "Unknown vector ISA: " << (arg + 13) << "\n";
+                return false;
+            }
+            if (*found > x86::hostVectorIsa()) {
+                err << "Vector ISA " << (arg + 13) << " is not supported by this processor\n";
+                return false;
+            }
+            options.vectorIsa = *found;
+        } else if (std::strcmp(arg, "--bounds-check") == 0) {
+            options.boundsCheck = true;
+        } else if (std::strcmp(arg, "--profile-generate") == 0) {
+            options.profileGenerate = defaultProfile;
+        } else if (std::strncmp(arg, "--profile-generate=", 19) == 0) {
+            options.profileGenerate = arg + 19;
+        } else if (std::strcmp(arg, "--profile-use") == 0) {
+            options.profileUse = defaultProfile;
+        } else if (std::strncmp(arg, "--profile-use=", 14) == 0) {
+            options.profileUse = arg + 14;
+        } else if (std::strncmp(arg, "--sample-folded=", 16) == 0) {
+            options.sampleFolded = arg + 16;
+        } else if (std::strncmp(arg, "--sample-listing=", 17) == 0) {
+            options.sampleListing = arg + 17;
+        } else if (std::strncmp(arg, "--sample-period=", 16) == 0) {
+            options.samplePeriod = std::atoi(arg + 16);
+            if (options.samplePeriod <= 0) {
+                err << "Invalid sample period: " << (arg + 16) << "\n";
+                return false;
+            }
+        } else if (std::strncmp(arg, "--cache-dir=", 12) == 0) {
+            options.cacheDir = arg + 12;
+        } else if (std::strcmp(arg, "--serve") == 0) {
+            options.serve = protocol::defaultSocketPath();
+        } else if (std::strncmp(arg, "--serve=", 8) == 0) {
+            options.serve = arg + 8;
+        } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+            options.threads = std::atoi(arg + 10);
+        } else if (std::strcmp(arg, "-o") == 0) {
+            if (i + 1 >= argc) {
+                err << "Missing file name after -o\n";
+                return false;
+            }
+            options.outputFile = argv[++i];
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            err << "Unknown option: " << arg << "\n";
+            return false;
+        } else if (options.inputFile.empty()) {
+            options.inputFile = arg;
+        } else {
+            err << "Multiple input files given\n";
+            return false;
+        }
+    }
+    if (options.stream && (options.jit || options.interp || options.bench || options.vm || options.dumpBytecode ||
+                           !options.emit.empty() || hasSuffix(options.inputFile, ".cmb"))) {
+        err << "--stream only works with --tokens, --ast or on its own\n";
+        return false;
+    }
+    if (options.dumpAsm && (options.jit || options.interp || options.bench || options.vm || options.dumpBytecode ||
+                            (!options.emit.empty() && options.emit != "obj") || hasSuffix(options.inputFile, ".cmb"))) {
+        err << "--dump-asm only works with --emit=obj or on its own\n";
+        return false;
+    }
+    if (!options.profileGenerate.empty() && (!options.jit || options.bench)) {
+        err << "--profile-generate only works with --jit\n";
+        return false;
+    }
+    if (!options.sampleFolded.empty() || !options.sampleListing.empty()) {
+        bool cmb = hasSuffix(options.inputFile, ".cmb");
+        bool vmRun = (options.vm || cmb) && !options.dumpBytecode && options.emit.empty();
+        if (options.bench || options.interp || options.stream || !(options.jit || vmRun)) {
+            err << "--sample-folded and --sample-listing only work with --jit or --vm\n";
+            return false;
+        }
+        if (!options.sampleListing.empty() && cmb) {
+            err << "--sample-listing needs the .cm source file\n";
+            return false;
+        }
+    } else if (options.samplePeriod > 0) {
+        err << "--sample-period needs --sample-folded or --sample-listing\n";
+        return false;
+    }
+    return !options.inputFile.empty() || !options.serve.empty();
+}
@@ -0,0 +1,188 @@
+#include "elfwriter.h"
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <stdexcept>
+
+using namespace x86;
+
+namespace {
+
+// 节的编号
+enum SectionIndex : uint16_t {
+    NULL_SECTION,
+    TEXT_SECTION,
+    DATA_SECTION,
+    BSS_SECTION,
+    RELA_SECTION,
+    SYMTAB_SECTION,
+    STRTAB_SECTION,
+    SHSTRTAB_SECTION,
+    NOTE_SECTION,  // .note.GNU-stack：不需要可执行栈
+    NUM_SECTIONS
+};
+
+// 字符串表：以空串开头，返回名字的偏移
+class StringTable {
+public:
+    StringTable() : text(1, '\0') {}
+
+    uint32_t add(const std::string& name) {
+        uint32_t offset = static_cast<uint32_t>(text.size());
+        text += name;
+        text += '\0';
+        return offset;
+    }
+
+    const std::string& data() const { return text; }
+
+private:
+    std::string text;
+};
+
+template <typename T>
+void append(std::vector<uint8_t>& image, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    image.insert(image.end(), bytes, bytes + sizeof(T));
+}
+
+void appendBytes(std::vector<uint8_t>& image, const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    image.insert(image.end(), bytes, bytes + size);
+}
+
+void alignImage(std::vector<uint8_t>& image, size_t alignment) {
+    image.resize((image.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+uint16_t sectionOf(Section section) {
+    switch (section) {
+        case Section::TEXT: return TEXT_SECTION;
+        case Section::DATA: return DATA_SECTION;
+        case Section::BSS:  return BSS_SECTION;
+        case Section::UNDEF: break;
+    }
+    return SHN_UNDEF;
+}
+
+} // namespace
+
+std::vector<uint8_t> elfObject(const ObjectCode& object, const std::string& sourceName) {
+    // 符号表：局部符号必须排在全局符号之前
+    StringTable strtab;
+    std::vector<Elf64_Sym> symbols(1);  // 0 号为空符号
+    std::vector<uint32_t> symbolIndex(object.symbols.size(), 0);
+
+    Elf64_Sym file{};
+    file.st_name = strtab.add(sourceName.substr(sourceName.find_last_of('/') + 1));
+    file.st_info = ELF64_ST_INFO(STB_LOCAL, STT_FILE);
+    file.st_shndx = SHN_ABS;
+    symbols.push_back(file);
+
+    auto isGlobal = [](const Symbol& symbol) { return symbol.section == Section::UNDEF || symbol.name == "main"; };
+    uint32_t firstGlobal = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) firstGlobal = static_cast<uint32_t>(symbols.size());
+        for (size_t i = 0; i < object.symbols.size(); i++) {
+            const Symbol& symbol = object.symbols[i];
+            if (isGlobal(symbol) != (pass == 1)) continue;
+            Elf64_Sym entry{};
+            entry.st_name = strtab.add(symbol.name);
+            unsigned char type = symbol.section == Section::UNDEF ? STT_NOTYPE
+                                 : symbol.isFunction              ? STT_FUNC
+                                                                  : STT_OBJECT;
+            entry.st_info = ELF64_ST_INFO(pass == 1 ? STB_GLOBAL : STB_LOCAL, type);
+            entry.st_shndx = sectionOf(symbol.section);
+            if (symbol.section != Section::UNDEF) {
+                entry.st_value = symbol.offset;
+                entry.st_size = symbol.size;
+            }
+            symbolIndex[i] = static_cast<uint32_t>(symbols.size());
+            symbols.push_back(entry);
+        }
+    }
+
+    std::vector<Elf64_Rela> relocations;
+    relocations.reserve(object.relocs.size());
+    for (const Reloc& reloc : object.relocs) {
+        Elf64_Rela entry{};
+        entry.r_offset = reloc.offset;
+        uint32_t type = reloc.kind == RelocKind::PLT32 ? R_X86_64_PLT32 : R_X86_64_PC32;
+        entry.r_info = ELF64_R_INFO(static_cast<uint64_t>(symbolIndex[reloc.symbol]), type);
+        entry.r_addend = reloc.addend;
+        relocations.push_back(entry);
+    }
+
+    StringTable shstrtab;
+    Elf64_Shdr headers[NUM_SECTIONS] = {};
+    auto describe = [&](SectionIndex index, const char* name, uint32_t type, uint64_t flags, uint64_t alignment) {
+        headers[index].sh_name = shstrtab.add(name);
+        headers[index].sh_type = type;
+        headers[index].sh_flags = flags;
+        headers[index].sh_addralign = alignment;
+    };
+    describe(TEXT_SECTION, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16);
+    describe(DATA_SECTION, ".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 8);
+    describe(BSS_SECTION, ".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 16);
+    describe(RELA_SECTION, ".rela.text", SHT_RELA, SHF_INFO_LINK, 8);
+    describe(SYMTAB_SECTION, ".symtab", SHT_SYMTAB, 0, 8);
+    describe(STRTAB_SECTION, ".strtab", SHT_STRTAB, 0, 1);
+    describe(SHSTRTAB_SECTION, ".shstrtab", SHT_STRTAB, 0, 1);
+    describe(NOTE_SECTION, ".note.GNU-stack", SHT_PROGBITS, 0, 1);
+
+    headers[RELA_SECTION].sh_link = SYMTAB_SECTION;
+    headers[RELA_SECTION].sh_info = TEXT_SECTION;
+    headers[RELA_SECTION].sh_entsize = sizeof(Elf64_Rela);
+    headers[SYMTAB_SECTION].sh_link = STRTAB_SECTION;
+    headers[SYMTAB_SECTION].sh_info = firstGlobal;
+    headers[SYMTAB_SECTION].sh_entsize = sizeof(Elf64_Sym);
+    headers[BSS_SECTION].sh_size = object.bssSize;
+
+    // 文件布局：ELF头、各节内容、节头表
+    std::vector<uint8_t> image(sizeof(Elf64_Ehdr), 0);
+    auto place = [&](SectionIndex index, const void* data, size_t size) {
+        alignImage(image, headers[index].sh_addralign);
+        headers[index].sh_offset = image.size();
+        headers[index].sh_size = size;
+        appendBytes(image, data, size);
+    };
+    place(TEXT_SECTION, object.text.data(), object.text.size());
+    place(DATA_SECTION, object.data.data(), object.data.size());
+    headers[BSS_SECTION].sh_offset = image.size();
+    place(RELA_SECTION, relocations.data(), relocations.size() * sizeof(Elf64_Rela));
+    place(SYMTAB_SECTION, symbols.data(), symbols.size() * sizeof(Elf64_Sym));
+    place(STRTAB_SECTION, strtab.data().data(), strtab.data().size());
+    place(SHSTRTAB_SECTION, shstrtab.data().data(), shstrtab.data().size());
+    headers[NOTE_SECTION].sh_offset = image.size();
+
+    alignImage(image, 8);
+    Elf64_Ehdr header{};
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    header.e_type = ET_REL;
+    header.e_machine = EM_X86_64;
+    header.e_version = EV_CURRENT;
+    header.e_shoff = image.size();
+    header.e_ehsize = sizeof(Elf64_Ehdr);
+    header.e_shentsize = sizeof(Elf64_Shdr);
+    header.e_shnum = NUM_SECTIONS;
+    header.e_shstrndx = SHSTRTAB_SECTION;
+    std::memcpy(image.data(), &header, sizeof header);
+    for (const Elf64_Shdr& section : headers) {
+        append(image, section);
+    }
+    return image;
+}
+
+void writeElfObject(const ObjectCode& object, const std::string& sourceName, const std::string& path) {
+    std::vector<uint8_t> image = elfObject(object, sourceName);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Failed to write '" + path + "'");
+    }
+}
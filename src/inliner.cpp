@@ -0,0 +1,721 @@
+#include "inliner.h"
+#include "semantic.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// 子树的大小：AST节点数
+int treeSize(const ASTNode& node) {
+    int size = 1;
+    visitChildren(node, [&size](const ASTNode& child) { size += treeSize(child); });
+    return size;
+}
+
+// 语句中 return 的分布
+enum class Returns {
+    NONE,     // 没有 return
+    ALWAYS,   // 每条路径都以 return 结束
+    MIXED,    // 有的路径 return，有的继续执行后续语句
+    IN_LOOP   // 循环中有 return
+};
+
+Returns returnsOf(const ASTNode* stmt) {
+    switch (stmt->type) {
+        case ASTNodeType::RETURN_STMT:
+            return Returns::ALWAYS;
+
+        case ASTNodeType::COMPOUND_STMT: {
+            Returns result = Returns::NONE;
+            for (const auto& s : static_cast<const CompoundStmtNode*>(stmt)->statements) {
+                Returns r = returnsOf(s.get());
+                if (r == Returns::IN_LOOP || r == Returns::ALWAYS) return r;
+                if (r == Returns::MIXED) result = Returns::MIXED;
+            }
+            return result;
+        }
+
+        case ASTNodeType::SELECTION_STMT: {
+            auto* selectionStmt = static_cast<const SelectionStmtNode*>(stmt);
+            Returns a = returnsOf(selectionStmt->ifBranch.get());
+            Returns b = selectionStmt->elseBranch ? returnsOf(selectionStmt->elseBranch.get()) : Returns::NONE;
+            if (a == Returns::IN_LOOP || b == Returns::IN_LOOP) return Returns::IN_LOOP;
+            return a == b ? a : Returns::MIXED;
+        }
+
+        case ASTNodeType::ITERATION_STMT:
+            return returnsOf(static_cast<const IterationStmtNode*>(stmt)->body.get()) == Returns::NONE
+                       ? Returns::NONE
+                       : Returns::IN_LOOP;
+
+        default:
+            return Returns::NONE;
+    }
+}
+
+// 分支中的语句序列（非复合语句的分支视为只有一条语句）
+std::vector<const ASTNode*> statementsOf(const ASTNode* stmt) {
+    std::vector<const ASTNode*> stmts;
+    if (!stmt) return stmts;
+    if (stmt->type != ASTNodeType::COMPOUND_STMT) {
+        stmts.push_back(stmt);
+        return stmts;
+    }
+    for (const auto& s : static_cast<const CompoundStmtNode*>(stmt)->statements) stmts.push_back(s.get());
+    return stmts;
+}
+
+// 位于函数末尾的语句序列能否把 return 改写为赋值而不复制语句（与 Inliner::rewriteReturns 对应）。
+// 可以时返回空，否则返回原因
+const char* returnsAtTail(const std::vector<const ASTNode*>& stmts) {
+    for (size_t k = 0; k < stmts.size(); k++) {
+        const ASTNode* stmt = stmts[k];
+        Returns r = returnsOf(stmt);
+        if (r == Returns::NONE) continue;
+        if (r == Returns::IN_LOOP) return "returns from inside a loop";
+        if (stmt->type == ASTNodeType::RETURN_STMT) return nullptr;
+
+        // return 之后的语句不可达，MIXED 时后续语句移入不 return 的分支
+        std::vector<const ASTNode*> rest;
+        if (r == Returns::MIXED) rest.assign(stmts.begin() + k + 1, stmts.end());
+        if (stmt->type == ASTNodeType::COMPOUND_STMT) {
+            std::vector<const ASTNode*> inner = statementsOf(stmt);
+            inner.insert(inner.end(), rest.begin(), rest.end());
+            return returnsAtTail(inner);
+        }
+
+        auto* selectionStmt = static_cast<const SelectionStmtNode*>(stmt);
+        const ASTNode* branches[2] = {selectionStmt->ifBranch.get(), selectionStmt->elseBranch.get()};
+        bool always[2] = {returnsOf(branches[0]) == Returns::ALWAYS,
+                          branches[1] && returnsOf(branches[1]) == Returns::ALWAYS};
+        if (!rest.empty() && !always[0] && !always[1]) return "returns from a branch that falls through";
+        for (int i = 0; i < 2; i++) {
+            std::vector<const ASTNode*> branch = statementsOf(branches[i]);
+            if (!always[i]) branch.insert(branch.end(), rest.begin(), rest.end());
+            if (const char* reason = returnsAtTail(branch)) return reason;
+        }
+        return nullptr;
+    }
+    return nullptr;
+}
+
+// 把分支换成复合语句（空分支换成空的复合语句）
+CompoundStmtNode& asCompound(std::unique_ptr<ASTNode>& stmt, SourceOffset start) {
+    if (!stmt || stmt->type != ASTNodeType::COMPOUND_STMT) {
+        auto compound = std::make_unique<CompoundStmtNode>(stmt ? stmt->start : start);
+        if (stmt) compound->statements.push_back(std::move(stmt));
+        stmt = std::move(compound);
+    }
+    return static_cast<CompoundStmtNode&>(*stmt);
+}
+
+std::unique_ptr<VarNode> localVar(const std::string& identifier, int slot, SourceOffset start) {
+    auto var = std::make_unique<VarNode>(identifier, start);
+    var->kind = VarKind::LOCAL_SCALAR;
+    var->slot = slot;
+    return var;
+}
+
+// 赋值语句 var = value
+std::unique_ptr<ASTNode> assignment(std::unique_ptr<VarNode> var, std::unique_ptr<ASTNode> value, SourceOffset start) {
+    auto assignExpr = std::make_unique<AssignExprNode>(start);
+    assignExpr->var = std::move(var);
+    assignExpr->expression = std::move(value);
+    auto exprStmt = std::make_unique<ExpressionStmtNode>(start);
+    exprStmt->expression = std::move(assignExpr);
+    return exprStmt;
+}
+
+// 子树中是否给局部标量赋值
+bool assignsLocal(const ASTNode& node) {
+    if (node.type == ASTNodeType::ASSIGN_EXPR &&
+        static_cast<const VarNode&>(*static_cast<const AssignExprNode&>(node).var).kind == VarKind::LOCAL_SCALAR) {
+        return true;
+    }
+    bool found = false;
+    visitChildren(node, [&found](const ASTNode& child) { found = found || assignsLocal(child); });
+    return found;
+}
+
+// 丢弃返回值时可以省去的表达式：常数和标量变量（除法和下标即使无副作用也可能出错）
+bool isTrivial(const ASTNode& expr) {
+    return expr.type == ASTNodeType::NUM ||
+           (expr.type == ASTNodeType::VAR && !static_cast<const VarNode&>(expr).index);
+}
+
+} // namespace
+
+// 语句中已求值部分的影响：blocked 表示可能与被调函数相互影响（读全局变量或数组、
+// 赋值、调用）或可能报错（除法），之后的调用不能提到语句之前；localsRead 表示读过局部标量
+struct Inliner::EvalState {
+    bool blocked = false;
+    bool localsRead = false;
+};
+
+// 被展开函数的存储位置：槽位和局部数组接在调用者的栈帧之后，数组参数换成实参
+struct Inliner::Remap {
+    int slotBase;
+    int arrayBase;
+    std::vector<const VarNode*> arrayArgs;  // 按参数槽位，标量参数为空
+};
+
+Inliner::Inliner(const InlineOptions& options)
+    : options(options), inlined(0), hottestSite(-1), currentCaller(nullptr), callerSize(0), callerLimit(0), sites(0) {}
+
+void Inliner::run(ProgramNode& program) {
+    analyzeCallGraph(program);
+    for (size_t index : order) {
+        inlineFunction(*callees[index].node);
+        callees[index].size = treeSize(*callees[index].node->body);
+    }
+}
+
+// 调用图：记录各函数的调用点数，用 Tarjan 算法（显式栈）求强连通分量，
+// 自身递归或在多于一个函数的分量中的函数是递归的。分量按逆拓扑序产生，被调函数在调用者之前
+void Inliner::analyzeCallGraph(ProgramNode& program) {
+    callees.clear();
+    calleeIndex.clear();
+    order.clear();
+    hottestSite = -1;
+    for (auto& decl : program.declarations) {
+        if (decl->type != ASTNodeType::FUN_DECLARATION) continue;
+        auto* fun = static_cast<FunDeclarationNode*>(decl.get());
+        calleeIndex.emplace(fun, callees.size());
+        callees.push_back(Callee());
+        callees.back().node = fun;
+    }
+
+    std::vector<std::vector<size_t>> edges(callees.size());
+    for (size_t i = 0; i < callees.size(); i++) {
+        std::function<void(const ASTNode&)> collect = [&](const ASTNode& node) {
+            if (node.type == ASTNodeType::CALL) {
+                const FunDeclarationNode* target = static_cast<const CallNode&>(node).callee;
+                if (target) {
+                    hottestSite = std::max(hottestSite, static_cast<const CallNode&>(node).counts.count);
+                    size_t j = calleeIndex.at(target);
+                    edges[i].push_back(j);
+                    callees[j].callSites++;
+                    if (j == i) callees[i].recursive = true;
+                }
+            }
+            visitChildren(node, collect);
+        };
+        collect(*callees[i].node->body);
+    }
+
+    const int unvisited = -1;
+    std::vector<int> index(callees.size(), unvisited);
+    std::vector<int> low(callees.size(), 0);
+    std::vector<bool> onStack(callees.size(), false);
+    std::vector<size_t> stack;
+    std::vector<std::pair<size_t, size_t>> work;  // （函数，下一条边）
+    int nextIndex = 0;
+    for (size_t root = 0; root < callees.size(); root++) {
+        if (index[root] != unvisited) continue;
+        work.emplace_back(root, 0);
+        while (!work.empty()) {
+            size_t v = work.back().first;
+            size_t edge = work.back().second;
+            if (edge == 0 && index[v] == unvisited) {
+                index[v] = low[v] = nextIndex++;
+                stack.push_back(v);
+                onStack[v] = true;
+            }
+            if (edge < edges[v].size()) {
+                work.back().second++;
+                size_t w = edges[v][edge];
+                if (index[w] == unvisited) {
+                    work.emplace_back(w, 0);
+                } else if (onStack[w]) {
+                    low[v] = std::min(low[v], index[w]);
+                }
+                continue;
+            }
+            work.pop_back();
+            if (!work.empty()) {
+                size_t u = work.back().first;
+                low[u] = std::min(low[u], low[v]);
+            }
+            if (low[v] != index[v]) continue;
+            size_t first = order.size();
+            size_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onStack[w] = false;
+                order.push_back(w);
+            } while (w != v);
+            if (order.size() - first > 1) {
+                for (size_t k = first; k < order.size(); k++) callees[order[k]].recursive = true;
+            }
+        }
+    }
+}
+
+// 在一个函数中展开调用
+void Inliner::inlineFunction(FunDeclarationNode& caller) {
+    currentCaller = &caller;
+    callerSize = treeSize(*caller.body);
+    callerLimit = callerSize + 10 * options.budget;
+    sites = 0;
+    decisions.clear();
+    inlineBlock(static_cast<CompoundStmtNode&>(*caller.body), 0);
+    currentCaller = nullptr;
+}
+
+void Inliner::inlineBlock(CompoundStmtNode& block, int loopDepth) {
+    hoistInitializers(block, loopDepth);
+    for (auto& stmt : block.statements) {
+        inlineStatement(stmt, loopDepth);
+    }
+}
+
+// 初始化表达式中有要展开的调用时，从这个声明起把初始化改写为复合语句开头的赋值。
+// 变量仍在进入时清零，各初始化表达式的求值顺序不变
+void Inliner::hoistInitializers(CompoundStmtNode& block, int loopDepth) {
+    auto& decls = block.localDeclarations;
+    size_t first = decls.size();
+    for (size_t i = 0; i < decls.size() && first == decls.size(); i++) {
+        if (decls[i]->type != ASTNodeType::VAR_DECLARATION) continue;
+        auto& initializer = static_cast<VarDeclarationNode&>(*decls[i]).initializer;
+        EvalState state;
+        if (initializer && findSite(initializer, state, loopDepth)) first = i;
+    }
+    if (first == decls.size()) return;
+
+    std::vector<std::unique_ptr<ASTNode>> assignments;
+    for (size_t i = first; i < decls.size(); i++) {
+        if (decls[i]->type != ASTNodeType::VAR_DECLARATION) continue;
+        auto& varDecl = static_cast<VarDeclarationNode&>(*decls[i]);
+        if (!varDecl.initializer) continue;
+        assignments.push_back(assignment(localVar(varDecl.identifier, varDecl.slot, varDecl.start),
+                                         std::move(varDecl.initializer), varDecl.start));
+    }
+    block.statements.insert(block.statements.begin(), std::make_move_iterator(assignments.begin()),
+                            std::make_move_iterator(assignments.end()));
+}
+
+// 反复展开语句中第一个可以展开的调用，再处理其中的子语句。展开的函数体已经处理过，不再展开
+void Inliner::inlineStatement(std::unique_ptr<ASTNode>& stmt, int loopDepth) {
+    std::unique_ptr<ASTNode>* current = &stmt;
+    while (true) {
+        std::unique_ptr<ASTNode>* expr = nullptr;
+        switch ((*current)->type) {
+            case ASTNodeType::EXPRESSION_STMT:
+                expr = &static_cast<ExpressionStmtNode&>(**current).expression;
+                break;
+            case ASTNodeType::RETURN_STMT:
+                expr = &static_cast<ReturnStmtNode&>(**current).expression;
+                break;
+            case ASTNodeType::SELECTION_STMT:
+                expr = &static_cast<SelectionStmtNode&>(**current).condition;
+                break;
+            default:
+                break;
+        }
+        if (!expr || !*expr) break;
+        EvalState state;
+        std::unique_ptr<ASTNode>* site = findSite(*expr, state, loopDepth);
+        if (!site) break;
+        current = expand(*current, *site);
+        if (!current) return;
+    }
+
+    ASTNode& s = **current;
+    switch (s.type) {
+        case ASTNodeType::COMPOUND_STMT:
+            inlineBlock(static_cast<CompoundStmtNode&>(s), loopDepth);
+            break;
+        case ASTNodeType::SELECTION_STMT: {
+            auto& selectionStmt = static_cast<SelectionStmtNode&>(s);
+            inlineStatement(selectionStmt.ifBranch, loopDepth);
+            if (selectionStmt.elseBranch) inlineStatement(selectionStmt.elseBranch, loopDepth);
+            break;
+        }
+        case ASTNodeType::ITERATION_STMT: {
+            auto& iterationStmt = static_cast<IterationStmtNode&>(s);
+            rejectCalls(iterationStmt.condition.get(), "called in a loop condition");
+            inlineStatement(iterationStmt.body, loopDepth + 1);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// 按求值顺序查找第一个要展开的调用
+std::unique_ptr<ASTNode>* Inliner::findSite(std::unique_ptr<ASTNode>& expr, EvalState& state, int loopDepth) {
+    switch (expr->type) {
+        case ASTNodeType::VAR: {
+            auto& var = static_cast<VarNode&>(*expr);
+            if (var.index) {
+                if (auto* site = findSite(var.index, state, loopDepth)) return site;
+                state.blocked = true;
+            } else if (var.kind == VarKind::GLOBAL_SCALAR) {
+                state.blocked = true;
+            } else if (var.kind == VarKind::LOCAL_SCALAR) {
+                state.localsRead = true;
+            }
+            return nullptr;
+        }
+
+        case ASTNodeType::ASSIGN_EXPR: {
+            // 先求下标再求右值，越界检查在求右值之后
+            auto& assignExpr = static_cast<AssignExprNode&>(*expr);
+            auto& var = static_cast<VarNode&>(*assignExpr.var);
+            if (var.index) {
+                if (auto* site = findSite(var.index, state, loopDepth)) return site;
+            }
+            if (auto* site = findSite(assignExpr.expression, state, loopDepth)) return site;
+            state.blocked = true;
+            return nullptr;
+        }
+
+        case ASTNodeType::BIN_OP: {
+            // 除法和取模可能报除零错误，之后的调用不能提到它之前
+            auto& binOp = static_cast<BinOpNode&>(*expr);
+            if (auto* site = findSite(binOp.left, state, loopDepth)) return site;
+            if (auto* site = findSite(binOp.right, state, loopDepth)) return site;
+            if ((binOp.op == TokenType::DIVIDE || binOp.op == TokenType::MOD) &&
+                !(binOp.right->type == ASTNodeType::NUM && static_cast<NumNode&>(*binOp.right).value != 0)) {
+                state.blocked = true;
+            }
+            return nullptr;
+        }
+
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto& simpleExpr = static_cast<SimpleExprNode&>(*expr);
+            if (auto* site = findSite(simpleExpr.left, state, loopDepth)) return site;
+            return findSite(simpleExpr.right, state, loopDepth);
+        }
+
+        case ASTNodeType::CALL: {
+            // 实参中的调用先展开。调用连同实参一起提前：此前读过的局部变量不能被实参修改
+            auto& call = static_cast<CallNode&>(*expr);
+            bool movable = !state.blocked && !(state.localsRead && assignsLocal(call));
+            for (auto& arg : call.args) {
+                if (auto* site = findSite(arg, state, loopDepth)) return site;
+            }
+            if (call.callee && decide(call, !movable, loopDepth)) return &expr;
+            state.blocked = true;
+            return nullptr;
+        }
+
+        default:
+            return nullptr;
+    }
+}
+
+// 是否展开这个调用点，同一调用点只决定一次
+bool Inliner::decide(const CallNode& call, bool blocked, int loopDepth) {
+    auto known = decisions.find(&call);
+    if (known != decisions.end()) return known->second;
+
+    Callee& callee = callees[calleeIndex.at(call.callee)];
+    if (!callee.shapeChecked) {
+        callee.unsuitable = returnsAtTail(statementsOf(callee.node->body.get()));
+        callee.shapeChecked = true;
+    }
+    // 有剖析数据时按执行次数代替循环嵌套：执行次数达到最热调用点的1%时预算乘4
+    int threshold = options.budget;
+    bool profiled = call.counts.count >= 0;
+    if (profiled ? call.counts.count > 0 && call.counts.count * 100 >= hottestSite : loopDepth > 0) {
+        threshold *= profiled ? 4 : 2;
+    }
+    if (callee.callSites == 1) threshold *= 4;
+
+    std::string reason;
+    if (profiled && call.counts.count == 0) {
+        reason = "never executed in the profile";
+    } else if (callee.recursive) {
+        reason = "recursive function";
+    } else if (callee.unsuitable) {
+        reason = callee.unsuitable;
+    } else if (callee.size > threshold) {
+        reason = "cost " + std::to_string(callee.size) + " exceeds threshold " + std::to_string(threshold);
+    } else if (callerSize + callee.size > callerLimit) {
+        reason = "'" + currentCaller->identifier + "' reached its growth limit";
+    } else if (currentCaller->numSlots + callee.node->numSlots + 1 > options.maxFrameSlots) {
+        reason = "frame of '" + currentCaller->identifier + "' would exceed " + std::to_string(options.maxFrameSlots) +
+                 " slots";
+    } else if (callee.node->arrayWords > SemanticAnalyzer::maxArrayWords - currentCaller->arrayWords) {
+        reason = "local arrays of '" + currentCaller->identifier + "' would exceed " +
+                 std::to_string(SemanticAnalyzer::maxArrayWords) + " ints";
+    } else if (blocked) {
+        reason = "evaluated after other side effects of the statement";
+    }
+    bool accept = reason.empty();
+    decisions.emplace(&call, accept);
+    if (options.remarks) {
+        if (accept) {
+            remark(call, "inlined '" + call.identifier + "' into '" + currentCaller->identifier + "' (cost " +
+                             std::to_string(callee.size) + ", threshold " + std::to_string(threshold) + ")");
+        } else {
+            remark(call, "'" + call.identifier + "' not inlined into '" + currentCaller->identifier + "': " + reason);
+        }
+    }
+    return accept;
+}
+
+// 记录不在可展开位置上的调用
+void Inliner::rejectCalls(const ASTNode* expr, const char* reason) {
+    if (!options.remarks) return;
+    if (expr->type == ASTNodeType::CALL) {
+        auto* call = static_cast<const CallNode*>(expr);
+        if (call->callee && decisions.emplace(call, false).second) {
+            remark(*call, "'" + call->identifier + "' not inlined into '" + currentCaller->identifier + "': " + reason);
+        }
+    }
+    visitChildren(*expr, [&](const ASTNode& child) { rejectCalls(&child, reason); });
+}
+
+void Inliner::remark(const CallNode& call, const std::string& message) {
+    remarkList.push_back(InlineRemark{call.start, message});
+}
+
+// 展开语句 stmt 中的调用 site，返回展开后的原语句（调用换成了结果变量）；
+// 原语句只是这个调用时返回空
+std::unique_ptr<ASTNode>* Inliner::expand(std::unique_ptr<ASTNode>& stmt, std::unique_ptr<ASTNode>& site) {
+    auto& call = static_cast<CallNode&>(*site);
+    FunDeclarationNode& callee = *call.callee;
+    FunDeclarationNode& caller = *currentCaller;
+    auto block = std::make_unique<CompoundStmtNode>(stmt->start);
+
+    bool valueUsed = stmt->type != ASTNodeType::EXPRESSION_STMT ||
+                     static_cast<ExpressionStmtNode&>(*stmt).expression.get() != &call;
+    int resultSlot = -1;
+    if (valueUsed) {
+        resultSlot = caller.numSlots++;
+        auto result = std::make_unique<VarDeclarationNode>("int", callee.identifier, call.start);
+        result->slot = resultSlot;
+        block->localDeclarations.push_back(std::move(result));
+    }
+
+    Remap remap{caller.numSlots, caller.arrayWords, std::vector<const VarNode*>(callee.numSlots, nullptr)};
+    caller.numSlots += callee.numSlots;
+    caller.arrayWords += callee.arrayWords;
+    for (size_t i = 0; i < callee.params.size(); i++) {
+        auto& param = static_cast<const ParamNode&>(*callee.params[i]);
+        if (param.isArray) {
+            remap.arrayArgs[param.slot] = static_cast<const VarNode*>(call.args[i].get());
+            continue;
+        }
+        auto value = std::make_unique<VarDeclarationNode>(param.typeSpecifier, param.identifier, call.args[i]->start);
+        value->slot = remap.slotBase + param.slot;
+        value->initializer = std::move(call.args[i]);
+        block->localDeclarations.push_back(std::move(value));
+    }
+
+    std::unique_ptr<ASTNode> body = clone(callee.body.get(), remap);
+    auto& inner = static_cast<CompoundStmtNode&>(*body);
+    rewriteReturns(inner.statements, resultSlot, callee.identifier);
+    std::move(inner.localDeclarations.begin(), inner.localDeclarations.end(),
+              std::back_inserter(block->localDeclarations));
+    std::move(inner.statements.begin(), inner.statements.end(), std::back_inserter(block->statements));
+
+    // 展开的内容进入调用者的指纹
+    Hasher hasher;
+    hasher.hash(caller.referenceHash);
+    hasher.number(options.budget);
+    hasher.number(sites++);
+    if (call.counts.count >= 0) {
+        // 展开哪些调用点取决于剖析数据
+        hasher.number(call.start);
+        hasher.number(call.counts.count);
+    }
+    hasher.hash(callee.tokenHash);
+    hasher.hash(callee.referenceHash);
+    caller.referenceHash = hasher.result();
+
+    callerSize += callees[calleeIndex.at(&callee)].size;
+    inlined++;
+    decisions.erase(&call);
+
+    CompoundStmtNode& result = *block;
+    if (valueUsed) {
+        site = localVar(callee.identifier, resultSlot, call.start);
+        result.statements.push_back(std::move(stmt));
+    }
+    stmt = std::move(block);
+    return valueUsed ? &result.statements.back() : nullptr;
+}
+
+// 位于末尾的语句序列中的 return 改写为给结果变量赋值（resultSlot 为-1时丢弃返回值）。
+// 结构须已由 returnsAtTail 检查
+void Inliner::rewriteReturns(std::vector<std::unique_ptr<ASTNode>>& stmts, int resultSlot,
+                             const std::string& resultName) {
+    for (size_t k = 0; k < stmts.size(); k++) {
+        ASTNode* stmt = stmts[k].get();
+        Returns r = returnsOf(stmt);
+        if (r == Returns::NONE) continue;
+
+        std::vector<std::unique_ptr<ASTNode>> rest;
+        if (r == Returns::MIXED) {
+            std::move(stmts.begin() + k + 1, stmts.end(), std::back_inserter(rest));
+        }
+        stmts.resize(k + 1);
+
+        if (stmt->type == ASTNodeType::RETURN_STMT) {
+            std::unique_ptr<ASTNode>& value = static_cast<ReturnStmtNode*>(stmt)->expression;
+            if (value && resultSlot >= 0) {
+                stmts[k] = assignment(localVar(resultName, resultSlot, stmt->start), std::move(value), stmt->start);
+            } else if (value && !isTrivial(*value)) {
+                auto exprStmt = std::make_unique<ExpressionStmtNode>(stmt->start);
+                exprStmt->expression = std::move(value);
+                stmts[k] = std::move(exprStmt);
+            } else {
+                stmts.pop_back();
+            }
+            return;
+        }
+
+        if (stmt->type == ASTNodeType::COMPOUND_STMT) {
+            auto& inner = static_cast<CompoundStmtNode*>(stmt)->statements;
+            std::move(rest.begin(), rest.end(), std::back_inserter(inner));
+            rewriteReturns(inner, resultSlot, resultName);
+            return;
+        }
+
+        auto* selectionStmt = static_cast<SelectionStmtNode*>(stmt);
+        std::unique_ptr<ASTNode>* branches[2] = {&selectionStmt->ifBranch, &selectionStmt->elseBranch};
+        bool always[2] = {returnsOf(branches[0]->get()) == Returns::ALWAYS,
+                          *branches[1] && returnsOf(branches[1]->get()) == Returns::ALWAYS};
+        for (int i = 0; i < 2; i++) {
+            bool takesRest = !always[i] && !rest.empty();
+            if (!*branches[i] && !takesRest) continue;
+            auto& inner = asCompound(*branches[i], stmt->start).statements;
+            if (takesRest) {
+                std::move(rest.begin(), rest.end(), std::back_inserter(inner));
+                rest.clear();
+            }
+            rewriteReturns(inner, resultSlot, resultName);
+        }
+        return;
+    }
+}
+
+// 复制被调函数的语句和表达式，换成调用者栈帧中的存储位置。
+// 复制得到的节点不共享；尾调用在展开后不再是尾调用。剖析数据照搬被调函数的
+// （各调用点合计的）计数，其中的比例仍可用于布局和展开
+std::unique_ptr<ASTNode> Inliner::clone(const ASTNode* node, const Remap& remap) {
+    if (!node) return nullptr;
+    switch (node->type) {
+        case ASTNodeType::VAR_DECLARATION: {
+            auto* varDecl = static_cast<const VarDeclarationNode*>(node);
+            auto copy = std::make_unique<VarDeclarationNode>(varDecl->typeSpecifier, varDecl->identifier, node->start);
+            copy->isArray = varDecl->isArray;
+            copy->arraySize = varDecl->arraySize;
+            copy->initializer = clone(varDecl->initializer.get(), remap);
+            copy->slot = remap.slotBase + varDecl->slot;
+            return copy;
+        }
+
+        case ASTNodeType::ARRAY_DECLARATION: {
+            auto* arrayDecl = static_cast<const ArrayDeclarationNode*>(node);
+            auto copy = std::make_unique<ArrayDeclarationNode>(arrayDecl->typeSpecifier, arrayDecl->identifier,
+                                                               arrayDecl->arraySize, node->start);
+            copy->offset = remap.arrayBase + arrayDecl->offset;
+            return copy;
+        }
+
+        case ASTNodeType::COMPOUND_STMT: {
+            auto* compoundStmt = static_cast<const CompoundStmtNode*>(node);
+            auto copy = std::make_unique<CompoundStmtNode>(node->start);
+            for (const auto& decl : compoundStmt->localDeclarations) {
+                copy->localDeclarations.push_back(clone(decl.get(), remap));
+            }
+            for (const auto& stmt : compoundStmt->statements) {
+                copy->statements.push_back(clone(stmt.get(), remap));
+            }
+            return copy;
+        }
+
+        case ASTNodeType::EXPRESSION_STMT: {
+            auto copy = std::make_unique<ExpressionStmtNode>(node->start);
+            copy->expression = clone(static_cast<const ExpressionStmtNode*>(node)->expression.get(), remap);
+            return copy;
+        }
+
+        case ASTNodeType::SELECTION_STMT: {
+            auto* selectionStmt = static_cast<const SelectionStmtNode*>(node);
+            auto copy = std::make_unique<SelectionStmtNode>(node->start);
+            copy->condition = clone(selectionStmt->condition.get(), remap);
+            copy->ifBranch = clone(selectionStmt->ifBranch.get(), remap);
+            copy->elseBranch = clone(selectionStmt->elseBranch.get(), remap);
+            copy->counts = selectionStmt->counts;
+            return copy;
+        }
+
+        case ASTNodeType::ITERATION_STMT: {
+            auto* iterationStmt = static_cast<const IterationStmtNode*>(node);
+            auto copy = std::make_unique<IterationStmtNode>(node->start);
+            copy->condition = clone(iterationStmt->condition.get(), remap);
+            copy->body = clone(iterationStmt->body.get(), remap);
+            copy->counts = iterationStmt->counts;
+            return copy;
+        }
+
+        case ASTNodeType::RETURN_STMT: {
+            auto copy = std::make_unique<ReturnStmtNode>(node->start);
+            copy->expression = clone(static_cast<const ReturnStmtNode*>(node)->expression.get(), remap);
+            return copy;
+        }
+
+        case ASTNodeType::ASSIGN_EXPR: {
+            auto* assignExpr = static_cast<const AssignExprNode*>(node);
+            auto copy = std::make_unique<AssignExprNode>(node->start);
+            copy->var = clone(assignExpr->var.get(), remap);
+            copy->expression = clone(assignExpr->expression.get(), remap);
+            return copy;
+        }
+
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto* simpleExpr = static_cast<const SimpleExprNode*>(node);
+            auto copy = std::make_unique<SimpleExprNode>(node->start);
+            copy->relop = simpleExpr->relop;
+            copy->left = clone(simpleExpr->left.get(), remap);
+            copy->right = clone(simpleExpr->right.get(), remap);
+            return copy;
+        }
+
+        case ASTNodeType::BIN_OP: {
+            auto* binOp = static_cast<const BinOpNode*>(node);
+            auto copy = std::make_unique<BinOpNode>(binOp->op, node->start);
+            copy->left = clone(binOp->left.get(), remap);
+            copy->right = clone(binOp->right.get(), remap);
+            return copy;
+        }
+
+        case ASTNodeType::VAR: {
+            auto* var = static_cast<const VarNode*>(node);
+            const VarNode* target = var;
+            if (var->kind == VarKind::PARAM_ARRAY) target = remap.arrayArgs[var->slot];
+            auto copy = std::make_unique<VarNode>(target->identifier, node->start);
+            copy->kind = target->kind;
+            copy->slot = target->slot;
+            copy->arraySize = target->arraySize;
+            if (var->kind == VarKind::LOCAL_SCALAR) copy->slot += remap.slotBase;
+            if (var->kind == VarKind::LOCAL_ARRAY) copy->slot += remap.arrayBase;
+            copy->index = clone(var->index.get(), remap);
+            return copy;
+        }
+
+        case ASTNodeType::CALL: {
+            auto* call = static_cast<const CallNode*>(node);
+            auto copy = std::make_unique<CallNode>(call->identifier, node->start);
+            copy->callee = call->callee;
+            copy->builtin = call->builtin;
+            copy->counts = call->counts;
+            for (const auto& arg : call->args) {
+                copy->args.push_back(clone(arg.get(), remap));
+            }
+            return copy;
+        }
+
+        case ASTNodeType::NUM:
+            return std::make_unique<NumNode>(static_cast<const NumNode*>(node)->value, node->start);
+
+        default:
+            return nullptr;
+    }
+}
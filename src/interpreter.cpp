@@ -0,0 +1,347 @@
+#include "interpreter.h"
+#include "runtime.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// 32位回绕运算
+inline int32_t wrap(uint64_t value) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+} // namespace
+
+Interpreter::Interpreter(const InterpreterOptions& options)
+    : options(options), sources(nullptr), slots(nullptr), stackTop(0), arrayBase(0), arrayTop(0),
+      callDepth(0), steps(0), returnValue(0), tailCallee(nullptr) {}
+
+// 运行时错误，报告出错的行
+void Interpreter::runtimeError(const std::string& message, SourceOffset start) const {
+    int line = sources ? sources->line(start) : 0;
+    throw std::runtime_error("Runtime error: " + message + " at line " + std::to_string(line));
+}
+
+// 计一步（调用或循环迭代），超出 maxSteps 时报错
+inline void Interpreter::step(SourceOffset start) {
+    if (steps-- == 0) runtimeError("step limit exceeded", start);
+}
+
+// 执行程序
+int Interpreter::run(const ProgramNode& program) {
+    if (static_cast<size_t>(program.globalArrayWords) > options.arrayWords) {
+        throw std::runtime_error("Runtime error: global arrays exceed the array memory");
+    }
+    // 只清零全局数组，栈和局部数组在使用前都会初始化
+    stack.reset(new int64_t[options.stackCells]);
+    memory.reset(new int32_t[options.arrayWords]);
+    std::memset(memory.get(), 0, sizeof(int32_t) * program.globalArrayWords);
+    globals.reset(new int32_t[program.numGlobalSlots + 1]());
+
+    const FunDeclarationNode* mainFun = nullptr;
+    for (const auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::VAR_DECLARATION) {
+            auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+            if (varDecl->initializer) {
+                globals[varDecl->slot] = static_cast<const NumNode*>(varDecl->initializer.get())->value;
+            }
+        } else if (decl->type == ASTNodeType::FUN_DECLARATION) {
+            auto* fun = static_cast<const FunDeclarationNode*>(decl.get());
+            if (fun->identifier == "main") mainFun = fun;
+        }
+    }
+    if (!mainFun) {
+        throw std::runtime_error("Runtime error: no 'main' function");
+    }
+
+    slots = stack.get();
+    stackTop = 0;
+    arrayBase = 0;
+    arrayTop = static_cast<uint32_t>(program.globalArrayWords);
+    callDepth = 0;
+    steps = options.maxSteps ? options.maxSteps : SIZE_MAX;
+    interpStats = InterpreterStats();
+    sources = program.sources.get();
+    return call(*mainFun, nullptr);
+}
+
+// 执行一个函数：实参放在栈底，数组区只有它的栈帧。存储在多次调用之间复用
+int32_t Interpreter::run(const FunDeclarationNode& fun, const std::vector<int32_t>& args) {
+    if (!stack) {
+        stack.reset(new int64_t[options.stackCells]);
+        memory.reset(new int32_t[options.arrayWords]);
+    }
+    if (args.size() > options.stackCells) {
+        throw std::runtime_error("Runtime error: too many arguments in call to '" + fun.identifier + "'");
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+        stack[i] = args[i];
+    }
+    slots = stack.get();
+    stackTop = args.size();
+    arrayBase = 0;
+    arrayTop = 0;
+    callDepth = 0;
+    steps = options.maxSteps ? options.maxSteps : SIZE_MAX;
+    interpStats = InterpreterStats();
+    sources = nullptr;
+    return call(fun, nullptr);
+}
+
+// 调用函数：实参依次求值到栈顶，成为被调函数栈帧的前几个槽位。
+// 没有 callNode 时实参已在栈顶（main 没有实参）
+int32_t Interpreter::call(const FunDeclarationNode& fun, const CallNode* callNode) {
+    SourceOffset start = callNode ? callNode->start : fun.start;
+    size_t frameBase = callNode ? stackTop : stackTop - fun.params.size();
+    step(start);
+    if (++callDepth > options.maxCallDepth || frameBase + fun.numSlots > options.stackCells ||
+        uint64_t(arrayTop) + fun.arrayWords > options.arrayWords) {
+        runtimeError("stack overflow in call to '" + fun.identifier + "'", start);
+    }
+    if (callNode) {
+        interpStats.calls++;
+        for (const auto& arg : callNode->args) {
+            int64_t value = evaluate(arg.get());
+            stack[stackTop++] = value;
+        }
+    }
+
+    int64_t* savedSlots = slots;
+    uint32_t savedArrayBase = arrayBase;
+    uint32_t savedArrayTop = arrayTop;
+
+    slots = stack.get() + frameBase;
+    arrayBase = arrayTop;
+
+    const FunDeclarationNode* current = &fun;
+    for (;;) {
+        stackTop = frameBase + current->numSlots;
+        arrayTop = arrayBase + static_cast<uint32_t>(current->arrayWords);
+
+        returnValue = 0;
+        tailCallee = nullptr;
+        executeCompound(*static_cast<const CompoundStmtNode*>(current->body.get()));
+        if (!tailCallee) break;
+
+        // 尾调用：把栈顶的实参搬到栈帧开头，复用当前栈帧
+        const FunDeclarationNode* next = tailCallee;
+        size_t numArgs = next->params.size();
+        if (frameBase + next->numSlots > options.stackCells ||
+            uint64_t(arrayBase) + next->arrayWords > options.arrayWords) {
+            runtimeError("stack overflow in call to '" + next->identifier + "'", start);
+        }
+        std::memmove(slots, stack.get() + stackTop - numArgs, sizeof(int64_t) * numArgs);
+        step(start);
+        interpStats.calls++;
+        interpStats.tailCalls++;
+        current = next;
+    }
+    int32_t result = returnValue;
+
+    slots = savedSlots;
+    stackTop = frameBase;
+    arrayBase = savedArrayBase;
+    arrayTop = savedArrayTop;
+    callDepth--;
+    return result;
+}
+
+// ===== 语句 =====
+
+Interpreter::Flow Interpreter::execute(const ASTNode* stmt) {
+    switch (stmt->type) {
+        case ASTNodeType::COMPOUND_STMT:
+            return executeCompound(*static_cast<const CompoundStmtNode*>(stmt));
+
+        case ASTNodeType::EXPRESSION_STMT: {
+            auto* exprStmt = static_cast<const ExpressionStmtNode*>(stmt);
+            if (exprStmt->expression) {
+                evaluate(exprStmt->expression.get());
+            }
+            return Flow::NORMAL;
+        }
+
+        case ASTNodeType::SELECTION_STMT: {
+            auto* selectionStmt = static_cast<const SelectionStmtNode*>(stmt);
+            if (static_cast<int32_t>(evaluate(selectionStmt->condition.get())) != 0) {
+                return execute(selectionStmt->ifBranch.get());
+            }
+            if (selectionStmt->elseBranch) {
+                return execute(selectionStmt->elseBranch.get());
+            }
+            return Flow::NORMAL;
+        }
+
+        case ASTNodeType::ITERATION_STMT: {
+            auto* iterationStmt = static_cast<const IterationStmtNode*>(stmt);
+            while (static_cast<int32_t>(evaluate(iterationStmt->condition.get())) != 0) {
+                step(stmt->start);
+                if (execute(iterationStmt->body.get()) == Flow::RETURN) {
+                    return Flow::RETURN;
+                }
+            }
+            return Flow::NORMAL;
+        }
+
+        case ASTNodeType::RETURN_STMT: {
+            auto* returnStmt = static_cast<const ReturnStmtNode*>(stmt);
+            const ASTNode* expression = returnStmt->expression.get();
+            if (expression && expression->type == ASTNodeType::CALL &&
+                static_cast<const CallNode*>(expression)->tailCall) {
+                // 尾调用：实参求值到栈顶，由 call() 复用栈帧执行被调函数
+                auto* callNode = static_cast<const CallNode*>(expression);
+                if (stackTop + callNode->args.size() > options.stackCells) {
+                    runtimeError("stack overflow in call to '" + callNode->identifier + "'", callNode->start);
+                }
+                for (const auto& arg : callNode->args) {
+                    int64_t value = evaluate(arg.get());
+                    stack[stackTop++] = value;
+                }
+                tailCallee = callNode->callee;
+                return Flow::RETURN;
+            }
+            returnValue = returnStmt->expression
+                              ? static_cast<int32_t>(evaluate(returnStmt->expression.get()))
+                              : 0;
+            return Flow::RETURN;
+        }
+
+        default:
+            runtimeError("unexpected statement", stmt->start);
+    }
+}
+
+// 进入复合语句时初始化其局部变量
+Interpreter::Flow Interpreter::executeCompound(const CompoundStmtNode& compoundStmt) {
+    for (const auto& decl : compoundStmt.localDeclarations) {
+        if (decl->type == ASTNodeType::ARRAY_DECLARATION) {
+            auto* arrayDecl = static_cast<const ArrayDeclarationNode*>(decl.get());
+            std::memset(memory.get() + arrayBase + arrayDecl->offset, 0, sizeof(int32_t) * arrayDecl->arraySize);
+            continue;
+        }
+        auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+        slots[varDecl->slot] = varDecl->initializer ? evaluate(varDecl->initializer.get()) : 0;
+    }
+
+    for (const auto& stmt : compoundStmt.statements) {
+        if (execute(stmt.get()) == Flow::RETURN) {
+            return Flow::RETURN;
+        }
+    }
+    return Flow::NORMAL;
+}
+
+// ===== 表达式 =====
+
+// 求值：整数表达式返回int32值，数组名返回数组引用
+int64_t Interpreter::evaluate(const ASTNode* expr) {
+    switch (expr->type) {
+        case ASTNodeType::NUM:
+            return static_cast<const NumNode*>(expr)->value;
+
+        case ASTNodeType::VAR: {
+            auto* var = static_cast<const VarNode*>(expr);
+            if (var->index) {
+                return *element(*var, evaluate(var->index.get()));
+            }
+            switch (var->kind) {
+                case VarKind::LOCAL_SCALAR:  return slots[var->slot];
+                case VarKind::GLOBAL_SCALAR: return globals[var->slot];
+                default:                     return arrayRef(*var);
+            }
+        }
+
+        case ASTNodeType::ASSIGN_EXPR: {
+            auto* assignExpr = static_cast<const AssignExprNode*>(expr);
+            auto* var = static_cast<const VarNode*>(assignExpr->var.get());
+            if (var->index) {
+                // 先求下标再求右值
+                int64_t index = evaluate(var->index.get());
+                int32_t value = static_cast<int32_t>(evaluate(assignExpr->expression.get()));
+                *element(*var, index) = value;
+                return value;
+            }
+            int32_t value = static_cast<int32_t>(evaluate(assignExpr->expression.get()));
+            if (var->kind == VarKind::LOCAL_SCALAR) {
+                slots[var->slot] = value;
+            } else {
+                globals[var->slot] = value;
+            }
+            return value;
+        }
+
+        case ASTNodeType::BIN_OP: {
+            auto* binOp = static_cast<const BinOpNode*>(expr);
+            int32_t left = static_cast<int32_t>(evaluate(binOp->left.get()));
+            int32_t right = static_cast<int32_t>(evaluate(binOp->right.get()));
+            switch (binOp->op) {
+                case TokenType::PLUS:  return wrap(uint64_t(left) + uint64_t(right));
+                case TokenType::MINUS: return wrap(uint64_t(left) - uint64_t(right));
+                case TokenType::TIMES: return wrap(uint64_t(left) * uint64_t(right));
+                case TokenType::MOD:
+                    if (right == 0) runtimeError("division by zero", expr->start);
+                    return right == -1 ? 0 : left % right;
+                default:
+                    if (right == 0) runtimeError("division by zero", expr->start);
+                    return right == -1 ? wrap(0 - uint64_t(left)) : left / right;
+            }
+        }
+
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto* simpleExpr = static_cast<const SimpleExprNode*>(expr);
+            int32_t left = static_cast<int32_t>(evaluate(simpleExpr->left.get()));
+            int32_t right = static_cast<int32_t>(evaluate(simpleExpr->right.get()));
+            switch (simpleExpr->relop) {
+                case TokenType::LT: return left < right;
+                case TokenType::LE: return left <= right;
+                case TokenType::GT: return left > right;
+                case TokenType::GE: return left >= right;
+                case TokenType::EQ: return left == right;
+                default:            return left != right;
+            }
+        }
+
+        case ASTNodeType::CALL: {
+            auto* callNode = static_cast<const CallNode*>(expr);
+            switch (callNode->builtin) {
+                case BuiltinKind::INPUT:
+                    return cminus_input();
+                case BuiltinKind::OUTPUT:
+                    cminus_output(static_cast<int32_t>(evaluate(callNode->args[0].get())));
+                    return 0;
+                default:
+                    return call(*callNode->callee, callNode);
+            }
+        }
+
+        default:
+            runtimeError("unexpected expression", expr->start);
+    }
+}
+
+// 数组引用
+int64_t Interpreter::arrayRef(const VarNode& var) {
+    switch (var.kind) {
+        case VarKind::LOCAL_ARRAY:
+            return int64_t((uint64_t(arrayBase + var.slot) << 32) | uint32_t(var.arraySize));
+        case VarKind::GLOBAL_ARRAY:
+            return int64_t((uint64_t(var.slot) << 32) | uint32_t(var.arraySize));
+        case VarKind::PARAM_ARRAY:
+            return slots[var.slot];
+        default:
+            runtimeError("'" + var.identifier + "' is not an array", var.start);
+    }
+}
+
+int32_t* Interpreter::element(const VarNode& var, int64_t index) {
+    return element(arrayRef(var), index, var.start);
+}
+
+// 越界检查后返回元素地址
+int32_t* Interpreter::element(int64_t ref, int64_t index, SourceOffset start) {
+    uint32_t i = static_cast<uint32_t>(index);
+    if (i >= static_cast<uint32_t>(ref)) {
+        runtimeError("array index " + std::to_string(static_cast<int32_t>(index)) + " out of bounds", start);
+    }
+    return memory.get() + (uint64_t(ref) >> 32) + i;
+}
@@ -0,0 +1,643 @@
+#include "interprocedural.h"
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// 对每个节点（含共享的子树中的节点）调用 visit 恰好一次
+void visitOnce(ASTNode& node, std::unordered_set<const ASTNode*>& shared, const std::function<void(ASTNode&)>& visit) {
+    if (node.sharedOwners > 0 && !shared.insert(&node).second) return;
+    visit(node);
+    visitChildSlots(node, [&](std::unique_ptr<ASTNode>& child) { visitOnce(*child, shared, visit); });
+}
+
+} // namespace
+
+bool InterproceduralOptimizer::Value::meet(const Value& other) {
+    if (other.kind == UNKNOWN || kind == VARYING) return false;
+    if (kind == UNKNOWN) {
+        *this = other;
+        return true;
+    }
+    if (other.kind == CONSTANT && other.value == value) return false;
+    kind = VARYING;
+    return true;
+}
+
+InterproceduralOptimizer::InterproceduralOptimizer(bool remarks) : recordRemarks(remarks) {}
+
+void InterproceduralOptimizer::run(ProgramNode& program) {
+    result = InterproceduralStats();
+    remarkList.clear();
+    buildCallGraph(program);
+    markReachable();
+    evaluator.clear();
+    for (Function& function : functions) {
+        if (function.reachable) evaluator.addFunction(*function.node);
+    }
+
+    for (Function& function : functions) {
+        if (!function.reachable) continue;
+        for (const auto& param : function.node->params) {
+            Value value;
+            if (static_cast<const ParamNode&>(*param).isArray) value.kind = Value::VARYING;
+            function.params.push_back(value);
+        }
+        function.locals.assign(static_cast<size_t>(function.node->numSlots), Value());
+    }
+    for (Function& function : functions) {
+        if (function.reachable) collectAssignments(*function.node->body, function);
+    }
+
+    // 迭代到不动点：值只会沿格下降
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (Function& function : functions) {
+            if (!function.reachable) continue;
+            // 从末尾落空时返回0
+            bool ends = propagate(*function.node->body, function, changed);
+            if (function.node->returnType != "void" && !ends) {
+                Value zero;
+                zero.kind = Value::CONSTANT;
+                changed = function.returned.meet(zero) || changed;
+            }
+        }
+    }
+
+    for (Function& function : functions) {
+        if (!function.reachable) continue;
+        for (size_t i = 0; i < function.params.size(); i++) {
+            if (!function.params[i].isConstant()) continue;
+            result.constantParams++;
+            const auto& param = static_cast<const ParamNode&>(*function.node->params[i]);
+            remark(param.start, "parameter '" + param.identifier + "' of '" + function.node->identifier +
+                                    "' is always " + std::to_string(function.params[i].value));
+        }
+    }
+    for (Function& function : functions) {
+        if (function.reachable) rewrite(function.node->body, function);
+    }
+    for (size_t slot = 0; slot < globalFolded.size(); slot++) {
+        if (!globalFolded[slot]) continue;
+        result.constantGlobals++;
+        remark(globalDecls[slot]->start, "global '" + globalDecls[slot]->identifier +
+                                             "' is never assigned, uses replaced by " +
+                                             std::to_string(globalInitial[slot]));
+    }
+
+    markReachable();
+    removeUnreachable(program);
+    renumberGlobals(program);
+
+    for (Function& function : functions) {
+        if (!function.reachable || !function.changed) continue;
+        Hasher hasher;
+        hasher.hash(function.node->referenceHash);
+        hasher.hash(function.changes.result());
+        function.node->referenceHash = hasher.result();
+    }
+}
+
+// 函数表和全局变量表
+void InterproceduralOptimizer::buildCallGraph(ProgramNode& program) {
+    functions.clear();
+    functionIndex.clear();
+    globalAssigned.assign(static_cast<size_t>(program.numGlobalSlots), false);
+    globalFolded.assign(static_cast<size_t>(program.numGlobalSlots), false);
+    globalInitial.assign(static_cast<size_t>(program.numGlobalSlots), 0);
+    globalDecls.assign(static_cast<size_t>(program.numGlobalSlots), nullptr);
+    for (auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::FUN_DECLARATION) {
+            auto* fun = static_cast<FunDeclarationNode*>(decl.get());
+            functionIndex.emplace(fun, functions.size());
+            functions.push_back(Function());
+            functions.back().node = fun;
+        } else if (decl->type == ASTNodeType::VAR_DECLARATION) {
+            auto* varDecl = static_cast<const VarDeclarationNode*>(decl.get());
+            size_t slot = static_cast<size_t>(varDecl->slot);
+            globalDecls[slot] = varDecl;
+            if (varDecl->initializer) globalInitial[slot] = static_cast<const NumNode&>(*varDecl->initializer).value;
+        }
+    }
+}
+
+InterproceduralOptimizer::Function* InterproceduralOptimizer::functionOf(const CallNode& call) {
+    if (!call.callee) return nullptr;
+    return &functions[functionIndex.at(call.callee)];
+}
+
+// 从 main 出发沿调用边标记可达的函数（显式栈）
+void InterproceduralOptimizer::markReachable() {
+    std::vector<Function*> stack;
+    for (Function& function : functions) {
+        function.reachable = false;
+        if (function.node->identifier == "main") {
+            function.reachable = true;
+            stack.push_back(&function);
+        }
+    }
+    while (!stack.empty()) {
+        Function* function = stack.back();
+        stack.pop_back();
+        std::function<void(const ASTNode&)> collect = [&](const ASTNode& node) {
+            if (node.type == ASTNodeType::CALL) {
+                Function* callee = functionOf(static_cast<const CallNode&>(node));
+                if (callee && !callee->reachable) {
+                    callee->reachable = true;
+                    stack.push_back(callee);
+                }
+            }
+            visitChildren(node, collect);
+        };
+        collect(*function->node->body);
+    }
+}
+
+// 被赋值的参数和全局变量不是常量；局部标量取决于初始化和赋值
+void InterproceduralOptimizer::collectAssignments(const ASTNode& node, Function& function) {
+    if (node.type == ASTNodeType::VAR_DECLARATION) {
+        // 没有初始化表达式时进入作用域初始化为0
+        auto& varDecl = static_cast<const VarDeclarationNode&>(node);
+        Value value;
+        value.kind = Value::CONSTANT;
+        if (varDecl.initializer && varDecl.initializer->type == ASTNodeType::NUM) {
+            value.value = static_cast<const NumNode&>(*varDecl.initializer).value;
+        } else if (varDecl.initializer) {
+            value.kind = Value::VARYING;
+        }
+        function.locals[static_cast<size_t>(varDecl.slot)].meet(value);
+    } else if (node.type == ASTNodeType::ASSIGN_EXPR) {
+        auto& var = static_cast<const VarNode&>(*static_cast<const AssignExprNode&>(node).var);
+        size_t slot = static_cast<size_t>(var.slot);
+        if (var.kind == VarKind::LOCAL_SCALAR && slot < function.params.size()) {
+            function.params[slot].kind = Value::VARYING;
+        } else if (var.kind == VarKind::LOCAL_SCALAR) {
+            function.locals[slot].kind = Value::VARYING;
+        } else if (var.kind == VarKind::GLOBAL_SCALAR) {
+            globalAssigned[slot] = true;
+        }
+    }
+    visitChildren(node, [&](const ASTNode& child) { collectAssignments(child, function); });
+}
+
+// 遍历语句一遍：实参并入被调函数的参数，return 的值并入返回值，有变化时置 changed。
+// 返回之后的语句是否（目前）不会执行：已经 return，或条件还未知、为常数时跳过的分支
+bool InterproceduralOptimizer::propagate(const ASTNode& stmt, Function& function, bool& changed) {
+    switch (stmt.type) {
+        case ASTNodeType::COMPOUND_STMT: {
+            auto& compoundStmt = static_cast<const CompoundStmtNode&>(stmt);
+            for (const auto& decl : compoundStmt.localDeclarations) {
+                if (decl->type != ASTNodeType::VAR_DECLARATION) continue;
+                const auto& initializer = static_cast<const VarDeclarationNode&>(*decl).initializer;
+                if (initializer) evaluate(*initializer, function, changed);
+            }
+            for (const auto& s : compoundStmt.statements) {
+                if (propagate(*s, function, changed)) return true;
+            }
+            return false;
+        }
+
+        case ASTNodeType::EXPRESSION_STMT: {
+            const auto& expression = static_cast<const ExpressionStmtNode&>(stmt).expression;
+            if (expression) evaluate(*expression, function, changed);
+            return false;
+        }
+
+        case ASTNodeType::SELECTION_STMT: {
+            // 条件为常数时只有一个分支会执行，未知时两个分支都还不会执行
+            auto& selectionStmt = static_cast<const SelectionStmtNode&>(stmt);
+            Value condition = evaluate(*selectionStmt.condition, function, changed);
+            if (condition.kind == Value::UNKNOWN) return true;
+            bool thenEnds = true;
+            bool elseEnds = true;
+            if (condition.kind == Value::VARYING || condition.value != 0) {
+                thenEnds = propagate(*selectionStmt.ifBranch, function, changed);
+            }
+            if (condition.kind == Value::VARYING || condition.value == 0) {
+                elseEnds = selectionStmt.elseBranch && propagate(*selectionStmt.elseBranch, function, changed);
+            }
+            return thenEnds && elseEnds;
+        }
+
+        case ASTNodeType::ITERATION_STMT: {
+            // 没有 break，条件为非零常数的循环只能从 return 离开
+            auto& iterationStmt = static_cast<const IterationStmtNode&>(stmt);
+            Value condition = evaluate(*iterationStmt.condition, function, changed);
+            if (condition.kind == Value::UNKNOWN) return true;
+            if (condition.kind == Value::VARYING || condition.value != 0) {
+                propagate(*iterationStmt.body, function, changed);
+            }
+            return condition.isConstant() && condition.value != 0;
+        }
+
+        case ASTNodeType::RETURN_STMT: {
+            auto& returnStmt = static_cast<const ReturnStmtNode&>(stmt);
+            Value value;
+            value.kind = Value::CONSTANT;
+            if (returnStmt.expression) value = evaluate(*returnStmt.expression, function, changed);
+            if (function.node->returnType != "void") changed = function.returned.meet(value) || changed;
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+// 表达式在格上的值；其中的调用把实参并入被调函数的参数
+InterproceduralOptimizer::Value InterproceduralOptimizer::evaluate(const ASTNode& expr, Function& function,
+                                                                   bool& changed) {
+    Value varying;
+    varying.kind = Value::VARYING;
+    switch (expr.type) {
+        case ASTNodeType::NUM: {
+            Value value;
+            value.kind = Value::CONSTANT;
+            value.value = static_cast<const NumNode&>(expr).value;
+            return value;
+        }
+
+        case ASTNodeType::VAR: {
+            auto& var = static_cast<const VarNode&>(expr);
+            size_t slot = static_cast<size_t>(var.slot);
+            if (var.index) {
+                evaluate(*var.index, function, changed);
+            } else if (var.kind == VarKind::LOCAL_SCALAR && slot < function.params.size()) {
+                return function.params[slot];
+            } else if (var.kind == VarKind::LOCAL_SCALAR && function.locals[slot].isConstant()) {
+                return function.locals[slot];
+            } else if (var.kind == VarKind::GLOBAL_SCALAR && !globalAssigned[slot]) {
+                Value value;
+                value.kind = Value::CONSTANT;
+                value.value = globalInitial[slot];
+                return value;
+            }
+            return varying;
+        }
+
+        case ASTNodeType::ASSIGN_EXPR: {
+            auto& assignExpr = static_cast<const AssignExprNode&>(expr);
+            auto& var = static_cast<const VarNode&>(*assignExpr.var);
+            if (var.index) evaluate(*var.index, function, changed);
+            return evaluate(*assignExpr.expression, function, changed);
+        }
+
+        case ASTNodeType::BIN_OP: case ASTNodeType::SIMPLE_EXPR: {
+            bool isCompare = expr.type == ASTNodeType::SIMPLE_EXPR;
+            const ASTNode& leftExpr = isCompare ? *static_cast<const SimpleExprNode&>(expr).left
+                                                : *static_cast<const BinOpNode&>(expr).left;
+            const ASTNode& rightExpr = isCompare ? *static_cast<const SimpleExprNode&>(expr).right
+                                                 : *static_cast<const BinOpNode&>(expr).right;
+            Value left = evaluate(leftExpr, function, changed);
+            Value right = evaluate(rightExpr, function, changed);
+            if (left.kind == Value::VARYING || right.kind == Value::VARYING) return varying;
+            if (left.kind == Value::UNKNOWN || right.kind == Value::UNKNOWN) return Value();
+            Value value;
+            value.kind = Value::CONSTANT;
+            if (isCompare) {
+                value.value = foldCompare(static_cast<const SimpleExprNode&>(expr).relop, left.value, right.value);
+            } else if (!foldBinary(static_cast<const BinOpNode&>(expr).op, left.value, right.value, value.value)) {
+                return varying;
+            }
+            return value;
+        }
+
+        case ASTNodeType::CALL: {
+            auto& call = static_cast<const CallNode&>(expr);
+            Function* callee = functionOf(call);
+            std::vector<int32_t> args;
+            for (size_t i = 0; i < call.args.size(); i++) {
+                Value arg = evaluate(*call.args[i], function, changed);
+                if (callee) changed = callee->params[i].meet(arg) || changed;
+                if (arg.isConstant()) args.push_back(arg.value);
+            }
+            if (!callee || callee->node->returnType == "void") return varying;
+            // 实参都是常数时纯函数的结果在编译期执行得到
+            Value value;
+            if (args.size() == call.args.size() && evaluator.call(*callee->node, args, value.value)) {
+                value.kind = Value::CONSTANT;
+                return value;
+            }
+            return callee->returned;
+        }
+
+        default:
+            return varying;
+    }
+}
+
+// 不动点上的常量折叠（不含调用）
+bool InterproceduralOptimizer::fold(const ASTNode& expr, const Function& function, int32_t& value) const {
+    switch (expr.type) {
+        case ASTNodeType::NUM:
+            value = static_cast<const NumNode&>(expr).value;
+            return true;
+        case ASTNodeType::VAR: {
+            auto& var = static_cast<const VarNode&>(expr);
+            size_t slot = static_cast<size_t>(var.slot);
+            if (var.index) return false;
+            if (var.kind == VarKind::LOCAL_SCALAR && slot < function.params.size() &&
+                function.params[slot].isConstant()) {
+                value = function.params[slot].value;
+                return true;
+            }
+            if (var.kind == VarKind::LOCAL_SCALAR && slot >= function.params.size() &&
+                function.locals[slot].isConstant()) {
+                value = function.locals[slot].value;
+                return true;
+            }
+            if (var.kind == VarKind::GLOBAL_SCALAR && !globalAssigned[slot]) {
+                value = globalInitial[slot];
+                return true;
+            }
+            return false;
+        }
+        case ASTNodeType::BIN_OP: {
+            auto& binOp = static_cast<const BinOpNode&>(expr);
+            int32_t left, right;
+            return fold(*binOp.left, function, left) && fold(*binOp.right, function, right) &&
+                   foldBinary(binOp.op, left, right, value);
+        }
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto& simpleExpr = static_cast<const SimpleExprNode&>(expr);
+            int32_t left, right;
+            if (!fold(*simpleExpr.left, function, left) || !fold(*simpleExpr.right, function, right)) return false;
+            value = foldCompare(simpleExpr.relop, left, right);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// 调用函数是否没有可观察的作用（一定返回、不报错、不改变调用者可见的状态）
+bool InterproceduralOptimizer::isEffectFree(Function& function) {
+    if (function.effectFree == 2) return false;  // 递归
+    if (function.effectFree >= 0) return function.effectFree == 1;
+    function.effectFree = 2;
+    bool effectFree = hasNoEffect(*function.node->body, function, true);
+    function.effectFree = effectFree ? 1 : 0;
+    return effectFree;
+}
+
+// 子树的求值是否没有可观察的作用；inCallee 时允许给局部标量赋值（调用返回后不可见）
+bool InterproceduralOptimizer::hasNoEffect(const ASTNode& node, Function& function, bool inCallee) {
+    switch (node.type) {
+        case ASTNodeType::ITERATION_STMT:
+            return false;  // 不一定终止
+        case ASTNodeType::VAR:
+            if (static_cast<const VarNode&>(node).index) return false;  // 下标可能越界
+            return true;
+        case ASTNodeType::ASSIGN_EXPR: {
+            auto& assignExpr = static_cast<const AssignExprNode&>(node);
+            auto& var = static_cast<const VarNode&>(*assignExpr.var);
+            if (!inCallee || var.kind != VarKind::LOCAL_SCALAR || var.index) return false;
+            return hasNoEffect(*assignExpr.expression, function, inCallee);
+        }
+        case ASTNodeType::BIN_OP: {
+            auto& binOp = static_cast<const BinOpNode&>(node);
+            int32_t divisor;
+            if ((binOp.op == TokenType::DIVIDE || binOp.op == TokenType::MOD) &&
+                (!fold(*binOp.right, function, divisor) || divisor == 0)) {
+                return false;
+            }
+            break;
+        }
+        case ASTNodeType::CALL: {
+            auto& call = static_cast<const CallNode&>(node);
+            Function* callee = functionOf(call);
+            int32_t value;
+            if (callee && !isEffectFree(*callee)) return evaluateCall(call, function, value);
+            if (!callee) return false;
+            break;
+        }
+        default:
+            break;
+    }
+    bool effectFree = true;
+    visitChildren(node, [&](const ASTNode& child) {
+        effectFree = effectFree && hasNoEffect(child, function, inCallee);
+    });
+    return effectFree;
+}
+
+// 按不动点改写函数体：常量参数和全局变量的读取、结果已知或不用的无作用调用
+void InterproceduralOptimizer::rewrite(std::unique_ptr<ASTNode>& slot, Function& function) {
+    ASTNode& node = *slot;
+    auto replace = [&](int32_t value) {
+        SourceOffset start = node.start;
+        slot = std::make_unique<NumNode>(value, start);
+        function.changes.number(static_cast<int64_t>(start));
+        function.changes.number(value);
+        function.changed = true;
+    };
+    auto removable = [&](const CallNode& call) {
+        Function* callee = functionOf(call);
+        if (!callee || !isEffectFree(*callee)) return false;
+        for (const auto& arg : call.args) {
+            if (!hasNoEffect(*arg, function, false)) return false;
+        }
+        return true;
+    };
+
+    switch (node.type) {
+        case ASTNodeType::VAR: {
+            auto& var = static_cast<VarNode&>(node);
+            size_t index = static_cast<size_t>(var.slot);
+            if (var.index) break;
+            if (var.kind == VarKind::LOCAL_SCALAR && index < function.params.size() &&
+                function.params[index].isConstant()) {
+                replace(function.params[index].value);
+            } else if (var.kind == VarKind::LOCAL_SCALAR && index >= function.params.size() &&
+                       function.locals[index].isConstant()) {
+                replace(function.locals[index].value);
+            } else if (var.kind == VarKind::GLOBAL_SCALAR && !globalAssigned[index]) {
+                globalFolded[index] = true;
+                replace(globalInitial[index]);
+            }
+            return;
+        }
+
+        case ASTNodeType::ASSIGN_EXPR: {
+            // 赋值的目标不是读取，只改写其中的下标
+            auto& assignExpr = static_cast<AssignExprNode&>(node);
+            auto& var = static_cast<VarNode&>(*assignExpr.var);
+            if (var.index) rewrite(var.index, function);
+            rewrite(assignExpr.expression, function);
+            return;
+        }
+
+        case ASTNodeType::CALL: {
+            // 先改写实参，实参折叠成常数后才能在编译期执行
+            auto& call = static_cast<CallNode&>(node);
+            for (auto& arg : call.args) rewrite(arg, function);
+            Function* callee = functionOf(call);
+            int32_t value;
+            if (callee && callee->returned.isConstant() && removable(call)) {
+                result.foldedCalls++;
+                remark(call.start, "call to '" + call.identifier + "' replaced by its result " +
+                                       std::to_string(callee->returned.value));
+                replace(callee->returned.value);
+            } else if (evaluateCall(call, function, value)) {
+                result.evaluatedCalls++;
+                remark(call.start, "call to '" + call.identifier + "' evaluated at compile time: " +
+                                       std::to_string(value));
+                replace(value);
+            }
+            return;
+        }
+
+        case ASTNodeType::SELECTION_STMT: case ASTNodeType::ITERATION_STMT: {
+            // 条件折叠为常数时只留下会执行的分支（条件中没有调用，求值没有作用）
+            bool isLoop = node.type == ASTNodeType::ITERATION_STMT;
+            auto& condition = isLoop ? static_cast<IterationStmtNode&>(node).condition
+                                     : static_cast<SelectionStmtNode&>(node).condition;
+            int32_t value;
+            if (!fold(*condition, function, value) || (isLoop && value != 0)) break;
+            std::unique_ptr<ASTNode> taken;
+            if (!isLoop) {
+                auto& selectionStmt = static_cast<SelectionStmtNode&>(node);
+                taken = std::move(value != 0 ? selectionStmt.ifBranch : selectionStmt.elseBranch);
+            }
+            if (!taken) taken = std::make_unique<ExpressionStmtNode>(node.start);
+            result.foldedBranches++;
+            remark(node.start, std::string(isLoop ? "loop" : "dead branch") + " removed (condition is always " +
+                                   (value != 0 ? "true" : "false") + ")");
+            function.changes.number(static_cast<int64_t>(node.start));
+            function.changes.number(value);
+            function.changed = true;
+            slot = std::move(taken);
+            rewrite(slot, function);
+            return;
+        }
+
+        case ASTNodeType::EXPRESSION_STMT: {
+            auto& expression = static_cast<ExpressionStmtNode&>(node).expression;
+            if (!expression || expression->type != ASTNodeType::CALL) break;
+            auto& call = static_cast<CallNode&>(*expression);
+            for (auto& arg : call.args) rewrite(arg, function);
+            int32_t value;
+            if (removable(call) || evaluateCall(call, function, value)) {
+                result.removedCalls++;
+                remark(call.start, "call to '" + call.identifier + "' removed (no side effects, result unused)");
+                function.changes.number(static_cast<int64_t>(call.start));
+                function.changed = true;
+                expression.reset();
+            }
+            return;
+        }
+
+        default:
+            break;
+    }
+    visitChildSlots(node, [&](std::unique_ptr<ASTNode>& child) { rewrite(child, function); });
+}
+
+// 实参都折叠成常数的纯函数调用在沙箱中执行，成功时得到结果
+bool InterproceduralOptimizer::evaluateCall(const CallNode& call, const Function& function, int32_t& value) {
+    if (!call.callee) return false;
+    std::vector<int32_t> args(call.args.size());
+    for (size_t i = 0; i < args.size(); i++) {
+        if (!fold(*call.args[i], function, args[i])) return false;
+    }
+    return evaluator.call(*call.callee, args, value);
+}
+
+// 删除从 main 不可达的函数
+void InterproceduralOptimizer::removeUnreachable(ProgramNode& program) {
+    auto& decls = program.declarations;
+    size_t kept = 0;
+    for (size_t i = 0; i < decls.size(); i++) {
+        if (decls[i]->type == ASTNodeType::FUN_DECLARATION) {
+            auto* fun = static_cast<const FunDeclarationNode*>(decls[i].get());
+            if (!functions[functionIndex.at(fun)].reachable) {
+                result.removedFunctions++;
+                remark(fun->start, "removed function '" + fun->identifier + "' (not reachable from 'main')");
+                continue;
+            }
+        }
+        if (kept != i) decls[kept] = std::move(decls[i]);
+        kept++;
+    }
+    decls.erase(decls.begin() + static_cast<std::ptrdiff_t>(kept), decls.end());
+}
+
+// 删除不再被引用的全局变量和数组，剩下的按声明顺序重新编号
+void InterproceduralOptimizer::renumberGlobals(ProgramNode& program) {
+    std::vector<bool> slotUsed(static_cast<size_t>(program.numGlobalSlots), false);
+    // 全局数组按声明记录：旧偏移 -> 新偏移（-1 表示没有引用），不随数组长度增长
+    std::unordered_map<int, int> newOffset;
+    for (Function& function : functions) {
+        if (!function.reachable) continue;
+        std::function<void(const ASTNode&)> collect = [&](const ASTNode& node) {
+            if (node.type == ASTNodeType::VAR) {
+                auto& var = static_cast<const VarNode&>(node);
+                if (var.kind == VarKind::GLOBAL_SCALAR) slotUsed[static_cast<size_t>(var.slot)] = true;
+                if (var.kind == VarKind::GLOBAL_ARRAY) newOffset.emplace(var.slot, -1);
+            }
+            visitChildren(node, collect);
+        };
+        collect(*function.node->body);
+    }
+
+    // 旧槽位 -> 新的
+    std::vector<int> newSlot(slotUsed.size(), -1);
+    int numSlots = 0;
+    int arrayWords = 0;
+    auto& decls = program.declarations;
+    size_t kept = 0;
+    for (size_t i = 0; i < decls.size(); i++) {
+        ASTNode& decl = *decls[i];
+        if (decl.type == ASTNodeType::VAR_DECLARATION) {
+            auto& varDecl = static_cast<VarDeclarationNode&>(decl);
+            size_t slot = static_cast<size_t>(varDecl.slot);
+            if (!slotUsed[slot]) {
+                result.removedGlobals++;
+                if (!globalFolded[slot]) remark(varDecl.start, "removed unused global '" + varDecl.identifier + "'");
+                continue;
+            }
+            newSlot[slot] = numSlots;
+            varDecl.slot = numSlots++;
+        } else if (decl.type == ASTNodeType::ARRAY_DECLARATION) {
+            auto& arrayDecl = static_cast<ArrayDeclarationNode&>(decl);
+            auto used = newOffset.find(arrayDecl.offset);
+            if (used == newOffset.end()) {
+                result.removedGlobals++;
+                remark(arrayDecl.start, "removed unused global array '" + arrayDecl.identifier + "'");
+                continue;
+            }
+            used->second = arrayWords;
+            arrayDecl.offset = arrayWords;
+            arrayWords += arrayDecl.arraySize;
+        }
+        if (kept != i) decls[kept] = std::move(decls[i]);
+        kept++;
+    }
+    decls.erase(decls.begin() + static_cast<std::ptrdiff_t>(kept), decls.end());
+    if (numSlots == program.numGlobalSlots && arrayWords == program.globalArrayWords) return;
+    program.numGlobalSlots = numSlots;
+    program.globalArrayWords = arrayWords;
+
+    // 共享的变量节点只改一次
+    std::unordered_set<const ASTNode*> shared;
+    for (Function& function : functions) {
+        if (!function.reachable) continue;
+        visitOnce(*function.node->body, shared, [&](ASTNode& node) {
+            if (node.type != ASTNodeType::VAR) return;
+            auto& var = static_cast<VarNode&>(node);
+            int renumbered = var.slot;
+            if (var.kind == VarKind::GLOBAL_SCALAR) renumbered = newSlot[static_cast<size_t>(var.slot)];
+            if (var.kind == VarKind::GLOBAL_ARRAY) renumbered = newOffset.at(var.slot);
+            if (renumbered == var.slot) return;
+            var.slot = renumbered;
+            function.changes.text(var.identifier);
+            function.changes.number(renumbered);
+            function.changed = true;
+        });
+    }
+}
+
+void InterproceduralOptimizer::remark(SourceOffset start, const std::string& message) {
+    if (recordRemarks) remarkList.push_back(InterproceduralRemark{start, message});
+}
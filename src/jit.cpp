@@ -0,0 +1,427 @@
+#include "jit.h"
+#include "codegen.h"
+#include "runtime.h"
+#include "stats.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+using namespace x86;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMicros(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// 外部函数桩：movabs rax, imm64; jmp rax
+const size_t stubSize = 16;
+// 采样时桩先把调用者的 rbp 和返回地址存入 runtimeCall，供在运行库中采到的样本回溯：
+//     mov [rip+d], rbp; mov r11, [rsp]; mov [rip+d], r11; movabs rax, imm64; jmp rax
+const size_t sampledStubSize = 32;
+
+// 进程内可解析的外部符号
+void* resolveExternal(const std::string& name) {
+    if (name == "cminus_input") return reinterpret_cast<void*>(&cminus_input);
+    if (name == "cminus_output") return reinterpret_cast<void*>(&cminus_output);
+    if (name == "cminus_bounds_error") return reinterpret_cast<void*>(&cminus_bounds_error);
+    if (name == "cminus_division_error") return reinterpret_cast<void*>(&cminus_division_error);
+    if (name == "cminus_stack_limit") return reinterpret_cast<void*>(&cminus_stack_limit);
+    if (name == "cminus_stack_overflow") return reinterpret_cast<void*>(&cminus_stack_overflow);
+    return nullptr;
+}
+
+// ===== 采样剖析 =====
+//
+// SIGPROF 的处理函数沿 rbp 链回溯JIT代码的调用栈（生成的代码总是建立 rbp 栈帧），把代码地址
+// 写入预先分配的缓冲区；不分配内存，只读取 [rsp, 栈顶) 之间的栈内容。
+
+const size_t sampleWords = 1 << 20;  // 缓冲区大小（64位字）
+const size_t maxSampleDepth = 256;   // 每个样本最多回溯的帧数
+const uint64_t runtimeFrame = 0;     // 正在执行运行库函数（input/output 等）
+const uint64_t truncatedFrame = 1;   // 更外层的帧超出了 maxSampleDepth
+
+struct SamplerState {
+    uintptr_t textStart = 0;  // JIT 函数的代码范围（不含外部函数桩）
+    uintptr_t textEnd = 0;
+    uintptr_t stubStart = 0;  // 外部函数桩的范围
+    uintptr_t stubEnd = 0;
+    const uintptr_t* runtimeCall = nullptr;  // 最近一次经由桩调用运行库时的 rbp 和返回地址
+    uintptr_t stackTop = 0;   // run 的栈帧，JIT代码的栈帧都在它之下
+    uintptr_t stackLimit = 0; // 栈的最大大小，rsp 不在 (stackTop - stackLimit, stackTop) 中的不是JIT线程
+    uint64_t* buffer = nullptr;
+    size_t used = 0;
+    uint64_t dropped = 0;
+};
+
+SamplerState* volatile activeSampler = nullptr;
+
+void onProfileSignal(int, siginfo_t*, void* context) {
+    SamplerState* state = activeSampler;
+    if (!state) return;
+    const auto& registers = static_cast<const ucontext_t*>(context)->uc_mcontext.gregs;
+    uintptr_t rip = static_cast<uintptr_t>(registers[REG_RIP]);
+    uintptr_t rsp = static_cast<uintptr_t>(registers[REG_RSP]);
+    uintptr_t rbp = static_cast<uintptr_t>(registers[REG_RBP]);
+    if (rsp >= state->stackTop || state->stackTop - rsp >= state->stackLimit) return;
+
+    auto inText = [state](uintptr_t address) { return address >= state->textStart && address < state->textEnd; };
+    auto word = [](uintptr_t address) { return *reinterpret_cast<const uintptr_t*>(address); };
+    uint64_t frames[maxSampleDepth + 1];
+    size_t n = 0;
+    bool walk = true;
+    if (inText(rip)) {
+        frames[n++] = rip;
+        // 序言建立栈帧之前和 ret 处，rbp 还是调用者的栈帧，返回地址在栈顶
+        const auto* code = reinterpret_cast<const uint8_t*>(rip);
+        int slot = -1;
+        if (code[0] == 0x55 || code[0] == 0xC3) {
+            slot = 0;  // push rbp / ret
+        } else if (code[0] == 0x48 && code[1] == 0x89 && code[2] == 0xE5) {
+            slot = 1;  // mov rbp, rsp
+        }
+        if (slot >= 0) {
+            uintptr_t ret = word(rsp + 8 * slot);
+            walk = inText(ret);
+            if (walk) frames[n++] = ret;
+        }
+    } else {
+        // 在桩或运行库函数中，从调用它的JIT函数开始回溯
+        frames[n++] = runtimeFrame;
+        uintptr_t ret = 0;
+        if (rip >= state->stubStart && rip < state->stubEnd) {
+            ret = word(rsp);
+        } else {
+            rbp = state->runtimeCall[0];
+            ret = state->runtimeCall[1];
+        }
+        if (!inText(ret)) return;  // 不在JIT代码中
+        frames[n++] = ret;
+    }
+
+    uintptr_t frame = rbp;
+    while (walk && n < maxSampleDepth) {
+        if (frame < rsp || frame + 16 > state->stackTop || frame % 8 != 0) break;
+        uintptr_t ret = word(frame + 8);
+        if (!inText(ret)) break;
+        frames[n++] = ret;
+        uintptr_t next = word(frame);
+        if (next <= frame) break;
+        frame = next;
+    }
+    if (n == maxSampleDepth) frames[n++] = truncatedFrame;
+
+    if (state->used + n + 1 > sampleWords) {
+        state->dropped++;
+        return;
+    }
+    uint64_t* out = state->buffer + state->used;
+    out[0] = n;
+    std::copy(frames, frames + n, out + 1);
+    state->used += n + 1;
+}
+
+} // namespace
+
+// 构造函数
+JitCompiler::JitCompiler(const JitOptions& options)
+    : options(options), memory(nullptr), memorySize(0), execSize(0),
+      dataStart(0), bssStart(0), stubStart(0), stubBytes(0), runtimeCallStart(0) {}
+
+JitCompiler::~JitCompiler() {
+    release();
+}
+
+void JitCompiler::release() {
+    if (memory) {
+        munmap(memory, memorySize);
+        memory = nullptr;
+        memorySize = 0;
+    }
+}
+
+// 编译并链接程序
+void JitCompiler::compile(const ProgramNode& program) {
+    release();
+    jitStats = JitStats();
+
+    Module module;
+    auto start = Clock::now();
+    {
+        stats::PhaseTimer timer("codegen");
+        CodegenOptions codegenOptions;
+        codegenOptions.optLevel = options.optLevel;
+        codegenOptions.vectorIsa = options.vectorIsa;
+        codegenOptions.remarks = options.remarks;
+        codegenOptions.boundsChecks = options.boundsChecks;
+        codegenOptions.instrument = options.instrument;
+        codegenOptions.lineTable = options.samplePeriod > 0;
+        CodeGenerator generator(codegenOptions);
+        module = generator.generate(program);
+        jitStats.tailCalls = generator.tailCallCount();
+        jitStats.vectorizedLoops = generator.vectorizedLoopCount();
+        jitStats.unrolledLoops = generator.unrolledLoopCount();
+        jitStats.peephole = generator.peepholeStats();
+        loopRemarks = generator.remarks();
+        counters = generator.profileCounters();
+        for (const BoundsReport& report : generator.boundsReports()) {
+            jitStats.boundsAccesses += report.accesses;
+            jitStats.boundsChecks += report.checks;
+        }
+    }
+    jitStats.codegenMicros = elapsedMicros(start);
+
+    start = Clock::now();
+    {
+        stats::PhaseTimer timer("assemble");
+        object = assemble(module);
+    }
+    jitStats.assembleMicros = elapsedMicros(start);
+
+    start = Clock::now();
+    {
+        stats::PhaseTimer timer("link");
+        link(object);
+    }
+    jitStats.linkMicros = elapsedMicros(start);
+
+    jitStats.functions = module.functions.size();
+    jitStats.codeBytes = object.text.size();
+    jitStats.memoryBytes = memorySize;
+}
+
+// 在进程内完成布局、重定位并设置页面权限
+void JitCompiler::link(const ObjectCode& obj) {
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    // 每个外部符号一个桩
+    std::vector<long> stubIndex(obj.symbols.size(), -1);
+    size_t numStubs = 0;
+    for (size_t i = 0; i < obj.symbols.size(); i++) {
+        if (obj.symbols[i].section == Section::UNDEF) {
+            stubIndex[i] = static_cast<long>(numStubs++);
+        }
+    }
+
+    bool sampled = options.samplePeriod > 0;
+    stubBytes = sampled ? sampledStubSize : stubSize;
+    stubStart = alignUp(obj.text.size(), 16);
+    execSize = alignUp(stubStart + numStubs * stubBytes, pageSize);
+    dataStart = execSize;
+    bssStart = alignUp(dataStart + obj.data.size(), 16);
+    runtimeCallStart = alignUp(bssStart + obj.bssSize, 16);
+    memorySize = alignUp(runtimeCallStart + (sampled ? 16 : 0), pageSize);
+    if (memorySize == execSize) {
+        memorySize += pageSize;
+    }
+
+    void* mapped = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        memorySize = 0;
+        throw std::runtime_error("JIT: mmap failed");
+    }
+    memory = static_cast<unsigned char*>(mapped);
+
+    std::memcpy(memory, obj.text.data(), obj.text.size());
+    if (!obj.data.empty()) {
+        std::memcpy(memory + dataStart, obj.data.data(), obj.data.size());
+    }
+
+    // 符号地址
+    std::vector<unsigned char*> addresses(obj.symbols.size(), nullptr);
+    for (size_t i = 0; i < obj.symbols.size(); i++) {
+        const Symbol& sym = obj.symbols[i];
+        switch (sym.section) {
+            case Section::TEXT: addresses[i] = memory + sym.offset; break;
+            case Section::DATA: addresses[i] = memory + dataStart + sym.offset; break;
+            case Section::BSS:  addresses[i] = memory + bssStart + sym.offset; break;
+            case Section::UNDEF: {
+                void* target = resolveExternal(sym.name);
+                if (!target) {
+                    throw std::runtime_error("JIT: unresolved symbol '" + sym.name + "'");
+                }
+                unsigned char* stub = memory + stubStart + stubIndex[i] * stubBytes;
+                size_t length = 0;
+                auto put = [stub, &length](std::initializer_list<uint8_t> bytes) {
+                    for (uint8_t b : bytes) stub[length++] = b;
+                };
+                auto putRipSlot = [&](const unsigned char* slot) {
+                    int32_t disp = static_cast<int32_t>(slot - (stub + length + 4));
+                    std::memcpy(stub + length, &disp, 4);
+                    length += 4;
+                };
+                if (sampled) {
+                    put({0x48, 0x89, 0x2D});  // mov [rip+d], rbp
+                    putRipSlot(memory + runtimeCallStart);
+                    put({0x4C, 0x8B, 0x1C, 0x24});  // mov r11, [rsp]
+                    put({0x4C, 0x89, 0x1D});  // mov [rip+d], r11
+                    putRipSlot(memory + runtimeCallStart + 8);
+                }
+                uint64_t address = reinterpret_cast<uint64_t>(target);
+                put({0x48, 0xB8});
+                std::memcpy(stub + length, &address, 8);
+                length += 8;
+                put({0xFF, 0xE0});
+                addresses[i] = stub;
+                break;
+            }
+        }
+    }
+
+    for (const Reloc& reloc : obj.relocs) {
+        unsigned char* place = memory + reloc.offset;
+        int64_t value = reinterpret_cast<int64_t>(addresses[reloc.symbol]) + reloc.addend -
+                        reinterpret_cast<int64_t>(place);
+        if (value < INT32_MIN || value > INT32_MAX) {
+            throw std::runtime_error("JIT: relocation out of range");
+        }
+        int32_t rel = static_cast<int32_t>(value);
+        std::memcpy(place, &rel, 4);
+    }
+
+    if (mprotect(memory, execSize, PROT_READ | PROT_EXEC) != 0) {
+        throw std::runtime_error("JIT: mprotect failed");
+    }
+}
+
+// 查找函数入口
+void* JitCompiler::lookup(const std::string& name) const {
+    if (!memory) return nullptr;
+    int index = object.findSymbol(name);
+    if (index < 0 || object.symbols[index].section != Section::TEXT) {
+        return nullptr;
+    }
+    return memory + object.symbols[index].offset;
+}
+
+// 计数器在BSS段中
+void JitCompiler::collectProfile(Profile& profile) const {
+    if (!memory) return;
+    for (const ProfileCounters& block : counters) {
+        auto* values = reinterpret_cast<const uint64_t*>(memory + bssStart + object.symbols[block.symbol].offset);
+        profile.add(block.function, block.hash, std::vector<uint64_t>(values, values + block.size));
+    }
+}
+
+// 调用 main
+int JitCompiler::run() {
+    void* entry = lookup("main");
+    if (!entry) {
+        throw std::runtime_error("JIT: no compiled 'main'");
+    }
+    auto mainFunction = reinterpret_cast<int (*)()>(entry);
+    if (options.samplePeriod > 0) {
+        return runSampled(mainFunction);
+    }
+    return mainFunction();
+}
+
+// 在 SIGPROF 定时器下调用 main
+int JitCompiler::runSampled(int (*mainFunction)()) {
+    if (activeSampler) {
+        throw std::runtime_error("JIT: another program is already being sampled");
+    }
+    samples.assign(sampleWords, 0);
+    SamplerState state;
+    state.textStart = reinterpret_cast<uintptr_t>(memory);
+    state.textEnd = state.textStart + object.text.size();
+    state.stubStart = reinterpret_cast<uintptr_t>(memory + stubStart);
+    state.stubEnd = reinterpret_cast<uintptr_t>(memory + execSize);
+    state.runtimeCall = reinterpret_cast<const uintptr_t*>(memory + runtimeCallStart);
+    state.stackTop = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    struct rlimit limit;
+    state.stackLimit = getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+                           ? static_cast<uintptr_t>(limit.rlim_cur)
+                           : uintptr_t(1) << 30;
+    state.buffer = samples.data();
+
+    struct sigaction action;
+    struct sigaction previous;
+    std::memset(&action, 0, sizeof action);
+    action.sa_sigaction = onProfileSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previous) != 0) {
+        throw std::runtime_error("JIT: cannot install the SIGPROF handler");
+    }
+    struct itimerval timer;
+    timer.it_interval.tv_sec = options.samplePeriod / 1000000;
+    timer.it_interval.tv_usec = options.samplePeriod % 1000000;
+    timer.it_value = timer.it_interval;
+
+    activeSampler = &state;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    int result = mainFunction();
+    struct itimerval stop;
+    std::memset(&stop, 0, sizeof stop);
+    setitimer(ITIMER_PROF, &stop, nullptr);
+    activeSampler = nullptr;
+    sigaction(SIGPROF, &previous, nullptr);
+
+    samples.resize(state.used);
+    droppedSamples = state.dropped;
+    return result;
+}
+
+// 叶帧按指令地址、其余帧按返回地址的前一个字节（调用指令）查找函数和行号
+uint64_t JitCompiler::collectSamples(SampleProfile& profile) const {
+    std::vector<const Symbol*> functions;
+    for (const Symbol& symbol : object.symbols) {
+        if (symbol.section == Section::TEXT && symbol.isFunction) functions.push_back(&symbol);
+    }
+    std::sort(functions.begin(), functions.end(),
+              [](const Symbol* a, const Symbol* b) { return a->offset < b->offset; });
+
+    auto symbolize = [&](uint64_t address, bool leaf) {
+        SampleFrame frame;
+        if (address == runtimeFrame || address == truncatedFrame) {
+            frame.function = address == runtimeFrame ? "[runtime]" : "[truncated]";
+            return frame;
+        }
+        uint64_t offset = address - reinterpret_cast<uint64_t>(memory) - (leaf ? 0 : 1);
+        auto symbol = std::upper_bound(functions.begin(), functions.end(), offset,
+                                       [](uint64_t value, const Symbol* s) { return value < s->offset; });
+        if (symbol != functions.begin() && offset - (*std::prev(symbol))->offset < (*std::prev(symbol))->size) {
+            frame.function = (*std::prev(symbol))->name;
+        } else {
+            frame.function = "[unknown]";
+        }
+        auto line = std::upper_bound(object.lines.begin(), object.lines.end(), offset,
+                                     [](uint64_t value, const std::pair<uint64_t, int>& entry) {
+                                         return value < entry.first;
+                                     });
+        if (line != object.lines.begin()) frame.line = std::prev(line)->second;
+        return frame;
+    };
+
+    // 相同的调用栈先合并
+    std::map<std::vector<uint64_t>, uint64_t> stacks;
+    for (size_t i = 0; i < samples.size(); i += samples[i] + 1) {
+        std::vector<uint64_t> stack(samples.begin() + i + 1, samples.begin() + i + 1 + samples[i]);
+        stacks[stack]++;
+    }
+    std::vector<SampleFrame> frames;
+    for (const auto& entry : stacks) {
+        frames.clear();
+        const std::vector<uint64_t>& stack = entry.first;
+        // 运行库函数的下一帧是调用它的JIT函数，按调用指令查找行号
+        for (size_t i = stack.size(); i-- > 0;) {
+            frames.push_back(symbolize(stack[i], i == 0 && stack[i] != runtimeFrame));
+        }
+        profile.add(frames, entry.second);
+    }
+    return droppedSamples;
+}
@@ -1,4 +1,5 @@
 #include "lexer.h"
+#include "diagnostic.h"
 #include <cctype>
 #include <stdexcept>
 #include <cstring>
@@ -14,26 +15,60 @@ const std::unordered_map<std::string, TokenType> Lexer::keywords = {
 };
 
 // 构造函数
-Lexer::Lexer(const std::string& source) 
-    : source(source), currentPos(0), currentLine(1) {}
+Lexer::Lexer(std::string_view source) 
+    : source(source), sources(std::make_shared<SourceManager>(source)), currentPos(0), tokenStart(0),
+      input(nullptr), bufferStart(0), chunkSize(0), skipping(false) {}
+
+Lexer::Lexer(std::istream& input, size_t chunkSize)
+    : sources(std::make_shared<SourceManager>()), currentPos(0), tokenStart(0), input(&input), bufferStart(0),
+      chunkSize(chunkSize ? chunkSize : 1), skipping(false) {}
+
+// 流式模式：丢弃已处理的内容（跳过空白和注释时全部丢弃，否则保留当前Token），
+// 再读入一块。返回是否读到了新内容
+bool Lexer::refill() {
+    if (!input) return false;
+    size_t keep = skipping ? currentPos : tokenStart;
+    buffer.erase(0, keep);
+    bufferStart += keep;
+    currentPos -= keep;
+    tokenStart = skipping ? currentPos : 0;
+
+    size_t size = buffer.size();
+    buffer.resize(size + chunkSize);
+    input->read(&buffer[size], static_cast<std::streamsize>(chunkSize));
+    buffer.resize(size + static_cast<size_t>(input->gcount()));
+    sources->append(std::string_view(buffer).substr(size));
+    source = buffer;
+    return buffer.size() > size;
+}
 
 // 查看下一个字符
-char Lexer::peek() const {
-    return currentPos < source.size() ? source[currentPos] : '\0';
+char Lexer::peek() {
+    if (currentPos < source.size()) return source[currentPos];
+    return refill() ? source[currentPos] : '\0';
+}
+
+// 查看再下一个字符
+char Lexer::peekNext() {
+    if (currentPos + 1 >= source.size() && !(refill() && currentPos + 1 < source.size())) return '\0';
+    return source[currentPos + 1];
 }
 
 // 前进一个字符
 char Lexer::advance() {
-    if (currentPos >= source.size()) return '\0';
+    if (currentPos >= source.size() && !refill()) return '\0';
     
-    char c = source[currentPos++];
-    if (c == '\n') currentLine++;
-    return c;
+    return source[currentPos++];
+}
+
+// 是否已到源代码末尾（源代码中间的 '\0' 不算结束）
+bool Lexer::atEnd() {
+    return currentPos >= source.size() && !refill();
 }
 
 // 跳过空白字符
 void Lexer::skipWhitespace() {
-    while (isspace(peek())) {
+    while (isspace(static_cast<unsigned char>(peek()))) {
         advance();
     }
 }
@@ -44,7 +79,7 @@ void Lexer::skipComment() {
     advance(); // 跳过 '/'
     advance(); // 跳过 '*'
     
-    while (peek() != '\0') {
+    while (!atEnd()) {
         if (peek() == '*') {
             advance(); // 跳过 '*'
             if (peek() == '/') {
@@ -57,142 +92,154 @@ void Lexer::skipComment() {
     }
     
     // 如果到达文件末尾但注释未结束
-    throw std::runtime_error("Unterminated comment at line " + std::to_string(currentLine));
+    SourceLocation location = sources->location(offset(currentPos));
+    throw CompileError("Unterminated comment at line " + std::to_string(location.line), location);
 }
 
 // 处理标识符或关键字
 Token Lexer::handleIdentifier() {
-    std::string lexeme;
-    int startLine = currentLine;
+    SourceOffset start = offset(tokenStart);
     
-    while (isalnum(peek())) {
-        lexeme += advance();
+    while (isalnum(static_cast<unsigned char>(peek()))) {
+        advance();
     }
+    std::string lexeme(source.substr(tokenStart, currentPos - tokenStart));
     
     // 检查是否是关键字
     auto it = keywords.find(lexeme);
     if (it != keywords.end()) {
-        return Token(it->second, lexeme, startLine);
+        return Token(it->second, std::move(lexeme), start);
     }
     
-    return Token(TokenType::ID, lexeme, startLine);
+    return Token(TokenType::ID, std::move(lexeme), start);
 }
 
 // 处理数字
 Token Lexer::handleNumber() {
-    std::string lexeme;
-    int startLine = currentLine;
+    SourceOffset start = offset(tokenStart);
     
-    while (isdigit(peek())) {
-        lexeme += advance();
+    while (isdigit(static_cast<unsigned char>(peek()))) {
+        advance();
     }
     
-    return Token(TokenType::NUM, lexeme, startLine);
+    return Token(TokenType::NUM, std::string(source.substr(tokenStart, currentPos - tokenStart)), start);
 }
 
 // 处理运算符
 Token Lexer::handleOperator() {
-    int startLine = currentLine;
+    SourceOffset start = offset(tokenStart);
     char first = advance();
     char next = peek();
     
     // 处理双字符运算符
     if (first == '=' && next == '=') {
         advance();
-        return Token(TokenType::EQ, "==", startLine);
+        return Token(TokenType::EQ, "==", start);
     }
     if (first == '!' && next == '=') {
         advance();
-        return Token(TokenType::NE, "!=", startLine);
+        return Token(TokenType::NE, "!=", start);
     }
     if (first == '<' && next == '=') {
         advance();
-        return Token(TokenType::LE, "<=", startLine);
+        return Token(TokenType::LE, "<=", start);
     }
     if (first == '>' && next == '=') {
         advance();
-        return Token(TokenType::GE, ">=", startLine);
+        return Token(TokenType::GE, ">=", start);
     }
     
     // 单字符运算符
     switch (first) {
-        case '+': return Token(TokenType::PLUS, "+", startLine);
-        case '-': return Token(TokenType::MINUS, "-", startLine);
-        case '*': return Token(TokenType::TIMES, "*", startLine);
-        case '/': return Token(TokenType::DIVIDE, "/", startLine);
-        case '=': return Token(TokenType::ASSIGN, "=", startLine);
-        case '<': return Token(TokenType::LT, "<", startLine);
-        case '>': return Token(TokenType::GT, ">", startLine);
+        case '+': return Token(TokenType::PLUS, "+", start);
+        case '-': return Token(TokenType::MINUS, "-", start);
+        case '*': return Token(TokenType::TIMES, "*", start);
+        case '/': return Token(TokenType::DIVIDE, "/", start);
+        case '%': return Token(TokenType::MOD, "%", start);
+        case '=': return Token(TokenType::ASSIGN, "=", start);
+        case '<': return Token(TokenType::LT, "<", start);
+        case '>': return Token(TokenType::GT, ">", start);
         default: 
-            return Token(TokenType::ERROR, std::string(1, first), startLine);
+            return Token(TokenType::ERROR, std::string(1, first), start);
     }
 }
 
 // 处理符号
 Token Lexer::handleSymbol() {
-    int startLine = currentLine;
+    SourceOffset start = offset(tokenStart);
     char c = advance();
     
     switch (c) {
-        case ';': return Token(TokenType::SEMICOLON, ";", startLine);
-        case ',': return Token(TokenType::COMMA, ",", startLine);
-        case '(': return Token(TokenType::LPAREN, "(", startLine);
-        case ')': return Token(TokenType::RPAREN, ")", startLine);
-        case '[': return Token(TokenType::LBRACKET, "[", startLine);
-        case ']': return Token(TokenType::RBRACKET, "]", startLine);
-        case '{': return Token(TokenType::LBRACE, "{", startLine);
-        case '}': return Token(TokenType::RBRACE, "}", startLine);
+        case ';': return Token(TokenType::SEMICOLON, ";", start);
+        case ',': return Token(TokenType::COMMA, ",", start);
+        case '(': return Token(TokenType::LPAREN, "(", start);
+        case ')': return Token(TokenType::RPAREN, ")", start);
+        case '[': return Token(TokenType::LBRACKET, "[", start);
+        case ']': return Token(TokenType::RBRACKET, "]", start);
+        case '{': return Token(TokenType::LBRACE, "{", start);
+        case '}': return Token(TokenType::RBRACE, "}", start);
         default: 
-            return Token(TokenType::ERROR, std::string(1, c), startLine);
+            return Token(TokenType::ERROR, std::string(1, c), start);
     }
 }
 
 // 获取下一个Token
 Token Lexer::getNextToken() {
     // 跳过空白和注释
+    skipping = true;
     while (true) {
         skipWhitespace();
         
         // 检查注释
-        if (peek() == '/' && currentPos < source.size() - 1 && source[currentPos+1] == '*') {
+        if (peek() == '/' && peekNext() == '*') {
             skipComment();
         } else {
             break;
         }
     }
+    skipping = false;
+    tokenStart = currentPos;
     
     // 文件结束
-    if (peek() == '\0') {
-        return Token(TokenType::END_OF_FILE, "", currentLine);
+    if (atEnd()) {
+        return Token(TokenType::END_OF_FILE, "", offset(currentPos));
     }
     
-    // 根据字符类型分发处理
+    // 根据字符类型分发处理（strchr 会匹配字符串末尾的 '\0'，需排除）
     char c = peek();
-    if (isalpha(c)) {
+    unsigned char uc = static_cast<unsigned char>(c);
+    if (isalpha(uc)) {
         return handleIdentifier();
-    } else if (isdigit(c)) {
+    } else if (isdigit(uc)) {
         return handleNumber();
-    } else if (strchr("+-*/=!<>", c)) {
+    } else if (c != '\0' && strchr("+-*/%=!<>", c)) {
         return handleOperator();
-    } else if (strchr(";,()[]{}", c)) {
+    } else if (c != '\0' && strchr(";,()[]{}", c)) {
         return handleSymbol();
     }
     
     // 未知字符
+    SourceOffset start = offset(tokenStart);
     std::string unknown(1, advance());
-    return Token(TokenType::ERROR, unknown, currentLine);
+    return Token(TokenType::ERROR, unknown, start);
 }
 
 // 获取所有Token
 std::vector<Token> Lexer::getAllTokens() {
     std::vector<Token> tokens;
+    tokenize(tokens);
+    return tokens;
+}
+
+// 获取所有Token到调用者的缓冲区
+void Lexer::tokenize(std::vector<Token>& tokens) {
+    tokens.clear();
     Token token = getNextToken();
     
     while (token.type != TokenType::END_OF_FILE) {
-        tokens.push_back(token);
+        tokens.push_back(std::move(token));
         token = getNextToken();
     }
     
-    tokens.push_back(token); // 添加EOF标记
-    return tokens;
+    tokens.push_back(std::move(token)); // 添加EOF标记
 }
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "loops.h"
+#include <algorithm>
+
+namespace {
+
+bool isScalar(const ASTNode* node) {
+    if (node->type != ASTNodeType::VAR) return false;
+    auto* var = static_cast<const VarNode*>(node);
+    return !var->index && (var->kind == VarKind::LOCAL_SCALAR || var->kind == VarKind::GLOBAL_SCALAR);
+}
+
+// 是否为同一个标量
+bool sameScalar(const ASTNode* node, const VarNode& var) {
+    return isScalar(node) && static_cast<const VarNode*>(node)->kind == var.kind &&
+           static_cast<const VarNode*>(node)->slot == var.slot;
+}
+
+// 子树中 var 出现的次数（包括赋值的目标）
+int countUses(const ASTNode& node, const VarNode& var) {
+    int count = sameScalar(&node, var) ? 1 : 0;
+    visitChildren(node, [&](const ASTNode& child) { count += countUses(child, var); });
+    return count;
+}
+
+// 子树中是否给 var 赋值
+bool assigns(const ASTNode& node, const VarNode& var) {
+    if (node.type == ASTNodeType::ASSIGN_EXPR && sameScalar(static_cast<const AssignExprNode&>(node).var.get(), var)) {
+        return true;
+    }
+    bool found = false;
+    visitChildren(node, [&](const ASTNode& child) { found = found || assigns(child, var); });
+    return found;
+}
+
+// 子树中是否有对用户函数的调用（内建函数不修改全局变量）
+bool callsFunction(const ASTNode& node) {
+    if (node.type == ASTNodeType::CALL && static_cast<const CallNode&>(node).builtin == BuiltinKind::NONE) {
+        return true;
+    }
+    bool found = false;
+    visitChildren(node, [&](const ASTNode& child) { found = found || callsFunction(child); });
+    return found;
+}
+
+bool containsLoop(const ASTNode& node) {
+    if (node.type == ASTNodeType::ITERATION_STMT) return true;
+    bool found = false;
+    visitChildren(node, [&](const ASTNode& child) { found = found || containsLoop(child); });
+    return found;
+}
+
+int treeSize(const ASTNode& node) {
+    int size = 1;
+    visitChildren(node, [&size](const ASTNode& child) { size += treeSize(child); });
+    return size;
+}
+
+// 语句是否为 i = i + c（或 i = c + i），是时返回 c
+bool isIncrement(const ASTNode* stmt, const VarNode& i, int& step) {
+    if (stmt->type != ASTNodeType::EXPRESSION_STMT) return false;
+    const ASTNode* expr = static_cast<const ExpressionStmtNode*>(stmt)->expression.get();
+    if (!expr || expr->type != ASTNodeType::ASSIGN_EXPR) return false;
+    auto* assign = static_cast<const AssignExprNode*>(expr);
+    if (!sameScalar(assign->var.get(), i) || assign->expression->type != ASTNodeType::BIN_OP) return false;
+    auto* sum = static_cast<const BinOpNode*>(assign->expression.get());
+    if (sum->op != TokenType::PLUS) return false;
+    const ASTNode* other = sameScalar(sum->left.get(), i) ? sum->right.get()
+                         : sameScalar(sum->right.get(), i) ? sum->left.get() : nullptr;
+    if (!other || other->type != ASTNodeType::NUM) return false;
+    step = static_cast<const NumNode*>(other)->value;
+    return true;
+}
+
+// 由常数和不变的标量经 + - * 组成的子树，在循环之前计算一次
+bool isInvariantTree(const ASTNode* expr, const VarNode& i) {
+    if (expr->type == ASTNodeType::NUM) return true;
+    if (expr->type == ASTNodeType::VAR) return isScalar(expr) && !sameScalar(expr, i);
+    if (expr->type != ASTNodeType::BIN_OP) return false;
+    auto* binOp = static_cast<const BinOpNode*>(expr);
+    return binOp->op != TokenType::DIVIDE && binOp->op != TokenType::MOD &&
+           isInvariantTree(binOp->left.get(), i) && isInvariantTree(binOp->right.get(), i);
+}
+
+// 收集向量化方案中表达式 E 的不变量，返回计算它需要的向量寄存器数（结果在第一个）。
+// 不变量常驻寄存器，作为右操作数时不占临时寄存器；数组元素先加载到寄存器
+// （SSE 的内存操作数要求16字节对齐）
+int planExpression(const ASTNode* expr, const VarNode& i, VectorPlan& plan, std::string& reason) {
+    if (expr->type == ASTNodeType::BIN_OP && isInvariantTree(expr, i)) {
+        plan.invariantOf[expr] = static_cast<int>(plan.invariants.size());
+        plan.invariants.push_back(expr);
+        return 1;
+    }
+    switch (expr->type) {
+        case ASTNodeType::NUM:
+        case ASTNodeType::VAR: {
+            auto* var = expr->type == ASTNodeType::VAR ? static_cast<const VarNode*>(expr) : nullptr;
+            if (var && var->index) {
+                if (!sameScalar(var->index.get(), i)) {
+                    reason = "index of '" + var->identifier + "' is not the induction variable";
+                }
+                return 1;
+            }
+            if (var && !isScalar(var)) {
+                reason = "uses array '" + var->identifier + "' without an index";
+                return 1;
+            }
+            if (var && sameScalar(var, i)) {
+                reason = "uses the induction variable as a value";
+                return 1;
+            }
+            // 常数和标量按值或存储位置去重
+            auto same = [expr](const ASTNode* other) {
+                if (expr->type != other->type) return false;
+                if (expr->type == ASTNodeType::NUM) {
+                    return static_cast<const NumNode*>(expr)->value == static_cast<const NumNode*>(other)->value;
+                }
+                return sameScalar(other, *static_cast<const VarNode*>(expr));
+            };
+            auto found = std::find_if(plan.invariants.begin(), plan.invariants.end(), same);
+            if (found == plan.invariants.end()) {
+                plan.invariants.push_back(expr);
+                found = plan.invariants.end() - 1;
+            }
+            plan.invariantOf[expr] = static_cast<int>(found - plan.invariants.begin());
+            return 1;
+        }
+
+        case ASTNodeType::BIN_OP: {
+            auto* binOp = static_cast<const BinOpNode*>(expr);
+            if (binOp->op == TokenType::DIVIDE || binOp->op == TokenType::MOD) {
+                reason = "contains a division";
+                return 1;
+            }
+            if (binOp->op == TokenType::TIMES) plan.multiplies = true;
+            int left = planExpression(binOp->left.get(), i, plan, reason);
+            int right = planExpression(binOp->right.get(), i, plan, reason);
+            bool rightInvariant = plan.invariantOf.count(binOp->right.get()) > 0;
+            return std::max(left, rightInvariant ? 1 : right + 1);
+        }
+
+        case ASTNodeType::SIMPLE_EXPR:
+            reason = "contains a comparison";
+            return 1;
+        case ASTNodeType::CALL:
+            reason = "contains a call to '" + static_cast<const CallNode*>(expr)->identifier + "'";
+            return 1;
+        default:
+            reason = "contains a nested assignment";
+            return 1;
+    }
+}
+
+} // namespace
+
+const char* analyzeCountedLoop(const IterationStmtNode& loop, const ASTNode* previous, CountedLoop& out) {
+    const ASTNode* cond = loop.condition.get();
+    if (cond->type != ASTNodeType::SIMPLE_EXPR) return "condition is not 'i < n' or 'i <= n'";
+    auto* compare = static_cast<const SimpleExprNode*>(cond);
+    if ((compare->relop != TokenType::LT && compare->relop != TokenType::LE) || !isScalar(compare->left.get()) ||
+        static_cast<const VarNode*>(compare->left.get())->kind != VarKind::LOCAL_SCALAR) {
+        return "condition is not 'i < n' or 'i <= n'";
+    }
+    auto* i = static_cast<const VarNode*>(compare->left.get());
+    const ASTNode* bound = compare->right.get();
+    if (bound->type != ASTNodeType::NUM && (!isScalar(bound) || sameScalar(bound, *i))) {
+        return "bound is not a constant or a scalar variable";
+    }
+
+    if (loop.body->type != ASTNodeType::COMPOUND_STMT) return "loop body does not end with 'i = i + 1'";
+    auto* body = static_cast<const CompoundStmtNode*>(loop.body.get());
+    int step = 0;
+    if (body->statements.empty() || !isIncrement(body->statements.back().get(), *i, step) || step != 1) {
+        return "loop body does not end with 'i = i + 1'";
+    }
+
+    // 除末尾的自增外，循环体不能修改 i 和 n
+    bool modifiesInduction = false;
+    bool modifiesBound = false;
+    for (const auto& decl : body->localDeclarations) {
+        modifiesInduction = modifiesInduction || assigns(*decl, *i);
+        modifiesBound = modifiesBound || (bound->type == ASTNodeType::VAR &&
+                                          assigns(*decl, *static_cast<const VarNode*>(bound)));
+    }
+    for (size_t k = 0; k + 1 < body->statements.size(); k++) {
+        const ASTNode& stmt = *body->statements[k];
+        modifiesInduction = modifiesInduction || assigns(stmt, *i);
+        modifiesBound = modifiesBound || (bound->type == ASTNodeType::VAR &&
+                                          assigns(stmt, *static_cast<const VarNode*>(bound)));
+    }
+    if (modifiesInduction) return "induction variable is modified in the loop body";
+    if (modifiesBound) return "bound is modified in the loop body";
+    if (bound->type == ASTNodeType::VAR && static_cast<const VarNode*>(bound)->kind == VarKind::GLOBAL_SCALAR &&
+        callsFunction(*body)) {
+        return "bound is a global variable and the loop body calls functions";
+    }
+
+    out.induction = i;
+    out.bound = bound;
+    out.inclusive = compare->relop == TokenType::LE;
+    out.body = body;
+    out.bodySize = treeSize(*body);
+    out.hasLoops = containsLoop(*body);
+    out.tripCount = -1;
+
+    // 紧挨在循环之前的 i = c
+    if (previous && bound->type == ASTNodeType::NUM && previous->type == ASTNodeType::EXPRESSION_STMT) {
+        const ASTNode* expr = static_cast<const ExpressionStmtNode*>(previous)->expression.get();
+        if (expr && expr->type == ASTNodeType::ASSIGN_EXPR &&
+            sameScalar(static_cast<const AssignExprNode*>(expr)->var.get(), *i) &&
+            static_cast<const AssignExprNode*>(expr)->expression->type == ASTNodeType::NUM) {
+            long long first = static_cast<const NumNode*>(static_cast<const AssignExprNode*>(expr)->expression.get())->value;
+            long long last = static_cast<const NumNode*>(bound)->value;
+            out.tripCount = std::max(0LL, last - first + (out.inclusive ? 1 : 0));
+        }
+    }
+    return nullptr;
+}
+
+std::string planVectorization(const CountedLoop& loop, VectorPlan& out) {
+    const VarNode& i = *loop.induction;
+    if (!loop.body->localDeclarations.empty()) return "loop body declares variables";
+
+    std::string reason;
+    for (size_t k = 0; k + 1 < loop.body->statements.size() && reason.empty(); k++) {
+        const ASTNode* stmt = loop.body->statements[k].get();
+        const ASTNode* expr = stmt->type == ASTNodeType::EXPRESSION_STMT
+                                  ? static_cast<const ExpressionStmtNode*>(stmt)->expression.get() : nullptr;
+        if (!expr || expr->type != ASTNodeType::ASSIGN_EXPR) {
+            if (stmt->type == ASTNodeType::ITERATION_STMT) return "contains a nested loop";
+            if (stmt->type == ASTNodeType::SELECTION_STMT) return "contains an if statement";
+            if (stmt->type == ASTNodeType::RETURN_STMT) return "contains a return statement";
+            if (expr && expr->type == ASTNodeType::CALL) {
+                return "contains a call to '" + static_cast<const CallNode*>(expr)->identifier + "'";
+            }
+            return "loop body has a statement other than an assignment";
+        }
+
+        auto* assign = static_cast<const AssignExprNode*>(expr);
+        auto* target = static_cast<const VarNode*>(assign->var.get());
+        VectorPlan::Statement planned{target, assign->expression.get(), false, false};
+        if (target->index) {
+            if (!sameScalar(target->index.get(), i)) {
+                return "index of '" + target->identifier + "' is not the induction variable";
+            }
+        } else {
+            // s = s + E、s = E + s、s = s - E，且 s 在循环中没有其他用途
+            auto* binOp = assign->expression->type == ASTNodeType::BIN_OP
+                              ? static_cast<const BinOpNode*>(assign->expression.get()) : nullptr;
+            if (binOp && binOp->op == TokenType::PLUS && sameScalar(binOp->left.get(), *target)) {
+                planned.value = binOp->right.get();
+            } else if (binOp && binOp->op == TokenType::PLUS && sameScalar(binOp->right.get(), *target)) {
+                planned.value = binOp->left.get();
+            } else if (binOp && binOp->op == TokenType::MINUS && sameScalar(binOp->left.get(), *target)) {
+                planned.value = binOp->right.get();
+                planned.subtract = true;
+            } else {
+                return "assigns '" + target->identifier + "', which is not a sum reduction";
+            }
+            if (countUses(*loop.body, *target) + countUses(*loop.bound, *target) != 2) {
+                return "reduction variable '" + target->identifier + "' is also used elsewhere in the loop";
+            }
+            planned.reduction = true;
+        }
+
+        out.temporaries = std::max(out.temporaries, planExpression(planned.value, i, out, reason));
+        out.statements.push_back(planned);
+    }
+    if (!reason.empty()) return reason;
+    if (out.statements.empty()) return "loop body is empty";
+    return "";
+}
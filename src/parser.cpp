@@ -1,42 +1,84 @@
 #include "parser.h"
+#include "diagnostic.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <climits>
 
 // 构造函数
 Parser::Parser(Lexer& lexer) 
-    : lexer(lexer), currentIndex(0) 
+    : lexer(&lexer), sources(lexer.sourceManager()), tokenPos(0), trace(false), traceOut(&std::cout), nestingDepth(0),
+      maxNesting(defaultMaxNestingDepth), parsedDeclaration(false), hashConsing(false), sharedCount(0),
+      nextBinding(0), hashingSpan(false) 
 {
     // 预读两个Token
-    tokenBuffer.push_back(lexer.getNextToken());
-    tokenBuffer.push_back(lexer.getNextToken());
+    tokenBuffer.push_back(nextToken());
+    tokenBuffer.push_back(nextToken());
+}
+
+Parser::Parser(std::vector<Token> tokens, std::shared_ptr<const SourceManager> sources)
+    : lexer(nullptr), sources(std::move(sources)), tokens(std::move(tokens)), tokenPos(0), trace(false), traceOut(&std::cout), nestingDepth(0),
+      maxNesting(defaultMaxNestingDepth), parsedDeclaration(false), hashConsing(false), sharedCount(0),
+      nextBinding(0), hashingSpan(false)
+{
+    if (this->tokens.empty() || this->tokens.back().type != TokenType::END_OF_FILE) {
+        throw std::runtime_error("Token sequence must end with EOF");
+    }
+    tokenBuffer.push_back(nextToken());
+    tokenBuffer.push_back(nextToken());
+}
+
+Parser::~Parser() {
+    clearInternTable();
+}
+
+// 取回Token序列的存储（其中的Token已被移走），供下一次词法分析复用容量
+std::vector<Token> Parser::releaseTokens() {
+    std::vector<Token> storage = std::move(tokens);
+    tokens.clear();
+    tokenPos = 0;
+    return storage;
+}
+
+// 取下一个Token；Token序列读完后一直返回末尾的EOF
+Token Parser::nextToken() {
+    if (lexer) return lexer->getNextToken();
+    if (tokenPos + 1 < tokens.size()) return std::move(tokens[tokenPos++]);
+    return tokens.back();
 }
 
 // 获取当前Token
-Token Parser::currentToken() const {
-    return tokenBuffer[currentIndex];
+const Token& Parser::currentToken() const {
+    return tokenBuffer[0];
 }
 
 // 预读下一个Token
-Token Parser::peekToken() const {
-    return tokenBuffer[currentIndex + 1];
+const Token& Parser::peekToken() const {
+    return tokenBuffer[1];
 }
 
 // 消费一个Token，并检查类型
 void Parser::eatToken(TokenType expected) {
     if (matchToken(expected)) {
+        if (hashingSpan) hashToken(tokenBuffer[0]);
         // 移动到下一个Token
-        currentIndex++;
-        tokenBuffer[0] = tokenBuffer[1];
-        tokenBuffer[1] = lexer.getNextToken();
+        tokenBuffer[0] = std::move(tokenBuffer[1]);
+        tokenBuffer[1] = nextToken();
     } else {
         std::ostringstream oss;
         oss << "Expected " << static_cast<int>(expected) 
             << " but found " << static_cast<int>(currentToken().type)
-            << " at line " << currentToken().line;
+            << " at line " << locate(currentToken()).line;
         error(oss.str());
     }
 }
 
+// 把Token计入当前函数的哈希（不含位置）
+void Parser::hashToken(const Token& token) {
+    spanHasher.number(static_cast<int64_t>(token.type));
+    spanHasher.text(token.lexeme);
+}
+
 // 检查当前Token类型
 bool Parser::matchToken(TokenType expected) const {
     return currentToken().type == expected;
@@ -44,13 +86,42 @@ bool Parser::matchToken(TokenType expected) const {
 
 // 错误处理
 void Parser::error(const std::string& message) const {
+    SourceLocation location = locate(currentToken());
     std::ostringstream oss;
     oss << message 
-        << " at line " << currentToken().line
+        << " at line " << location.line
         << ". Current token: " << currentToken().lexeme
         << " (type=" << static_cast<int>(currentToken().type) << ")"
-        << ", Next token: " << (currentIndex + 1 < tokenBuffer.size() ? tokenBuffer[currentIndex + 1].lexeme : "none");
-    throw std::runtime_error(oss.str());
+        << ", Next token: " << tokenBuffer[1].lexeme;
+    throw CompileError(oss.str(), location);
+}
+
+// 整数字面量，超出 int 范围时报错
+int Parser::parseNumber(const Token& numToken) const {
+    long long value = 0;
+    for (char c : numToken.lexeme) {
+        value = value * 10 + (c - '0');
+        if (value > INT_MAX) {
+            SourceLocation location = locate(numToken);
+            std::ostringstream oss;
+            oss << "Integer literal " << numToken.lexeme.substr(0, 32)
+                << (numToken.lexeme.size() > 32 ? "..." : "") << " is too large at line " << location.line;
+            throw CompileError(oss.str(), location);
+        }
+    }
+    return static_cast<int>(value);
+}
+
+// 嵌套深度加一，超过限制时报错
+void Parser::enterNesting() {
+    if (++nestingDepth > maxNesting) {
+        nestingDepth--;
+        error("Nesting too deep (limit " + std::to_string(maxNesting) + ")");
+    }
+}
+
+Parser::NestingGuard::NestingGuard(Parser& parser) : parser(parser) {
+    parser.enterNesting();
 }
 
 // 解析入口
@@ -58,22 +129,41 @@ std::unique_ptr<ProgramNode> Parser::parse() {
     return parseProgram();
 }
 
+// 流式解析的下一个声明；与 declaration_list 一样至少要有一个声明
+std::unique_ptr<ASTNode> Parser::parseNextDeclaration() {
+    if (parsedDeclaration) {
+        if (matchToken(TokenType::END_OF_FILE)) {
+            return nullptr;
+        }
+        if (!matchToken(TokenType::INT) && !matchToken(TokenType::VOID)) {
+            error("Expected declaration");
+        }
+    }
+    parsedDeclaration = true;
+    return parseDeclaration();
+}
+
 // program -> declaration_list
 std::unique_ptr<ProgramNode> Parser::parseProgram() {
-    std::cout << "=== Starting to parse program ===\n";
+    if (trace) *traceOut << "=== Starting to parse program ===\n";
     auto program = std::make_unique<ProgramNode>();
+    program->sources = sources;
     parseDeclarationList(*program);
-    std::cout << "=== Finished parsing program ===\n";
+    
+    if (!matchToken(TokenType::END_OF_FILE)) {
+        error("Expected declaration");
+    }
+    if (trace) *traceOut << "=== Finished parsing program ===\n";
     return program;
 }
 
 // declaration_list -> declaration_list declaration | declaration
 void Parser::parseDeclarationList(ProgramNode& program) {
-    std::cout << "Parsing declaration list\n";
+    if (trace) *traceOut << "Parsing declaration list\n";
     program.declarations.push_back(parseDeclaration());
     
     while (matchToken(TokenType::INT) || matchToken(TokenType::VOID)) {
-        std::cout << "Parsing additional declaration\n";
+        if (trace) *traceOut << "Parsing additional declaration\n";
         program.declarations.push_back(parseDeclaration());
     }
 }
@@ -84,13 +174,15 @@ std::unique_ptr<ASTNode> Parser::parseDeclaration() {
     if (!(matchToken(TokenType::INT) || matchToken(TokenType::VOID))) {
         error("Expected INT or VOID at start of declaration");
     }
+    // 共享只在一个顶层声明之内，流式解析时哈希表不随输入增长
+    if (hashConsing) clearInternTable();
 
     Token typeToken = currentToken();
     eatToken(typeToken.type);  // 消费类型 token
 
     // 检查是否直接跟着 '('（函数声明无函数名）
     if (matchToken(TokenType::LPAREN)) {
-        Token idToken = Token(TokenType::ID, "", typeToken.line);
+        Token idToken = Token(TokenType::ID, "", typeToken.start);
         return parseFunDeclaration(typeToken, idToken);
     }
 
@@ -106,15 +198,13 @@ std::unique_ptr<ASTNode> Parser::parseDeclaration() {
         return parseFunDeclaration(typeToken, idToken);
     }
     
-    // 否则是变量声明
-    // 回退 token 以便 parseVarDeclaration 可以处理
-    tokenBuffer.insert(tokenBuffer.begin(), idToken);
-    tokenBuffer.insert(tokenBuffer.begin(), typeToken);
-    currentIndex = 0;
-    return parseVarDeclaration();
+    // 否则是变量声明，类型和标识符已经消费
+    auto varDecl = parseVarDeclarationRest(typeToken, idToken);
+    if (hashConsing) bind(idToken.lexeme, true);
+    return varDecl;
 }
 
-// var_declaration -> type_specifier ID | type_specifier ID [ NUM ]
+// var_declaration -> type_specifier ID | type_specifier ID [ expression ] | type_specifier ID = expression
 std::unique_ptr<ASTNode> Parser::parseVarDeclaration() {
     Token typeToken = currentToken();
     eatToken(typeToken.type); // 消费类型说明符
@@ -126,32 +216,52 @@ std::unique_ptr<ASTNode> Parser::parseVarDeclaration() {
     Token idToken = currentToken();
     eatToken(TokenType::ID); // 消费标识符
     
+    return parseVarDeclarationRest(typeToken, idToken);
+}
+
+// 解析变量声明中标识符之后的部分
+std::unique_ptr<ASTNode> Parser::parseVarDeclarationRest(const Token& typeToken, const Token& idToken) {
     // 检查数组声明
     if (matchToken(TokenType::LBRACKET)) {
         eatToken(TokenType::LBRACKET);
         
-        if (!matchToken(TokenType::NUM)) {
-            error("Expected number in array declaration");
-        }
-        
-        Token numToken = currentToken();
-        eatToken(TokenType::NUM);
+        // 长度是整数常数或常量表达式（由语义分析求值）
+        std::unique_ptr<ASTNode> size = parseExpression();
         eatToken(TokenType::RBRACKET);
         eatToken(TokenType::SEMICOLON);
         
-        return std::make_unique<ArrayDeclarationNode>(typeToken.lexeme, idToken.lexeme, 
-                                                    std::stoi(numToken.lexeme), typeToken.line);
+        if (size->type == ASTNodeType::NUM) {
+            return std::make_unique<ArrayDeclarationNode>(typeToken.lexeme, idToken.lexeme,
+                                                        static_cast<const NumNode&>(*size).value, typeToken.start);
+        }
+        auto arrayDecl = std::make_unique<ArrayDeclarationNode>(typeToken.lexeme, idToken.lexeme, 0, typeToken.start);
+        arrayDecl->sizeExpression = std::move(size);
+        return arrayDecl;
+    }
+    
+    auto varDecl = std::make_unique<VarDeclarationNode>(typeToken.lexeme, idToken.lexeme, typeToken.start);
+    
+    // 检查初始化表达式
+    if (matchToken(TokenType::ASSIGN)) {
+        eatToken(TokenType::ASSIGN);
+        varDecl->initializer = parseExpression();
     }
     
     eatToken(TokenType::SEMICOLON);
-    return std::make_unique<VarDeclarationNode>(typeToken.lexeme, idToken.lexeme, typeToken.line);
+    return varDecl;
 }
 
 // fun_declaration -> type_specifier ID ( params ) compound_stmt
 std::unique_ptr<FunDeclarationNode> Parser::parseFunDeclaration(const Token& typeToken, const Token& idToken) {
-    std::cout << "Parsing function declaration: " << typeToken.lexeme << " " << idToken.lexeme << "\n";
+    if (trace) *traceOut << "Parsing function declaration: " << typeToken.lexeme << " " << idToken.lexeme << "\n";
+    
+    auto funDecl = std::make_unique<FunDeclarationNode>(typeToken.lexeme, idToken.lexeme, typeToken.start);
     
-    auto funDecl = std::make_unique<FunDeclarationNode>(typeToken.lexeme, idToken.lexeme, typeToken.line);
+    // 从类型说明符开始对函数的Token序列做哈希
+    spanHasher = Hasher();
+    hashToken(typeToken);
+    hashToken(idToken);
+    hashingSpan = true;
     
     // 确保下一个 token 是 '('
     if (!matchToken(TokenType::LPAREN)) {
@@ -160,10 +270,14 @@ std::unique_ptr<FunDeclarationNode> Parser::parseFunDeclaration(const Token& typ
     eatToken(TokenType::LPAREN);
     
     // 解析参数
+    size_t scope = localBindings.size();
     if (matchToken(TokenType::VOID)) {
         eatToken(TokenType::VOID);
     } else if (!matchToken(TokenType::RPAREN)) {
         parseParamList(funDecl->params);
+        if (hashConsing) {
+            for (const auto& param : funDecl->params) bind(static_cast<ParamNode*>(param.get())->identifier, false);
+        }
     }
     
     // 确保下一个 token 是 ')'
@@ -174,7 +288,10 @@ std::unique_ptr<FunDeclarationNode> Parser::parseFunDeclaration(const Token& typ
     
     // 解析函数体
     funDecl->body = parseCompoundStmt();
+    localBindings.resize(scope);
     
+    hashingSpan = false;
+    funDecl->tokenHash = spanHasher.result();
     return funDecl;
 }
 
@@ -197,7 +314,7 @@ std::unique_ptr<ParamNode> Parser::parseParam() {
         isArray = true;
     }
     
-    return std::make_unique<ParamNode>(typeToken.lexeme, idToken.lexeme, isArray, typeToken.line);
+    return std::make_unique<ParamNode>(typeToken.lexeme, idToken.lexeme, isArray, typeToken.start);
 }
 
 // param_list -> param_list , param | param
@@ -212,10 +329,11 @@ void Parser::parseParamList(std::vector<std::unique_ptr<ASTNode>>& params) {
 
 // compound_stmt -> { local_declarations statement_list }
 std::unique_ptr<CompoundStmtNode> Parser::parseCompoundStmt() {
-    int line = currentToken().line;
+    SourceOffset start = currentToken().start;
     eatToken(TokenType::LBRACE); // 消费 '{'
     
-    auto compoundStmt = std::make_unique<CompoundStmtNode>(line);
+    auto compoundStmt = std::make_unique<CompoundStmtNode>(start);
+    size_t scope = localBindings.size();
     
     // 解析局部声明
     parseLocalDeclarations(*compoundStmt);
@@ -224,6 +342,7 @@ std::unique_ptr<CompoundStmtNode> Parser::parseCompoundStmt() {
     parseStatementList(*compoundStmt);
     
     eatToken(TokenType::RBRACE); // 消费 '}'
+    localBindings.resize(scope);
     
     return compoundStmt;
 }
@@ -232,6 +351,13 @@ std::unique_ptr<CompoundStmtNode> Parser::parseCompoundStmt() {
 void Parser::parseLocalDeclarations(CompoundStmtNode& compoundStmt) {
     while (matchToken(TokenType::INT) || matchToken(TokenType::VOID)) {
         compoundStmt.localDeclarations.push_back(parseVarDeclaration());
+        if (hashConsing) {
+            // 初始化表达式在声明之前解析，引用的是外层的同名变量
+            const ASTNode* decl = compoundStmt.localDeclarations.back().get();
+            bind(decl->type == ASTNodeType::ARRAY_DECLARATION ? static_cast<const ArrayDeclarationNode*>(decl)->identifier
+                                                              : static_cast<const VarDeclarationNode*>(decl)->identifier,
+                 false);
+        }
     }
 }
 
@@ -257,6 +383,7 @@ void Parser::parseStatementList(CompoundStmtNode& compoundStmt) {
 
 // statement -> expression_stmt | compound_stmt | selection_stmt | iteration_stmt | return_stmt
 std::unique_ptr<ASTNode> Parser::parseStatement() {
+    NestingGuard guard(*this);
     switch (currentToken().type) {
         case TokenType::LBRACE:
             return parseCompoundStmt();
@@ -284,7 +411,7 @@ std::unique_ptr<ASTNode> Parser::parseStatement() {
 
 // expression_stmt -> expression ; | ;
 std::unique_ptr<ExpressionStmtNode> Parser::parseExpressionStmt() {
-    auto exprStmt = std::make_unique<ExpressionStmtNode>(currentToken().line);
+    auto exprStmt = std::make_unique<ExpressionStmtNode>(currentToken().start);
     
     if (!matchToken(TokenType::SEMICOLON)) {
         exprStmt->expression = parseExpression();
@@ -296,11 +423,11 @@ std::unique_ptr<ExpressionStmtNode> Parser::parseExpressionStmt() {
 
 // selection_stmt -> IF ( expression ) statement | IF ( expression ) statement ELSE statement
 std::unique_ptr<SelectionStmtNode> Parser::parseSelectionStmt() {
-    int line = currentToken().line;
+    SourceOffset start = currentToken().start;
     eatToken(TokenType::IF); // 消费 'if'
     eatToken(TokenType::LPAREN); // 消费 '('
     
-    auto selectionStmt = std::make_unique<SelectionStmtNode>(line);
+    auto selectionStmt = std::make_unique<SelectionStmtNode>(start);
     selectionStmt->condition = parseExpression();
     
     eatToken(TokenType::RPAREN); // 消费 ')'
@@ -312,16 +439,16 @@ std::unique_ptr<SelectionStmtNode> Parser::parseSelectionStmt() {
         selectionStmt->elseBranch = parseStatement();
     }
     
-    return selectionStmt; // 错误：有极字
+    return selectionStmt;
 }
 
 // iteration_stmt -> WHILE ( expression ) statement
 std::unique_ptr<IterationStmtNode> Parser::parseIterationStmt() {
-    int line = currentToken().line;
+    SourceOffset start = currentToken().start;
     eatToken(TokenType::WHILE); // 消费 'while'
     eatToken(TokenType::LPAREN); // 消费 '('
     
-    auto iterationStmt = std::make_unique<IterationStmtNode>(line);
+    auto iterationStmt = std::make_unique<IterationStmtNode>(start);
     iterationStmt->condition = parseExpression();
     
     eatToken(TokenType::RPAREN); // 消费 ')'
@@ -332,166 +459,309 @@ std::unique_ptr<IterationStmtNode> Parser::parseIterationStmt() {
 
 // return_stmt -> RETURN | RETURN expression
 std::unique_ptr<ReturnStmtNode> Parser::parseReturnStmt() {
-    int line = currentToken().line;
+    SourceOffset start = currentToken().start;
     eatToken(TokenType::RETURN); // 消费 'return'
     
-    auto returnStmt = std::make_unique<ReturnStmtNode>(line);
+    auto returnStmt = std::make_unique<ReturnStmtNode>(start);
     
     if (!matchToken(TokenType::SEMICOLON)) {
         returnStmt->expression = parseExpression();
     }
     
+    eatToken(TokenType::SEMICOLON); // 消费 ';'
     return returnStmt;
 }
 
-// expression -> var = expression | simple_expression
-std::unique_ptr<ASTNode> Parser::parseExpression() {
-    // 检查是否是赋值表达式
-    if (matchToken(TokenType::ID) && peekToken().type == TokenType::ASSIGN) {
-        auto var = parseVar();
-        eatToken(TokenType::ASSIGN); // 消费 '='
-        
-        auto assignExpr = std::make_unique<AssignExprNode>(var->line);
-        assignExpr->var = std::move(var);
-        assignExpr->expression = parseExpression();
-        
-        return assignExpr;
+// 二元运算符的优先级：赋值最低（右结合），其次是关系运算（不结合），
+// 加减、乘除依次更高（左结合）；不是二元运算符时返回0
+int Parser::precedence(TokenType type) {
+    switch (type) {
+        case TokenType::ASSIGN:
+            return 1;
+        case TokenType::LT: case TokenType::LE: case TokenType::GT:
+        case TokenType::GE: case TokenType::EQ: case TokenType::NE:
+            return 2;
+        case TokenType::PLUS: case TokenType::MINUS:
+            return 3;
+        case TokenType::TIMES: case TokenType::DIVIDE: case TokenType::MOD:
+            return 4;
+        default:
+            return 0;
     }
-    
-    // 否则是简单表达式
-    return parseSimpleExpression();
 }
 
-// var -> ID | ID [ expression ]
-std::unique_ptr<VarNode> Parser::parseVar() {
-    if (!matchToken(TokenType::ID)) {
-        error("Expected identifier for variable");
+// 把运算符栈顶优先级不低于 minPrecedence 的运算符（不越过 base）与其操作数归约为节点
+void Parser::reduceOperators(size_t base, int minPrecedence) {
+    while (operators.size() > base && precedence(operators.back()) >= minPrecedence) {
+        TokenType op = operators.back();
+        operators.pop_back();
+        std::unique_ptr<ASTNode> right = std::move(operands.back());
+        operands.pop_back();
+        operandStarts.pop_back();
+        std::unique_ptr<ASTNode>& left = operands.back();
+        SourceOffset start = operandStarts.back();
+        int height = std::max(operandHeights[operandHeights.size() - 2], operandHeights.back()) + 1;
+        operandHeights.pop_back();
+        operandHeights.back() = height;
+        if (frames.back().depth + height > maxNesting) {
+            error("Nesting too deep (limit " + std::to_string(maxNesting) + ")");
+        }
+
+        if (op == TokenType::ASSIGN) {
+            auto assignExpr = std::make_unique<AssignExprNode>(start);
+            assignExpr->var = std::move(left);
+            assignExpr->expression = std::move(right);
+            left = std::move(assignExpr);
+            continue;
+        }
+
+        auto make = [&]() -> std::unique_ptr<ASTNode> {
+            if (precedence(op) == 2) {
+                auto simpleExpr = std::make_unique<SimpleExprNode>(start);
+                simpleExpr->left = std::move(left);
+                simpleExpr->relop = op;
+                simpleExpr->right = std::move(right);
+                return simpleExpr;
+            }
+            auto binOp = std::make_unique<BinOpNode>(op, start);
+            binOp->left = std::move(left);
+            binOp->right = std::move(right);
+            return binOp;
+        };
+        // 只共享两个操作数都是共享节点（不含调用和赋值）的运算。除法和取模可能报告运行时
+        // 错误，不共享，错误总是按各自的行报告
+        bool mayFail = op == TokenType::DIVIDE || op == TokenType::MOD;
+        if (hashConsing && !mayFail && left->sharedOwners > 0 && right->sharedOwners > 0) {
+            ExprKey key{precedence(op) == 2 ? ASTNodeType::SIMPLE_EXPR : ASTNodeType::BIN_OP, static_cast<int>(op),
+                        left.get(), right.get()};
+            left = intern(key, make);
+        } else {
+            left = make();
+        }
     }
-    
-    Token idToken = currentToken();
-    eatToken(TokenType::ID); // 消费标识符
-    
-    auto varNode = std::make_unique<VarNode>(idToken.lexeme, idToken.line);
-    
-    // 检查数组索引
-    if (matchToken(TokenType::LBRACKET)) {
-        eatToken(TokenType::LBRACKET);
-        varNode->index = parseExpression();
-        eatToken(TokenType::RBRACKET);
+}
+
+// 进入括号、下标或实参列表
+void Parser::pushFrame(ExprFrame::Kind kind, std::unique_ptr<ASTNode> owner) {
+    int depth = nestingDepth;
+    enterNesting();
+    frames.push_back(ExprFrame{kind, operators.size(), operators.size(), false, depth, std::move(owner), 0});
+}
+
+// 名字当前绑定的声明编号；未声明的名字也分配一个编号，之后声明的同名全局变量另取编号
+int Parser::bindingOf(const std::string& name) {
+    for (auto it = localBindings.rbegin(); it != localBindings.rend(); ++it) {
+        if (it->first == name) return it->second;
     }
-    
-    return varNode;
+    auto found = globalBindings.find(name);
+    if (found != globalBindings.end()) return found->second;
+    globalBindings.emplace(name, nextBinding);
+    return nextBinding++;
 }
 
-// simple_expression -> additive_expression relop additive_expression | additive_expression
-std::unique_ptr<ASTNode> Parser::parseSimpleExpression() {
-    auto left = parseAdditiveExpression();
-    
-    // 检查关系运算符
-    TokenType op = currentToken().type;
-    if (op == TokenType::LT || op == TokenType::LE || 
-        op == TokenType::GT || op == TokenType::GE || 
-        op == TokenType::EQ || op == TokenType::NE) {
-        
-        eatToken(op);
-        auto simpleExpr = std::make_unique<SimpleExprNode>(left->line);
-        simpleExpr->left = std::move(left);
-        simpleExpr->relop = op;
-        simpleExpr->right = parseAdditiveExpression();
-        
-        return simpleExpr;
+// 声明名字：之后对它的引用与此前同名的引用不再共享节点
+void Parser::bind(const std::string& name, bool global) {
+    if (global) {
+        globalBindings[name] = nextBinding++;
+    } else {
+        localBindings.emplace_back(name, nextBinding++);
     }
-    
-    return left;
 }
 
-// additive_expression -> additive_expression addop term | term
-std::unique_ptr<ASTNode> Parser::parseAdditiveExpression() {
-    auto left = parseTerm();
-    
-    while (matchToken(TokenType::PLUS) || matchToken(TokenType::MINUS)) {
-        TokenType op = currentToken().type;
-        eatToken(op);
-        
-        auto binOp = std::make_unique<BinOpNode>(op, left->line);
-        binOp->left = std::move(left);
-        binOp->right = parseTerm();
-        left = std::move(binOp);
+size_t Parser::ExprKeyHash::operator()(const ExprKey& key) const {
+    uint64_t h = static_cast<uint64_t>(key.type) * 0x9e3779b97f4a7c15ULL;
+    h = (h ^ static_cast<uint32_t>(key.value)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ reinterpret_cast<uintptr_t>(key.left)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ reinterpret_cast<uintptr_t>(key.right)) * 0x94d049bb133111ebULL;
+    return static_cast<size_t>(h ^ (h >> 31));
+}
+
+// 取哈希表中结构相同的共享节点；没有时用 make 构造新节点并加入哈希表
+template <class Make>
+std::unique_ptr<ASTNode> Parser::intern(const ExprKey& key, Make make) {
+    auto found = internTable.find(key);
+    if (found != internTable.end() && found->second->sharedOwners < UINT16_MAX) {
+        sharedCount++;
+        found->second->sharedOwners++;
+        return std::unique_ptr<ASTNode>(found->second);
     }
-    
-    return left;
+    std::unique_ptr<ASTNode> node = make();
+    node->sharedOwners++;  // 哈希表的引用
+    if (found == internTable.end()) {
+        internTable.emplace(key, node.get());
+    } else {
+        // 引用计数饱和时改用新节点
+        std::default_delete<ASTNode>()(found->second);
+        found->second = node.get();
+    }
+    return node;
 }
 
-// term -> term mulop factor | factor
-std::unique_ptr<ASTNode> Parser::parseTerm() {
-    auto left = parseFactor();
-    
-    while (matchToken(TokenType::TIMES) || matchToken(TokenType::DIVIDE)) {
-        TokenType op = currentToken().type;
-        eatToken(op);
-        
-        auto binOp = std::make_unique<BinOpNode>(op, left->line);
-        binOp->left = std::move(left);
-        binOp->right = parseFactor();
-        left = std::move(binOp);
+// 释放哈希表持有的引用
+void Parser::clearInternTable() {
+    for (auto& entry : internTable) {
+        std::default_delete<ASTNode>()(entry.second);
     }
-    
-    return left;
+    internTable.clear();
 }
 
+// expression -> var = expression | simple_expression
+// simple_expression -> additive_expression relop additive_expression | additive_expression
+// additive_expression -> additive_expression addop term | term
+// term -> term mulop factor | factor
 // factor -> ( expression ) | var | call | NUM
-std::unique_ptr<ASTNode> Parser::parseFactor() {
-    switch (currentToken().type) {
-        case TokenType::LPAREN: {
-            eatToken(TokenType::LPAREN);
-            auto expr = parseExpression();
-            eatToken(TokenType::RPAREN);
-            return expr;
+// var -> ID | ID [ expression ]
+// call -> ID ( args ),  args -> arg_list | empty,  arg_list -> arg_list , expression | expression
+//
+// 运算符优先级分析：操作数和运算符放在显式的栈中，括号、下标和实参列表各占一帧，
+// 因此嵌套再深也不会递归。得到的AST与按上面的文法递归下降得到的相同：
+// 一个 simple_expression 中最多一个关系运算符，赋值的左边必须是单个变量（可以带括号）。
+std::unique_ptr<ASTNode> Parser::parseExpression() {
+    NestingGuard guard(*this);
+    int depth = nestingDepth;
+    operands.clear();
+    operandStarts.clear();
+    operandHeights.clear();
+    operators.clear();
+    frames.clear();
+    frames.push_back(ExprFrame{ExprFrame::TOP, 0, 0, false, depth, nullptr, 0});
+    bool expectOperand = true;
+
+    while (true) {
+        TokenType type = currentToken().type;
+
+        // 操作数，或开始一个括号、下标、实参列表
+        if (expectOperand) {
+            if (type == TokenType::LPAREN) {
+                eatToken(TokenType::LPAREN);
+                pushFrame(ExprFrame::PAREN, nullptr);
+            } else if (type == TokenType::NUM) {
+                Token numToken = currentToken();
+                eatToken(TokenType::NUM);
+                int value = parseNumber(numToken);
+                auto make = [&]() -> std::unique_ptr<ASTNode> { return std::make_unique<NumNode>(value, numToken.start); };
+                operands.push_back(hashConsing ? intern(ExprKey{ASTNodeType::NUM, value, nullptr, nullptr}, make)
+                                               : make());
+                operandStarts.push_back(numToken.start);
+                operandHeights.push_back(0);
+                expectOperand = false;
+            } else if (type == TokenType::ID) {
+                Token idToken = currentToken();
+                eatToken(TokenType::ID);
+                if (matchToken(TokenType::LPAREN)) {
+                    eatToken(TokenType::LPAREN);
+                    auto callNode = std::make_unique<CallNode>(idToken.lexeme, idToken.start);
+                    if (matchToken(TokenType::RPAREN)) {
+                        eatToken(TokenType::RPAREN);
+                        operands.push_back(std::move(callNode));
+                        operandStarts.push_back(idToken.start);
+                        operandHeights.push_back(0);
+                        expectOperand = false;
+                    } else {
+                        pushFrame(ExprFrame::CALL, std::move(callNode));
+                    }
+                } else {
+                    auto make = [&]() -> std::unique_ptr<ASTNode> {
+                        return std::make_unique<VarNode>(idToken.lexeme, idToken.start);
+                    };
+                    if (matchToken(TokenType::LBRACKET)) {
+                        eatToken(TokenType::LBRACKET);
+                        pushFrame(ExprFrame::INDEX, make());
+                    } else {
+                        operands.push_back(hashConsing ? intern(ExprKey{ASTNodeType::VAR, bindingOf(idToken.lexeme), nullptr, nullptr},
+                                                                 make)
+                                                       : make());
+                        operandStarts.push_back(idToken.start);
+                        operandHeights.push_back(0);
+                        expectOperand = false;
+                    }
+                }
+            } else {
+                error("Unexpected token in factor");
+            }
+            continue;
         }
-            
-        case TokenType::ID: {
-            // 区分变量和函数调用
-            if (peekToken().type == TokenType::LPAREN) {
-                return parseCall();
+
+        // 运算符
+        ExprFrame& frame = frames.back();
+        int prec = precedence(type);
+        if (prec == 1) {
+            if (operators.size() != frame.simpleBase || operands.back()->type != ASTNodeType::VAR) {
+                error("Left side of assignment must be a variable");
             }
-            return parseVar();
+            eatToken(TokenType::ASSIGN);
+            // 赋值的目标不共享
+            if (operands.back()->sharedOwners > 0) {
+                auto* var = static_cast<VarNode*>(operands.back().get());
+                operands.back() = std::make_unique<VarNode>(var->identifier, operandStarts.back());
+            }
+            enterNesting();
+            operators.push_back(TokenType::ASSIGN);
+            frame.simpleBase = operators.size();
+            frame.relop = false;
+            expectOperand = true;
+            continue;
         }
-            
-        case TokenType::NUM: {
-            Token numToken = currentToken();
-            eatToken(TokenType::NUM);
-            return std::make_unique<NumNode>(std::stoi(numToken.lexeme), numToken.line);
+        // 第二个关系运算符不属于这个 simple_expression，与其他Token一样结束当前帧
+        if (prec > 1 && !(prec == 2 && frame.relop)) {
+            reduceOperators(frame.operatorBase, prec);
+            eatToken(type);
+            operators.push_back(type);
+            if (prec == 2) frame.relop = true;
+            expectOperand = true;
+            continue;
         }
-            
-        default:
-            error("Unexpected token in factor");
-            return nullptr;
-    }
-}
 
-// call -> ID ( args )
-std::unique_ptr<CallNode> Parser::parseCall() {
-    Token idToken = currentToken();
-    eatToken(TokenType::ID); // 消费函数名
-    eatToken(TokenType::LPAREN); // 消费 '('
-    
-    auto callNode = std::make_unique<CallNode>(idToken.lexeme, idToken.line);
-    
-    if (!matchToken(TokenType::RPAREN)) {
-        parseArgList(callNode->args);
+        // 结束当前帧：帧内只剩一个操作数
+        reduceOperators(frame.operatorBase, 1);
+        if (frame.kind == ExprFrame::TOP) {
+            break;
+        }
+        std::unique_ptr<ASTNode> value = std::move(operands.back());
+        operands.pop_back();
+        nestingDepth = frame.depth;
+        if (frame.kind == ExprFrame::PAREN) {
+            eatToken(TokenType::RPAREN);
+            frames.pop_back();
+            operands.push_back(std::move(value));
+        } else if (frame.kind == ExprFrame::INDEX) {
+            eatToken(TokenType::RBRACKET);
+            std::unique_ptr<ASTNode> varNode = std::move(frame.owner);
+            auto* var = static_cast<VarNode*>(varNode.get());
+            var->index = std::move(value);
+            operandStarts.back() = var->start;
+            operandHeights.back()++;
+            frames.pop_back();
+            // 下标访问不共享：下标检查的结论和越界时报告的行属于每一处访问
+            operands.push_back(std::move(varNode));
+        } else {
+            auto* callNode = static_cast<CallNode*>(frame.owner.get());
+            callNode->args.push_back(std::move(value));
+            frame.argHeight = std::max(frame.argHeight, operandHeights.back());
+            if (matchToken(TokenType::COMMA)) {
+                // 下一个实参：帧保留
+                eatToken(TokenType::COMMA);
+                operandStarts.pop_back();
+                operandHeights.pop_back();
+                nestingDepth = frame.depth + 1;
+                frame.simpleBase = operators.size();
+                frame.relop = false;
+                expectOperand = true;
+                continue;
+            }
+            eatToken(TokenType::RPAREN);
+            std::unique_ptr<ASTNode> call = std::move(frame.owner);
+            operandStarts.back() = call->start;
+            operandHeights.back() = frame.argHeight + 1;
+            frames.pop_back();
+            operands.push_back(std::move(call));
+        }
     }
-    
-    eatToken(TokenType::RPAREN); // 消费 ')'
-    
-    return callNode;
-}
 
-// args -> arg_list | empty
-void Parser::parseArgList(std::vector<std::unique_ptr<ASTNode>>& args) {
-    args.push_back(parseExpression());
-    
-    while (matchToken(TokenType::COMMA)) {
-        eatToken(TokenType::COMMA);
-        args.push_back(parseExpression());
-    }
-}
\ No newline at end of file
+    nestingDepth = depth;
+    std::unique_ptr<ASTNode> expr = std::move(operands.back());
+    operands.clear();
+    operandStarts.clear();
+    operandHeights.clear();
+    return expr;
+}
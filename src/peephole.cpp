@@ -0,0 +1,809 @@
+#include "peephole.h"
+#include <algorithm>
+#include <climits>
+
+namespace x86 {
+
+namespace {
+
+// 寄存器集合：低16位为通用寄存器，第16位为标志位
+using RegSet = uint32_t;
+const RegSet FLAGS = 1u << 16;
+
+RegSet bit(uint8_t reg) {
+    return reg < 16 ? 1u << reg : 0;
+}
+
+const RegSet argRegs = bit(RDI) | bit(RSI) | bit(RDX) | bit(RCX) | bit(R8) | bit(R9);
+const RegSet callerSaved = bit(RAX) | argRegs | bit(R10) | bit(R11);
+const RegSet calleeSaved = bit(RBX) | bit(R12) | bit(R13) | bit(R14) | bit(R15);
+const RegSet frameRegs = bit(RSP) | bit(RBP);
+
+// 借用来代替 push/pop 周转的寄存器，按优先顺序
+const Reg scratchRegs[] = {R11, R10, R9, R8, RSI, RDI, RDX, RCX};
+
+bool fitsInt32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+bool isVector(Op op) {
+    return op >= Op::MOVDQU && op <= Op::VZEROUPPER;
+}
+
+bool isReg(const Operand& operand, uint8_t reg) {
+    return operand.kind == Operand::REG && operand.reg == reg;
+}
+
+RegSet addressRegs(const Operand& operand) {
+    return operand.kind == Operand::MEM ? bit(operand.base) | bit(operand.index) : 0;
+}
+
+// 作为通用寄存器操作数或内存地址读到的寄存器
+RegSet operandRegs(const Operand& operand) {
+    return operand.kind == Operand::REG ? bit(operand.reg) : addressRegs(operand);
+}
+
+// 一条指令读写的寄存器和内存
+struct Effects {
+    RegSet use = 0;
+    RegSet def = 0;
+    bool load = false;
+    bool store = false;
+};
+
+Effects effects(const Inst& inst) {
+    Effects e;
+    const Operand& a = inst.a;
+    const Operand& b = inst.b;
+    auto destination = [&]() {
+        if (a.isReg()) {
+            e.def |= bit(a.reg);
+        } else {
+            e.use |= addressRegs(a);
+            e.store = true;
+        }
+    };
+    auto source = [&](const Operand& operand) {
+        e.use |= operandRegs(operand);
+        e.load = e.load || operand.isMem();
+    };
+
+    switch (inst.op) {
+        case Op::MOV:
+            destination();
+            source(b);
+            break;
+        case Op::MOVSXD:
+        case Op::MOVZX8:
+            e.def |= bit(a.reg);
+            source(b);
+            break;
+        case Op::LEA:
+            e.def |= bit(a.reg);
+            e.use |= addressRegs(b);
+            break;
+        case Op::XOR:
+            if (a.isReg() && a == b) {  // 清零
+                e.def |= bit(a.reg) | FLAGS;
+                break;
+            }
+            [[fallthrough]];
+        case Op::ADD: case Op::SUB: case Op::AND: case Op::OR:
+            source(a);
+            destination();
+            source(b);
+            e.def |= FLAGS;
+            break;
+        case Op::CMP:
+        case Op::TEST:
+            source(a);
+            source(b);
+            e.def |= FLAGS;
+            break;
+        case Op::IMUL:
+            if (inst.c.isImm()) {
+                e.def |= bit(a.reg);
+            } else {
+                e.use |= bit(a.reg);
+                e.def |= bit(a.reg);
+            }
+            source(b);
+            e.def |= FLAGS;
+            break;
+        case Op::IDIV:
+            source(a);
+            e.use |= bit(RAX) | bit(RDX);
+            e.def |= bit(RAX) | bit(RDX) | FLAGS;
+            break;
+        case Op::NEG:
+        case Op::SHL: case Op::SAR: case Op::SHR:
+            source(a);
+            destination();
+            e.def |= FLAGS;
+            break;
+        case Op::CDQ:
+            e.use |= bit(RAX);
+            e.def |= bit(RDX);
+            break;
+        case Op::SETCC:  // 只写低8位
+            e.use |= FLAGS | bit(a.reg);
+            e.def |= bit(a.reg);
+            break;
+        case Op::JCC:
+            e.use |= FLAGS;
+            break;
+        case Op::JMP:
+            if (a.kind == Operand::SYM) {  // 尾调用
+                e.use |= argRegs | calleeSaved | frameRegs;
+            }
+            break;
+        case Op::CALL:
+            e.use |= argRegs | bit(RSP);
+            e.def |= callerSaved | FLAGS;
+            e.load = e.store = true;
+            break;
+        case Op::RET:
+            e.use |= bit(RAX) | calleeSaved | frameRegs;
+            break;
+        case Op::LEAVE:
+            e.use |= bit(RBP);
+            e.def |= frameRegs;
+            e.load = true;
+            break;
+        case Op::PUSH:
+            e.use |= bit(a.reg) | bit(RSP);
+            e.def |= bit(RSP);
+            e.store = true;
+            break;
+        case Op::POP:
+            e.use |= bit(RSP);
+            e.def |= bit(a.reg) | bit(RSP);
+            e.load = true;
+            break;
+        case Op::REP_STOSD:
+            e.use |= bit(RDI) | bit(RCX) | bit(RAX);
+            e.def |= bit(RDI) | bit(RCX);
+            e.store = true;
+            break;
+        case Op::LABEL:
+        case Op::LINE:
+            break;
+        default:
+            // 向量指令：寄存器操作数是 xmm/ymm，只有 movd 的一侧和内存地址涉及通用寄存器
+            e.use |= addressRegs(a) | addressRegs(b);
+            e.load = b.isMem();
+            e.store = a.isMem();
+            if (inst.op == Op::MOVD_TO_VEC) e.use |= bit(b.reg);
+            if (inst.op == Op::MOVD_FROM_VEC) e.def |= bit(a.reg);
+            break;
+    }
+    return e;
+}
+
+// 各指令之后活跃的寄存器（含标志位）。函数出口处只有返回值和被调用者保存的寄存器活跃
+std::vector<RegSet> liveOut(const std::vector<Inst>& code, int numLabels) {
+    size_t n = code.size();
+    std::vector<size_t> labelAt(static_cast<size_t>(numLabels), n);
+    for (size_t i = 0; i < n; i++) {
+        if (code[i].op == Op::LABEL) labelAt[static_cast<size_t>(code[i].a.id)] = i;
+    }
+    std::vector<Effects> info(n);
+    for (size_t i = 0; i < n; i++) info[i] = effects(code[i]);
+    // setcc r8; movzx r32, r8 合起来整个写 r，setcc 之前 r 的值已无用
+    for (size_t i = 0; i + 1 < n; i++) {
+        const Inst& next = code[i + 1];
+        if (code[i].op == Op::SETCC && next.op == Op::MOVZX8 && next.a == code[i].a && next.b == code[i].a) {
+            info[i].use &= ~bit(code[i].a.reg);
+        }
+    }
+
+    std::vector<RegSet> in(n + 1, 0);
+    std::vector<RegSet> out(n, 0);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = n; i-- > 0;) {
+            const Inst& inst = code[i];
+            RegSet live = 0;
+            bool fallsThrough = inst.op != Op::JMP && inst.op != Op::RET;
+            if (fallsThrough) live |= in[i + 1];
+            if ((inst.op == Op::JMP || inst.op == Op::JCC) && inst.a.kind == Operand::LABEL) {
+                live |= in[labelAt[static_cast<size_t>(inst.a.id)]];
+            }
+            out[i] = live;
+            RegSet liveIn = info[i].use | (live & ~info[i].def);
+            if (liveIn != in[i]) {
+                in[i] = liveIn;
+                changed = true;
+            }
+        }
+    }
+    return out;
+}
+
+// 一轮窥孔优化：逐条尝试各模式，改写过的区间在本轮内不再改写（活跃性已过时），
+// 本轮结束后删除标记的指令
+class PeepholePass {
+public:
+    PeepholePass(MFunction& function, PeepholeStats& stats)
+        : code(function.code), stats(stats), live(liveOut(function.code, function.numLabels)),
+          removed(code.size(), false) {}
+
+    bool run() {
+        bool changed = false;
+        size_t i = 0;
+        while (i < code.size()) {
+            if (removed[i] || code[i].op == Op::LINE) {
+                i++;
+                continue;
+            }
+            size_t resume = apply(i);
+            if (resume == 0) {
+                i++;
+            } else {
+                changed = true;
+                i = resume;
+            }
+        }
+        if (changed) {
+            size_t kept = 0;
+            for (size_t k = 0; k < code.size(); k++) {
+                if (!removed[k]) code[kept++] = code[k];
+            }
+            code.erase(code.begin() + static_cast<std::ptrdiff_t>(kept), code.end());
+        }
+        return changed;
+    }
+
+private:
+    // 在 i 处尝试各模式，改写时返回继续扫描的位置，否则返回0
+    size_t apply(size_t i) {
+        size_t j = next(i);
+        if (size_t resume = unreachable(i)) return resume;
+        if (size_t resume = jumps(i, j)) return resume;
+        if (size_t resume = pushPop(i)) return resume;
+        if (j < code.size()) {
+            if (storeLoad(i, j) || coalesce(i, j) || propagate(i, j) || formLea(i, j)) return next(j) + 1;
+        }
+        if (deadCode(i)) return i + 1;
+        return 0;
+    }
+
+    // i 之后的下一条指令（跳过已删除的指令和行号）
+    size_t next(size_t i) const {
+        size_t k = i + 1;
+        while (k < code.size() && (removed[k] || code[k].op == Op::LINE)) k++;
+        return k;
+    }
+
+    // 从 k 开始的连续标签中是否有 label
+    bool labelFollows(size_t k, int label) const {
+        for (; k < code.size(); k = next(k)) {
+            if (code[k].op != Op::LABEL) return false;
+            if (code[k].a.id == label) return true;
+        }
+        return false;
+    }
+
+    void remove(size_t k, Peephole pattern) {
+        removed[k] = true;
+        stats[pattern]++;
+    }
+
+    bool dead(size_t k, uint8_t reg) const {
+        return (live[k] & bit(reg)) == 0;
+    }
+
+    size_t unreachable(size_t i) {
+        if (code[i].op != Op::JMP && code[i].op != Op::RET) return 0;
+        size_t k = i + 1;
+        bool found = false;
+        for (; k < code.size() && code[k].op != Op::LABEL; k++) {
+            if (removed[k]) continue;
+            removed[k] = true;
+            if (code[k].op != Op::LINE) {
+                stats[Peephole::UNREACHABLE]++;
+                found = true;
+            }
+        }
+        return found ? k : 0;
+    }
+
+    size_t jumps(size_t i, size_t j) {
+        const Inst& inst = code[i];
+        if (inst.a.kind != Operand::LABEL) return 0;
+        if (inst.op == Op::JMP && labelFollows(j, inst.a.id)) {
+            remove(i, Peephole::JUMP_NEXT);
+            return j;
+        }
+        if (inst.op == Op::JCC && j < code.size() && code[j].op == Op::JMP && code[j].a.kind == Operand::LABEL &&
+            labelFollows(next(j), inst.a.id)) {
+            code[i].cc = negate(inst.cc);
+            code[i].a = code[j].a;
+            remove(j, Peephole::BRANCH_INVERSION);
+            return next(j);
+        }
+        return 0;
+    }
+
+    // push r ... pop d，其间的指令不涉及栈顶、不跳转
+    size_t pushPop(size_t i) {
+        if (code[i].op != Op::PUSH) return 0;
+        uint8_t r = code[i].a.reg;
+        RegSet touched = 0;
+        RegSet written = 0;
+        size_t k = next(i);
+        for (; k < code.size() && code[k].op != Op::POP; k = next(k)) {
+            const Inst& inst = code[k];
+            Effects e = effects(inst);
+            switch (inst.op) {
+                case Op::LABEL: case Op::JCC: case Op::JMP: case Op::CALL: case Op::RET:
+                case Op::LEAVE: case Op::PUSH: case Op::REP_STOSD:
+                    return 0;
+                default:
+                    break;
+            }
+            if (isVector(inst.op) || ((e.use | e.def) & bit(RSP))) return 0;
+            touched |= e.use | e.def;
+            written |= e.def;
+        }
+        if (k == code.size()) return 0;
+        uint8_t d = code[k].a.reg;
+
+        auto move = [](uint8_t to, uint8_t from) { return Inst(Op::MOV, 8, Operand::r(to), Operand::r(from)); };
+        if (d == r && !(written & bit(r))) {
+            removed[i] = true;
+        } else if (!(touched & bit(d))) {
+            // 在 push 处直接传给 d
+            code[i] = move(d, r);
+        } else if (!(written & bit(r))) {
+            // r 一直未变，在 pop 处再传
+            removed[i] = true;
+            code[k] = move(d, r);
+            stats[Peephole::PUSH_POP]++;
+            return k + 1;
+        } else {
+            // 借用一个其间未用到、之后也不再使用的寄存器
+            uint8_t scratch = NOREG;
+            for (Reg candidate : scratchRegs) {
+                if (candidate != d && candidate != r && !(touched & bit(candidate)) && dead(k, candidate)) {
+                    scratch = candidate;
+                    break;
+                }
+            }
+            if (scratch == NOREG) return 0;
+            code[i] = move(scratch, r);
+            code[k] = move(d, scratch);
+            stats[Peephole::PUSH_POP]++;
+            return k + 1;
+        }
+        remove(k, Peephole::PUSH_POP);
+        return k + 1;
+    }
+
+    // mov [m], a; mov b, [m] => mov b, a        mov a, [m]; mov [m], a => 删去后一条
+    bool storeLoad(size_t i, size_t j) {
+        const Inst& first = code[i];
+        Inst& second = code[j];
+        if (first.op != Op::MOV || second.op != Op::MOV || first.size != second.size) return false;
+        if (first.a.isMem() && first.b.isReg() && second.a.isReg() && second.b == first.a) {
+            if (second.a == first.b) {
+                remove(j, Peephole::STORE_LOAD);
+            } else {
+                second.b = first.b;
+                stats[Peephole::STORE_LOAD]++;
+            }
+            return true;
+        }
+        if (first.a.isReg() && first.b.isMem() && second.a == first.b && second.b == first.a &&
+            !(addressRegs(first.b) & bit(first.a.reg))) {
+            remove(j, Peephole::STORE_LOAD);
+            return true;
+        }
+        return false;
+    }
+
+    // 算出 a 的指令直接写 d：x a, ...; mov d, a（a 之后不再使用）
+    bool coalesce(size_t i, size_t j) {
+        Inst& first = code[i];
+        const Inst& second = code[j];
+        if (coalesceThrough(i, j)) return true;
+        if (second.op != Op::MOV || !second.b.isReg() || !first.a.isReg() || first.a.reg != second.b.reg) return false;
+        uint8_t a = first.a.reg;
+        if (isReg(second.a, a) || !dead(j, a)) return false;
+        switch (first.op) {
+            case Op::MOV: case Op::LEA: case Op::MOVSXD: case Op::MOVZX8:
+                break;
+            default:
+                return false;
+        }
+
+        if (second.a.isReg()) {
+            // 32位的结果已零扩展，之后按64位传送等同于按32位传送
+            bool widened = first.size == 4 && second.size == 8;
+            if (first.size != second.size && !widened) return false;
+            first.a = second.a;
+        } else {
+            bool sourceOk = first.b.isReg() || (first.b.isImm() && fitsInt32(first.b.imm));
+            if (first.op != Op::MOV || !sourceOk || first.size != second.size || (addressRegs(second.a) & bit(a))) {
+                return false;
+            }
+            first.a = second.a;
+        }
+        remove(j, Peephole::COPY_COALESCE);
+        return true;
+    }
+
+    // 经过一次运算：mov a, x; op a, y; mov d, a => mov d, x; op d, y
+    bool coalesceThrough(size_t i, size_t j) {
+        Inst& first = code[i];
+        Inst& second = code[j];
+        size_t k = next(j);
+        if (k >= code.size() || first.op != Op::MOV || !first.a.isReg()) return false;
+        const Inst& third = code[k];
+        uint8_t a = first.a.reg;
+        if (third.op != Op::MOV || !isReg(third.b, a) || !third.a.isReg() || third.a.reg == a || !dead(k, a)) {
+            return false;
+        }
+        switch (second.op) {
+            case Op::ADD: case Op::SUB: case Op::AND: case Op::OR: case Op::XOR: case Op::SHL: case Op::SAR:
+            case Op::SHR: case Op::NEG:
+                break;
+            case Op::IMUL:
+                if (second.c.isImm()) return false;
+                break;
+            default:
+                return false;
+        }
+        // 32位的运算结果已零扩展，mov 的宽度无关紧要
+        uint8_t d = third.a.reg;
+        bool sizesOk = second.size == 4 || (first.size == 8 && third.size == 8);
+        if (!isReg(second.a, a) || !sizesOk ||
+            (operandRegs(second.b) & (bit(a) | bit(d)))) {
+            return false;
+        }
+        first.a = third.a;
+        second.a = third.a;
+        remove(k, Peephole::COPY_COALESCE);
+        return true;
+    }
+
+    // mov a, x 之后的指令只把 a 作源操作数：改用 x，删去 mov
+    bool propagate(size_t i, size_t j) {
+        const Inst& first = code[i];
+        if (first.op != Op::MOV || !first.a.isReg() || first.b == first.a) return false;
+        uint8_t a = first.a.reg;
+        const Operand& x = first.b;
+        Inst candidate = code[j];
+        Peephole pattern = Peephole::COPY_PROPAGATE;
+        bool sameSize = first.size == candidate.size;
+        bool redefines = false;
+
+        switch (candidate.op) {
+            case Op::CMP:
+            case Op::TEST:
+                if (isReg(candidate.a, a)) {
+                    // 比较 x 本身
+                    pattern = Peephole::COMPARE_OPERAND;
+                    if (!sameSize || x.isImm()) return false;
+                    if (isReg(candidate.b, a)) {
+                        if (!x.isReg()) return false;
+                        candidate.b = x;
+                    } else if (x.isMem() && (candidate.b.isMem() || (candidate.op == Op::TEST && !candidate.b.isReg()))) {
+                        return false;
+                    }
+                    candidate.a = x;
+                    break;
+                }
+                [[fallthrough]];
+            case Op::ADD: case Op::SUB: case Op::AND: case Op::OR: case Op::XOR:
+                if (!isReg(candidate.b, a) || isReg(candidate.a, a) || !sameSize) return false;
+                if (candidate.op == Op::XOR && candidate.a == candidate.b) return false;
+                if (candidate.op == Op::TEST && !x.isReg()) return false;
+                if (x.isImm() && !fitsInt32(x.imm)) return false;
+                if (x.isMem() && !candidate.a.isReg()) return false;
+                candidate.b = x;
+                break;
+            case Op::IMUL:
+                if (!isReg(candidate.b, a) || !sameSize || x.isImm()) return false;
+                if (isReg(candidate.a, a) && !candidate.c.isImm()) return false;
+                redefines = isReg(candidate.a, a);
+                candidate.b = x;
+                break;
+            case Op::MOVSXD:
+                if (!isReg(candidate.b, a) || x.isImm()) return false;
+                redefines = isReg(candidate.a, a);
+                candidate.b = x;
+                break;
+            case Op::LEA:
+                // 32位的 lea 只用到地址的低32位
+                if (!x.isReg() || !(addressRegs(candidate.b) & bit(a)) || (candidate.size == 8 && first.size != 8)) {
+                    return false;
+                }
+                if (candidate.b.base == a) candidate.b.base = x.reg;
+                if (candidate.b.index == a) candidate.b.index = x.reg;
+                redefines = isReg(candidate.a, a);
+                break;
+            default:
+                return false;
+        }
+        if ((effects(candidate).use & bit(a)) || (!redefines && !dead(j, a))) return false;
+        code[j] = candidate;
+        remove(i, pattern);
+        return true;
+    }
+
+    // 不影响标志位的加法：mov a, b; add a, c => lea a, [b + c]   shl a, k; add a, c => lea a, [c + a*2^k]
+    bool formLea(size_t i, size_t j) {
+        Inst& first = code[i];
+        const Inst& second = code[j];
+        if (first.size != second.size || !first.a.isReg() || !isReg(second.a, first.a.reg) || (live[j] & FLAGS)) {
+            return false;
+        }
+        uint8_t a = first.a.reg;
+        Operand address;
+        if (first.op == Op::MOV && first.b.isReg()) {
+            uint8_t b = first.b.reg;
+            if (second.op == Op::ADD && second.b.isReg()) {
+                uint8_t c = second.b.reg == a ? b : second.b.reg;
+                address = Operand::mem(b, c, 1, 0);
+            } else if ((second.op == Op::ADD || second.op == Op::SUB) && second.b.isImm()) {
+                int64_t disp = second.op == Op::ADD ? second.b.imm : -second.b.imm;
+                if (!fitsInt32(disp)) return false;
+                address = Operand::mem(b, static_cast<int32_t>(disp));
+            } else if (second.op == Op::SHL && second.b.imm == 1) {
+                address = Operand::mem(b, b, 1, 0);
+            } else {
+                return false;
+            }
+        } else if (first.op == Op::SHL && first.b.imm >= 1 && first.b.imm <= 3 && second.op == Op::ADD &&
+                   second.b.isReg() && second.b.reg != a) {
+            address = Operand::mem(second.b.reg, a, static_cast<uint8_t>(1 << first.b.imm), 0);
+        } else {
+            return false;
+        }
+        if (address.base == RSP || address.index == RSP) return false;
+        code[j] = Inst(Op::LEA, first.size, first.a, address);
+        remove(i, Peephole::LEA);
+        return true;
+    }
+
+    // 只写寄存器和标志位、结果都不再使用的指令
+    bool deadCode(size_t i) {
+        const Inst& inst = code[i];
+        switch (inst.op) {
+            case Op::MOV: case Op::MOVSXD: case Op::MOVZX8: case Op::LEA:
+            case Op::ADD: case Op::SUB: case Op::AND: case Op::OR: case Op::XOR:
+            case Op::SHL: case Op::SAR: case Op::SHR: case Op::NEG: case Op::IMUL: case Op::SETCC:
+                break;
+            default:
+                return false;
+        }
+        if (inst.op == Op::MOV && inst.size == 8 && inst.a.isReg() && inst.a == inst.b) {
+            remove(i, Peephole::DEAD_CODE);
+            return true;
+        }
+        Effects e = effects(inst);
+        if (!inst.a.isReg() || (e.def & frameRegs) || (e.def & live[i])) return false;
+        remove(i, Peephole::DEAD_CODE);
+        return true;
+    }
+
+    std::vector<Inst>& code;
+    PeepholeStats& stats;
+    std::vector<RegSet> live;
+    std::vector<bool> removed;
+};
+
+// ===== 调度 =====
+
+// 内存操作数是否可能指向同一位置。本栈帧（[rbp + ...]）中按固定偏移的访问直接比较偏移；
+// 其余情况只相信代码生成器标记的区域：标量槽位与局部数组、不同的局部数组互不重叠，
+// 标量槽位不会经指针访问，未标记的访问可能与栈帧中的任何位置重叠。全局变量与本栈帧
+// 互不重叠，不同的全局变量互不重叠，但指针可能指向全局数组
+bool mayAlias(const Operand& x, const Operand& y) {
+    if (x.base == RBP && y.base == RBP) {
+        if (x.index == NOREG && y.index == NOREG) {
+            return x.disp < y.disp + 8 && y.disp < x.disp + 8;
+        }
+        if (x.id == Operand::unknownFrame || y.id == Operand::unknownFrame) return true;
+        return x.id == y.id && x.id != Operand::frameSlot;
+    }
+    if (x.base == RBP || y.base == RBP) {
+        if (x.base == RIP || y.base == RIP) return false;
+        return (x.base == RBP ? x.id : y.id) != Operand::frameSlot;
+    }
+    if (x.base == RIP && y.base == RIP) return x.id == y.id;
+    return true;
+}
+
+const Operand* memoryOperand(const Inst& inst) {
+    if (inst.op == Op::LEA) return nullptr;
+    if (inst.a.isMem()) return &inst.a;
+    if (inst.b.isMem()) return &inst.b;
+    return nullptr;
+}
+
+int latency(const Inst& inst, const Effects& e) {
+    if (inst.op == Op::IDIV) return 25;
+    if (e.load) return 4;
+    if (inst.op == Op::IMUL) return 3;
+    return 1;
+}
+
+// 一次调度的最大指令数
+const size_t maxBlock = 64;
+
+bool isBoundary(const Inst& inst, const Effects& e) {
+    switch (inst.op) {
+        case Op::LABEL: case Op::JCC: case Op::JMP: case Op::CALL: case Op::RET:
+        case Op::LEAVE: case Op::PUSH: case Op::POP: case Op::REP_STOSD:
+            return true;
+        default:
+            break;
+    }
+    return isVector(inst.op) || ((e.use | e.def) & bit(RSP));
+}
+
+// 调度 code[begin, end)（不超过 maxBlock 条），info 为各指令的读写，lines 为各指令的行，随指令重排
+void scheduleBlock(std::vector<Inst>& code, std::vector<int64_t>& lines, const std::vector<Effects>& info,
+                   const std::vector<RegSet>& live, size_t begin, size_t end, PeepholeStats& stats) {
+    size_t n = end - begin;
+    if (n < 3) return;
+
+    // 依赖：preds[s] 的第 p 位表示 s 须在 p 之后，raw 中的是写后读（延迟为 p 的延迟，其余为0）
+    uint64_t preds[maxBlock] = {};
+    uint64_t raw[maxBlock] = {};
+    int lat[maxBlock];
+    for (size_t k = 0; k < n; k++) {
+        lat[k] = latency(code[begin + k], info[begin + k]);
+    }
+    for (size_t s = 1; s < n; s++) {
+        const Effects& y = info[begin + s];
+        for (size_t p = 0; p < s; p++) {
+            const Effects& x = info[begin + p];
+            bool xw = (x.def & FLAGS) != 0;
+            bool yw = (y.def & FLAGS) != 0;
+            bool isRaw = (x.def & y.use) != 0;
+            // 标志位：两次写之间只有其中一次的结果有用时才需保持顺序
+            bool other = ((x.use & y.def) | (x.def & y.def & ~FLAGS)) != 0 ||
+                         (xw && yw && ((live[begin + p] & FLAGS) || (live[begin + s] & FLAGS)));
+            if ((x.store && (y.load || y.store)) || (x.load && y.store)) {
+                const Operand* mx = memoryOperand(code[begin + p]);
+                const Operand* my = memoryOperand(code[begin + s]);
+                bool alias = !mx || !my || mayAlias(*mx, *my);
+                isRaw = isRaw || (alias && x.store && y.load);
+                other = other || alias;
+            }
+            if (isRaw || other) preds[s] |= uint64_t(1) << p;
+            if (isRaw) raw[s] |= uint64_t(1) << p;
+        }
+    }
+
+    // 优先级：到基本块末尾的最长延迟路径
+    int height[maxBlock];
+    for (size_t k = n; k-- > 0;) {
+        height[k] = lat[k];
+        for (size_t s = k + 1; s < n; s++) {
+            if (preds[s] >> k & 1) {
+                int weight = (raw[s] >> k & 1) ? lat[k] : 0;
+                height[k] = std::max(height[k], weight + height[s]);
+            }
+        }
+    }
+
+    // 按周期模拟单发射：每个周期从前驱都已完成的指令中选优先级最高的
+    int earliest[maxBlock] = {};  // 前驱的结果都可用的最早周期
+    uint64_t done = 0;
+    size_t order[maxBlock];
+    int cycle = 0;
+    for (size_t count = 0; count < n;) {
+        size_t best = n;
+        int nextCycle = INT_MAX;
+        for (size_t k = 0; k < n; k++) {
+            if ((done >> k & 1) || (preds[k] & ~done)) continue;
+            if (earliest[k] > cycle) {
+                nextCycle = std::min(nextCycle, earliest[k]);
+            } else if (best == n || height[k] > height[best]) {
+                best = k;
+            }
+        }
+        if (best == n) {
+            cycle = nextCycle;
+            continue;
+        }
+        done |= uint64_t(1) << best;
+        for (size_t k = best + 1; k < n; k++) {
+            if (preds[k] >> best & 1) {
+                earliest[k] = std::max(earliest[k], cycle + ((raw[k] >> best & 1) ? lat[best] : 0));
+            }
+        }
+        cycle++;
+        order[count++] = best;
+    }
+
+    size_t moved = 0;
+    for (size_t k = 0; k < n; k++) {
+        if (order[k] != k) moved++;
+    }
+    if (moved == 0) return;
+    std::vector<Inst> block(code.begin() + static_cast<std::ptrdiff_t>(begin),
+                            code.begin() + static_cast<std::ptrdiff_t>(end));
+    std::vector<int64_t> blockLines(lines.begin() + static_cast<std::ptrdiff_t>(begin),
+                                    lines.begin() + static_cast<std::ptrdiff_t>(end));
+    for (size_t k = 0; k < n; k++) {
+        code[begin + k] = block[order[k]];
+        lines[begin + k] = blockLines[order[k]];
+    }
+    stats.scheduledBlocks++;
+    stats.movedInstructions += moved;
+}
+
+} // namespace
+
+const char* peepholeName(Peephole pattern) {
+    switch (pattern) {
+        case Peephole::PUSH_POP:         return "pushPop";
+        case Peephole::COPY_COALESCE:    return "copyCoalesce";
+        case Peephole::COPY_PROPAGATE:   return "copyPropagate";
+        case Peephole::COMPARE_OPERAND:  return "compareOperand";
+        case Peephole::STORE_LOAD:       return "storeLoad";
+        case Peephole::LEA:              return "lea";
+        case Peephole::DEAD_CODE:        return "deadCode";
+        case Peephole::UNREACHABLE:      return "unreachable";
+        case Peephole::JUMP_NEXT:        return "jumpNext";
+        case Peephole::BRANCH_INVERSION: return "branchInversion";
+        case Peephole::COUNT:            break;
+    }
+    return "?";
+}
+
+void optimizePeephole(MFunction& function, PeepholeStats& stats) {
+    // 每轮之后重新计算活跃性；轮数有上限，防止极端情况下耗时过长
+    for (int round = 0; round < 32; round++) {
+        PeepholePass pass(function, stats);
+        if (!pass.run()) break;
+    }
+}
+
+void scheduleInstructions(MFunction& function, PeepholeStats& stats) {
+    // 取出行号伪指令，记下每条指令所在的行（函数入口处为0行）
+    std::vector<Inst> code;
+    std::vector<int64_t> lines;
+    int64_t line = 0;
+    for (const Inst& inst : function.code) {
+        if (inst.op == Op::LINE) {
+            line = inst.a.imm;
+        } else {
+            code.push_back(inst);
+            lines.push_back(line);
+        }
+    }
+
+    std::vector<RegSet> live = liveOut(code, function.numLabels);
+    std::vector<Effects> info(code.size());
+    for (size_t k = 0; k < code.size(); k++) info[k] = effects(code[k]);
+    size_t begin = 0;
+    for (size_t k = 0; k <= code.size(); k++) {
+        if (k == code.size() || isBoundary(code[k], info[k])) {
+            scheduleBlock(code, lines, info, live, begin, k, stats);
+            begin = k + 1;
+        } else if (k + 1 - begin == maxBlock) {
+            // 很长的直线代码分段调度
+            scheduleBlock(code, lines, info, live, begin, k + 1, stats);
+            begin = k + 1;
+        }
+    }
+
+    function.code.clear();
+    line = 0;
+    for (size_t k = 0; k < code.size(); k++) {
+        if (lines[k] != line) {
+            line = lines[k];
+            function.code.emplace_back(Op::LINE, 4, Operand::immediate(line));
+        }
+        function.code.push_back(code[k]);
+    }
+}
+
+} // namespace x86
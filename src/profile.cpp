@@ -0,0 +1,181 @@
+#include "profile.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const char profileMagic[] = "cminus-profile";
+const int profileVersion = 1;
+
+// 插桩位置：if、while 和调用用户函数的调用
+bool isSite(const ASTNode& node) {
+    switch (node.type) {
+        case ASTNodeType::SELECTION_STMT:
+        case ASTNodeType::ITERATION_STMT:
+            return true;
+        case ASTNodeType::CALL:
+            return static_cast<const CallNode&>(node).builtin == BuiltinKind::NONE;
+        default:
+            return false;
+    }
+}
+
+// 按先序收集插桩位置（共享的子树只含无副作用的表达式，其中没有插桩位置）
+void collectSites(const ASTNode& node, std::vector<const ASTNode*>& sites) {
+    if (isSite(node)) sites.push_back(&node);
+    visitChildren(node, [&](const ASTNode& child) { collectSites(child, sites); });
+}
+
+void hashStructure(const ASTNode& node, Hasher& hasher) {
+    bool site = isSite(node);
+    if (site) {
+        hasher.number(static_cast<int64_t>(node.type) + 1);
+        if (node.type == ASTNodeType::CALL) hasher.text(static_cast<const CallNode&>(node).identifier);
+    }
+    visitChildren(node, [&](const ASTNode& child) { hashStructure(child, hasher); });
+    if (site) hasher.number(0);
+}
+
+std::string toHex(const Hash128& hash) {
+    char buffer[33];
+    std::snprintf(buffer, sizeof buffer, "%016llx%016llx", static_cast<unsigned long long>(hash.high),
+                  static_cast<unsigned long long>(hash.low));
+    return buffer;
+}
+
+bool fromHex(const std::string& text, Hash128& hash) {
+    if (text.size() != 32 || text.find_first_not_of("0123456789abcdef") != std::string::npos) return false;
+    hash.high = std::stoull(text.substr(0, 16), nullptr, 16);
+    hash.low = std::stoull(text.substr(16), nullptr, 16);
+    return true;
+}
+
+} // namespace
+
+CounterLayout layoutCounters(const FunDeclarationNode& fun) {
+    CounterLayout layout;
+    std::vector<const ASTNode*> sites;
+    collectSites(*fun.body, sites);
+    for (const ASTNode* site : sites) {
+        layout.first[site] = layout.size;
+        layout.size += site->type == ASTNodeType::CALL ? 1 : 2;
+    }
+    return layout;
+}
+
+Hash128 structuralHash(const FunDeclarationNode& fun) {
+    Hasher hasher;
+    hasher.number(static_cast<int64_t>(fun.params.size()));
+    hashStructure(*fun.body, hasher);
+    return hasher.result();
+}
+
+bool Profile::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    auto invalid = [&path]() { return std::runtime_error("Invalid profile file '" + path + "'"); };
+    std::string magic;
+    int version = 0;
+    if (!(file >> magic >> version) || magic != profileMagic) throw invalid();
+    if (version != profileVersion) {
+        throw std::runtime_error("Profile file '" + path + "' has unsupported version " + std::to_string(version));
+    }
+
+    std::string keyword;
+    while (file >> keyword) {
+        std::string name;
+        std::string hashText;
+        size_t size = 0;
+        Entry entry;
+        if (keyword != "function" || !(file >> name >> hashText >> size) || !fromHex(hashText, entry.hash) ||
+            size == 0 || size > (1u << 24)) {
+            throw invalid();
+        }
+        entry.counters.resize(size);
+        for (uint64_t& counter : entry.counters) {
+            if (!(file >> counter)) throw invalid();
+        }
+        if (functions.find(name) == functions.end()) order.push_back(name);
+        functions[name] = std::move(entry);
+    }
+    if (!file.eof()) throw invalid();
+    return true;
+}
+
+void Profile::save(const std::string& path) const {
+    std::ostringstream text;
+    text << profileMagic << " " << profileVersion << "\n";
+    for (const std::string& name : order) {
+        const Entry& entry = functions.at(name);
+        text << "function " << name << " " << toHex(entry.hash) << " " << entry.counters.size() << "\n";
+        for (size_t i = 0; i < entry.counters.size(); i++) {
+            text << (i == 0 ? "" : " ") << entry.counters[i];
+        }
+        text << "\n";
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    file << text.str();
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Failed to write profile '" + path + "'");
+    }
+}
+
+void Profile::add(const std::string& function, const Hash128& hash, const std::vector<uint64_t>& counters) {
+    auto found = functions.find(function);
+    if (found == functions.end()) {
+        order.push_back(function);
+        functions[function] = Entry{hash, counters};
+        return;
+    }
+    Entry& entry = found->second;
+    if (entry.hash != hash || entry.counters.size() != counters.size()) {
+        entry = Entry{hash, counters};
+        return;
+    }
+    for (size_t i = 0; i < counters.size(); i++) {
+        entry.counters[i] += counters[i];
+    }
+}
+
+int Profile::annotate(ProgramNode& program, std::vector<const FunDeclarationNode*>* stale) const {
+    int matched = 0;
+    for (auto& decl : program.declarations) {
+        if (decl->type != ASTNodeType::FUN_DECLARATION) continue;
+        auto& fun = static_cast<FunDeclarationNode&>(*decl);
+        auto found = functions.find(fun.identifier);
+        if (found == functions.end()) continue;
+
+        const Entry& entry = found->second;
+        CounterLayout layout = layoutCounters(fun);
+        if (entry.hash != structuralHash(fun) || entry.counters.size() != static_cast<size_t>(layout.size)) {
+            if (stale) stale->push_back(&fun);
+            continue;
+        }
+        auto counter = [&](int index) { return static_cast<int64_t>(entry.counters[index]); };
+        fun.counts.count = counter(0);
+        // 布局中的节点就是本程序的节点，这里只是去掉 const
+        for (const auto& site : layout.first) {
+            ExecutionCounts counts{counter(site.second), 0};
+            switch (site.first->type) {
+                case ASTNodeType::SELECTION_STMT:
+                    counts.taken = counter(site.second + 1);
+                    const_cast<SelectionStmtNode*>(static_cast<const SelectionStmtNode*>(site.first))->counts = counts;
+                    break;
+                case ASTNodeType::ITERATION_STMT:
+                    counts.taken = counter(site.second + 1);
+                    const_cast<IterationStmtNode*>(static_cast<const IterationStmtNode*>(site.first))->counts = counts;
+                    break;
+                default:
+                    const_cast<CallNode*>(static_cast<const CallNode*>(site.first))->counts = counts;
+                    break;
+            }
+        }
+        matched++;
+    }
+    return matched;
+}
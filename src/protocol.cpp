@@ -0,0 +1,124 @@
+#include "protocol.h"
+#include <cerrno>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace protocol {
+
+namespace {
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        // MSG_NOSIGNAL：对端关闭时返回错误而不是触发 SIGPIPE
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void putU32(char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out[i] = static_cast<char>(value >> (8 * i));
+}
+
+uint32_t getU32(const char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= uint32_t(static_cast<unsigned char>(in[i])) << (8 * i);
+    return value;
+}
+
+} // namespace
+
+std::string defaultSocketPath() {
+    if (const char* path = std::getenv("CMINUS_SERVER_SOCKET")) {
+        if (*path) return path;
+    }
+    return "/tmp/cminus-" + std::to_string(getuid()) + ".sock";
+}
+
+bool writeFrame(int fd, FrameType type, const char* data, size_t size) {
+    if (size > maxFrameSize) return false;
+    char header[5];
+    putU32(header, static_cast<uint32_t>(size));
+    header[4] = static_cast<char>(type);
+    return writeAll(fd, header, sizeof(header)) && writeAll(fd, data, size);
+}
+
+bool readFrame(int fd, FrameType& type, std::string& payload) {
+    char header[5];
+    if (!readAll(fd, header, sizeof(header))) return false;
+    uint32_t size = getU32(header);
+    if (size > maxFrameSize) return false;
+    type = static_cast<FrameType>(header[4]);
+    payload.resize(size);
+    return readAll(fd, &payload[0], size);
+}
+
+void encodeStrings(const std::vector<std::string>& strings, std::string& payload) {
+    payload.clear();
+    for (const std::string& s : strings) {
+        char length[4];
+        putU32(length, static_cast<uint32_t>(s.size()));
+        payload.append(length, 4);
+        payload += s;
+    }
+}
+
+bool decodeStrings(const std::string& payload, std::vector<std::string>& strings) {
+    strings.clear();
+    size_t pos = 0;
+    while (pos < payload.size()) {
+        if (payload.size() - pos < 4) return false;
+        uint32_t length = getU32(payload.data() + pos);
+        pos += 4;
+        if (payload.size() - pos < length) return false;
+        strings.emplace_back(payload, pos, length);
+        pos += length;
+    }
+    return true;
+}
+
+FrameStreambuf::FrameStreambuf(int fd, FrameType type, size_t capacity)
+    : fd(fd), type(type), buffer(capacity), failed(false) {
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+bool FrameStreambuf::send() {
+    size_t size = static_cast<size_t>(pptr() - pbase());
+    if (size > 0 && !failed) {
+        failed = !writeFrame(fd, type, pbase(), size);
+    }
+    setp(buffer.data(), buffer.data() + buffer.size());
+    return !failed;
+}
+
+FrameStreambuf::int_type FrameStreambuf::overflow(int_type c) {
+    send();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    // 连接断开后仍然“成功”，让编译正常结束
+    return traits_type::not_eof(c);
+}
+
+int FrameStreambuf::sync() {
+    send();
+    return 0;
+}
+
+} // namespace protocol
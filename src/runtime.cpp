@@ -0,0 +1,97 @@
+#include "runtime.h"
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+
+namespace {
+
+// 栈底之上留给 input/output 等运行库函数和信号处理函数的空间
+const uintptr_t stackMargin = 256 * 1024;
+
+// 重定向状态
+const std::string* redirectedInput = nullptr;
+size_t inputPosition = 0;
+std::string* redirectedOutput = nullptr;
+
+// 从内存输入中读取一个整数（格式同 scanf 的 %d）
+bool readRedirected(int& value) {
+    const std::string& input = *redirectedInput;
+    const char* begin = input.c_str() + inputPosition;
+    char* end = nullptr;
+    long parsed = std::strtol(begin, &end, 10);
+    if (end == begin) {
+        return false;
+    }
+    inputPosition += static_cast<size_t>(end - begin);
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+} // namespace
+
+extern "C" {
+
+int cminus_input(void) {
+    int value = 0;
+    if (redirectedInput) {
+        return readRedirected(value) ? value : 0;
+    }
+    if (std::scanf("%d", &value) != 1) {
+        return 0;
+    }
+    return value;
+}
+
+void cminus_output(int value) {
+    if (redirectedOutput) {
+        *redirectedOutput += std::to_string(value);
+        *redirectedOutput += '\n';
+        return;
+    }
+    std::printf("%d\n", value);
+}
+
+void cminus_bounds_error(int index, int line) {
+    std::fflush(stdout);
+    std::fprintf(stderr, "Runtime error: array index %d out of bounds at line %d\n", index, line);
+    std::exit(1);
+}
+
+void cminus_division_error(int line) {
+    std::fflush(stdout);
+    std::fprintf(stderr, "Runtime error: division by zero at line %d\n", line);
+    std::exit(1);
+}
+
+uintptr_t cminus_stack_limit(void) {
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(), &attributes) != 0) return 0;
+    void* address = nullptr;
+    size_t size = 0;
+    int status = pthread_attr_getstack(&attributes, &address, &size);
+    pthread_attr_destroy(&attributes);
+    if (status != 0 || size <= stackMargin) return 0;
+    return reinterpret_cast<uintptr_t>(address) + stackMargin;
+}
+
+void cminus_stack_overflow(const char* function, int line) {
+    std::fflush(stdout);
+    std::fprintf(stderr, "Runtime error: stack overflow in call to '%s' at line %d\n", function, line);
+    std::exit(1);
+}
+
+}
+
+namespace runtime {
+
+void redirect(const std::string* input, std::string* output) {
+    redirectedInput = input;
+    inputPosition = 0;
+    redirectedOutput = output;
+}
+
+void restore() {
+    redirect(nullptr, nullptr);
+}
+
+}
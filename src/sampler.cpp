@@ -0,0 +1,62 @@
+#include "sampler.h"
+#include <algorithm>
+#include <cstdio>
+
+void SampleProfile::add(const std::vector<SampleFrame>& stack, uint64_t count) {
+    if (stack.empty() || count == 0) return;
+    total += count;
+
+    std::string folded;
+    for (const SampleFrame& frame : stack) {
+        if (!folded.empty()) folded += ';';
+        folded += frame.function;
+    }
+    stacks[folded] += count;
+
+    // 递归时同一行在栈中出现多次，累计只算一次
+    std::vector<int> seen;
+    for (const SampleFrame& frame : stack) {
+        if (frame.line <= 0 || std::find(seen.begin(), seen.end(), frame.line) != seen.end()) continue;
+        seen.push_back(frame.line);
+        lines[frame.line].total += count;
+    }
+    if (stack.back().line > 0) lines[stack.back().line].self += count;
+}
+
+void SampleProfile::writeFolded(std::ostream& out) const {
+    for (const auto& entry : stacks) {
+        out << entry.first << " " << entry.second << "\n";
+    }
+}
+
+void SampleProfile::writeListing(std::ostream& out, std::string_view source) const {
+    auto percent = [this](uint64_t count) {
+        char buffer[16];
+        std::snprintf(buffer, sizeof buffer, "%6.1f%%", 100.0 * static_cast<double>(count) / static_cast<double>(total));
+        return std::string(buffer);
+    };
+
+    out << "# " << total << " samples\n";
+    out << "#  self   total   line\n";
+    int line = 1;
+    size_t position = 0;
+    while (position < source.size()) {
+        size_t end = source.find('\n', position);
+        if (end == std::string_view::npos) end = source.size();
+        std::string_view text = source.substr(position, end - position);
+        if (!text.empty() && text.back() == '\r') text.remove_suffix(1);
+
+        char number[16];
+        std::snprintf(number, sizeof number, "%6d", line);
+        auto found = lines.find(line);
+        if (found != lines.end() && total > 0) {
+            out << percent(found->second.self) << " " << percent(found->second.total);
+        } else {
+            out << std::string(15, ' ');
+        }
+        out << " " << number << " | " << text << "\n";
+
+        position = end + 1;
+        line++;
+    }
+}
@@ -0,0 +1,526 @@
+#include "semantic.h"
+#include "diagnostic.h"
+#include <stdexcept>
+
+// 构造函数
+SemanticAnalyzer::SemanticAnalyzer()
+    : sources(nullptr), numGlobalSlots(0), globalArrayWords(0), currentFunction(nullptr), streaming(false) {}
+
+// 错误处理
+void SemanticAnalyzer::error(const std::string& message, SourceOffset start) const {
+    SourceLocation location = sources ? sources->location(start) : SourceLocation();
+    throw CompileError("Semantic error: " + message + " at line " + std::to_string(location.line), location);
+}
+
+// 在当前作用域中声明符号
+void SemanticAnalyzer::declareSymbol(const std::string& name, const Symbol& symbol, SourceOffset start) {
+    if (!scopes.back().emplace(name, symbol).second) {
+        error("Redeclaration of '" + name + "'", start);
+    }
+}
+
+// 由内向外查找符号
+const SemanticAnalyzer::Symbol* SemanticAnalyzer::lookup(const std::string& name) const {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) {
+            return &found->second;
+        }
+    }
+    return nullptr;
+}
+
+// 清空上一次分析的状态
+void SemanticAnalyzer::reset() {
+    scopes.clear();
+    functions.clear();
+    pendingCalls.clear();
+    scopes.emplace_back();
+    numGlobalSlots = 0;
+    globalArrayWords = 0;
+    voidUse.clear();
+    evaluator.clear();
+}
+
+// 分析整个程序
+void SemanticAnalyzer::analyze(ProgramNode& program) {
+    reset();
+    streaming = false;
+    sources = program.sources.get();
+
+    // 先收集所有函数，允许相互递归
+    for (auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::FUN_DECLARATION) {
+            declareFunction(static_cast<FunDeclarationNode*>(decl.get()));
+        }
+    }
+
+    // 全局变量按声明顺序可见
+    for (auto& decl : program.declarations) {
+        if (decl->type == ASTNodeType::FUN_DECLARATION) {
+            analyzeFunction(*static_cast<FunDeclarationNode*>(decl.get()));
+        } else {
+            declareGlobal(decl.get());
+        }
+    }
+    program.numGlobalSlots = numGlobalSlots;
+    program.globalArrayWords = globalArrayWords;
+
+    auto mainIt = functions.find("main");
+    if (mainIt == functions.end()) {
+        error("Missing function 'main'", program.start);
+    }
+    if (!mainIt->second.paramIsArray.empty()) {
+        error("Function 'main' must not take parameters", mainIt->second.start);
+    }
+}
+
+// 开始流式分析
+void SemanticAnalyzer::beginStream(const SourceManager& sources) {
+    reset();
+    streaming = true;
+    this->sources = &sources;
+}
+
+// 流式分析一个顶层声明：函数在分析函数体之前声明，允许递归
+void SemanticAnalyzer::analyzeDeclaration(ASTNode& decl) {
+    if (decl.type == ASTNodeType::FUN_DECLARATION) {
+        auto& fun = static_cast<FunDeclarationNode&>(decl);
+        declareFunction(&fun);
+        analyzeFunction(fun);
+    } else {
+        declareGlobal(&decl);
+    }
+}
+
+// 结束流式分析：所有被调函数都应已定义，并且有 main
+void SemanticAnalyzer::finishStream(SourceOffset start) {
+    const std::string* undeclared = nullptr;
+    SourceOffset undeclaredStart = 0;
+    for (const auto& call : pendingCalls) {
+        if (!undeclared || call.second.start < undeclaredStart) {
+            undeclared = &call.first;
+            undeclaredStart = call.second.start;
+        }
+    }
+    if (undeclared) {
+        error("Call to undeclared function '" + *undeclared + "'", undeclaredStart);
+    }
+
+    auto mainIt = functions.find("main");
+    if (mainIt == functions.end()) {
+        error("Missing function 'main'", start);
+    }
+    if (!mainIt->second.paramIsArray.empty()) {
+        error("Function 'main' must not take parameters", mainIt->second.start);
+    }
+    streaming = false;
+}
+
+// 声明全局变量
+void SemanticAnalyzer::declareGlobal(ASTNode* decl) {
+    if (decl->type == ASTNodeType::ARRAY_DECLARATION) {
+        auto* arrayDecl = static_cast<ArrayDeclarationNode*>(decl);
+        if (arrayDecl->typeSpecifier == "void") {
+            error("Array '" + arrayDecl->identifier + "' declared void", decl->start);
+        }
+        evaluateArraySize(*arrayDecl);
+        arrayDecl->isGlobal = true;
+        allocateArray(*arrayDecl, globalArrayWords, "Global arrays");
+        declareSymbol(arrayDecl->identifier,
+                      {VarKind::GLOBAL_ARRAY, arrayDecl->offset, arrayDecl->arraySize}, decl->start);
+        return;
+    }
+
+    auto* varDecl = static_cast<VarDeclarationNode*>(decl);
+    if (varDecl->typeSpecifier == "void") {
+        error("Variable '" + varDecl->identifier + "' declared void", decl->start);
+    }
+    if (varDecl->initializer && varDecl->initializer->type != ASTNodeType::NUM) {
+        error("Initializer of global '" + varDecl->identifier + "' must be a constant", decl->start);
+    }
+    if (functions.count(varDecl->identifier)) {
+        error("'" + varDecl->identifier + "' redeclared as variable", decl->start);
+    }
+    varDecl->isGlobal = true;
+    varDecl->slot = numGlobalSlots++;
+    declareSymbol(varDecl->identifier, {VarKind::GLOBAL_SCALAR, varDecl->slot, 0}, decl->start);
+}
+
+// 声明函数
+void SemanticAnalyzer::declareFunction(FunDeclarationNode* fun) {
+    if (fun->identifier.empty()) {
+        error("Function without a name", fun->start);
+    }
+    if (fun->identifier == "input" || fun->identifier == "output") {
+        error("Redefinition of builtin function '" + fun->identifier + "'", fun->start);
+    }
+    // 整体分析时先声明所有函数，全局作用域此时为空；流式分析时全局变量可能已经声明
+    if (scopes.front().count(fun->identifier)) {
+        error("'" + fun->identifier + "' redeclared as function", fun->start);
+    }
+
+    Function function{streaming ? nullptr : fun, fun->returnType == "void", {}, fun->start};
+    for (const auto& param : fun->params) {
+        function.paramIsArray.push_back(static_cast<ParamNode*>(param.get())->isArray);
+    }
+    auto inserted = functions.emplace(fun->identifier, std::move(function));
+    if (!inserted.second) {
+        error("Redefinition of function '" + fun->identifier + "'", fun->start);
+    }
+
+    // 检查此前对它的调用
+    auto range = pendingCalls.equal_range(fun->identifier);
+    for (auto it = range.first; it != range.second; ++it) {
+        const PendingCall& call = it->second;
+        const Function& callee = inserted.first->second;
+        checkArgumentCount(fun->identifier, callee, call.args.size(), call.start);
+        for (size_t i = 0; i < call.args.size(); i++) {
+            checkArgument(fun->identifier, callee, i, call.args[i], call.start);
+        }
+        if (callee.returnsVoid && !call.voidUse.empty()) {
+            error(call.voidUse, call.start);
+        }
+    }
+    pendingCalls.erase(range.first, range.second);
+}
+
+// 分析函数定义
+void SemanticAnalyzer::analyzeFunction(FunDeclarationNode& fun) {
+    currentFunction = &fun;
+    fun.numSlots = 0;
+    fun.arrayWords = 0;
+    referenceHasher = Hasher();
+
+    scopes.emplace_back();
+    for (auto& param : fun.params) {
+        auto* paramNode = static_cast<ParamNode*>(param.get());
+        if (paramNode->typeSpecifier == "void") {
+            error("Parameter '" + paramNode->identifier + "' declared void", param->start);
+        }
+        paramNode->slot = fun.numSlots++;
+        VarKind kind = paramNode->isArray ? VarKind::PARAM_ARRAY : VarKind::LOCAL_SCALAR;
+        declareSymbol(paramNode->identifier, {kind, paramNode->slot, 0}, param->start);
+    }
+
+    // 函数体与参数共用一个作用域
+    auto* body = static_cast<CompoundStmtNode*>(fun.body.get());
+    for (auto& decl : body->localDeclarations) {
+        analyzeLocalDeclaration(decl.get());
+    }
+    for (auto& stmt : body->statements) {
+        analyzeStatement(stmt.get());
+    }
+    scopes.pop_back();
+
+    fun.referenceHash = referenceHasher.result();
+    currentFunction = nullptr;
+    // 之后的数组长度可以调用它（流式分析时函数分析完即释放）
+    if (!streaming) evaluator.addFunction(fun);
+}
+
+// 分析复合语句
+void SemanticAnalyzer::analyzeCompoundStmt(CompoundStmtNode& compoundStmt) {
+    scopes.emplace_back();
+    for (auto& decl : compoundStmt.localDeclarations) {
+        analyzeLocalDeclaration(decl.get());
+    }
+    for (auto& stmt : compoundStmt.statements) {
+        analyzeStatement(stmt.get());
+    }
+    scopes.pop_back();
+}
+
+// 求数组长度：常量表达式（见 ConstantEvaluator）在编译期求值，其中调用的函数须已分析
+void SemanticAnalyzer::evaluateArraySize(ArrayDeclarationNode& arrayDecl) {
+    if (arrayDecl.sizeExpression) {
+        expectInt(arrayDecl.sizeExpression.get(), "array size");
+        int32_t size;
+        if (!evaluator.evaluate(*arrayDecl.sizeExpression, size)) {
+            error("Size of array '" + arrayDecl.identifier + "' is not a constant expression", arrayDecl.start);
+        }
+        arrayDecl.arraySize = size;
+        arrayDecl.sizeExpression.reset();
+    }
+    if (arrayDecl.arraySize <= 0) {
+        error("Array '" + arrayDecl.identifier + "' must have positive size", arrayDecl.start);
+    }
+}
+
+// 在数组区（全局数组或函数的局部数组）末尾分配数组，总长度不超过 maxArrayWords
+void SemanticAnalyzer::allocateArray(ArrayDeclarationNode& arrayDecl, int& words, const std::string& owner) {
+    if (arrayDecl.arraySize > maxArrayWords - words) {
+        error(owner + " exceed " + std::to_string(maxArrayWords) + " ints", arrayDecl.start);
+    }
+    arrayDecl.offset = words;
+    words += arrayDecl.arraySize;
+}
+
+// 分析局部声明
+void SemanticAnalyzer::analyzeLocalDeclaration(ASTNode* decl) {
+    if (decl->type == ASTNodeType::ARRAY_DECLARATION) {
+        auto* arrayDecl = static_cast<ArrayDeclarationNode*>(decl);
+        if (arrayDecl->typeSpecifier == "void") {
+            error("Array '" + arrayDecl->identifier + "' declared void", decl->start);
+        }
+        bool computed = arrayDecl->sizeExpression != nullptr;
+        evaluateArraySize(*arrayDecl);
+        // 长度由函数计算时随被调函数改变，函数级缓存须区分
+        if (computed) referenceHasher.number(arrayDecl->arraySize);
+        arrayDecl->isGlobal = false;
+        allocateArray(*arrayDecl, currentFunction->arrayWords,
+                      "Local arrays of '" + currentFunction->identifier + "'");
+        declareSymbol(arrayDecl->identifier,
+                      {VarKind::LOCAL_ARRAY, arrayDecl->offset, arrayDecl->arraySize}, decl->start);
+        return;
+    }
+
+    auto* varDecl = static_cast<VarDeclarationNode*>(decl);
+    if (varDecl->typeSpecifier == "void") {
+        error("Variable '" + varDecl->identifier + "' declared void", decl->start);
+    }
+    // 初始化表达式在变量声明之前求值，不能引用变量自身
+    if (varDecl->initializer) {
+        expectInt(varDecl->initializer.get(), "initializer");
+    }
+    varDecl->isGlobal = false;
+    varDecl->slot = currentFunction->numSlots++;
+    declareSymbol(varDecl->identifier, {VarKind::LOCAL_SCALAR, varDecl->slot, 0}, decl->start);
+}
+
+// 分析语句
+void SemanticAnalyzer::analyzeStatement(ASTNode* stmt) {
+    switch (stmt->type) {
+        case ASTNodeType::COMPOUND_STMT:
+            analyzeCompoundStmt(*static_cast<CompoundStmtNode*>(stmt));
+            break;
+
+        case ASTNodeType::EXPRESSION_STMT: {
+            auto* exprStmt = static_cast<ExpressionStmtNode*>(stmt);
+            if (exprStmt->expression) {
+                // 表达式语句允许调用void函数
+                if (analyzeExpression(exprStmt->expression.get()) == ExprType::ARRAY) {
+                    error("Array used as a value", stmt->start);
+                }
+            }
+            break;
+        }
+
+        case ASTNodeType::SELECTION_STMT: {
+            auto* selectionStmt = static_cast<SelectionStmtNode*>(stmt);
+            expectInt(selectionStmt->condition.get(), "if condition");
+            analyzeStatement(selectionStmt->ifBranch.get());
+            if (selectionStmt->elseBranch) {
+                analyzeStatement(selectionStmt->elseBranch.get());
+            }
+            break;
+        }
+
+        case ASTNodeType::ITERATION_STMT: {
+            auto* iterationStmt = static_cast<IterationStmtNode*>(stmt);
+            expectInt(iterationStmt->condition.get(), "while condition");
+            analyzeStatement(iterationStmt->body.get());
+            break;
+        }
+
+        case ASTNodeType::RETURN_STMT: {
+            auto* returnStmt = static_cast<ReturnStmtNode*>(stmt);
+            bool isVoid = currentFunction->returnType == "void";
+            if (returnStmt->expression) {
+                if (isVoid) {
+                    error("Void function '" + currentFunction->identifier + "' returns a value", stmt->start);
+                }
+                expectInt(returnStmt->expression.get(), "return value");
+                markTailCall(returnStmt->expression.get());
+            } else if (!isVoid) {
+                error("Function '" + currentFunction->identifier + "' must return a value", stmt->start);
+            }
+            break;
+        }
+
+        default:
+            error("Unexpected node in statement", stmt->start);
+    }
+}
+
+// return f(...) 是尾调用，可以直接复用当前栈帧（自身递归和相互递归均可）。
+// 以局部数组为实参时不行：被调函数仍要访问调用者栈帧中的数组。
+void SemanticAnalyzer::markTailCall(ASTNode* expr) {
+    if (expr->type != ASTNodeType::CALL) return;
+    auto* call = static_cast<CallNode*>(expr);
+    if (call->builtin != BuiltinKind::NONE) return;
+    for (const auto& arg : call->args) {
+        if (arg->type == ASTNodeType::VAR && static_cast<VarNode*>(arg.get())->kind == VarKind::LOCAL_ARRAY &&
+            !static_cast<VarNode*>(arg.get())->index) {
+            return;
+        }
+    }
+    call->tailCall = true;
+}
+
+// 要求表达式为int类型
+void SemanticAnalyzer::expectInt(ASTNode* expr, const char* context) {
+    if (streaming && expr->type == ASTNodeType::CALL) {
+        voidUse = std::string("Void value used in ") + context;
+    }
+    ExprType type = analyzeExpression(expr);
+    if (type == ExprType::VOID) {
+        error(std::string("Void value used in ") + context, expr->start);
+    }
+    if (type == ExprType::ARRAY) {
+        error(std::string("Array used as a value in ") + context, expr->start);
+    }
+}
+
+// 分析表达式并返回其类型
+SemanticAnalyzer::ExprType SemanticAnalyzer::analyzeExpression(ASTNode* expr) {
+    switch (expr->type) {
+        case ASTNodeType::NUM:
+            return ExprType::INT;
+
+        case ASTNodeType::VAR:
+            return analyzeVar(*static_cast<VarNode*>(expr));
+
+        case ASTNodeType::CALL:
+            return analyzeCall(*static_cast<CallNode*>(expr));
+
+        case ASTNodeType::ASSIGN_EXPR: {
+            auto* assignExpr = static_cast<AssignExprNode*>(expr);
+            if (analyzeVar(*static_cast<VarNode*>(assignExpr->var.get())) != ExprType::INT) {
+                error("Cannot assign to an array", expr->start);
+            }
+            expectInt(assignExpr->expression.get(), "assignment");
+            return ExprType::INT;
+        }
+
+        case ASTNodeType::SIMPLE_EXPR: {
+            auto* simpleExpr = static_cast<SimpleExprNode*>(expr);
+            expectInt(simpleExpr->left.get(), "comparison");
+            expectInt(simpleExpr->right.get(), "comparison");
+            return ExprType::INT;
+        }
+
+        case ASTNodeType::BIN_OP: {
+            auto* binOp = static_cast<BinOpNode*>(expr);
+            expectInt(binOp->left.get(), "arithmetic");
+            expectInt(binOp->right.get(), "arithmetic");
+            return ExprType::INT;
+        }
+
+        default:
+            error("Unexpected node in expression", expr->start);
+            return ExprType::VOID;
+    }
+}
+
+// 解析变量引用
+SemanticAnalyzer::ExprType SemanticAnalyzer::analyzeVar(VarNode& var) {
+    const Symbol* symbol = lookup(var.identifier);
+    if (!symbol) {
+        error("Undeclared variable '" + var.identifier + "'", var.start);
+    }
+
+    var.kind = symbol->kind;
+    var.slot = symbol->slot;
+    var.arraySize = symbol->arraySize;
+    if (currentFunction && (var.kind == VarKind::GLOBAL_SCALAR || var.kind == VarKind::GLOBAL_ARRAY)) {
+        referenceHasher.text(var.identifier);
+        referenceHasher.number(static_cast<int64_t>(var.kind));
+        referenceHasher.number(var.slot);
+        referenceHasher.number(var.arraySize);
+    }
+
+    bool isArray = symbol->kind == VarKind::GLOBAL_ARRAY ||
+                   symbol->kind == VarKind::LOCAL_ARRAY ||
+                   symbol->kind == VarKind::PARAM_ARRAY;
+
+    if (var.index) {
+        if (!isArray) {
+            error("Subscripted value '" + var.identifier + "' is not an array", var.start);
+        }
+        expectInt(var.index.get(), "array index");
+        return ExprType::INT;
+    }
+
+    return isArray ? ExprType::ARRAY : ExprType::INT;
+}
+
+// 解析函数调用
+SemanticAnalyzer::ExprType SemanticAnalyzer::analyzeCall(CallNode& call) {
+    if (call.identifier == "input") {
+        if (!call.args.empty()) {
+            error("Builtin 'input' takes no arguments", call.start);
+        }
+        call.builtin = BuiltinKind::INPUT;
+        return ExprType::INT;
+    }
+    if (call.identifier == "output") {
+        if (call.args.size() != 1) {
+            error("Builtin 'output' takes one argument", call.start);
+        }
+        expectInt(call.args[0].get(), "argument");
+        call.builtin = BuiltinKind::OUTPUT;
+        return ExprType::VOID;
+    }
+
+    call.builtin = BuiltinKind::NONE;
+    std::string callVoidUse;
+    if (streaming) callVoidUse.swap(voidUse);
+
+    auto it = functions.find(call.identifier);
+    if (it == functions.end()) {
+        if (!streaming) {
+            error("Call to undeclared function '" + call.identifier + "'", call.start);
+        }
+        // 流式分析：被调函数可能在后面定义，先记下实参类型，返回值暂按int处理
+        PendingCall pending{{}, std::move(callVoidUse), call.start};
+        for (size_t i = 0; i < call.args.size(); i++) {
+            if (call.args[i]->type == ASTNodeType::CALL) {
+                voidUse = "Argument " + std::to_string(i + 1) + " of '" + call.identifier + "' must be an int";
+            }
+            pending.args.push_back(analyzeExpression(call.args[i].get()));
+        }
+        pendingCalls.emplace(call.identifier, std::move(pending));
+        return ExprType::INT;
+    }
+    const Function& callee = it->second;
+    checkArgumentCount(call.identifier, callee, call.args.size(), call.start);
+
+    for (size_t i = 0; i < call.args.size(); i++) {
+        if (streaming && call.args[i]->type == ASTNodeType::CALL) {
+            voidUse = "Argument " + std::to_string(i + 1) + " of '" + call.identifier + "' must be an int";
+        }
+        ExprType argType = analyzeExpression(call.args[i].get());
+        checkArgument(call.identifier, callee, i, argType, call.start);
+    }
+
+    // 被调函数的签名
+    referenceHasher.text(call.identifier);
+    referenceHasher.text(callee.returnsVoid ? "void" : "int");
+    for (bool isArray : callee.paramIsArray) {
+        referenceHasher.number(isArray);
+    }
+
+    call.callee = callee.node;
+    return callee.returnsVoid ? ExprType::VOID : ExprType::INT;
+}
+
+// 检查实参个数
+void SemanticAnalyzer::checkArgumentCount(const std::string& name, const Function& callee, size_t count,
+                                          SourceOffset start) const {
+    if (callee.paramIsArray.size() != count) {
+        error("Function '" + name + "' expects " + std::to_string(callee.paramIsArray.size()) +
+              " arguments but got " + std::to_string(count), start);
+    }
+}
+
+// 检查第 i 个实参的类型
+void SemanticAnalyzer::checkArgument(const std::string& name, const Function& callee, size_t i, ExprType type,
+                                     SourceOffset start) const {
+    if (callee.paramIsArray[i] && type != ExprType::ARRAY) {
+        error("Argument " + std::to_string(i + 1) + " of '" + name + "' must be an array", start);
+    }
+    if (!callee.paramIsArray[i] && type != ExprType::INT) {
+        error("Argument " + std::to_string(i + 1) + " of '" + name + "' must be an int", start);
+    }
+}
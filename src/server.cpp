@@ -0,0 +1,189 @@
+#include "server.h"
+#include "driver.h"
+#include "protocol.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using protocol::FrameType;
+
+namespace {
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+void sendExit(int fd, int code) {
+    char payload[4];
+    for (int i = 0; i < 4; i++) payload[i] = static_cast<char>(static_cast<uint32_t>(code) >> (8 * i));
+    protocol::writeFrame(fd, FrameType::EXIT, payload, sizeof(payload));
+}
+
+} // namespace
+
+CompileServer::CompileServer(const ServerOptions& options)
+    : options(options), listenFd(-1), stopping(false) {}
+
+CompileServer::~CompileServer() {
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(options.socketPath.c_str());
+    }
+}
+
+int CompileServer::serve() {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (options.socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + options.socketPath);
+    }
+    std::strcpy(address.sun_path, options.socketPath.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    // 上次异常退出留下的套接字文件
+    unlink(options.socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, 128) != 0) {
+        throw std::runtime_error("Cannot listen on " + options.socketPath + ": " + std::strerror(errno));
+    }
+
+    // 工作线程屏蔽停止信号，由主线程的 accept 被中断来感知
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    int threads = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+    if (threads <= 0) threads = 1;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(&CompileServer::workerLoop, this);
+    }
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = onStopSignal;  // 不设置 SA_RESTART，accept 返回 EINTR
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    pthread_sigmask(SIG_UNBLOCK, &stopSignals, nullptr);
+
+    std::cerr << "cminus server: listening on " << options.socketPath << " with " << threads << " threads"
+              << std::endl;
+    while (!stopRequested) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "cminus server: accept: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(fd);
+        ready.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+    std::cerr << "cminus server: stopped" << std::endl;
+    return 0;
+}
+
+void CompileServer::workerLoop() {
+    WorkerBuffers buffers;
+    buffers.payload.reserve(options.bufferBytes);
+    buffers.source.reserve(options.bufferBytes);
+
+    for (;;) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) return;
+            fd = pending.front();
+            pending.pop_front();
+        }
+        try {
+            handle(fd, buffers);
+        } catch (const std::exception& e) {
+            std::cerr << "cminus server: " << e.what() << std::endl;
+        }
+        close(fd);
+    }
+}
+
+// 处理一个连接：读取请求，运行驱动程序，流式返回输出
+void CompileServer::handle(int fd, WorkerBuffers& buffers) {
+    bool haveRequest = false;
+    bool haveSource = false;
+    buffers.source.clear();
+    for (;;) {
+        FrameType type;
+        if (!protocol::readFrame(fd, type, buffers.payload)) return;
+        if (type == FrameType::END) break;
+        if (type == FrameType::REQUEST) {
+            if (!protocol::decodeStrings(buffers.payload, buffers.args) || buffers.args.empty()) return;
+            haveRequest = true;
+        } else if (type == FrameType::SOURCE) {
+            buffers.source.swap(buffers.payload);
+            haveSource = true;
+        } else {
+            return;
+        }
+    }
+    if (!haveRequest) return;
+
+    // args[0] 是客户端工作目录，其余是命令行参数
+    std::vector<const char*> argv;
+    argv.push_back("cminus_compiler");
+    for (size_t i = 1; i < buffers.args.size(); i++) argv.push_back(buffers.args[i].c_str());
+
+    protocol::FrameStreambuf outBuffer(fd, FrameType::STDOUT);
+    protocol::FrameStreambuf errBuffer(fd, FrameType::STDERR);
+    std::ostream out(&outBuffer);
+    std::ostream err(&errBuffer);
+
+    Options options;
+    if (!parseOptions(static_cast<int>(argv.size()), argv.data(), options, err) || !options.serve.empty()) {
+        printUsage("cminus_compiler", err);
+        err.flush();
+        sendExit(fd, 1);
+        return;
+    }
+    if (!isCompileOnly(options)) {
+        protocol::writeFrame(fd, FrameType::FALLBACK, nullptr, 0);
+        return;
+    }
+    // 相对路径按客户端的工作目录解析
+    options.workingDirectory = buffers.args[0];
+    if (options.inputFile == "-") {
+        if (!haveSource) {
+            err << "No source sent for '-'" << std::endl;
+            sendExit(fd, 1);
+            return;
+        }
+        options.sourceText = &buffers.source;
+    }
+
+    Driver driver(options, out, err, &buffers.context);
+    int result = driver.run();
+    out.flush();
+    err.flush();
+    sendExit(fd, result);
+}
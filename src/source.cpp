@@ -0,0 +1,37 @@
+#include "source.h"
+#include "diagnostic.h"
+#include <algorithm>
+#include <cstring>
+
+SourceManager::SourceManager() : lineStarts(1, 0), length(0) {}
+
+// 先数出行数一次分配行首表，避免它与Token序列交替增长造成堆碎片
+SourceManager::SourceManager(std::string_view text) : SourceManager() {
+    lineStarts.reserve(1 + static_cast<size_t>(std::count(text.begin(), text.end(), '\n')));
+    append(text);
+}
+
+void SourceManager::append(std::string_view chunk) {
+    // 空的块的 data() 可能是空指针，不能传给 memchr
+    if (chunk.empty()) return;
+    if (chunk.size() > maxSize - length) {
+        throw CompileError("Source too large (limit 4 GB)", SourceLocation());
+    }
+    const char* begin = chunk.data();
+    const char* end = begin + chunk.size();
+    const char* p = begin;
+    while ((p = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)))) != nullptr) {
+        p++;
+        lineStarts.push_back(static_cast<SourceOffset>(length + static_cast<size_t>(p - begin)));
+    }
+    length += chunk.size();
+}
+
+// 偏移所在的行：最后一个不大于偏移的行首
+SourceLocation SourceManager::location(SourceOffset offset) const {
+    auto next = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+    SourceLocation result;
+    result.line = static_cast<int>(next - lineStarts.begin());
+    result.column = static_cast<int>(offset - next[-1]) + 1;
+    return result;
+}
@@ -0,0 +1,225 @@
+#include "stats.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+
+namespace stats {
+
+thread_local bool active = false;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 分配计数（统计开启后才累加）
+thread_local uint64_t allocatedBytes = 0;
+thread_local uint64_t allocationCount = 0;
+
+struct Phase {
+    const char* name;
+    int depth;
+    Clock::time_point start;
+    double seconds;
+    uint64_t startBytes;
+    uint64_t startCount;
+    uint64_t bytes;
+    uint64_t count;
+    uint64_t rssBytes;  // 阶段结束时的峰值RSS
+};
+
+// 统计状态按线程保存，编译服务的每个工作线程各自统计自己的请求
+thread_local Clock::time_point startTime;
+thread_local std::vector<Phase> phases;
+thread_local std::vector<std::pair<std::string, uint64_t>> counters;
+thread_local int openDepth = 0;
+
+uint64_t peakRss() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+double totalSeconds() {
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+std::string formatBytes(uint64_t bytes) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1);
+    if (bytes >= (1u << 20)) {
+        oss << bytes / double(1 << 20) << " MB";
+    } else {
+        oss << bytes / 1024.0 << " KB";
+    }
+    return oss.str();
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+void countNodes(const ASTNode& node, std::vector<uint64_t>& counts) {
+    counts[static_cast<size_t>(node.type)]++;
+    visitChildren(node, [&](const ASTNode& child) { countNodes(child, counts); });
+}
+
+} // namespace
+
+void enable() {
+    if (active) return;
+    startTime = Clock::now();
+    active = true;
+}
+
+void reset() {
+    active = false;
+    phases.clear();
+    counters.clear();
+    openDepth = 0;
+    allocatedBytes = 0;
+    allocationCount = 0;
+}
+
+PhaseTimer::PhaseTimer(const char* name) : index(-1) {
+    if (!active) return;
+    index = static_cast<int>(phases.size());
+    Phase phase = {};
+    phase.name = name;
+    phase.depth = openDepth++;
+    phases.push_back(phase);
+    // 最后取时间和计数，不把记录本身的开销算进阶段
+    Phase& current = phases.back();
+    current.startBytes = allocatedBytes;
+    current.startCount = allocationCount;
+    current.start = Clock::now();
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (index < 0) return;
+    Phase& phase = phases[index];
+    phase.seconds = std::chrono::duration<double>(Clock::now() - phase.start).count();
+    phase.bytes = allocatedBytes - phase.startBytes;
+    phase.count = allocationCount - phase.startCount;
+    phase.rssBytes = peakRss();
+    openDepth--;
+}
+
+void addCounter(const std::string& name, uint64_t value) {
+    if (!active) return;
+    for (auto& counter : counters) {
+        if (counter.first == name) {
+            counter.second += value;
+            return;
+        }
+    }
+    counters.emplace_back(name, value);
+}
+
+void countAstNodes(const ProgramNode& program) {
+    if (!active) return;
+    std::vector<uint64_t> counts(static_cast<size_t>(ASTNodeType::BIN_OP) + 1, 0);
+    countNodes(program, counts);
+    uint64_t total = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        total += counts[i];
+        if (counts[i]) addCounter(std::string("ast.") + astNodeTypeName(static_cast<ASTNodeType>(i)), counts[i]);
+    }
+    addCounter("ast.nodes", total);
+}
+
+void printTimeReport(std::ostream& out) {
+    double total = totalSeconds();
+    std::ios::fmtflags flags = out.flags();
+    out << "===== time report =====\n"
+        << std::left << std::setw(24) << "phase" << std::right << std::setw(12) << "time (ms)"
+        << std::setw(9) << "%" << "\n" << std::fixed;
+    for (const Phase& phase : phases) {
+        out << std::left << std::setw(24) << (std::string(2 * phase.depth, ' ') + phase.name) << std::right
+            << std::setprecision(3) << std::setw(12) << phase.seconds * 1e3 << std::setprecision(1)
+            << std::setw(8) << (total > 0 ? 100 * phase.seconds / total : 0) << "%\n";
+    }
+    out << std::left << std::setw(24) << "total" << std::right << std::setprecision(3) << std::setw(12)
+        << total * 1e3 << "\n";
+    for (const auto& counter : counters) {
+        out << std::left << std::setw(24) << counter.first << std::right << std::setw(12) << counter.second << "\n";
+    }
+    out.flags(flags);
+}
+
+void printMemReport(std::ostream& out) {
+    std::ios::fmtflags flags = out.flags();
+    out << "===== memory report =====\n"
+        << std::left << std::setw(24) << "phase" << std::right << std::setw(14) << "allocated"
+        << std::setw(12) << "allocations" << std::setw(14) << "peak RSS" << "\n";
+    for (const Phase& phase : phases) {
+        out << std::left << std::setw(24) << (std::string(2 * phase.depth, ' ') + phase.name) << std::right
+            << std::setw(14) << formatBytes(phase.bytes) << std::setw(12) << phase.count
+            << std::setw(14) << formatBytes(phase.rssBytes) << "\n";
+    }
+    out << std::left << std::setw(24) << "total" << std::right
+        << std::setw(14) << formatBytes(allocatedBytes)
+        << std::setw(12) << allocationCount
+        << std::setw(14) << formatBytes(peakRss()) << "\n";
+    out.flags(flags);
+}
+
+void writeJson(const std::string& path, const std::string& inputFile, int exitCode) {
+    std::ostringstream json;
+    json << std::setprecision(9);
+    json << "{\n  \"schema\": \"cminus-stats-1\",\n"
+         << "  \"input\": " << jsonString(inputFile) << ",\n"
+         << "  \"exitCode\": " << exitCode << ",\n"
+         << "  \"totalSeconds\": " << totalSeconds() << ",\n"
+         << "  \"peakRssBytes\": " << peakRss() << ",\n"
+         << "  \"allocatedBytes\": " << allocatedBytes << ",\n"
+         << "  \"allocations\": " << allocationCount << ",\n"
+         << "  \"phases\": [";
+    for (size_t i = 0; i < phases.size(); i++) {
+        const Phase& phase = phases[i];
+        json << (i ? ",\n" : "\n") << "    {\"name\": " << jsonString(phase.name)
+             << ", \"depth\": " << phase.depth << ", \"seconds\": " << phase.seconds
+             << ", \"allocatedBytes\": " << phase.bytes << ", \"allocations\": " << phase.count
+             << ", \"peakRssBytes\": " << phase.rssBytes << "}";
+    }
+    json << (phases.empty() ? "],\n" : "\n  ],\n") << "  \"counters\": {";
+    for (size_t i = 0; i < counters.size(); i++) {
+        json << (i ? ",\n" : "\n") << "    " << jsonString(counters[i].first) << ": " << counters[i].second;
+    }
+    json << (counters.empty() ? "}\n}\n" : "\n  }\n}\n");
+
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        throw std::runtime_error("Cannot open '" + path + "' for writing");
+    }
+    std::string text = json.str();
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (std::fclose(file) != 0 || !ok) {
+        throw std::runtime_error("Failed to write '" + path + "'");
+    }
+}
+
+void countAllocation(std::size_t size) {
+    allocatedBytes += size;
+    allocationCount++;
+}
+
+} // namespace stats
@@ -0,0 +1,316 @@
+#include "vm.h"
+#include "runtime.h"
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// GCC/Clang 使用 computed goto 做线索化分发，其他编译器退回到 switch
+#if defined(__GNUC__)
+#define CMINUS_COMPUTED_GOTO 1
+#endif
+
+namespace {
+
+// 调用帧
+struct Frame {
+    const uint32_t* returnPc;
+    int64_t* regs;
+    uint32_t arrayBase;
+    const BytecodeFunction* function;
+};
+
+// 32位回绕运算
+inline int64_t wrap(uint64_t value) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+// 样本中的调用栈最多保留最内层的这么多帧，更外层的帧记为一个截断标记
+const size_t maxSampleDepth = 256;
+const uint32_t truncatedStack = UINT32_MAX;
+
+// 记录一个样本：各调用者停在调用指令上，正在执行的函数停在 pc
+void recordSample(std::map<std::vector<uint32_t>, uint64_t>& stacks, std::vector<uint32_t>& stack,
+                  const std::vector<Frame>& frames, const uint32_t* pc, const uint32_t* codeBase) {
+    stack.clear();
+    size_t first = 0;
+    if (frames.size() >= maxSampleDepth) {
+        first = frames.size() - (maxSampleDepth - 1);
+        stack.push_back(truncatedStack);
+    }
+    for (size_t i = first; i < frames.size(); i++) {
+        stack.push_back(static_cast<uint32_t>(frames[i].returnPc - 2 - codeBase));
+    }
+    stack.push_back(static_cast<uint32_t>(pc - codeBase));
+    stacks[stack]++;
+}
+
+[[noreturn]] void runtimeError(const std::string& message) {
+    throw std::runtime_error("Runtime error: " + message);
+}
+
+// 与解释器一致，报告出错的源代码行（没有行号表时为0）
+[[noreturn]] void runtimeError(const std::string& message, int line) {
+    runtimeError(message + " at line " + std::to_string(line));
+}
+
+} // namespace
+
+VirtualMachine::VirtualMachine(const BytecodeModule& module, const VmOptions& options)
+    : module(module), options(options) {}
+
+// 解释执行
+int VirtualMachine::run() {
+    if (module.globalArrayWords() > options.arrayWords) {
+        runtimeError("global arrays exceed the array memory");
+    }
+    // 只清零全局数组，栈和局部数组在使用前都会初始化，避免提前触碰所有页面
+    stack.reset(new int64_t[options.stackCells]);
+    memory.reset(new int32_t[options.arrayWords]);
+    std::memset(memory.get(), 0, sizeof(int32_t) * module.globalArrayWords());
+    globals.reset(new int32_t[module.numGlobals() + 1]);
+    std::memcpy(globals.get(), module.globals(), sizeof(int32_t) * module.numGlobals());
+
+    vmStats = VmStats();
+    sampledStacks.clear();
+    return options.samplePeriod > 0 ? execute<true>() : execute<false>();
+}
+
+template <bool Sampling>
+int VirtualMachine::execute() {
+    const BytecodeFunction* functions = module.functions();
+    const uint32_t* codeBase = module.code();
+    const int32_t* constants = module.constants();
+    const uint64_t memoryWords = options.arrayWords;
+    int64_t* const stackEnd = stack.get() + options.stackCells;
+    int32_t* const mem = memory.get();
+    int32_t* const glob = globals.get();
+
+    std::vector<Frame> frames;
+    frames.reserve(64);
+    uint64_t countdown = options.samplePeriod;
+    std::vector<uint32_t> sampleStack;
+
+    const BytecodeFunction* fun = &functions[module.mainFunction()];
+    int64_t* regs = stack.get();
+    uint32_t arrayBase = module.globalArrayWords();
+    const uint32_t* pc = codeBase + fun->codeOffset;
+    uint32_t insn;
+
+// 当前指令所在的源代码行
+#define LINE module.lineAt(static_cast<uint32_t>(pc - codeBase))
+    if (regs + fun->numRegs > stackEnd || uint64_t(arrayBase) + fun->arrayWords > memoryWords) {
+        runtimeError("stack overflow in call to '" + module.functionName(module.mainFunction()) + "'", LINE);
+    }
+
+#define A insnA(insn)
+#define B insnB(insn)
+#define C insnC(insn)
+#define R(i) regs[i]
+// 每 samplePeriod 条指令记录一次调用栈
+#define VM_SAMPLE()                                                     \
+    if (Sampling && --countdown == 0) {                                 \
+        countdown = options.samplePeriod;                               \
+        recordSample(sampledStacks, sampleStack, frames, pc, codeBase); \
+    }
+
+#ifdef CMINUS_COMPUTED_GOTO
+    // 与 Opcode 的顺序一致
+    static const void* const dispatchTable[] = {
+        &&op_LOADI, &&op_LOADK, &&op_MOV, &&op_GETG, &&op_SETG,
+        &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_MOD, &&op_ADDI,
+        &&op_LT, &&op_LE, &&op_GT, &&op_GE, &&op_EQ, &&op_NE,
+        &&op_JMP, &&op_JT, &&op_JF,
+        &&op_JLT, &&op_JLE, &&op_JGT, &&op_JGE, &&op_JEQ, &&op_JNE,
+        &&op_LREF, &&op_GREF, &&op_LOADX, &&op_STOREX, &&op_ZEROA,
+        &&op_CALL, &&op_TAILCALL, &&op_INPUT, &&op_OUTPUT, &&op_RET, &&op_RET0
+    };
+    static_assert(sizeof(dispatchTable) / sizeof(dispatchTable[0]) == static_cast<size_t>(Opcode::NUM_OPCODES),
+                  "dispatch table out of sync");
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() do { VM_SAMPLE(); insn = *pc; goto *dispatchTable[insn & 0xff]; } while (0)
+    VM_NEXT();
+#else
+#define VM_CASE(name) case Opcode::name:
+#define VM_NEXT() continue
+    for (;;) {
+        VM_SAMPLE();
+        insn = *pc;
+        switch (insnOp(insn)) {
+#endif
+
+    VM_CASE(LOADI) R(A) = insnSBx(insn); pc++; VM_NEXT();
+    VM_CASE(LOADK) R(A) = constants[insnBx(insn)]; pc++; VM_NEXT();
+    VM_CASE(MOV)   R(A) = R(B); pc++; VM_NEXT();
+    VM_CASE(GETG)  R(A) = glob[insnBx(insn)]; pc++; VM_NEXT();
+    VM_CASE(SETG)  glob[insnBx(insn)] = static_cast<int32_t>(R(A)); pc++; VM_NEXT();
+
+    VM_CASE(ADD)  R(A) = wrap(uint64_t(R(B)) + uint64_t(R(C))); pc++; VM_NEXT();
+    VM_CASE(SUB)  R(A) = wrap(uint64_t(R(B)) - uint64_t(R(C))); pc++; VM_NEXT();
+    VM_CASE(MUL)  R(A) = wrap(uint64_t(R(B)) * uint64_t(R(C))); pc++; VM_NEXT();
+    VM_CASE(DIV) {
+        int32_t dividend = static_cast<int32_t>(R(B));
+        int32_t divisor = static_cast<int32_t>(R(C));
+        if (divisor == 0) runtimeError("division by zero", LINE);
+        R(A) = divisor == -1 ? wrap(0 - uint64_t(dividend)) : dividend / divisor;
+        pc++;
+        VM_NEXT();
+    }
+    VM_CASE(MOD) {
+        int32_t dividend = static_cast<int32_t>(R(B));
+        int32_t divisor = static_cast<int32_t>(R(C));
+        if (divisor == 0) runtimeError("division by zero", LINE);
+        R(A) = divisor == -1 ? 0 : dividend % divisor;
+        pc++;
+        VM_NEXT();
+    }
+    VM_CASE(ADDI) R(A) = wrap(uint64_t(R(B)) + uint64_t(int64_t(insnSC(insn)))); pc++; VM_NEXT();
+
+    VM_CASE(LT) R(A) = int32_t(R(B)) <  int32_t(R(C)); pc++; VM_NEXT();
+    VM_CASE(LE) R(A) = int32_t(R(B)) <= int32_t(R(C)); pc++; VM_NEXT();
+    VM_CASE(GT) R(A) = int32_t(R(B)) >  int32_t(R(C)); pc++; VM_NEXT();
+    VM_CASE(GE) R(A) = int32_t(R(B)) >= int32_t(R(C)); pc++; VM_NEXT();
+    VM_CASE(EQ) R(A) = int32_t(R(B)) == int32_t(R(C)); pc++; VM_NEXT();
+    VM_CASE(NE) R(A) = int32_t(R(B)) != int32_t(R(C)); pc++; VM_NEXT();
+
+    VM_CASE(JMP) pc += insnSAx(insn); VM_NEXT();
+    VM_CASE(JT) pc += int32_t(R(A)) != 0 ? static_cast<int32_t>(pc[1]) : 2; VM_NEXT();
+    VM_CASE(JF) pc += int32_t(R(A)) == 0 ? static_cast<int32_t>(pc[1]) : 2; VM_NEXT();
+
+#define VM_JUMP_IF(name, relop) \
+    VM_CASE(name) pc += int32_t(R(A)) relop int32_t(R(B)) ? static_cast<int32_t>(pc[1]) : 2; VM_NEXT();
+    VM_JUMP_IF(JLT, <)
+    VM_JUMP_IF(JLE, <=)
+    VM_JUMP_IF(JGT, >)
+    VM_JUMP_IF(JGE, >=)
+    VM_JUMP_IF(JEQ, ==)
+    VM_JUMP_IF(JNE, !=)
+#undef VM_JUMP_IF
+
+    VM_CASE(LREF) R(A) = int64_t((uint64_t(arrayBase + pc[1]) << 32) | pc[2]); pc += 3; VM_NEXT();
+    VM_CASE(GREF) R(A) = int64_t((uint64_t(pc[1]) << 32) | pc[2]); pc += 3; VM_NEXT();
+
+    // 越界检查；同时检查存储区范围，防止伪造的数组引用
+    VM_CASE(LOADX) {
+        uint64_t ref = uint64_t(R(B));
+        uint32_t index = static_cast<uint32_t>(R(C));
+        uint64_t address = (ref >> 32) + index;
+        if (index >= uint32_t(ref) || address >= memoryWords) {
+            runtimeError("array index " + std::to_string(int32_t(index)) + " out of bounds", LINE);
+        }
+        R(A) = mem[address];
+        pc++;
+        VM_NEXT();
+    }
+    VM_CASE(STOREX) {
+        uint64_t ref = uint64_t(R(A));
+        uint32_t index = static_cast<uint32_t>(R(B));
+        uint64_t address = (ref >> 32) + index;
+        if (index >= uint32_t(ref) || address >= memoryWords) {
+            runtimeError("array index " + std::to_string(int32_t(index)) + " out of bounds", LINE);
+        }
+        mem[address] = static_cast<int32_t>(R(C));
+        pc++;
+        VM_NEXT();
+    }
+    VM_CASE(ZEROA) std::memset(mem + arrayBase + pc[1], 0, sizeof(int32_t) * pc[2]); pc += 3; VM_NEXT();
+
+    VM_CASE(CALL) {
+        const BytecodeFunction* callee = &functions[pc[1]];
+        int64_t* calleeRegs = regs + A;
+        uint32_t calleeArrays = arrayBase + fun->arrayWords;
+        if (frames.size() >= options.maxCallDepth || calleeRegs + callee->numRegs > stackEnd ||
+            uint64_t(calleeArrays) + callee->arrayWords > memoryWords) {
+            runtimeError("stack overflow in call to '" + module.functionName(pc[1]) + "'", LINE);
+        }
+        frames.push_back(Frame{pc + 2, regs, arrayBase, fun});
+        vmStats.calls++;
+        fun = callee;
+        regs = calleeRegs;
+        arrayBase = calleeArrays;
+        pc = codeBase + callee->codeOffset;
+        VM_NEXT();
+    }
+
+    // 尾调用：实参搬到栈帧开头，栈帧和数组区都复用，返回地址不变
+    VM_CASE(TAILCALL) {
+        const BytecodeFunction* callee = &functions[pc[1]];
+        if (regs + callee->numRegs > stackEnd || uint64_t(arrayBase) + callee->arrayWords > memoryWords) {
+            runtimeError("stack overflow in call to '" + module.functionName(pc[1]) + "'", LINE);
+        }
+        std::memmove(regs, regs + A, sizeof(int64_t) * C);
+        vmStats.calls++;
+        vmStats.tailCalls++;
+        fun = callee;
+        pc = codeBase + callee->codeOffset;
+        VM_NEXT();
+    }
+
+    VM_CASE(INPUT)  R(A) = cminus_input(); pc++; VM_NEXT();
+    VM_CASE(OUTPUT) cminus_output(static_cast<int32_t>(R(A))); pc++; VM_NEXT();
+
+    // 返回值写入被调函数的 R[0]，即调用者的 R[a]
+    VM_CASE(RET) {
+        int32_t result = static_cast<int32_t>(R(A));
+        if (frames.empty()) return result;
+        regs[0] = result;
+        const Frame& frame = frames.back();
+        pc = frame.returnPc;
+        regs = frame.regs;
+        arrayBase = frame.arrayBase;
+        fun = frame.function;
+        frames.pop_back();
+        VM_NEXT();
+    }
+    VM_CASE(RET0) {
+        if (frames.empty()) return 0;
+        regs[0] = 0;
+        const Frame& frame = frames.back();
+        pc = frame.returnPc;
+        regs = frame.regs;
+        arrayBase = frame.arrayBase;
+        fun = frame.function;
+        frames.pop_back();
+        VM_NEXT();
+    }
+
+#ifndef CMINUS_COMPUTED_GOTO
+        default:
+            runtimeError("invalid opcode");
+        }
+    }
+#endif
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_SAMPLE
+#undef A
+#undef B
+#undef C
+#undef R
+#undef LINE
+}
+
+void VirtualMachine::collectSamples(SampleProfile& profile) const {
+    const BytecodeFunction* functions = module.functions();
+    std::vector<SampleFrame> stack;
+    for (const auto& entry : sampledStacks) {
+        stack.clear();
+        for (uint32_t offset : entry.first) {
+            SampleFrame frame;
+            if (offset == truncatedStack) {
+                frame.function = "[truncated]";
+                stack.push_back(frame);
+                continue;
+            }
+            for (uint32_t i = 0; i < module.numFunctions(); i++) {
+                if (offset - functions[i].codeOffset < functions[i].codeLength) {
+                    frame.function = module.functionName(i);
+                    break;
+                }
+            }
+            frame.line = module.lineAt(offset);
+            stack.push_back(frame);
+        }
+        profile.add(stack, entry.second);
+    }
+}
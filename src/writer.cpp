@@ -0,0 +1,71 @@
+#include "writer.h"
+#include <cstring>
+#include <stdexcept>
+
+BufferedWriter::BufferedWriter(std::FILE* file, size_t capacity)
+    : file(file), stream(nullptr), buffer(new char[capacity]), capacity(capacity), used(0) {}
+
+BufferedWriter::BufferedWriter(std::ostream& stream, size_t capacity)
+    : file(nullptr), stream(&stream), buffer(new char[capacity]), capacity(capacity), used(0) {}
+
+BufferedWriter::~BufferedWriter() {
+    // 析构时不抛出异常，需要检查错误的调用者应显式调用 flush
+    if (used > 0) {
+        sink(buffer.get(), used);
+    }
+    if (stream) {
+        stream->flush();
+    } else {
+        std::fflush(file);
+    }
+}
+
+// 写到文件或输出流，返回是否成功
+bool BufferedWriter::sink(const char* data, size_t size) {
+    if (stream) {
+        return static_cast<bool>(stream->write(data, static_cast<std::streamsize>(size)));
+    }
+    return std::fwrite(data, 1, size, file) == size;
+}
+
+void BufferedWriter::write(const char* data, size_t size) {
+    if (size > capacity - used) {
+        drain();
+        // 大块数据直接写出
+        if (size >= capacity) {
+            if (!sink(data, size)) {
+                throw std::runtime_error("Write failed");
+            }
+            return;
+        }
+    }
+    std::memcpy(buffer.get() + used, data, size);
+    used += size;
+}
+
+BufferedWriter& BufferedWriter::operator<<(const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+}
+
+BufferedWriter& BufferedWriter::operator<<(long value) {
+    char digits[24];
+    int length = std::snprintf(digits, sizeof(digits), "%ld", value);
+    write(digits, static_cast<size_t>(length));
+    return *this;
+}
+
+void BufferedWriter::drain() {
+    if (used > 0 && !sink(buffer.get(), used)) {
+        used = 0;
+        throw std::runtime_error("Write failed");
+    }
+    used = 0;
+}
+
+void BufferedWriter::flush() {
+    drain();
+    if (stream ? !stream->flush() : std::fflush(file) != 0) {
+        throw std::runtime_error("Write failed");
+    }
+}
@@ -0,0 +1,783 @@
+#include "x86.h"
+#include <cstdio>
+#include <stdexcept>
+
+namespace x86 {
+
+// 取反条件：条件码最低位翻转即为其反条件
+Cond negate(Cond cc) {
+    return static_cast<Cond>(static_cast<uint8_t>(cc) ^ 1);
+}
+
+// 只检测一次；__builtin_cpu_supports 同时确认操作系统保存了 ymm 状态
+VectorIsa hostVectorIsa() {
+    static const VectorIsa isa = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return VectorIsa::AVX2;
+        if (__builtin_cpu_supports("sse4.1")) return VectorIsa::SSE41;
+        return VectorIsa::SSE2;
+    }();
+    return isa;
+}
+
+const char* vectorIsaName(VectorIsa isa) {
+    switch (isa) {
+        case VectorIsa::NONE:  return "none";
+        case VectorIsa::SSE2:  return "sse2";
+        case VectorIsa::SSE41: return "sse4.1";
+        case VectorIsa::AVX2:  return "avx2";
+    }
+    return "none";
+}
+
+// ===== 操作数构造 =====
+
+Operand Operand::r(uint8_t reg) {
+    Operand op;
+    op.kind = REG;
+    op.reg = reg;
+    return op;
+}
+
+Operand Operand::immediate(int64_t value) {
+    Operand op;
+    op.kind = IMM;
+    op.imm = value;
+    return op;
+}
+
+Operand Operand::mem(uint8_t base, int32_t disp) {
+    Operand op;
+    op.kind = MEM;
+    op.base = base;
+    op.disp = disp;
+    return op;
+}
+
+Operand Operand::mem(uint8_t base, uint8_t index, uint8_t scale, int32_t disp) {
+    Operand op;
+    op.kind = MEM;
+    op.base = base;
+    op.index = index;
+    op.scale = scale;
+    op.disp = disp;
+    return op;
+}
+
+Operand Operand::rip(int symbol, int32_t disp) {
+    Operand op;
+    op.kind = MEM;
+    op.base = RIP;
+    op.id = symbol;
+    op.disp = disp;
+    return op;
+}
+
+Operand Operand::label(int id) {
+    Operand op;
+    op.kind = LABEL;
+    op.id = id;
+    return op;
+}
+
+Operand Operand::symbol(int id) {
+    Operand op;
+    op.kind = SYM;
+    op.id = id;
+    return op;
+}
+
+Operand Operand::inFrame(int area) const {
+    Operand op = *this;
+    op.id = area;
+    return op;
+}
+
+bool Operand::operator==(const Operand& other) const {
+    if (kind != other.kind) return false;
+    switch (kind) {
+        case NONE: return true;
+        case REG: return reg == other.reg;
+        case IMM: return imm == other.imm;
+        case MEM:
+            return base == other.base && index == other.index &&
+                   (index == NOREG || scale == other.scale) &&
+                   disp == other.disp && (base != RIP || id == other.id);
+        case LABEL:
+        case SYM: return id == other.id;
+    }
+    return false;
+}
+
+// ===== 模块与目标代码 =====
+
+int Module::addSymbol(const std::string& name, Section section, uint64_t offset, uint64_t size, bool isFunction) {
+    Symbol sym;
+    sym.name = name;
+    sym.section = section;
+    sym.offset = offset;
+    sym.size = size;
+    sym.isFunction = isFunction;
+    symbols.push_back(sym);
+    return static_cast<int>(symbols.size() - 1);
+}
+
+int ObjectCode::findSymbol(const std::string& name) const {
+    for (size_t i = 0; i < symbols.size(); i++) {
+        if (symbols[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// ===== 编码器 =====
+
+namespace {
+
+bool fitsInt8(int64_t v) { return v >= -128 && v <= 127; }
+bool fitsInt32(int64_t v) { return v >= INT32_MIN && v <= INT32_MAX; }
+
+class Encoder {
+public:
+    Encoder(ObjectCode& object) : out(object.text), relocs(object.relocs), lines(object.lines) {}
+
+    // offsets 不为空时记下每条指令（含伪指令）的开始位置
+    void encodeFunction(const MFunction& fun, std::vector<uint64_t>* offsets);
+
+private:
+    void byte(uint8_t b) { out.push_back(b); }
+    void dword(uint32_t v) {
+        for (int i = 0; i < 4; i++) byte(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    void qword(uint64_t v) {
+        for (int i = 0; i < 8; i++) byte(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    // REX 前缀：byteReg 表示使用 spl/bpl/sil/dil 等字节寄存器
+    void rex(bool w, uint8_t reg, const Operand& rm, bool byteReg = false);
+    // ModRM（及SIB、偏移）
+    void modrm(uint8_t regField, const Operand& rm);
+    // 通用 “前缀 + 操作码 + ModRM” 形式
+    void emitRM(uint8_t size, std::initializer_list<uint8_t> opcode, uint8_t regField,
+                const Operand& rm, bool byteReg = false);
+    // SSE 指令：强制前缀（66/F3）、REX、0F 转义的操作码、ModRM
+    void emitSse(uint8_t prefix, std::initializer_list<uint8_t> opcode, uint8_t regField, const Operand& rm);
+    // VEX 三字节前缀的指令：pp 为隐含前缀（1=66 2=F3），map 为操作码表（1=0F 2=0F38 3=0F3A），
+    // vvvv 为第二个源寄存器（不用时为 NOREG）
+    void emitVex(uint8_t pp, uint8_t map, bool l256, uint8_t opcode, uint8_t regField, uint8_t vvvv,
+                 const Operand& rm);
+    void emitVector(const Inst& inst, uint8_t sseOpcode, bool map0F38 = false);
+    // 结束一条指令：修正RIP相对重定位的加数
+    void finish();
+
+    void emitAlu(uint8_t n, const Inst& inst);
+    void emitBranch(std::initializer_list<uint8_t> opcode, int label);
+    void encode(const Inst& inst);
+    void markLine(int line);
+
+    std::vector<uint8_t>& out;
+    std::vector<Reloc>& relocs;
+    std::vector<std::pair<uint64_t, int>>& lines;
+
+    // RIP相对寻址待修正的重定位
+    long pendingReloc = -1;
+    size_t pendingField = 0;
+    int32_t pendingDisp = 0;
+
+    // 标签位置与待回填的跳转
+    std::vector<long> labelPos;
+    std::vector<std::pair<size_t, int>> labelFixups;
+};
+
+void Encoder::rex(bool w, uint8_t reg, const Operand& rm, bool byteReg) {
+    uint8_t value = 0x40;
+    if (w) value |= 0x08;
+    if (reg != NOREG && (reg & 8)) value |= 0x04;
+    if (rm.kind == Operand::MEM) {
+        if (rm.index != NOREG && (rm.index & 8)) value |= 0x02;
+        if (rm.base != NOREG && rm.base != RIP && (rm.base & 8)) value |= 0x01;
+    } else if (rm.kind == Operand::REG && (rm.reg & 8)) {
+        value |= 0x01;
+    }
+    bool needByteRex = byteReg && ((rm.kind == Operand::REG && rm.reg >= 4 && rm.reg < 8) ||
+                                   (reg != NOREG && reg >= 4 && reg < 8));
+    if (value != 0x40 || needByteRex) {
+        byte(value);
+    }
+}
+
+void Encoder::modrm(uint8_t regField, const Operand& rm) {
+    uint8_t regBits = static_cast<uint8_t>((regField & 7) << 3);
+
+    if (rm.kind == Operand::REG) {
+        byte(0xC0 | regBits | (rm.reg & 7));
+        return;
+    }
+    if (rm.kind != Operand::MEM) {
+        throw std::runtime_error("x86: invalid r/m operand");
+    }
+
+    // RIP相对：mod=00 rm=101 disp32，加数在指令结束后确定
+    if (rm.base == RIP) {
+        byte(0x05 | regBits);
+        pendingReloc = rm.id;
+        pendingField = out.size();
+        pendingDisp = rm.disp;
+        dword(0);
+        return;
+    }
+
+    bool needSib = rm.index != NOREG || rm.base == NOREG || (rm.base & 7) == RSP;
+    uint8_t mod;
+    if (rm.base == NOREG) {
+        mod = 0; // 仅 [index*scale + disp32]
+    } else if (rm.disp == 0 && (rm.base & 7) != RBP) {
+        mod = 0;
+    } else if (fitsInt8(rm.disp)) {
+        mod = 1;
+    } else {
+        mod = 2;
+    }
+
+    if (!needSib) {
+        byte(static_cast<uint8_t>(mod << 6) | regBits | (rm.base & 7));
+    } else {
+        byte(static_cast<uint8_t>(mod << 6) | regBits | 0x04);
+        uint8_t scaleBits = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+        uint8_t indexBits = rm.index == NOREG ? 0x04 : (rm.index & 7);
+        uint8_t baseBits = rm.base == NOREG ? 0x05 : (rm.base & 7);
+        byte(static_cast<uint8_t>(scaleBits << 6) | static_cast<uint8_t>(indexBits << 3) | baseBits);
+    }
+
+    if (rm.base == NOREG || mod == 2) {
+        dword(static_cast<uint32_t>(rm.disp));
+    } else if (mod == 1) {
+        byte(static_cast<uint8_t>(rm.disp));
+    }
+}
+
+void Encoder::emitRM(uint8_t size, std::initializer_list<uint8_t> opcode, uint8_t regField,
+                     const Operand& rm, bool byteReg) {
+    rex(size == 8, regField, rm, byteReg);
+    for (uint8_t b : opcode) byte(b);
+    modrm(regField, rm);
+}
+
+void Encoder::emitSse(uint8_t prefix, std::initializer_list<uint8_t> opcode, uint8_t regField,
+                      const Operand& rm) {
+    byte(prefix);
+    rex(false, regField, rm);
+    byte(0x0F);
+    for (uint8_t b : opcode) byte(b);
+    modrm(regField, rm);
+}
+
+void Encoder::emitVex(uint8_t pp, uint8_t map, bool l256, uint8_t opcode, uint8_t regField, uint8_t vvvv,
+                      const Operand& rm) {
+    // R/X/B 以反码存放
+    bool r = regField != NOREG && (regField & 8);
+    bool x = rm.kind == Operand::MEM && rm.index != NOREG && (rm.index & 8);
+    bool b = (rm.kind == Operand::MEM && rm.base != NOREG && rm.base != RIP && (rm.base & 8)) ||
+             (rm.kind == Operand::REG && (rm.reg & 8));
+    uint8_t v = vvvv == NOREG ? 0 : vvvv;
+    byte(0xC4);
+    byte(static_cast<uint8_t>((r ? 0 : 0x80) | (x ? 0 : 0x40) | (b ? 0 : 0x20) | map));
+    byte(static_cast<uint8_t>(((~v & 15) << 3) | (l256 ? 0x04 : 0) | pp));
+    byte(opcode);
+    modrm(regField, rm);
+}
+
+// 66 前缀的 a = a op b：SSE 为两操作数形式，AVX2 为 vop a, a, b
+void Encoder::emitVector(const Inst& inst, uint8_t sseOpcode, bool map0F38) {
+    if (inst.size == 32) {
+        emitVex(1, map0F38 ? 2 : 1, true, sseOpcode, inst.a.reg, inst.a.reg, inst.b);
+    } else if (map0F38) {
+        emitSse(0x66, {0x38, sseOpcode}, inst.a.reg, inst.b);
+    } else {
+        emitSse(0x66, {sseOpcode}, inst.a.reg, inst.b);
+    }
+}
+
+void Encoder::finish() {
+    if (pendingReloc >= 0) {
+        // 目标 = 下一条指令地址 + disp32，故加数需扣除字段之后的字节数
+        int64_t trailing = static_cast<int64_t>(out.size() - pendingField);
+        relocs.push_back({pendingField, static_cast<int>(pendingReloc), RelocKind::PC32, pendingDisp - trailing});
+        pendingReloc = -1;
+    }
+}
+
+// ADD=0 OR=1 AND=4 SUB=5 XOR=6 CMP=7
+void Encoder::emitAlu(uint8_t n, const Inst& inst) {
+    const Operand& a = inst.a;
+    const Operand& b = inst.b;
+    if (b.kind == Operand::IMM) {
+        if (fitsInt8(b.imm)) {
+            emitRM(inst.size, {0x83}, n, a);
+            byte(static_cast<uint8_t>(b.imm));
+        } else {
+            emitRM(inst.size, {0x81}, n, a);
+            dword(static_cast<uint32_t>(b.imm));
+        }
+    } else if (b.kind == Operand::REG) {
+        emitRM(inst.size, {static_cast<uint8_t>(0x01 + 8 * n)}, b.reg, a);
+    } else if (a.kind == Operand::REG && b.kind == Operand::MEM) {
+        emitRM(inst.size, {static_cast<uint8_t>(0x03 + 8 * n)}, a.reg, b);
+    } else {
+        throw std::runtime_error("x86: invalid ALU operands");
+    }
+}
+
+void Encoder::emitBranch(std::initializer_list<uint8_t> opcode, int label) {
+    for (uint8_t b : opcode) byte(b);
+    labelFixups.emplace_back(out.size(), label);
+    dword(0);
+}
+
+void Encoder::encode(const Inst& inst) {
+    const Operand& a = inst.a;
+    const Operand& b = inst.b;
+
+    switch (inst.op) {
+        case Op::MOV:
+            if (b.kind == Operand::IMM) {
+                if (a.kind == Operand::REG && (inst.size == 4 || !fitsInt32(b.imm))) {
+                    // mov r32, imm32 / movabs r64, imm64
+                    rex(inst.size == 8, NOREG, a);
+                    byte(static_cast<uint8_t>(0xB8 + (a.reg & 7)));
+                    if (inst.size == 8) qword(static_cast<uint64_t>(b.imm));
+                    else dword(static_cast<uint32_t>(b.imm));
+                } else {
+                    emitRM(inst.size, {0xC7}, 0, a);
+                    dword(static_cast<uint32_t>(b.imm));
+                }
+            } else if (b.kind == Operand::REG) {
+                emitRM(inst.size, {0x89}, b.reg, a);
+            } else if (a.kind == Operand::REG && b.kind == Operand::MEM) {
+                emitRM(inst.size, {0x8B}, a.reg, b);
+            } else {
+                throw std::runtime_error("x86: invalid MOV operands");
+            }
+            break;
+
+        case Op::MOVSXD:
+            emitRM(8, {0x63}, a.reg, b);
+            break;
+
+        case Op::MOVZX8:
+            emitRM(4, {0x0F, 0xB6}, a.reg, b, true);
+            break;
+
+        case Op::LEA:
+            emitRM(inst.size, {0x8D}, a.reg, b);
+            break;
+
+        case Op::ADD: emitAlu(0, inst); break;
+        case Op::OR:  emitAlu(1, inst); break;
+        case Op::AND: emitAlu(4, inst); break;
+        case Op::SUB: emitAlu(5, inst); break;
+        case Op::XOR: emitAlu(6, inst); break;
+        case Op::CMP: emitAlu(7, inst); break;
+
+        case Op::TEST:
+            if (b.kind == Operand::IMM) {
+                emitRM(inst.size, {0xF7}, 0, a);
+                dword(static_cast<uint32_t>(b.imm));
+            } else {
+                emitRM(inst.size, {0x85}, b.reg, a);
+            }
+            break;
+
+        case Op::IMUL:
+            if (inst.c.kind == Operand::IMM) {
+                if (fitsInt8(inst.c.imm)) {
+                    emitRM(inst.size, {0x6B}, a.reg, b);
+                    byte(static_cast<uint8_t>(inst.c.imm));
+                } else {
+                    emitRM(inst.size, {0x69}, a.reg, b);
+                    dword(static_cast<uint32_t>(inst.c.imm));
+                }
+            } else {
+                emitRM(inst.size, {0x0F, 0xAF}, a.reg, b);
+            }
+            break;
+
+        case Op::IDIV:
+            emitRM(inst.size, {0xF7}, 7, a);
+            break;
+
+        case Op::NEG:
+            emitRM(inst.size, {0xF7}, 3, a);
+            break;
+
+        case Op::CDQ:
+            if (inst.size == 8) byte(0x48);
+            byte(0x99);
+            break;
+
+        case Op::SHL:
+        case Op::SAR:
+        case Op::SHR: {
+            uint8_t n = inst.op == Op::SHL ? 4 : inst.op == Op::SAR ? 7 : 5;
+            emitRM(inst.size, {0xC1}, n, a);
+            byte(static_cast<uint8_t>(b.imm));
+            break;
+        }
+
+        case Op::SETCC:
+            emitRM(4, {0x0F, static_cast<uint8_t>(0x90 + static_cast<uint8_t>(inst.cc))}, 0, a, true);
+            break;
+
+        case Op::JCC:
+            emitBranch({0x0F, static_cast<uint8_t>(0x80 + static_cast<uint8_t>(inst.cc))}, a.id);
+            break;
+
+        case Op::JMP:
+            if (a.kind == Operand::SYM) {
+                // 尾调用：跳转到函数符号
+                byte(0xE9);
+                relocs.push_back({out.size(), a.id, RelocKind::PLT32, -4});
+                dword(0);
+            } else {
+                emitBranch({0xE9}, a.id);
+            }
+            break;
+
+        case Op::CALL:
+            if (a.kind == Operand::SYM) {
+                byte(0xE8);
+                relocs.push_back({out.size(), a.id, RelocKind::PLT32, -4});
+                dword(0);
+            } else {
+                emitRM(4, {0xFF}, 2, a);
+            }
+            break;
+
+        case Op::RET:
+            byte(0xC3);
+            break;
+
+        case Op::LEAVE:
+            byte(0xC9);
+            break;
+
+        case Op::PUSH:
+            if (a.reg & 8) byte(0x41);
+            byte(static_cast<uint8_t>(0x50 + (a.reg & 7)));
+            break;
+
+        case Op::POP:
+            if (a.reg & 8) byte(0x41);
+            byte(static_cast<uint8_t>(0x58 + (a.reg & 7)));
+            break;
+
+        case Op::REP_STOSD:
+            byte(0xF3);
+            byte(0xAB);
+            break;
+
+        case Op::MOVDQU: {
+            bool store = a.kind == Operand::MEM;
+            uint8_t opcode = store ? 0x7F : 0x6F;
+            uint8_t regField = store ? b.reg : a.reg;
+            const Operand& rm = store ? a : b;
+            if (inst.size == 32) {
+                emitVex(2, 1, true, opcode, regField, NOREG, rm);
+            } else {
+                emitSse(0xF3, {opcode}, regField, rm);
+            }
+            break;
+        }
+
+        case Op::MOVD_TO_VEC:
+            if (inst.size == 32) {
+                emitVex(1, 1, false, 0x6E, a.reg, NOREG, b);
+            } else {
+                emitSse(0x66, {0x6E}, a.reg, b);
+            }
+            break;
+
+        case Op::MOVD_FROM_VEC:
+            if (inst.size == 32) {
+                emitVex(1, 1, false, 0x7E, b.reg, NOREG, a);
+            } else {
+                emitSse(0x66, {0x7E}, b.reg, a);
+            }
+            break;
+
+        case Op::PADDD:  emitVector(inst, 0xFE); break;
+        case Op::PSUBD:  emitVector(inst, 0xFA); break;
+        case Op::PXOR:   emitVector(inst, 0xEF); break;
+        case Op::PMULLD: emitVector(inst, 0x40, true); break;
+
+        case Op::PSHUFD:
+            emitSse(0x66, {0x70}, a.reg, b);
+            byte(static_cast<uint8_t>(inst.c.imm));
+            break;
+
+        case Op::VPBROADCASTD:
+            emitVex(1, 2, true, 0x58, a.reg, NOREG, b);
+            break;
+
+        case Op::VEXTRACTI128:
+            emitVex(1, 3, true, 0x39, b.reg, NOREG, a);
+            byte(1);
+            break;
+
+        case Op::VZEROUPPER:
+            byte(0xC5);
+            byte(0xF8);
+            byte(0x77);
+            break;
+
+        case Op::LABEL:
+            labelPos[a.id] = static_cast<long>(out.size());
+            break;
+
+        case Op::LINE:
+            markLine(static_cast<int>(a.imm));
+            break;
+    }
+
+    finish();
+}
+
+// 同一位置只保留最后一个行号，相邻的相同行号合并
+void Encoder::markLine(int line) {
+    if (!lines.empty() && lines.back().first == out.size()) {
+        lines.back().second = line;
+    } else if (lines.empty() || lines.back().second != line) {
+        lines.emplace_back(out.size(), line);
+    }
+}
+
+void Encoder::encodeFunction(const MFunction& fun, std::vector<uint64_t>* offsets) {
+    labelPos.assign(fun.numLabels, -1);
+    labelFixups.clear();
+    markLine(0);
+
+    for (const Inst& inst : fun.code) {
+        if (offsets) offsets->push_back(out.size());
+        encode(inst);
+    }
+
+    // 回填标签（rel32相对于字段之后的地址）
+    for (const auto& fixup : labelFixups) {
+        long target = labelPos[fixup.second];
+        if (target < 0) {
+            throw std::runtime_error("x86: undefined label in function " + fun.name);
+        }
+        int32_t rel = static_cast<int32_t>(target - static_cast<long>(fixup.first + 4));
+        for (int i = 0; i < 4; i++) {
+            out[fixup.first + i] = static_cast<uint8_t>(static_cast<uint32_t>(rel) >> (8 * i));
+        }
+    }
+}
+
+} // namespace
+
+// 把 Module 编码为机器码
+ObjectCode assemble(const Module& module, std::vector<uint64_t>* offsets) {
+    ObjectCode object;
+    object.data = module.data;
+    object.bssSize = module.bssSize;
+    object.symbols = module.symbols;
+
+    Encoder encoder(object);
+    for (const MFunction& fun : module.functions) {
+        // 函数入口按16字节对齐
+        while (object.text.size() % 16 != 0) {
+            object.text.push_back(0x90);
+        }
+        uint64_t start = object.text.size();
+        encoder.encodeFunction(fun, offsets);
+        object.symbols[fun.symbol].offset = start;
+        object.symbols[fun.symbol].size = object.text.size() - start;
+    }
+    return object;
+}
+
+// ===== 反汇编列表 =====
+
+namespace {
+
+const char* const regNames64[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                  "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15"};
+const char* const regNames32[] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+                                  "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+const char* const regNames8[] = {"al",  "cl",  "dl",   "bl",   "spl",  "bpl",  "sil",  "dil",
+                                 "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+const char* const condNames[] = {"o", "no", "b", "ae", "e", "ne", "be", "a",
+                                 "s", "ns", "p", "np", "l", "ge", "le", "g"};
+
+const char* mnemonic(Op op) {
+    switch (op) {
+        case Op::ADD:  return "add";
+        case Op::SUB:  return "sub";
+        case Op::AND:  return "and";
+        case Op::OR:   return "or";
+        case Op::XOR:  return "xor";
+        case Op::CMP:  return "cmp";
+        case Op::TEST: return "test";
+        case Op::IMUL: return "imul";
+        case Op::IDIV: return "idiv";
+        case Op::NEG:  return "neg";
+        case Op::SHL:  return "shl";
+        case Op::SAR:  return "sar";
+        case Op::SHR:  return "shr";
+        case Op::JMP:  return "jmp";
+        case Op::CALL: return "call";
+        case Op::PUSH: return "push";
+        case Op::POP:  return "pop";
+        case Op::PADDD:  return "paddd";
+        case Op::PSUBD:  return "psubd";
+        case Op::PMULLD: return "pmulld";
+        case Op::PXOR:   return "pxor";
+        default: return "?";
+    }
+}
+
+// Intel 语法的操作数，size 为寄存器或内存操作数的宽度（0 表示内存操作数不标宽度，如 lea）
+std::string operandText(const Module& module, const Operand& op, int size) {
+    switch (op.kind) {
+        case Operand::REG:
+            if (size == 16 || size == 32) return (size == 32 ? "ymm" : "xmm") + std::to_string(op.reg);
+            return size == 8 ? regNames64[op.reg] : size == 1 ? regNames8[op.reg] : regNames32[op.reg];
+        case Operand::IMM:
+            return std::to_string(op.imm);
+        case Operand::LABEL:
+            return ".L" + std::to_string(op.id);
+        case Operand::SYM:
+            return module.symbols[op.id].name;
+        case Operand::MEM: {
+            std::string text;
+            switch (size) {
+                case 1: text = "byte ptr "; break;
+                case 4: text = "dword ptr "; break;
+                case 8: text = "qword ptr "; break;
+                case 16: text = "xmmword ptr "; break;
+                case 32: text = "ymmword ptr "; break;
+            }
+            std::string address;
+            if (op.base == RIP) {
+                address = "rip + " + module.symbols[op.id].name;
+            } else if (op.base != NOREG) {
+                address = regNames64[op.base];
+            }
+            if (op.index != NOREG) {
+                address += (address.empty() ? "" : " + ") + std::string(regNames64[op.index]) + "*" +
+                           std::to_string(op.scale);
+            }
+            if (op.disp != 0 || address.empty()) {
+                int64_t disp = op.disp;
+                if (address.empty()) {
+                    address = std::to_string(disp);
+                } else {
+                    address += (disp < 0 ? " - " : " + ") + std::to_string(disp < 0 ? -disp : disp);
+                }
+            }
+            return text + "[" + address + "]";
+        }
+        case Operand::NONE:
+            break;
+    }
+    return "";
+}
+
+std::string instructionText(const Module& module, const Inst& inst) {
+    auto operand = [&module](const Operand& op, int size) { return operandText(module, op, size); };
+    const Operand& a = inst.a;
+    const Operand& b = inst.b;
+    int size = inst.size;
+    bool vex = size == 32;
+    switch (inst.op) {
+        case Op::MOV:
+            return "mov " + operand(a, size) + ", " + operand(b, size);
+        case Op::MOVSXD:
+            return "movsxd " + operand(a, 8) + ", " + operand(b, 4);
+        case Op::MOVZX8:
+            return "movzx " + operand(a, 4) + ", " + operand(b, 1);
+        case Op::LEA:
+            return "lea " + operand(a, size) + ", " + operand(b, 0);
+        case Op::ADD: case Op::SUB: case Op::AND: case Op::OR: case Op::XOR: case Op::CMP: case Op::TEST:
+            return std::string(mnemonic(inst.op)) + " " + operand(a, size) + ", " + operand(b, size);
+        case Op::IMUL:
+            return "imul " + operand(a, size) + ", " + operand(b, size) +
+                   (inst.c.kind == Operand::IMM ? ", " + operand(inst.c, size) : "");
+        case Op::IDIV: case Op::NEG:
+            return std::string(mnemonic(inst.op)) + " " + operand(a, size);
+        case Op::CDQ:
+            return size == 8 ? "cqo" : "cdq";
+        case Op::SHL: case Op::SAR: case Op::SHR:
+            return std::string(mnemonic(inst.op)) + " " + operand(a, size) + ", " + operand(b, size);
+        case Op::SETCC:
+            return std::string("set") + condNames[static_cast<int>(inst.cc)] + " " + operand(a, 1);
+        case Op::JCC:
+            return std::string("j") + condNames[static_cast<int>(inst.cc)] + " " + operand(a, 8);
+        case Op::JMP: case Op::CALL: case Op::PUSH: case Op::POP:
+            return std::string(mnemonic(inst.op)) + " " + operand(a, 8);
+        case Op::RET:
+            return "ret";
+        case Op::LEAVE:
+            return "leave";
+        case Op::REP_STOSD:
+            return "rep stosd";
+        case Op::MOVDQU:
+            return (vex ? "vmovdqu " : "movdqu ") + operand(a, size) + ", " + operand(b, size);
+        case Op::MOVD_TO_VEC:
+            return (vex ? "vmovd " : "movd ") + operand(a, 16) + ", " + operand(b, 4);
+        case Op::MOVD_FROM_VEC:
+            return (vex ? "vmovd " : "movd ") + operand(a, 4) + ", " + operand(b, 16);
+        case Op::PADDD: case Op::PSUBD: case Op::PMULLD: case Op::PXOR:
+            if (vex) {
+                return std::string("v") + mnemonic(inst.op) + " " + operand(a, size) + ", " + operand(a, size) +
+                       ", " + operand(b, size);
+            }
+            return std::string(mnemonic(inst.op)) + " " + operand(a, size) + ", " + operand(b, size);
+        case Op::PSHUFD:
+            return "pshufd " + operand(a, 16) + ", " + operand(b, 16) + ", " + operand(inst.c, 16);
+        case Op::VPBROADCASTD:
+            return "vpbroadcastd " + operand(a, 32) + ", " + operand(b, b.isMem() ? 4 : 16);
+        case Op::VEXTRACTI128:
+            return "vextracti128 " + operand(a, 16) + ", " + operand(b, 32) + ", 1";
+        case Op::VZEROUPPER:
+            return "vzeroupper";
+        case Op::LABEL:
+            return ".L" + std::to_string(a.id) + ":";
+        case Op::LINE:
+            return "# line " + std::to_string(a.imm);
+    }
+    return "?";
+}
+
+} // namespace
+
+void printListing(std::ostream& out, const Module& module, const ObjectCode& object,
+                  const std::vector<uint64_t>& offsets) {
+    size_t index = 0;
+    for (const MFunction& fun : module.functions) {
+        const Symbol& symbol = object.symbols[fun.symbol];
+        out << (index == 0 ? "" : "\n") << fun.name << ":\n";
+        for (size_t i = 0; i < fun.code.size(); i++, index++) {
+            const Inst& inst = fun.code[i];
+            // 标签顶格，行号与指令文本对齐
+            if (inst.op == Op::LABEL || inst.op == Op::LINE) {
+                out << std::string(inst.op == Op::LABEL ? 0 : 41, ' ') << instructionText(module, inst) << "\n";
+                continue;
+            }
+            uint64_t start = offsets[index];
+            uint64_t end = i + 1 < fun.code.size() ? offsets[index + 1] : symbol.offset + symbol.size;
+            char buffer[16];
+            std::snprintf(buffer, sizeof buffer, "  %6llx:  ", static_cast<unsigned long long>(start));
+            std::string bytes;
+            for (uint64_t p = start; p < end; p++) {
+                char hex[4];
+                std::snprintf(hex, sizeof hex, "%02x ", object.text[p]);
+                bytes += hex;
+            }
+            if (bytes.size() < 30) bytes.resize(30, ' ');
+            out << buffer << bytes << instructionText(module, inst) << "\n";
+        }
+    }
+}
+
+} // namespace x86
@@ -0,0 +1,149 @@
+#!/bin/bash
+# 差分测试：各执行引擎和优化选项的结果与树遍历解释器（--interp）一致
+#
+# 用法：differential.sh <cminus_compiler> <cminus_testgen> <libcminus.a> <cc> <c++> <programs目录> <随机程序个数>
+#
+# 比较标准输出、退出码和 "Runtime error" 行。测试程序：
+#   - <programs目录>/*.cm：回归测试，同名的 .in 为输入（默认 "3 5"），同名的 .modes 每行
+#     一组要比较的选项（默认为下面的全部）；
+#   - cminus_testgen 按种子 1..N 生成的随机程序；
+#   - 超出嵌套深度限制的长运算符链，各引擎都应报错而不是崩溃；
+#   - 没有引用的很大的全局数组，--ipo 删除它时占用的内存不随数组长度增长。
+# 选项 "c" 表示 --emit=c 后用 C 编译器构建运行，"obj" 表示 -O --emit=obj 后与 libcminus 链接运行
+# （并检查加上 --dump-asm 时目标文件不变），其后可以跟其他编译选项。有不一致时输出程序、选项和
+# 两边的结果，退出码为1。
+
+set -u
+compiler=$1
+testgen=$2
+library=$3
+cc=$4
+cxx=$5
+programs=$6
+count=$7
+
+work=$(mktemp -d "${TMPDIR:-/tmp}/cminus-differential.XXXXXX")
+trap 'rm -rf "$work"' EXIT
+
+defaultModes=(
+    "--vm"
+    "--vm --hash-cons --inline"
+    "--vm --ipo --cache-dir=$work/cache"
+    "--jit"
+    "--jit -O"
+    "--jit -O --inline --ipo"
+    "--jit -O --hash-cons --bounds-check"
+    "--jit -O --vector-isa=none"
+    "--interp --ipo --hash-cons --inline"
+    "c"
+    "c --bounds-check"
+    "obj"
+)
+
+failures=0
+checked=0
+
+# 运行一组选项，结果写到 $work/out.<name>：标准输出、退出码和运行时错误
+run() {
+    local name=$1 program=$2 input=$3 mode=$4
+    local result=$work/out.$name
+    local words=($mode)
+    case ${words[0]} in
+        c)
+            "$compiler" "$program" --emit=c "${words[@]:1}" -o "$work/prog.c" > /dev/null 2>&1 &&
+                "$cc" -O0 -w -o "$work/prog" "$work/prog.c" > /dev/null 2>&1 ||
+                { echo "build failed" > "$result"; return; }
+            ;;
+        obj)
+            "$compiler" "$program" -O --emit=obj "${words[@]:1}" -o "$work/prog.o" > /dev/null 2>&1 &&
+                "$cxx" -o "$work/prog" "$work/prog.o" "$library" > /dev/null 2>&1 ||
+                { echo "build failed" > "$result"; return; }
+            # 记录行号表（--dump-asm）不改变生成的代码
+            "$compiler" "$program" -O --emit=obj --dump-asm "${words[@]:1}" -o "$work/lines.o" > /dev/null 2>&1 &&
+                cmp -s "$work/prog.o" "$work/lines.o" ||
+                { echo "object differs with --dump-asm" > "$result"; return; }
+            ;;
+    esac
+    case ${words[0]} in
+        c|obj) timeout 20 "$work/prog" < "$input" > "$result" 2> "$work/err" ;;
+        *)     timeout 20 "$compiler" "$program" $mode < "$input" > "$result" 2> "$work/err" ;;
+    esac
+    echo "exit $?" >> "$result"
+    grep "Runtime error" "$work/err" >> "$result"
+}
+
+check() {
+    local program=$1 input=$2
+    shift 2
+    run reference "$program" "$input" "--interp"
+    local mode
+    for mode in "$@"; do
+        run actual "$program" "$input" "$mode"
+        checked=$((checked + 1))
+        if ! cmp -s "$work/out.reference" "$work/out.actual"; then
+            failures=$((failures + 1))
+            echo "MISMATCH: $program [$mode]"
+            diff "$work/out.reference" "$work/out.actual" | head -20
+        fi
+    done
+}
+
+echo "3 5" > "$work/default.in"
+
+for program in "$programs"/*.cm; do
+    [ -e "$program" ] || continue
+    base=${program%.cm}
+    input=$work/default.in
+    [ -e "$base.in" ] && input=$base.in
+    modes=("${defaultModes[@]}")
+    if [ -e "$base.modes" ]; then
+        mapfile -t modes < "$base.modes"
+    fi
+    check "$program" "$input" "${modes[@]}"
+done
+
+for seed in $(seq 1 "$count"); do
+    program=$work/random$seed.cm
+    "$testgen" "$seed" > "$program"
+    check "$program" "$work/default.in" "${defaultModes[@]}"
+    if [ "$failures" -gt 0 ] && [ ! -e "$work/kept" ]; then
+        cp "$program" "${TMPDIR:-/tmp}/cminus-differential-seed$seed.cm"
+        echo "kept ${TMPDIR:-/tmp}/cminus-differential-seed$seed.cm"
+        touch "$work/kept"
+    fi
+done
+
+# 很长的运算符链（左深的树）按嵌套深度的限制报错，不能耗尽递归遍历和析构的调用栈
+program=$work/chain.cm
+{
+    printf 'int main(void) {\n    output(1'
+    for ((i = 0; i < 100000; i++)); do printf ' + 1'; done
+    printf ');\n    return 0;\n}\n'
+} > "$program"
+for mode in "--interp" "--vm" "--jit -O" "--stream"; do
+    checked=$((checked + 1))
+    "$compiler" "$program" $mode < /dev/null > /dev/null 2> "$work/err"
+    status=$?
+    if [ "$status" -ne 1 ] || ! grep -q "Nesting too deep" "$work/err"; then
+        failures=$((failures + 1))
+        echo "MISMATCH: operator chain [$mode]: exit $status"
+        head -5 "$work/err"
+    fi
+done
+
+# 没有引用的全局数组（2^28-1 个 int）由 --ipo 删除，限制虚拟内存为512MB时也能编译运行
+program=$work/unused.cm
+printf 'int t[268435455];\nint main(void) {\n    output(input());\n    return 0;\n}\n' > "$program"
+for mode in "--interp --ipo" "--vm --ipo" "--jit -O --ipo"; do
+    checked=$((checked + 1))
+    result=$(echo 7 | (ulimit -v 524288; "$compiler" "$program" $mode 2> "$work/err"))
+    status=$?
+    if [ "$status" -ne 0 ] || [ "$result" != "7" ]; then
+        failures=$((failures + 1))
+        echo "MISMATCH: unused global array [$mode]: exit $status"
+        head -5 "$work/err"
+    fi
+done
+
+echo "$checked runs, $failures mismatches"
+[ "$failures" -eq 0 ]
@@ -0,0 +1,286 @@
+// 差分测试的随机程序生成器：cminus_testgen <种子>
+//
+// 生成一个能正常结束、没有运行时错误的 C- 程序，输出到标准输出。相同的种子总是得到相同的
+// 文本。程序覆盖各执行引擎和优化容易出错的地方：标量和局部、全局、参数数组（常数下标和
+// 变量下标）、嵌套的 if/while、可以向量化的循环、32位环绕的算术和除法、尾递归与相互递归、
+// 以常数为实参的调用和从不赋值的全局变量，以及 input/output。
+//
+// 下标总是折回 [0, 16)，除数总是 [2, 12) 中的数，递归的深度由参数限制，所以程序的
+// 行为对所有引擎都有定义，输出应与解释器完全一致。
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 数组长度（下标折回的范围）
+const int arraySize = 16;
+
+class TestGenerator {
+public:
+    explicit TestGenerator(uint64_t seed) : state(seed) {}
+
+    std::string generate() {
+        out += "/* cminus_testgen */\n";
+        out += "int g0 = " + number() + ";\n";
+        out += "int g1;\n";
+        out += "int c0 = " + number() + ";\n";  // 从不赋值
+        out += "int ga[" + std::to_string(arraySize) + "];\n";
+        out += "int gb[" + std::to_string(arraySize) + "];\n\n";
+
+        recursiveFunctions();
+        int count = 3 + below(5);
+        for (int i = 0; i < count; i++) {
+            function(i);
+        }
+        mainFunction(count);
+        return out;
+    }
+
+private:
+    // splitmix64
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    int below(int bound) { return static_cast<int>(next() % static_cast<uint64_t>(bound)); }
+
+    std::string number() {
+        switch (below(8)) {
+            case 0: return "2147483647";
+            case 1: return "65536";
+            default: return std::to_string(below(20));
+        }
+    }
+
+    std::string indent() const { return std::string(4 * depth, ' '); }
+
+    // 折回 [0, arraySize) 的下标
+    std::string index() {
+        if (below(3) == 0) return std::to_string(below(arraySize));
+        return "((" + expression(1) + ") % " + std::to_string(arraySize) + " + " + std::to_string(arraySize) +
+               ") % " + std::to_string(arraySize);
+    }
+
+    // 可以读取的数组：局部数组、参数数组和全局数组
+    std::string arrayName() {
+        std::vector<std::string> names{"ga", "gb"};
+        if (hasLocalArray) names.push_back("la");
+        if (hasParamArray) names.push_back("pv");
+        return names[below(static_cast<int>(names.size()))];
+    }
+
+    std::string leaf() {
+        switch (below(9)) {
+            case 0: case 1: return scalars[below(static_cast<int>(scalars.size()))];
+            case 2: return "g0";
+            case 3: return "c0";
+            case 4: return arrayName() + "[" + index() + "]";
+            default: return number();
+        }
+    }
+
+    std::string expression(int level) {
+        if (level <= 0 || below(3) == 0) return leaf();
+        std::string left = expression(level - 1);
+        std::string right = expression(level - 1);
+        switch (below(9)) {
+            case 0: case 1: return "(" + left + " + " + right + ")";
+            case 2: return "(" + left + " - " + right + ")";
+            case 3: case 4: return "(" + left + " * " + right + ")";
+            case 5: return "(" + left + " / (" + right + " % 5 + 7))";
+            case 6: return "(" + left + " % (" + right + " % 5 + 7))";
+            case 7: return "(" + left + relop() + right + ")";
+            default:
+                return call(left, right);
+        }
+    }
+
+    std::string relop() {
+        static const char* const ops[] = {" < ", " <= ", " > ", " >= ", " == ", " != "};
+        return ops[below(6)];
+    }
+
+    // 调用编号更小的函数（无环，一定结束）或有界的递归函数。循环中和超出每个函数的调用
+    // 次数时不调用其他的 f，运行时间不随函数个数指数增长
+    std::string call(const std::string& left, const std::string& right) {
+        int kind = below(4);
+        if (kind >= 2 && (callable == 0 || loopDepth > 0 || callsLeft == 0)) kind = below(3);
+        switch (kind) {
+            case 0: return "sum(" + std::to_string(below(30)) + ", " + left + ")";
+            case 1: return "even(" + std::to_string(below(40)) + ")";
+            case 2: return "(" + left + " + " + right + ")";
+            default: break;
+        }
+        callsLeft--;
+        int callee = below(callable);
+        std::string args = expression(0) + ", ";
+        args += calleeTakesArray[callee] ? arrayName() : expression(0);
+        return "f" + std::to_string(callee) + "(" + args + ")";
+    }
+
+    std::string assignable() {
+        switch (below(6)) {
+            case 0: return "g1";
+            case 1: return arrayName() + "[" + index() + "]";
+            case 2: return hasLocalArray ? "la[" + std::to_string(below(arraySize)) + "]" : "x";
+            case 3: return "y";
+            default: return "x";
+        }
+    }
+
+    void statements(int count) {
+        for (int i = 0; i < count; i++) statement();
+    }
+
+    void statement() {
+        int kind = below(10);
+        if (depth >= 3 && kind < 4) kind = 4 + below(6);
+        switch (kind) {
+            case 0: case 1: {
+                out += indent() + "if (" + expression(2) + ") {\n";
+                depth++;
+                statements(1 + below(3));
+                depth--;
+                if (below(2)) {
+                    out += indent() + "} else {\n";
+                    depth++;
+                    statements(1 + below(3));
+                    depth--;
+                }
+                out += indent() + "}\n";
+                break;
+            }
+            case 2: {
+                std::string counter = "i" + std::to_string(loopCounter++ % 2);
+                out += indent() + counter + " = 0;\n";
+                out += indent() + "while (" + counter + " < " + std::to_string(1 + below(4)) + ") {\n";
+                depth++;
+                loopDepth++;
+                statements(1 + below(3));
+                out += indent() + counter + " = " + counter + " + 1;\n";
+                loopDepth--;
+                depth--;
+                out += indent() + "}\n";
+                break;
+            }
+            case 3: {
+                // 可以向量化的循环
+                if (!hasLocalArray) break;
+                std::string counter = "i" + std::to_string(loopCounter++ % 2);
+                out += indent() + counter + " = 0;\n";
+                out += indent() + "while (" + counter + " < " + std::to_string(arraySize) + ") {\n";
+                out += indent() + "    la[" + counter + "] = la[" + counter + "] + ga[" + counter + "] * " +
+                       std::to_string(below(9)) + " - " + (below(2) ? "x" : "c0") + ";\n";
+                out += indent() + "    " + counter + " = " + counter + " + 1;\n";
+                out += indent() + "}\n";
+                break;
+            }
+            case 4:
+                out += indent() + "output(" + expression(2) + ");\n";
+                break;
+            case 5:
+                if (hasLocalArray) {
+                    // 连续的常数下标写入之后按变量下标读取
+                    int k = below(arraySize);
+                    out += indent() + "la[" + std::to_string(k) + "] = " + std::to_string(below(100)) + ";\n";
+                    out += indent() + "la[" + std::to_string((k + 1) % arraySize) + "] = " + expression(1) + ";\n";
+                    out += indent() + "x = la[" + index() + "];\n";
+                    break;
+                }
+                [[fallthrough]];
+            default:
+                out += indent() + assignable() + " = " + expression(2) + ";\n";
+                break;
+        }
+    }
+
+    // 有界的递归：尾递归求和与相互递归
+    void recursiveFunctions() {
+        out += "int sum(int n, int acc) {\n";
+        out += "    if (n <= 0) return acc;\n";
+        out += "    return sum(n - 1, acc + n);\n";
+        out += "}\n\n";
+        out += "int even(int n) {\n";
+        out += "    if (n == 0) return 1;\n";
+        out += "    return odd(n - 1);\n";
+        out += "}\n\n";
+        out += "int odd(int n) {\n";
+        out += "    if (n == 0) return 0;\n";
+        out += "    return even(n - 1);\n";
+        out += "}\n\n";
+    }
+
+    void function(int id) {
+        bool takesArray = below(2) == 0;
+        calleeTakesArray.push_back(takesArray);
+        out += "int f" + std::to_string(id) + "(int a, " + (takesArray ? "int pv[]" : "int b") + ") {\n";
+        out += "    int x;\n    int y;\n    int i0;\n    int i1;\n";
+        hasLocalArray = below(2) == 0;
+        hasParamArray = takesArray;
+        if (hasLocalArray) out += "    int la[" + std::to_string(arraySize) + "];\n";
+        scalars = {"a", "x", "y"};
+        if (!takesArray) scalars.push_back("b");
+        callable = id;
+        callsLeft = 1;
+        depth = 1;
+        out += "    x = " + expression(2) + ";\n";
+        statements(2 + below(5));
+        out += "    return " + expression(2) + ";\n";
+        out += "}\n\n";
+    }
+
+    void mainFunction(int count) {
+        out += "int main(void) {\n";
+        out += "    int x;\n    int y;\n    int a;\n    int i0;\n    int i1;\n";
+        out += "    int la[" + std::to_string(arraySize) + "];\n";
+        hasLocalArray = true;
+        hasParamArray = false;
+        scalars = {"a", "x", "y"};
+        callable = count;
+        callsLeft = 4;
+        depth = 1;
+        out += "    a = input();\n";
+        out += "    y = input();\n";
+        out += "    x = 0;\n";
+        statements(4 + below(6));
+        for (int i = 0; i < count; i++) {
+            out += "    output(f" + std::to_string(i) + "(" + std::to_string(below(10)) + ", " +
+                   (calleeTakesArray[i] ? "la" : expression(1)) + "));\n";
+        }
+        out += "    output(g0);\n    output(g1);\n";
+        out += "    output(ga[" + std::to_string(below(arraySize)) + "] + gb[" + std::to_string(below(arraySize)) +
+               "]);\n";
+        out += "    return x % 100;\n";
+        out += "}\n";
+    }
+
+    uint64_t state;
+    std::string out;
+    std::vector<bool> calleeTakesArray;
+    std::vector<std::string> scalars;
+    bool hasLocalArray = false;
+    bool hasParamArray = false;
+    int callable = 0;
+    int depth = 0;
+    int loopDepth = 0;
+    int callsLeft = 0;
+    int loopCounter = 0;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <seed>\n";
+        return 2;
+    }
+    std::cout << TestGenerator(std::strtoull(argv[1], nullptr, 10)).generate();
+    return 0;
+}